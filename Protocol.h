@@ -64,7 +64,7 @@ typedef enum {
 typedef enum {
 	SnapGameStateStart	= 0x01,
 	SnapGameStateEnd	= 0x02,
-	SnapGameStateSeat	= 0x03,   // TODO
+	SnapGameStateSeat	= 0x03,   // cid, tid, to-tid (moving) or seat (seated)
 	SnapGameStateNewHand	= 0x04,
 	SnapGameStateBlinds	= 0x05,
 	SnapGameStateWon	= 0x10,
@@ -99,6 +99,8 @@ typedef enum {
 typedef enum {
 	SnapFoyerJoin		= 0x01,
 	SnapFoyerLeave		= 0x02,
+	SnapFoyerUpdate		= 0x03,   // batched changes: +cid "name" / -cid
+	SnapFoyerRoster		= 0x04,   // more-flag followed by cid "name" pairs
 } snap_foyer_type;
 
 
@@ -122,6 +124,7 @@ typedef enum {
 	ErrParameters = 0x4,
 	ErrServerFull = 0x10,
 	ErrMaxConnectionsPerIP = 0x11,
+	ErrRateLimit = 0x12,
 	ErrNoPermission = 0x100,
 } cmderror;
 
@@ -131,8 +134,16 @@ typedef enum {
 	StatsClientsIntroduced		= 0x11,
 	StatsClientsIncompatible	= 0x12,
 	StatsGamesCreated		= 0x20,
+	StatsCommandsExecuted		= 0x30,
+	StatsCommandLatencyMedian	= 0x31,  // usec
+	StatsCommandLatencyP99		= 0x32,  // usec
+	StatsGameloopMedian		= 0x40,  // usec
+	StatsGameloopP99		= 0x41,  // usec
+	StatsDatabaseLatency		= 0x50,  // usec; last update
 	StatsClientCount		= 0x100,
 	StatsGamesCount			= 0x101,
+	StatsTablesCount		= 0x102,
+	StatsOutputQueued		= 0x103,  // bytes
 	StatsConarchiveCount		= 0x120,
 } serverstats_codes;
 
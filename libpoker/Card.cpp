@@ -33,6 +33,23 @@ static const char suit_symbols[] = {
 	'c', 'd', 'h', 's'
 };
 
+// card names indexed by Card::getMaskIndex()
+static const char card_names[52][3] = {
+	"2c", "2d", "2h", "2s",
+	"3c", "3d", "3h", "3s",
+	"4c", "4d", "4h", "4s",
+	"5c", "5d", "5h", "5s",
+	"6c", "6d", "6h", "6s",
+	"7c", "7d", "7h", "7s",
+	"8c", "8d", "8h", "8s",
+	"9c", "9d", "9h", "9s",
+	"Tc", "Td", "Th", "Ts",
+	"Jc", "Jd", "Jh", "Js",
+	"Qc", "Qd", "Qh", "Qs",
+	"Kc", "Kd", "Kh", "Ks",
+	"Ac", "Ad", "Ah", "As"
+};
+
 
 Card::Card()
 {
@@ -73,13 +90,7 @@ char Card::getSuitSymbol() const
 
 const char* Card::getName() const
 {
-	static char card_name[3];
-	
-	card_name[0] = getFaceSymbol();
-	card_name[1] = getSuitSymbol();
-	card_name[2] = '\0';
-	
-	return card_name;
+	return card_names[getMaskIndex()];
 }
 
 Card::Face Card::convertFaceSymbol(char fsym)
@@ -99,3 +110,29 @@ Card::Suit Card::convertSuitSymbol(char ssym)
 		
 	return Card::FirstSuit;
 }
+
+unsigned int Card::countMask(cardmask_type mask)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(mask);
+#else
+	unsigned int count = 0;
+	for (; mask; count++)
+		mask &= mask - 1;
+	
+	return count;
+#endif
+}
+
+unsigned int Card::highestMaskIndex(cardmask_type mask)
+{
+#if defined(__GNUC__)
+	return 63 - __builtin_clzll(mask);
+#else
+	unsigned int index = 0;
+	while (mask >>= 1)
+		index++;
+	
+	return index;
+#endif
+}
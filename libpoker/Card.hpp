@@ -24,6 +24,9 @@
 #ifndef _CARD_H
 #define _CARD_H
 
+// set of cards, one bit per card (see Card::getMask())
+typedef unsigned long long cardmask_type;
+
 class Card
 {
 public:
@@ -72,6 +75,17 @@ public:
 	bool operator >  (const Card &c) const { return (getFace() > c.getFace()); };
 	bool operator == (const Card &c) const { return (getFace() == c.getFace()); };
 	
+	//! \brief Bit index of the card in a cardmask_type; 2c is 0 and As is 51
+	unsigned int getMaskIndex() const { return (face - FirstFace) * 4 + (suit - FirstSuit); };
+	cardmask_type getMask() const { return 1ULL << getMaskIndex(); };
+	
+	static Card fromMaskIndex(unsigned int index) { return Card((Face) (FirstFace + index / 4), (Suit) (FirstSuit + index % 4)); };
+	
+	//! \brief Number of cards in the mask
+	static unsigned int countMask(cardmask_type mask);
+	//! \brief Bit index of the highest card in a non-empty mask
+	static unsigned int highestMaskIndex(cardmask_type mask);
+	
 	static Face convertFaceSymbol(char fsym);
 	static Suit convertSuitSymbol(char ssym);
 
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#ifndef _CARDARRAY_H
+#define _CARDARRAY_H
+
+#include <vector>
+
+#include "Card.hpp"
+
+
+//! \brief Up to Capacity cards kept inline, so copies never touch the heap
+//!
+//! Supports the subset of std::vector the card classes use. Cards pushed
+//! beyond the capacity are dropped.
+template <unsigned int Capacity>
+class CardArray
+{
+public:
+	typedef Card* iterator;
+	typedef const Card* const_iterator;
+	
+	CardArray() : count(0) {};
+	
+	void clear() { count = 0; };
+	unsigned int size() const { return count; };
+	bool empty() const { return !count; };
+	
+	void push_back(const Card &c) { if (count < Capacity) cards[count++] = c; };
+	void pop_back() { if (count) count--; };
+	
+	iterator erase(iterator pos)
+	{
+		for (iterator e = pos; e + 1 != end(); e++)
+			*e = *(e + 1);
+		count--;
+		return pos;
+	};
+	
+	template <typename InputIterator>
+	void append(InputIterator first, InputIterator last)
+	{
+		for (; first != last; first++)
+			push_back(*first);
+	};
+	
+	//! \brief Append the cards to a vector
+	void copyTo(std::vector<Card> *v) const { v->insert(v->end(), begin(), end()); };
+	
+	Card& operator[](unsigned int i) { return cards[i]; };
+	const Card& operator[](unsigned int i) const { return cards[i]; };
+	
+	Card& front() { return cards[0]; };
+	const Card& front() const { return cards[0]; };
+	Card& back() { return cards[count - 1]; };
+	const Card& back() const { return cards[count - 1]; };
+	
+	iterator begin() { return cards; };
+	iterator end() { return cards + count; };
+	const_iterator begin() const { return cards; };
+	const_iterator end() const { return cards + count; };
+	
+private:
+	Card cards[Capacity];
+	unsigned int count;
+};
+
+#endif /* _CARDARRAY_H */
@@ -64,5 +64,5 @@ bool CommunityCards::setRiver(Card c)
 
 void CommunityCards::debug()
 {
-	print_cards("Community", &cards);
+	print_cards("Community", cards.begin(), cards.size());
 }
@@ -27,6 +27,7 @@
 #include <vector>
 
 #include "Card.hpp"
+#include "CardArray.hpp"
 
 class CommunityCards
 {
@@ -46,11 +47,13 @@ public:
 	
 	void clear() { cards.clear(); };
 	
-	void copyCards(std::vector<Card> *v) const { v->insert(v->end(), cards.begin(), cards.end()); };
+	void copyCards(std::vector<Card> *v) const { cards.copyTo(v); };
+	template <unsigned int N>
+	void copyCards(CardArray<N> *v) const { v->append(cards.begin(), cards.end()); };
 	
 	void debug();
 private:
-	std::vector<Card> cards;
+	CardArray<5> cards;
 };
 
 #endif /* _COMMUNITYCARDS_H */
@@ -77,12 +77,12 @@ bool Deck::shuffle()
 
 void Deck::debug()
 {
-	print_cards("Deck", &cards);
+	print_cards("Deck", cards.begin(), cards.size());
 }
 
 void Deck::debugRemoveCard(Card card)
 {
-	for (vector<Card>::iterator e = cards.begin(); e != cards.end(); e++)
+	for (CardArray<52>::iterator e = cards.begin(); e != cards.end(); e++)
 	{
 		if (e->getFace() == card.getFace() && e->getSuit() == card.getSuit()) {
 			cards.erase(e);
@@ -137,7 +137,7 @@ void Deck::load()
 
 	for (size_t i = 0; i < v.size(); ++i)
 	{
-		vector<Card>::iterator it = cards.begin();
+		CardArray<52>::iterator it = cards.begin();
 		while (it != cards.end())
 		{
 			Card card = *it;
@@ -27,6 +27,7 @@
 #include <vector>
 
 #include "Card.hpp"
+#include "CardArray.hpp"
 
 class Deck
 {
@@ -46,7 +47,7 @@ public:
 	void load();
 	
 private:
-	std::vector<Card> cards;
+	CardArray<52> cards;	// copied along with the deck for insurance outs
 };
 
 #endif /* _DECK_H */
@@ -27,11 +27,11 @@ using namespace std;
 
 #if DEBUG
 
-void print_cards(const char *name, vector<Card> *cards)
+void print_cards(const char *name, const Card *cards, unsigned int count)
 {
 	fprintf(stderr, "[cards]: %s: [[ ", name);
-	for (vector<Card>::iterator e = cards->begin(); e != cards->end(); e++)
-		fprintf(stderr, "%s ", e->getName());
+	for (unsigned int i=0; i < count; i++)
+		fprintf(stderr, "%s ", cards[i].getName());
 	
 	fprintf(stderr, "]]\n");
 }
@@ -30,7 +30,7 @@
 #include "Card.hpp"
 
 #if DEBUG
-void print_cards(const char *name, std::vector<Card> *cards);
+void print_cards(const char *name, const Card *cards, unsigned int count);
 #else
 # define print_cards(args...)
 #endif
@@ -47,7 +47,7 @@ using namespace std;
 
 bool GameLogic::getStrength(const HoleCards *hole, const CommunityCards *community, HandStrength *strength)
 {
-	vector<Card> allcards;
+	CardArray<7> allcards;
 	
 	// merge hole- and community-cards
 	hole->copyCards(&allcards);
@@ -57,18 +57,30 @@ bool GameLogic::getStrength(const HoleCards *hole, const CommunityCards *communi
 }
 
 bool GameLogic::getStrength(vector<Card> *allcards, HandStrength *strength)
+{
+	CardArray<7> cards;
+	cards.append(allcards->begin(), allcards->end());
+	
+	const bool retval = getStrength(&cards, strength);
+	
+	// the cards are sorted like before
+	copy(cards.begin(), cards.end(), allcards->begin());
+	
+	return retval;
+}
+
+bool GameLogic::getStrength(CardArray<7> *allcards, HandStrength *strength)
 {
 	HandStrength::Ranking *r = &(strength->ranking);
-	strength->allcards.clear();
-	strength->allcards.insert(strength->allcards.end(), allcards->begin(), allcards->end());
-	vector<Card> *rank = &(strength->rank);
-	vector<Card> *kicker = &(strength->kicker);
+	strength->allcards = *allcards;
+	CardArray<5> *rank = &(strength->rank);
+	CardArray<5> *kicker = &(strength->kicker);
 
 	// sort them descending
 	sort(allcards->begin(), allcards->end(), greater<Card>());
 
 #if 0
-	print_cards("AllCards", &allcards);
+	print_cards("AllCards", allcards->begin(), allcards->size());
 #endif
 
 	// clear rank and kicker
@@ -100,14 +112,14 @@ bool GameLogic::getStrength(vector<Card> *allcards, HandStrength *strength)
 		rank->push_back(allcards->front());
 
 		kicker->clear();
-		for (vector<Card>::iterator e = allcards->begin() + 1; e != allcards->end() && kicker->size() < 4; e++)
+		for (CardArray<7>::iterator e = allcards->begin() + 1; e != allcards->end() && kicker->size() < 4; e++)
 			kicker->push_back(*e);
 	}
 
 #if 0
 	log_msg("getStrength", "Strength: %s", HandStrength::getRankingName(*r));
-	print_cards("Rank", rank);
-	print_cards("Kicker", kicker);
+	print_cards("Rank", rank->begin(), rank->size());
+	print_cards("Kicker", kicker->begin(), kicker->size());
 #endif
 
 	return true;
@@ -115,15 +127,15 @@ bool GameLogic::getStrength(vector<Card> *allcards, HandStrength *strength)
 
 bool GameLogic::getStrength(Card newCard, HandStrength *strength)
 {
-	vector<Card> allcard = strength->allcards;
+	CardArray<7> allcard = strength->allcards;
 	allcard.push_back(newCard);
 	return getStrength(&allcard, strength);
 }
 
-bool GameLogic::isTwoPair(std::vector<Card> *allcards, std::vector<Card> *rank, std::vector<Card> *kicker)
+bool GameLogic::isTwoPair(CardArray<7> *allcards, CardArray<5> *rank, CardArray<5> *kicker)
 {
 	bool is_twopair = false;
-	vector<Card> trank, tkicker;  // tkicker is unused dummy
+	CardArray<5> trank, tkicker;  // tkicker is unused dummy
 	
 	// contains first Pair
 	if (isXOfAKind(allcards, 2, &trank, &tkicker))
@@ -142,7 +154,7 @@ bool GameLogic::isTwoPair(std::vector<Card> *allcards, std::vector<Card> *rank,
 			
 			// copy remaining one kicker
 			kicker->clear();
-			for (vector<Card>::iterator e = allcards->begin(); e != allcards->end() && kicker->size() < 1; e++)
+			for (CardArray<7>::iterator e = allcards->begin(); e != allcards->end() && kicker->size() < 1; e++)
 				if (e->getFace() != fp.getFace() && e->getFace() != sp.getFace())
 					kicker->push_back(*e);
 			
@@ -153,13 +165,13 @@ bool GameLogic::isTwoPair(std::vector<Card> *allcards, std::vector<Card> *rank,
 	return is_twopair;
 }
 
-bool GameLogic::isStraight(vector<Card> *allcards, const int suit, vector<Card> *rank)
+bool GameLogic::isStraight(CardArray<7> *allcards, const int suit, CardArray<5> *rank)
 {
 	bool is_straight = false;
 	int last_face = -1, count = 0;
 	Card high;
 	
-	for (vector<Card>::iterator e = allcards->begin(); e != allcards->end(); e++)
+	for (CardArray<7>::iterator e = allcards->begin(); e != allcards->end(); e++)
 	{
 		// ignore wrong suit when testing for StraightFlush
 		if (suit != -1 && e->getSuit() != suit)
@@ -203,14 +215,14 @@ bool GameLogic::isStraight(vector<Card> *allcards, const int suit, vector<Card>
 	return is_straight;
 }
 
-bool GameLogic::isFlush(vector<Card> *allcards, vector<Card> *rank)
+bool GameLogic::isFlush(CardArray<7> *allcards, CardArray<5> *rank)
 {
 	bool is_flush = false;
 	Card::Suit flush_suit;
 	int suit_count[4] = {0, 0, 0, 0};
 	
 	// count same suits
-	for (vector<Card>::iterator e = allcards->begin(); e != allcards->end(); e++)
+	for (CardArray<7>::iterator e = allcards->begin(); e != allcards->end(); e++)
 	{
 		if (++suit_count[e->getSuit() - Card::FirstSuit] == 5)
 		{
@@ -225,7 +237,7 @@ bool GameLogic::isFlush(vector<Card> *allcards, vector<Card> *rank)
 		// copy all cards with flush suit as rank; max 5 cards
 		rank->clear();
 		
-		for (vector<Card>::iterator e = allcards->begin(); e != allcards->end() && rank->size() < 5; e++)
+		for (CardArray<7>::iterator e = allcards->begin(); e != allcards->end() && rank->size() < 5; e++)
 			if (e->getSuit() == flush_suit)
 				rank->push_back(*e);
 	}
@@ -233,7 +245,7 @@ bool GameLogic::isFlush(vector<Card> *allcards, vector<Card> *rank)
 	return is_flush;
 }
 
-bool GameLogic::isXOfAKind(vector<Card> *allcards, const unsigned int n, vector<Card> *rank, vector<Card> *kicker)
+bool GameLogic::isXOfAKind(CardArray<7> *allcards, const unsigned int n, CardArray<5> *rank, CardArray<5> *kicker)
 {
 	bool is_xofakind = false;
 	int face = -1;
@@ -241,7 +253,7 @@ bool GameLogic::isXOfAKind(vector<Card> *allcards, const unsigned int n, vector<
 	unsigned int count = 0;
 	
 	// count face of cards, break on n of a kind
-	for (vector<Card>::iterator e = allcards->begin(); e != allcards->end(); e++)
+	for (CardArray<7>::iterator e = allcards->begin(); e != allcards->end(); e++)
 	{
 		// ignore face which might be in rank-vector at first index
 		if (rank->size() && rank->begin()->getFace() == e->getFace())
@@ -274,7 +286,7 @@ bool GameLogic::isXOfAKind(vector<Card> *allcards, const unsigned int n, vector<
 		rank->push_back(high);
 		
 		// copy the kicker; max (5-n) card
-		for (vector<Card>::iterator e = allcards->begin(); e != allcards->end() && kicker->size() < (5 - n); e++)
+		for (CardArray<7>::iterator e = allcards->begin(); e != allcards->end() && kicker->size() < (5 - n); e++)
 			if (e->getFace() != face)
 				kicker->push_back(*e);
 	}
@@ -282,10 +294,10 @@ bool GameLogic::isXOfAKind(vector<Card> *allcards, const unsigned int n, vector<
 	return is_xofakind;
 }
 
-bool GameLogic::isFullHouse(vector<Card> *allcards, vector<Card> *rank)
+bool GameLogic::isFullHouse(CardArray<7> *allcards, CardArray<5> *rank)
 {
 	bool is_fullhouse = false;
-	vector<Card> trank, tkicker;  // tkicker is unused dummy
+	CardArray<5> trank, tkicker;  // tkicker is unused dummy
 	
 	// contains ThreeOfAKind
 	if (isXOfAKind(allcards, 3, &trank, &tkicker))
@@ -309,16 +321,23 @@ bool GameLogic::isFullHouse(vector<Card> *allcards, vector<Card> *rank)
 	return is_fullhouse;
 }
 
-bool GameLogic::getWinList(vector<HandStrength> &hands, vector< vector<HandStrength> > &winlist)
+bool GameLogic::getWinList(vector<HandStrength> &hands, vector< vector<HandStrength> > &winlist,
+	vector< vector<HandStrength> > *spare)
 {
-	winlist.clear();
-	winlist.push_back(hands);
+	unsigned int groups = 1;
+	if (winlist.empty())
+		addWinGroup(winlist, spare);
+	winlist[0].assign(hands.begin(), hands.end());
 	
 	unsigned int index=0;
 	do
 	{
+		if (winlist.size() == groups)
+			addWinGroup(winlist, spare);
+		
 		vector<HandStrength> &tw = winlist[index];
-		vector<HandStrength> tmp;
+		vector<HandStrength> &tmp = winlist[groups];
+		tmp.clear();
 		
 		sort(tw.begin(), tw.end(), greater<HandStrength>());
 		
@@ -334,119 +353,105 @@ bool GameLogic::getWinList(vector<HandStrength> &hands, vector< vector<HandStren
 		if (!tmp.size())
 			break;
 		
-		winlist.push_back(tmp);
+		groups++;
 		index++;
 		
 	} while (true);
 	
+	// keep the groups left over for the next call
+	while (winlist.size() > groups)
+	{
+		if (spare)
+		{
+			spare->push_back(vector<HandStrength>());
+			spare->back().swap(winlist.back());
+		}
+		
+		winlist.pop_back();
+	}
+	
 	return true;
 }
 
+void GameLogic::addWinGroup(vector< vector<HandStrength> > &winlist, vector< vector<HandStrength> > *spare)
+{
+	winlist.push_back(vector<HandStrength>());
+	
+	if (spare && !spare->empty())
+	{
+		winlist.back().swap(spare->back());
+		spare->pop_back();
+	}
+}
+
 
-bool GameLogic::getInsuranceOuts(HandStrength* winner_hands, std::vector<HandStrength> *loser_hands, Deck deck, std::vector<Card> *outs, std::map<int, std::vector<Card> > *every_single_outs)
+bool GameLogic::getInsuranceOuts(HandStrength* winner_hands, std::vector<HandStrength> *loser_hands, Deck deck, cardmask_type *outs, cardmask_type *every_single_outs)
 {
 	while (deck.count() > 0)
 	{
 		Card c;
 		deck.pop(c);
+		const cardmask_type bit = c.getMask();
 
 		HandStrength w_hands = *winner_hands;
 		GameLogic::getStrength(c, &w_hands);
-		std::vector<HandStrength> l_hands = *loser_hands;
-		for (size_t i = 0; i < l_hands.size(); ++i)
+		for (size_t i = 0; i < loser_hands->size(); ++i)
 		{
-			GameLogic::getStrength(c, &l_hands[i]);
+			HandStrength l_hand = (*loser_hands)[i];
+			GameLogic::getStrength(c, &l_hand);
 
-			if (l_hands[i] > w_hands)
+			if (l_hand > w_hands)
 			{
 				if (outs)
-				{
-					bool find = false;
-					for (size_t j = 0; j < outs->size(); ++j)
-					{
-						if ((*outs)[j].getFace() == c.getFace() && (*outs)[j].getSuit() == c.getSuit())
-						{
-							find = true;
-							break;
-						}
-					}
-					if (find == false)
-					{
-						outs->push_back(c);
-					}
-				}
+					*outs |= bit;
 
 				if (every_single_outs)
-				{
-					bool find = false;
-					for (size_t j = 0; j < (*every_single_outs)[l_hands[i].getId()].size(); ++j)
-					{
-						if ((*every_single_outs)[l_hands[i].getId()][j].getFace() == c.getFace() && (*every_single_outs)[l_hands[i].getId()][j].getSuit() == c.getSuit())
-						{
-							find = true;
-							break;
-						}
-					}
-                    if (!find)
-					    (*every_single_outs)[l_hands[i].getId()].push_back(c);
-				}
+					every_single_outs[l_hand.getId()] |= bit;
 			}
 		}
 	}
 	return true;
 }
 
-bool GameLogic::getInsuranceOutsDivided(HandStrength* winner_hands, std::vector<HandStrength> &hands, std::vector< std::vector<HandStrength> > *ori_winlist, Deck deck, std::vector<Card> *outs_divided)
+bool GameLogic::getInsuranceOutsDivided(HandStrength* winner_hands, std::vector<HandStrength> &hands, std::vector< std::vector<HandStrength> > *ori_winlist, Deck deck, cardmask_type *outs_divided)
 {
     while (deck.count() > 0)
     {
         Card c;
         deck.pop(c);
 
-        std::vector<HandStrength> hs;
+        // the best hands after this card, as the first group of a winlist would hold them
+        HandStrength best;
+        unsigned int best_count = 0;
+        bool find = false;
         for (size_t i = 0; i < hands.size(); ++ i)
         {
             HandStrength hand = hands[i];
             GameLogic::getStrength(c, &hand);
-            hs.push_back(hand);
-        }
-
-        vector< vector<HandStrength> > winlist;
-        GameLogic::getWinList(hs, winlist);
 
-        if (winlist[0].size() > (*ori_winlist)[0].size())
-        {
-            bool find = false;
-            for (size_t i = 0; i < winlist[0].size(); ++ i)
+            if (!best_count || hand > best)
             {
-                if (winlist[0].at(i).getId() == winner_hands->getId())
-                {
-                    find = true;
-                    break;
-                }
+                best = hand;
+                best_count = 1;
+                find = (hand.getId() == winner_hands->getId());
             }
-            if (find)
+            else if (!(hand < best))
             {
-                outs_divided->push_back(c);
+                best_count++;
+                if (hand.getId() == winner_hands->getId())
+                    find = true;
             }
         }
+
+        if (best_count > (*ori_winlist)[0].size() && find)
+        {
+            *outs_divided |= c.getMask();
+        }
     }
     return true;
 }
 
 
-bool GameLogic::cardInList(Card card, std::vector<Card>* cards)
-{
-	for (size_t i = 0; i < cards->size(); ++ i)
-	{
-		if (cards->at(i).getFace() == card.getFace() && cards->at(i).getSuit() == card.getSuit())
-		{
-			return true;
-		}
-	}
-	return false;
-}
-
 const char* HandStrength::getRankingName(Ranking r)
 {
 	static const char *sstr[] = {
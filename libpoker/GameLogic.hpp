@@ -24,11 +24,13 @@
 #ifndef _GAMELOGIC_H
 #define _GAMELOGIC_H
 
+#include <cstddef>
 #include <vector>
 #include <map>
 #include <set>
 
 #include "Card.hpp"
+#include "CardArray.hpp"
 #include "HoleCards.hpp"
 #include "CommunityCards.hpp"
 #include "Deck.hpp"
@@ -53,8 +55,8 @@ public:
 	Ranking getRanking() const { return ranking; };
 	static const char* getRankingName(Ranking r);
 	
-	void copyRankCards(std::vector<Card> *v) const { v->insert(v->end(), rank.begin(), rank.end()); };
-	void copyKickerCards(std::vector<Card> *v) const { v->insert(v->end(), kicker.begin(), kicker.end()); };
+	void copyRankCards(std::vector<Card> *v) const { rank.copyTo(v); };
+	void copyKickerCards(std::vector<Card> *v) const { kicker.copyTo(v); };
 	
 	void setId(int rid) { id = rid; };
 	int getId() const { return id; };
@@ -65,9 +67,9 @@ public:
 	
 private:
 	Ranking ranking;
-	std::vector<Card> rank;
-	std::vector<Card> kicker;
-	std::vector<Card> allcards;
+	CardArray<5> rank;
+	CardArray<5> kicker;
+	CardArray<7> allcards;
 	
 	int id;  // identifier; can be used for associating player
 };
@@ -78,19 +80,28 @@ public:
 	GameLogic();
 	
 	static bool getStrength(std::vector<Card> *allcards, HandStrength *strength);
+	static bool getStrength(CardArray<7> *allcards, HandStrength *strength);
 	static bool getStrength(const HoleCards *hole, const CommunityCards *community, HandStrength *strength);
 	static bool getStrength(Card newCard, HandStrength *strength);
 
-	static bool isTwoPair(std::vector<Card> *allcards, std::vector<Card> *rank, std::vector<Card> *kicker);
-	static bool isStraight(std::vector<Card> *allcards, const int suit, std::vector<Card> *rank);
-	static bool isFlush(std::vector<Card> *allcards, std::vector<Card> *rank);
-	static bool isXOfAKind(std::vector<Card> *allcards, const unsigned int n, std::vector<Card> *rank, std::vector<Card> *kicker);
-	static bool isFullHouse(std::vector<Card> *allcards, std::vector<Card> *rank);
+	static bool isTwoPair(CardArray<7> *allcards, CardArray<5> *rank, CardArray<5> *kicker);
+	static bool isStraight(CardArray<7> *allcards, const int suit, CardArray<5> *rank);
+	static bool isFlush(CardArray<7> *allcards, CardArray<5> *rank);
+	static bool isXOfAKind(CardArray<7> *allcards, const unsigned int n, CardArray<5> *rank, CardArray<5> *kicker);
+	static bool isFullHouse(CardArray<7> *allcards, CardArray<5> *rank);
 	
-	static bool getWinList(std::vector<HandStrength> &hands, std::vector< std::vector<HandStrength> > &winlist);
-	static bool getInsuranceOuts(HandStrength* winner_hands, std::vector<HandStrength> *loser_hands, Deck deck, std::vector<Card> *outs, std::map<int, std::vector<Card> > *every_single_outs);
-    static bool getInsuranceOutsDivided(HandStrength* winner_hands, std::vector<HandStrength> &hands, std::vector< std::vector<HandStrength> > *ori_winlist, Deck deck, std::vector<Card> *outs_divided);
-    static bool cardInList(Card card, std::vector<Card>* cards);
+	//! \brief Group hands by strength, best first
+	//!
+	//! Groups already in winlist are refilled. Groups no longer needed are
+	//! moved to spare and taken from there again, so their storage is reused.
+	static bool getWinList(std::vector<HandStrength> &hands, std::vector< std::vector<HandStrength> > &winlist,
+		std::vector< std::vector<HandStrength> > *spare=NULL);
+	//! \brief Cards of the deck that let a loser overtake the winner; every_single_outs is indexed by the losers' ids
+	static bool getInsuranceOuts(HandStrength* winner_hands, std::vector<HandStrength> *loser_hands, Deck deck, cardmask_type *outs, cardmask_type *every_single_outs);
+    static bool getInsuranceOutsDivided(HandStrength* winner_hands, std::vector<HandStrength> &hands, std::vector< std::vector<HandStrength> > *ori_winlist, Deck deck, cardmask_type *outs_divided);
+
+private:
+	static void addWinGroup(std::vector< std::vector<HandStrength> > &winlist, std::vector< std::vector<HandStrength> > *spare);
 };
 
 
@@ -28,7 +28,7 @@ using namespace std;
 
 HoleCards::HoleCards()
 {
-
+	clear();
 }
 
 bool HoleCards::setCards(Card c1, Card c2)
@@ -37,9 +37,8 @@ bool HoleCards::setCards(Card c1, Card c2)
 	cards.push_back(c1);
 	cards.push_back(c2);
 	
-    showcards.clear();
-	showcards.push_back(false);
-	showcards.push_back(false);
+	showcards[0] = false;
+	showcards[1] = false;
 
 	return true;
 }
@@ -55,22 +54,7 @@ bool HoleCards::setShowCard(int which, bool show)
 	return true;
 }
 
-std::string HoleCards::showCards() 
-{
-    std::string shole;
-    for (size_t i = 0; i < cards.size(); i++) {
-        shole += "_";
-        if (showcards[i]) {
-            shole += cards[i].getName();
-        } else {
-            shole += "-";
-        }
-    }
-
-    return shole;
-}
-
 void HoleCards::debug()
 {
-	print_cards("Hole", &cards);
+	print_cards("Hole", cards.begin(), cards.size());
 }
@@ -28,6 +28,7 @@
 #include <string>
 
 #include "Card.hpp"
+#include "CardArray.hpp"
 
 class HoleCards
 {
@@ -36,17 +37,19 @@ public:
 	
 	bool setCards(Card c1, Card c2);
     bool setShowCard(int which, bool show);
-	void clear() { cards.clear(); showcards.clear();};
+	void clear() { cards.clear(); showcards[0] = showcards[1] = false; };
 	
-	void copyCards(std::vector<Card> *v) const { v->insert(v->end(), cards.begin(), cards.end()); };
-    std::string showCards();
+	void copyCards(std::vector<Card> *v) const { cards.copyTo(v); };
+	template <unsigned int N>
+	void copyCards(CardArray<N> *v) const { v->append(cards.begin(), cards.end()); };
+    bool isCardShown(unsigned int which) const { return which < cards.size() && showcards[which]; };
 	Card * getC1() { if (cards.size() > 0) return &cards[0]; else return NULL; };
 	Card * getC2() { if (cards.size() > 1) return &cards[1]; else return NULL; };
 	
 	void debug();
 private:
-	std::vector<Card> cards;
-	std::vector<bool> showcards;
+	CardArray<2> cards;
+	bool showcards[2];
 };
 
 #endif /* _HOLECARDS_H */
@@ -39,6 +39,9 @@ Player::Player()
     rebuy_stake = 0;
     timedout_count = 0;
     timeout = 0;
+    
+    insuraceInfo[0].pots_count = 0;
+    insuraceInfo[1].pots_count = 0;
 }
 
 void Player::clearInsuranceInfo()
@@ -48,13 +51,13 @@ void Player::clearInsuranceInfo()
         insuraceInfo[i].bought = false;
         insuraceInfo[i].buy_amount = 0;
         insuraceInfo[i].max_payment = 0;
-        insuraceInfo[i].buy_cards.clear();
-        insuraceInfo[i].outs.clear();
-        insuraceInfo[i].outs_divided.clear();
-        insuraceInfo[i].every_single_outs.clear();
+        insuraceInfo[i].buy_cards = 0;
+        insuraceInfo[i].outs = 0;
+        insuraceInfo[i].outs_divided = 0;
+        for (size_t j = 0; j < 10; ++j)
+            insuraceInfo[i].every_single_outs[j] = 0;
         insuraceInfo[i].res_amount = 0;
-        insuraceInfo[i].buy_pots.clear();
-        insuraceInfo[i].pots_investment.clear();
+        insuraceInfo[i].pots_count = 0;
     }
     log_msg("player", "%d clear insurance info", seat_no);
 }
@@ -40,6 +40,7 @@ friend class GameController;
 friend class SitAndGoGameController;
 friend class SNGGameController;
 friend class TestCaseGameController;
+friend class BenchTable;
 friend class Table;
 
 public:
@@ -75,16 +76,18 @@ public:
 		// 
 		chips_type buy_amount;
 		// outs
-		std::vector<Card> outs;
-	    std::vector<Card> outs_divided;
+		cardmask_type outs;
+	    cardmask_type outs_divided;
         // outs
-        std::map<int, std::vector<Card> > every_single_outs;
+        cardmask_type every_single_outs[10];	// by seat
 		// outs
-		std::vector<Card> buy_cards;
+		cardmask_type buy_cards;
 		// Ǯ
 		chips_type res_amount;
-        std::vector<chips_type> buy_pots;
-        std::vector<chips_type> pots_investment;
+        // insured pots and the share invested into them, at most one pot per seat
+        chips_type buy_pots[10];
+        chips_type pots_investment[10];
+        unsigned int pots_count;
     }InsuranceInfo;
 	
 	Player();
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include "ConnectionArchive.hpp"
+
+using namespace std;
+
+
+ConnectionArchive::ConnectionArchive()
+{
+	max_per_ip = 0;
+	max_entries = 0;
+}
+
+void ConnectionArchive::setLimits(unsigned int max_per_ip, unsigned int max_entries)
+{
+	this->max_per_ip = max_per_ip;
+	this->max_entries = max_entries;
+}
+
+void ConnectionArchive::heapSwap(int a, int b)
+{
+	entry *tmp = heap[a];
+	heap[a] = heap[b];
+	heap[b] = tmp;
+	
+	heap[a]->heap_pos = a;
+	heap[b]->heap_pos = b;
+}
+
+void ConnectionArchive::heapUp(int pos)
+{
+	while (pos > 0)
+	{
+		const int parent = (pos - 1) / 2;
+		if (heap[parent]->expire_time <= heap[pos]->expire_time)
+			break;
+		
+		heapSwap(pos, parent);
+		pos = parent;
+	}
+}
+
+void ConnectionArchive::heapDown(int pos)
+{
+	const int size = heap.size();
+	
+	for (;;)
+	{
+		const int left = pos * 2 + 1;
+		const int right = left + 1;
+		int smallest = pos;
+		
+		if (left < size && heap[left]->expire_time < heap[smallest]->expire_time)
+			smallest = left;
+		if (right < size && heap[right]->expire_time < heap[smallest]->expire_time)
+			smallest = right;
+		
+		if (smallest == pos)
+			break;
+		
+		heapSwap(pos, smallest);
+		pos = smallest;
+	}
+}
+
+// put a disconnected entry into the expiry heap and its IP list
+void ConnectionArchive::archive(entry *e)
+{
+	e->heap_pos = heap.size();
+	heap.push_back(e);
+	heapUp(e->heap_pos);
+	
+	ip_list &l = ips[e->ip];
+	
+	e->ip_prev = l.count ? l.last : 0;
+	e->ip_next = 0;
+	
+	if (l.count)
+		l.last->ip_next = e;
+	else
+		l.first = e;
+	
+	l.last = e;
+	l.count++;
+}
+
+// take an entry out of the expiry heap and its IP list
+void ConnectionArchive::unarchive(entry *e)
+{
+	if (e->heap_pos < 0)
+		return;
+	
+	const int pos = e->heap_pos;
+	const int last = heap.size() - 1;
+	
+	if (pos != last)
+	{
+		heapSwap(pos, last);
+		heap.pop_back();
+		
+		// restore heap order for the entry moved into the gap
+		entry *moved = heap[pos];
+		heapUp(pos);
+		heapDown(moved->heap_pos);
+	}
+	else
+		heap.pop_back();
+	
+	e->heap_pos = -1;
+	
+	unordered_map<unsigned int,ip_list>::iterator it = ips.find(e->ip);
+	ip_list &l = it->second;
+	
+	if (e->ip_prev)
+		e->ip_prev->ip_next = e->ip_next;
+	else
+		l.first = e->ip_next;
+	
+	if (e->ip_next)
+		e->ip_next->ip_prev = e->ip_prev;
+	else
+		l.last = e->ip_prev;
+	
+	if (!--l.count)
+		ips.erase(it);
+}
+
+void ConnectionArchive::remove(entry *e)
+{
+	unarchive(e);
+	
+	// copy key; e is part of the map node being erased
+	const string uuid = e->uuid;
+	entries.erase(uuid);
+}
+
+void ConnectionArchive::add(const string &uuid, int cid)
+{
+	unordered_map<string,entry>::iterator it = entries.find(uuid);
+	entry *e;
+	
+	if (it == entries.end())
+	{
+		e = &entries[uuid];
+		e->uuid = uuid;
+		e->heap_pos = -1;
+	}
+	else
+	{
+		e = &it->second;
+		unarchive(e);
+	}
+	
+	e->id = cid;
+	e->logout_time = 0;
+	e->expire_time = 0;
+	e->ip = 0;
+	e->ip_prev = e->ip_next = 0;
+}
+
+void ConnectionArchive::logout(const string &uuid, unsigned int ip, time_t expire_time)
+{
+	unordered_map<string,entry>::iterator it = entries.find(uuid);
+	if (it == entries.end())
+		return;
+	
+	entry *e = &it->second;
+	unarchive(e);
+	
+	e->logout_time = time(NULL);
+	e->expire_time = expire_time;
+	e->ip = ip;
+	
+	archive(e);
+	
+	// keep only the latest entries for each IP
+	if (max_per_ip)
+	{
+		ip_list &l = ips[ip];
+		while (l.count > max_per_ip)
+			remove(l.first);
+	}
+	
+	// bound total count of disconnected entries; drop the ones expiring first
+	if (max_entries)
+	{
+		while (heap.size() > max_entries)
+			remove(heap[0]);
+	}
+}
+
+const ConnectionArchive::entry* ConnectionArchive::find(const string &uuid) const
+{
+	unordered_map<string,entry>::const_iterator it = entries.find(uuid);
+	if (it == entries.end())
+		return 0;
+	
+	return &it->second;
+}
+
+unsigned int ConnectionArchive::expire(time_t now)
+{
+	unsigned int count = 0;
+	
+	while (heap.size() && heap[0]->expire_time <= now)
+	{
+		remove(heap[0]);
+		count++;
+	}
+	
+	return count;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _CONNECTIONARCHIVE_H
+#define _CONNECTIONARCHIVE_H
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+//! \brief Archive of client connections by UUID for re-assigning client ids
+//
+// Entries of connected clients never expire. Once a client disconnects its
+// entry is put into an expiry min-heap and onto a per-IP list; expiring,
+// per-IP and total limits then only touch the entries being removed.
+class ConnectionArchive
+{
+public:
+	typedef struct entry {
+		std::string uuid;
+		int id;
+		time_t logout_time;	// 0 while connected
+		time_t expire_time;
+		unsigned int ip;
+		int heap_pos;		// -1 while connected
+		struct entry *ip_prev;	// per-IP list, oldest logout first
+		struct entry *ip_next;
+	} entry;
+	
+	ConnectionArchive();
+	
+	void setLimits(unsigned int max_per_ip, unsigned int max_entries);
+	
+	//! \brief Store (or re-activate) the entry of a connected client
+	void add(const std::string &uuid, int cid);
+	
+	//! \brief Mark entry as disconnected; it is removed at expire_time
+	void logout(const std::string &uuid, unsigned int ip, time_t expire_time);
+	
+	//! \brief Returns NULL if no entry exists
+	const entry* find(const std::string &uuid) const;
+	
+	//! \brief Remove all entries expired at time now; returns count of removed entries
+	unsigned int expire(time_t now);
+	
+	unsigned int size() const { return entries.size(); };
+	
+private:
+	typedef struct {
+		entry *first;
+		entry *last;
+		unsigned int count;
+	} ip_list;
+	
+	void archive(entry *e);
+	void unarchive(entry *e);
+	void remove(entry *e);
+	
+	void heapSwap(int a, int b);
+	void heapUp(int pos);
+	void heapDown(int pos);
+	
+	std::unordered_map<std::string,entry> entries;
+	std::unordered_map<unsigned int,ip_list> ips;
+	std::vector<entry*> heap;	// disconnected entries, earliest expiry on top
+	
+	unsigned int max_per_ip;
+	unsigned int max_entries;
+};
+
+#endif /* _CONNECTIONARCHIVE_H */
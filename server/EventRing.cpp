@@ -0,0 +1,89 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <cstring>
+
+#include "EventRing.hpp"
+
+using namespace std;
+
+
+EventRing::EventRing()
+{
+	reset(0);
+}
+
+void EventRing::reset(unsigned int capacity)
+{
+	slots.clear();
+	slots.resize(capacity);
+	seq = 0;
+	count = 0;
+}
+
+void EventRing::push(const char *event)
+{
+	seq++;
+	
+	if (slots.empty())
+		return;
+	
+	// assign() reuses the capacity of the overwritten event
+	slots[seq % slots.size()].assign(event);
+	
+	if (count < slots.size())
+		count++;
+}
+
+bool EventRing::getSince(unsigned int after, vector<const string*> &events) const
+{
+	// sequence from the future (or another session)
+	if (after > seq)
+		return false;
+	
+	if (seq - after > count)
+		return false;
+	
+	for (unsigned int s = after + 1; s <= seq; s++)
+		events.push_back(&slots[s % slots.size()]);
+	
+	return true;
+}
+
+bool EventRing::isEvent(const char *line)
+{
+	if (!strncmp(line, "SNAP ", 5))
+		return true;
+	
+	// game and table messages are sent from "<gid>:<tid>", the others from a client id
+	if (!strncmp(line, "MSG ", 4))
+	{
+		const char *from = line + 4;
+		const char *end = strchr(from, ' ');
+		const char *colon = strchr(from, ':');
+		return colon && (!end || colon < end);
+	}
+	
+	return false;
+}
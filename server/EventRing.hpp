@@ -0,0 +1,63 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _EVENTRING_H
+#define _EVENTRING_H
+
+#include <string>
+#include <vector>
+
+
+//! \brief Bounded log of the most recent events sent to one client
+//
+// Every event gets the next sequence number of the session. Once the ring
+// is full the oldest event is overwritten, so a resuming client can only be
+// replayed what it missed if the gap is no larger than the capacity.
+class EventRing
+{
+public:
+	EventRing();
+	
+	//! \brief Start a new session: drop all events and restart numbering
+	void reset(unsigned int capacity);
+	
+	//! \brief Store an event under the next sequence number
+	void push(const char *event);
+	
+	//! \brief Sequence number of the last event, 0 if none was stored
+	unsigned int getSeq() const { return seq; };
+	
+	//! \brief Collect the events after sequence number after; false if some are no longer kept
+	bool getSince(unsigned int after, std::vector<const std::string*> &events) const;
+	
+	//! \brief Whether a line sent to the client counts as an event (SNAP, game or table MSG)
+	static bool isEvent(const char *line);
+	
+private:
+	std::vector<std::string> slots;
+	unsigned int seq;
+	unsigned int count;	// events currently kept
+};
+
+#endif /* _EVENTRING_H */
@@ -29,10 +29,12 @@
 
 #include "Config.h"
 #include "Logger.h"
+#include "Trace.hpp"
 #include "Debug.h"
 #include "GameController.hpp"
 #include "GameLogic.hpp"
 #include "Card.hpp"
+#include "MessageWriter.hpp"
 
 #include "game.hpp"
 
@@ -47,6 +49,49 @@ static int MAX_PLAYERS_PER_TABLE = 9;
 static int MIN_PLAYERS_PER_TABLE = 6;
 static int MAX_DIFF = 2;
 
+std::map<int,GameController::client_games_type> GameController::owner_index;
+std::map<int,GameController::client_games_type> GameController::player_index;
+std::map<int,GameController::client_games_type> GameController::spectator_index;
+time_t GameController::clock_time = 0;
+bool GameController::spectator_feed_enabled = false;
+
+
+static void index_remove(std::map<int,GameController::client_games_type> &index, int cid, GameController *g)
+{
+	std::map<int,GameController::client_games_type>::iterator it = index.find(cid);
+	if (it == index.end())
+		return;
+	
+	it->second.erase(g);
+	if (it->second.empty())
+		index.erase(it);
+}
+
+static const GameController::client_games_type& index_get(const std::map<int,GameController::client_games_type> &index, int cid)
+{
+	static const GameController::client_games_type empty;
+	
+	std::map<int,GameController::client_games_type>::const_iterator it = index.find(cid);
+	if (it == index.end())
+		return empty;
+	
+	return it->second;
+}
+
+static void listener_remove(std::vector<int> &listeners, int cid)
+{
+	for (unsigned int i=0; i < listeners.size(); i++)
+	{
+		if (listeners[i] == cid)
+		{
+			listeners[i] = listeners.back();
+			listeners.pop_back();
+			return;
+		}
+	}
+}
+
+
 GameController::GameController()
 {
 	reset();
@@ -68,10 +113,13 @@ GameController::GameController()
     tid = -1;
 
     addBlindLevels();
+    reserveHandBuffers();
 }
 
 GameController::GameController(const GameController& g)
 {
+	owner = -1;
+	
 	reset();
 	
 	setName(g.getName());
@@ -87,17 +135,27 @@ GameController::GameController(const GameController& g)
 	setPassword(g.getPassword());
 
     addBlindLevels();
+    reserveHandBuffers();
 }
 
 
 GameController::~GameController()
 {
-	// remove all players
-	for (players_type::iterator e = players.begin(); e != players.end();)
-	{
-		delete e->second;
-		players.erase(e++);
-	}
+	// remove all players and spectators
+	clearPlayers();
+	clearSpectators();
+	
+	setOwner(-1);
+}
+
+void GameController::reserveHandBuffers()
+{
+	// a showdown has at most one hand and one group of hands per seat
+	strength_buffer.reserve(10);
+	winlist_buffer.reserve(10);
+	winlist_spare.resize(10);
+	for (unsigned int i=0; i < winlist_spare.size(); i++)
+		winlist_spare[i].reserve(10);
 }
 
 void GameController::addBlindLevels()
@@ -126,14 +184,10 @@ void GameController::reset()
 	mandatory_straddle = false;
     enable_insurance = true;	
 	// remove all players
-	for (players_type::iterator e = players.begin(); e != players.end();)
-	{
-		delete e->second;
-		players.erase(e++);
-	}
+	clearPlayers();
 	
 	// remove all spectators
-	spectators.clear();
+	clearSpectators();
 	
 	// clear finish list
 	finish_list.clear();
@@ -160,10 +214,11 @@ bool GameController::addTimeout(int cid, unsigned int timeout_to_add)
     // send pot-win snapshot
     int tid = p->getTableNo();
     Table *t = tables[tid];
-    int time_elapsed = (unsigned int)difftime(time(NULL), t->timeout_start);
+    int time_elapsed = (unsigned int)difftime(now(), t->timeout_start);
     int time_left = p->getTimeout() - time_elapsed;
-    snprintf(msg, sizeof(msg), "%d %d %d", p->client_id, timeout_to_add, time_left);
-    snap(t->table_id, SnapRespite, msg);
+    MessageWriter w(msg);
+    w << p->client_id << ' ' << timeout_to_add << ' ' << time_left;
+    snap(t->table_id, SnapRespite, w.c_str());
 
     return true;
 }
@@ -191,6 +246,8 @@ bool GameController::addSpectator(int cid)
 		return false;
 	
 	spectators.insert(cid);
+	spectator_index[cid].insert(this);
+	listeners.push_back(cid);
 	
 	return true;
 }
@@ -203,10 +260,85 @@ bool GameController::removeSpectator(int cid)
 		return false;
 	
 	spectators.erase(it);
+	index_remove(spectator_index, cid, this);
+	listener_remove(listeners, cid);
+	
+	// nobody left to watch the queued events
+	if (spectators.empty())
+		spectator_feed.clear();
 	
 	return true;
 }
 
+void GameController::clearSpectators()
+{
+	for (spectators_type::const_iterator e = spectators.begin(); e != spectators.end(); e++)
+	{
+		index_remove(spectator_index, *e, this);
+		listener_remove(listeners, *e);
+	}
+	
+	spectators.clear();
+	spectator_feed.clear();
+}
+
+void GameController::registerPlayer(int cid, Player *p)
+{
+	players[cid] = p;
+	player_index[cid].insert(this);
+	listeners.push_back(cid);
+}
+
+void GameController::unregisterPlayer(int cid)
+{
+	if (!players.erase(cid))
+		return;
+	
+	index_remove(player_index, cid, this);
+	listener_remove(listeners, cid);
+}
+
+void GameController::clearPlayers()
+{
+	for (players_type::iterator e = players.begin(); e != players.end();)
+	{
+		index_remove(player_index, e->first, this);
+		listener_remove(listeners, e->first);
+		
+		player_pool.destroy(e->second);
+		players.erase(e++);
+	}
+}
+
+void GameController::setOwner(int cid)
+{
+	if (owner == cid)
+		return;
+	
+	if (owner != -1)
+		index_remove(owner_index, owner, this);
+	
+	owner = cid;
+	
+	if (owner != -1)
+		owner_index[owner].insert(this);
+}
+
+const GameController::client_games_type& GameController::getOwnedGames(int cid)
+{
+	return index_get(owner_index, cid);
+}
+
+const GameController::client_games_type& GameController::getPlayerGames(int cid)
+{
+	return index_get(player_index, cid);
+}
+
+const GameController::client_games_type& GameController::getSpectatorGames(int cid)
+{
+	return index_get(spectator_index, cid);
+}
+
 bool GameController::isSpectator(int cid) const
 {
 	spectators_type::const_iterator it = spectators.find(cid);
@@ -233,6 +365,14 @@ bool GameController::setPlayerMax(unsigned int max)
 		return false;
 	
 	max_players = max;
+	
+	// every player ends up in the finish list
+	finish_list.reserve(max);
+	
+	// one chunk holds all players and the tables they are seated at
+	player_pool.setChunkSize(max);
+	table_pool.setChunkSize((max + 9) / 10);
+	
 	return true;
 }
 
@@ -248,13 +388,7 @@ bool GameController::setPlayerStakes(chips_type stake)
 
 bool GameController::getListenerList(vector<int> &client_list) const
 {
-    client_list.clear();
-
-    for (players_type::const_iterator e = players.begin(); e != players.end(); e++)
-        client_list.push_back(e->first);
-
-    for (spectators_type::const_iterator e = spectators.begin(); e != spectators.end(); e++)
-        client_list.push_back(*e);
+    client_list = listeners;
 
     return true;
 }
@@ -271,18 +405,14 @@ void GameController::selectNewOwner()
     if (e == players.end())
         return;
 
-    owner = e->second->client_id;
+    setOwner(e->second->client_id);
 }
 
 void GameController::chat(int tid, const char* msg)
 {
-    // players
-    for (players_type::const_iterator e = players.begin(); e != players.end(); e++)
-        client_chat(game_id, tid, e->first, msg);
-
-    // spectators
-    for (spectators_type::const_iterator e = spectators.begin(); e != spectators.end(); e++)
-        client_chat(game_id, tid, *e, msg);
+    // players and spectators
+    for (unsigned int i=0; i < listeners.size(); i++)
+        client_chat(game_id, tid, listeners[i], msg);
 }
 
 void GameController::chat(int cid, int tid, const char* msg)
@@ -292,14 +422,17 @@ void GameController::chat(int cid, int tid, const char* msg)
 
 void GameController::snap(int tid, int sid, const char* msg)
 {
-    // players
-    for (players_type::const_iterator e = players.begin(); e != players.end(); e++) {
-        client_snapshot(game_id, tid, e->first, sid, msg);
+    if (!queueSpectatorEvent(tid, sid, msg))
+    {
+        // players and spectators
+        for (unsigned int i=0; i < listeners.size(); i++)
+            client_snapshot(game_id, tid, listeners[i], sid, msg);
+        return;
     }
 
-    // spectators
-    for (spectators_type::const_iterator e = spectators.begin(); e != spectators.end(); e++)
-        client_snapshot(game_id, tid, *e, sid, msg);
+    // spectators get the event later with the delayed feed
+    for (players_type::const_iterator e = players.begin(); e != players.end(); e++)
+        client_snapshot(game_id, tid, e->first, sid, msg);
 }
 
 void GameController::snap(int cid, int tid, int sid, const char* msg)
@@ -307,6 +440,56 @@ void GameController::snap(int cid, int tid, int sid, const char* msg)
     client_snapshot(game_id, tid, cid, sid, msg);
 }
 
+bool GameController::queueSpectatorEvent(int tid, int sid, const char* msg)
+{
+    if (!spectator_feed_enabled)
+        return false;
+
+    if (spectators.empty())
+        return true;
+
+    spectator_feed.push_back(SpectatorEvent());
+    SpectatorEvent &ev = spectator_feed.back();
+    ev.time = now();
+    ev.tid = tid;
+    ev.sid = sid;
+    ev.msg = msg;
+
+    return true;
+}
+
+void GameController::releaseSpectatorFeed(time_t until, vector<SpectatorEvent> &batch)
+{
+    batch.clear();
+
+    unsigned int due = 0;
+    while (due < spectator_feed.size() && spectator_feed[due].time <= until)
+        due++;
+
+    // a table snapshot carries the whole table state; only the last one of a table is sent
+    map<int,unsigned int> last_snapshot;
+    for (unsigned int i=0; i < due; i++)
+        if (spectator_feed[i].sid == SnapTable)
+            last_snapshot[spectator_feed[i].tid] = i;
+
+    for (unsigned int i=0; i < due; i++)
+    {
+        SpectatorEvent &ev = spectator_feed[i];
+
+        if (ev.sid == SnapTable && last_snapshot[ev.tid] != i)
+            continue;
+
+        batch.push_back(SpectatorEvent());
+        SpectatorEvent &out = batch.back();
+        out.time = ev.time;
+        out.tid = ev.tid;
+        out.sid = ev.sid;
+        out.msg.swap(ev.msg);
+    }
+
+    spectator_feed.erase(spectator_feed.begin(), spectator_feed.begin() + due);
+}
+
 bool GameController::setPlayerAction(int cid, Player::PlayerAction action, chips_type arg)
 {
     Player *p = findPlayer(cid);
@@ -347,9 +530,53 @@ bool GameController::setPlayerAction(int cid, Player::PlayerAction action, chips
     return true;
 }
 
+void GameController::dispatchPlayerAction(int cid)
+{
+    if (status != Started)
+        return;
+
+    Player *p = findPlayer(cid);
+    if (!p)
+        return;
+
+    // look up the player's table directly; a game may run many of them
+    tables_type::iterator e = tables.find(p->getTableNo());
+    if (e == tables.end())
+        return;
+
+    Table *t = e->second;
+
+    // only the table waiting for this player's action is advanced
+    if (t->cur_player < 0 || !t->seats[t->cur_player].occupied || t->seats[t->cur_player].player != p)
+        return;
+
+    TraceScope trace("GameController::dispatchPlayerAction", t->table_id);
+
+    // run the betting states until the table waits for the next player;
+    // everything else (delays, showdown, new round) stays with tick()
+    for (unsigned int i=0; i < 10; i++)
+    {
+        if (t->delay)
+            stateDelay(t);
+
+        if (t->delay || (t->state != Table::Betting &&
+                t->state != Table::BettingEnd && t->state != Table::AskShow))
+            break;
+
+        const Table::State state = t->state;
+        const int cur_player = t->cur_player;
+
+        handleTable(t);
+
+        if (t->state == state && t->cur_player == cur_player)
+            break;
+    }
+}
+
 bool GameController::createWinlist(Table *t, vector< vector<HandStrength> > &winlist)
 {
-    vector<HandStrength> wl;
+    vector<HandStrength> &wl = strength_buffer;
+    wl.clear();
 
     unsigned int showdown_player = t->last_bet_player;
     for (unsigned int i=0; i < t->countActivePlayers(); i++)
@@ -365,27 +592,60 @@ bool GameController::createWinlist(Table *t, vector< vector<HandStrength> > &win
         showdown_player = t->getNextActivePlayer(showdown_player);
     }
 
-    return GameLogic::getWinList(wl, winlist);
+    return GameLogic::getWinList(wl, winlist, &winlist_spare);
 }
 
-void GameController::sendTableSnapshot(Table *t)
+void GameController::sendTableSnapshot(Table *t, int cid)
 {
-    // assemble community-cards string
-    string scards;
-    vector<Card> cards;
+    TraceScope trace("GameController::sendTableSnapshot", t->table_id);
+    chips_type minimum_bet;
+    if (t->state == Table::Betting)
+        minimum_bet = determineMinimumBet(t);
+    else
+        minimum_bet = 0;
+
+    int next_level = 0;
+    int next_amount = 0;
+    if (blind.level + 1 < blind_levels.size()) {
+        next_level = blind.level + 1;
+        next_amount = blind_levels[next_level].big_blind;
+    }
+
+    MessageWriter w(msg);
+
+    // <state>:<betting-round>
+    w << (int)t->state << ':' << ((t->state == Table::Betting) ? (int)t->betround : -1) << ' ';
+
+    // <dealer>:<SB>:<BB>:<current>:<time-left>:<last-bet>
+    if (t->state == Table::GameStart ||
+            t->state == Table::ElectDealer)
+    {
+        w << "-1";
+    }
+    else
+    {
+        w << t->seats[t->dealer].seat_no << ':'
+            << t->seats[t->sb].seat_no << ':'
+            << t->seats[t->bb].seat_no << ':'
+            << ((t->cur_player == -1) ? -1 : (int)t->seats[t->cur_player].seat_no) << ':'
+            << ((t->cur_player == -1) ? -1 : (int)(t->seats[t->cur_player].player->getTimeout() - difftime(now(), t->timeout_start))) << ':' // how much time left for current player to act
+            << t->seats[t->last_bet_player].seat_no;
+    }
 
+    // community-cards
+    CardArray<5> cards;
     t->communitycards.copyCards(&cards);
 
+    w << " cc:";
     for (unsigned int i=0; i < cards.size(); i++)
     {
-        scards += cards[i].getName();
-
-        if (i < cards.size() -1)
-            scards += ':';
+        if (i)
+            w << ':';
+        w.write(cards[i].getName(), 2);
     }
+    w << ' ';
 
-    // assemble seats string
-    string sseats;
+    // seats
     for (unsigned int i=0; i < 10; i++)
     {
         Table::Seat *s = &(t->seats[i]);
@@ -395,146 +655,110 @@ void GameController::sendTableSnapshot(Table *t)
 
         Player *p = s->player;
 
-        // assemble hole-cards string
-        string shole;
-        if (t->nomoreaction || s->auto_showcards)
+        int pstate = 0;
+        if (s->in_round)
+            pstate |= PlayerInRound;
+        if (p->sitout)
+            pstate |= PlayerSitout;
+
+        w << 's' << s->seat_no
+            << ':' << p->client_id
+            << ':' << pstate
+            << ':' << (int)p->stake
+            << ':' << (int)p->getRebuyStake()
+            << ':' << (int)s->bet
+            << ':' << (int)p->last_action
+            << ':';
+
+        // hole-cards
+        if (t->nomoreaction || s->auto_showcards || t->state == Table::EndRound)
         {
-            vector<Card> cards;
+            // at EndRound the user may have decided to show only 1 or 2 cards
+            const bool all_shown = (t->nomoreaction || s->auto_showcards);
+            CardArray<2> cards;
 
             p->holecards.copyCards(&cards);
 
             for (unsigned int i=0; i < cards.size(); i++) {
-                shole += "_";
-                shole += cards[i].getName();
+                w << '_';
+                if (all_shown || p->holecards.isCardShown(i))
+                    w.write(cards[i].getName(), 2);
+                else
+                    w << '-';
             }
         }
-        else if (t->state == Table::EndRound ) {
-            // user has decided to show 1 or 2 cards
-            shole += p->holecards.showCards();
-        }
         else
-            shole = "-_-";
+            w << "-_-";
 
-        int pstate = 0;
-        if (s->in_round)
-            pstate |= PlayerInRound;
-        if (p->sitout)
-            pstate |= PlayerSitout;
-
-        char tmp[1024];
-        snprintf(tmp, sizeof(tmp),
-                "s%d:%d:%d:%d:%d:%d:%d:%s",
-                s->seat_no,
-                p->client_id,
-                pstate,
-                p->stake,
-                p->getRebuyStake(),
-                s->bet,
-                p->last_action,
-                shole.c_str());
-
-        sseats += tmp;
-
-        sseats += ' ';
+        w << ' ';
     }
+    w << ' ';
 
-
-    // assemble pots string
-    string spots;
+    // pots
     for (unsigned int i=0; i < t->pots.size(); i++)
     {
-        Table::Pot *pot = &(t->pots[i]);
-
-        char tmp[1024];
-
-        snprintf(tmp, sizeof(tmp),
-                "p%d:%d",
-                i, pot->amount);
-
-        spots += tmp;
-
-        if (i < t->pots.size() -1)
-            spots += ' ';
+        if (i)
+            w << ' ';
+        w << 'p' << i << ':' << (int)t->pots[i].amount;
     }
 
+    w << ' ' << (int)blind.amount               // current big blind amount
+        << ' ' << (int)blind.level              // current blind level
+        << ' ' << next_amount                   // next big blind amount
+        << ' ' << next_level                    // next blind level
+        << ' ' << (int)blind.last_blinds_time   // last blind time
+        << ' ' << (int)minimum_bet;             // minimum bet
 
-    // assemble 'whose-turn' string
-    string sturn;
-    if (t->state == Table::GameStart ||
-            t->state == Table::ElectDealer)
-    {
-        sturn = "-1";
-    }
+    if (cid == -1)
+        snap(t->table_id, SnapTable, w.c_str());
     else
+        snap(cid, t->table_id, SnapTable, w.c_str());
+}
+
+void GameController::sendKeyframe(int cid)
+{
+    Player *p = findPlayer(cid);
+
+    for (tables_type::iterator e = tables.begin(); e != tables.end(); e++)
     {
-        char tmp[128];
-        snprintf(tmp, sizeof(tmp), "%d:%d:%d:%d:%d:%d",
-                t->seats[t->dealer].seat_no,
-                t->seats[t->sb].seat_no,
-                t->seats[t->bb].seat_no,
-                (t->cur_player == -1) ? -1 : (int)t->seats[t->cur_player].seat_no,
-                (t->cur_player == -1) ? -1 : (int)(t->seats[t->cur_player].player->getTimeout() - difftime(time(NULL), t->timeout_start)), // how much time left for current player to act
-                t->seats[t->last_bet_player].seat_no);
-        sturn = tmp;
-    }
+        Table *t = e->second;
 
+        // a player only follows its own table, spectators all of them
+        if (p && p->getTableNo() != t->table_id)
+            continue;
 
-    chips_type minimum_bet;
-    if (t->state == Table::Betting)
-        minimum_bet = determineMinimumBet(t);
-    else
-        minimum_bet = 0;
+        sendTableSnapshot(t, cid);
 
-    int next_level = 0;
-    int next_amount = 0;
-    if (blind.level < blind_levels.size()) {
-        next_level = blind.level + 1;
-        next_amount = blind_levels[next_level].big_blind;
-    }
+        if (!p || t->state <= Table::Blinds)
+            continue;
+
+        Table::Seat *s = &(t->seats[p->getSeatNo()]);
+        if (!s->occupied || s->player != p || !s->in_round)
+            continue;
 
+        CardArray<2> cards;
+        p->holecards.copyCards(&cards);
+        if (cards.size() != 2)
+            continue;
 
-    snprintf(msg, sizeof(msg),
-            "%d:%d "           // <state>:<betting-round>
-            "%s "              // <dealer>:<SB>:<BB>:<current>:<last-bet>
-            "cc:%s "           // <community-cards>
-            "%s "              // seats
-            "%s "              // pots
-            "%d "              // current big blind amount
-            "%d "              // current blind level
-            "%d "              // next big blind amount
-            "%d "              // next blind level
-            "%d "              // last blind time
-            "%d",              // minimum bet
-            t->state, (t->state == Table::Betting) ? t->betround : -1,
-            sturn.c_str(),
-            scards.c_str(),
-            sseats.c_str(),
-            spots.c_str(),
-            blind.amount,
-            (int)blind.level,
-            next_amount,
-            next_level,
-            (int)blind.last_blinds_time,
-            minimum_bet);
-
-    snap(t->table_id, SnapTable, msg);
+        MessageWriter w(msg);
+        w << (int)SnapCardsHole << ' ' << cards[0].getName() << ' ' << cards[1].getName();
+        snap(cid, t->table_id, SnapCards, w.c_str());
+    }
 }
 
 void GameController::sendPlayerShowSnapshot(Table *t, Player *p)
 {
-    vector<Card> allcards;
+    CardArray<7> allcards;
     p->holecards.copyCards(&allcards);
     t->communitycards.copyCards(&allcards);
 
-    string hsstr;
-    for (vector<Card>::const_iterator e = allcards.begin(); e != allcards.end(); e++)
-        hsstr += string(e->getName()) + string(" ");
-
-    snprintf(msg, sizeof(msg), "%d %s",
-            p->client_id,
-            hsstr.c_str());
+    MessageWriter w(msg);
+    w << p->client_id << ' ';
+    for (CardArray<7>::const_iterator e = allcards.begin(); e != allcards.end(); e++)
+        w << e->getName() << ' ';
 
-    snap(t->table_id, SnapPlayerShow, msg);
+    snap(t->table_id, SnapPlayerShow, w.c_str());
 }
 
 chips_type GameController::determineMinimumBet(Table *t) const
@@ -561,12 +785,9 @@ void GameController::dealHole(Table *t)
         t->deck.pop(c2);
         p->holecards.setCards(c1, c2);
 
-        char card1[3], card2[3];
-        strcpy(card1, c1.getName());
-        strcpy(card2, c2.getName());
-        snprintf(msg, sizeof(msg), "%d %s %s",
-                SnapCardsHole, card1, card2);
-        snap(p->client_id, t->table_id, SnapCards, msg);
+        MessageWriter w(msg);
+        w << (int)SnapCardsHole << ' ' << c1.getName() << ' ' << c2.getName();
+        snap(p->client_id, t->table_id, SnapCards, w.c_str());
 
 
         // increase the found-player counter
@@ -582,13 +803,9 @@ void GameController::dealFlop(Table *t)
     t->deck.pop(f3);
     t->communitycards.setFlop(f1, f2, f3);
 
-    char card1[3], card2[3], card3[3];
-    strcpy(card1, f1.getName());
-    strcpy(card2, f2.getName());
-    strcpy(card3, f3.getName());
-    snprintf(msg, sizeof(msg), "%d %s %s %s",
-            SnapCardsFlop, card1, card2, card3);
-    snap(t->table_id, SnapCards, msg);
+    MessageWriter w(msg);
+    w << (int)SnapCardsFlop << ' ' << f1.getName() << ' ' << f2.getName() << ' ' << f3.getName();
+    snap(t->table_id, SnapCards, w.c_str());
 }
 
 void GameController::dealTurn(Table *t)
@@ -597,11 +814,9 @@ void GameController::dealTurn(Table *t)
     t->deck.pop(tc);
     t->communitycards.setTurn(tc);
 
-    char card[3];
-    strcpy(card, tc.getName());
-    snprintf(msg, sizeof(msg), "%d %s",
-            SnapCardsTurn, card);
-    snap(t->table_id, SnapCards, msg);
+    MessageWriter w(msg);
+    w << (int)SnapCardsTurn << ' ' << tc.getName();
+    snap(t->table_id, SnapCards, w.c_str());
 }
 
 void GameController::dealRiver(Table *t)
@@ -610,22 +825,22 @@ void GameController::dealRiver(Table *t)
     t->deck.pop(r);
     t->communitycards.setRiver(r);
 
-    char card[3];
-    strcpy(card, r.getName());
-    snprintf(msg, sizeof(msg), "%d %s",
-            SnapCardsRiver, card);
-    snap(t->table_id, SnapCards, msg);
+    MessageWriter w(msg);
+    w << (int)SnapCardsRiver << ' ' << r.getName();
+    snap(t->table_id, SnapCards, w.c_str());
 }
 
 
 void GameController::stateNewRound(Table *t)
 {
-    log_msg("game", "state new Round");
+    TraceScope trace("GameController::stateNewRound", t->table_id);
+    log_debug("game", "state new Round");
     // count up current hand number	
     hand_no++;
 
-    snprintf(msg, sizeof(msg), "%d %d", SnapGameStateNewHand, hand_no);
-    snap(t->table_id, SnapGameState, msg);
+    MessageWriter w(msg);
+    w << (int)SnapGameStateNewHand << ' ' << hand_no;
+    snap(t->table_id, SnapGameState, w.c_str());
 
     log_msg("Table", "Hand #%d (gid=%d tid=%d)", hand_no, game_id, t->table_id);
 
@@ -661,6 +876,7 @@ void GameController::stateNewRound(Table *t)
     t->pots.clear();
     Table::Pot pot;
     pot.amount = 0;
+    pot.involved_mask = 0;
     pot.final = false;
     t->pots.push_back(pot);
 
@@ -677,9 +893,10 @@ void GameController::stateNewRound(Table *t)
 
 
         Player *p = t->seats[i].player;
-		if (p->getStake() >= blind.amount) {
-            t->seats[i].in_round = true;
-        }
+
+        // blinds are taken from occupied seats, so every one of them is dealt in;
+        // a stack short of the big blind posts what it has and is all-in
+        t->setInRound(i, true);
 
 
         p->holecards.clear();
@@ -716,6 +933,7 @@ void GameController::stateNewRound(Table *t)
 
 void GameController::stateBlinds(Table *t)
 {
+    TraceScope trace("GameController::stateBlinds", t->table_id);
     t->bet_amount = blind.amount;
 
     Player *pSmall = t->seats[t->sb].player;
@@ -740,7 +958,7 @@ void GameController::stateBlinds(Table *t)
     pBig->stake -= amount;
 
     // initialize the player's timeout
-    t->timeout_start = time(NULL);
+    t->timeout_start = now();
 
     // give out hole-cards
     dealHole(t);
@@ -775,6 +993,7 @@ void GameController::stateBlinds(Table *t)
 
 void GameController::stateBettingEnd(Table *t)
 {
+    TraceScope trace("GameController::stateBettingEnd", t->table_id);
     //reset player's timeout
     for (unsigned int i = 0; i < 10; i++)
     {
@@ -789,10 +1008,31 @@ void GameController::stateBettingEnd(Table *t)
     sendTableSnapshot(t);
 }
 
+bool GameController::ensureCurrentPlayer(Table *t)
+{
+    if (t->cur_player >= 0 && t->seats[t->cur_player].occupied)
+        return true;
+
+    // continue with the first player still in the hand
+    t->cur_player = t->getNextActivePlayer(t->dealer);
+    if (t->cur_player >= 0)
+        return true;
+
+    log_msg("game", "no player left in hand #%d (gid=%d tid=%d), ending round",
+            hand_no, game_id, t->table_id);
+    t->state = Table::EndRound;
+
+    return false;
+}
+
 void GameController::stateAskShow(Table *t)
 {
+    TraceScope trace("GameController::stateAskShow", t->table_id);
     bool chose_action = false;
 
+    if (!ensureCurrentPlayer(t))
+        return;
+
     Player *p = t->seats[t->cur_player].player;
 
     if (!p->stake && t->countActivePlayers() > 1) // player went allin and has no option to show/muck
@@ -824,7 +1064,7 @@ void GameController::stateAskShow(Table *t)
 #ifndef SERVER_TESTING
         // handle player timeout
         const int timeout = 1;   // FIXME: configurable
-        if ((int)difftime(time(NULL), t->timeout_start) > timeout || p->sitout)
+        if ((int)difftime(now(), t->timeout_start) > timeout || p->sitout)
         {
             // default on showdown is "to show"
             // Note: client needs to determine if it's hand is
@@ -876,7 +1116,7 @@ void GameController::stateAskShow(Table *t)
             // find next player
             t->cur_player = t->getNextActivePlayer(t->cur_player);
 
-            t->timeout_start = time(NULL);
+            t->timeout_start = now();
 
             // send update snapshot
             sendTableSnapshot(t);
@@ -886,6 +1126,11 @@ void GameController::stateAskShow(Table *t)
 
 void GameController::stateAllFolded(Table *t)
 {
+    TraceScope trace("GameController::stateAllFolded", t->table_id);
+
+    if (!ensureCurrentPlayer(t))
+        return;
+
     // get last remaining player
     Player *p = t->seats[t->cur_player].player;
 
@@ -898,8 +1143,9 @@ void GameController::stateAllFolded(Table *t)
     t->seats[t->cur_player].bet = t->pots[0].amount;
 
     // send pot-win snapshot
-    snprintf(msg, sizeof(msg), "%d %d %d", p->client_id, 0, t->pots[0].amount);
-    snap(t->table_id, SnapWinPot, msg);
+    MessageWriter w(msg);
+    w << p->client_id << ' ' << 0 << ' ' << (int)t->pots[0].amount;
+    snap(t->table_id, SnapWinPot, w.c_str());
 
 
     sendTableSnapshot(t);
@@ -908,6 +1154,7 @@ void GameController::stateAllFolded(Table *t)
 
 void GameController::stateShowdown(Table *t)
 {
+    TraceScope trace("GameController::stateShowdown", t->table_id);
     // the player who did the last action is first
     unsigned int showdown_player = t->last_bet_player;
 
@@ -926,7 +1173,7 @@ void GameController::stateShowdown(Table *t)
 
 
     // determine winners
-    vector< vector<HandStrength> > winlist;
+    vector< vector<HandStrength> > &winlist = winlist_buffer;
     createWinlist(t, winlist);
 
     // for each winner-list
@@ -983,8 +1230,9 @@ void GameController::stateShowdown(Table *t)
                     // count up overall cashed-out
                     cashout_amount += win_amount;
 
-                    snprintf(msg, sizeof(msg), "%d %d %d", p->client_id, poti, win_amount);
-                    snap(t->table_id, SnapWinPot, msg);
+                    MessageWriter w(msg);
+                    w << p->client_id << ' ' << poti << ' ' << (int)win_amount;
+                    snap(t->table_id, SnapWinPot, w.c_str());
                 }
             }
 
@@ -1004,8 +1252,9 @@ void GameController::stateShowdown(Table *t)
                 p->stake += odd_chips;
                 seat->bet += odd_chips;
 
-                snprintf(msg, sizeof(msg), "%d %d %d", p->client_id, poti, odd_chips);
-                snap(t->table_id, SnapOddChips, msg);
+                MessageWriter w(msg);
+                w << p->client_id << ' ' << poti << ' ' << (int)odd_chips;
+                snap(t->table_id, SnapOddChips, w.c_str());
 
                 cashout_amount += odd_chips;
             }
@@ -1042,7 +1291,7 @@ void GameController::stateShowdown(Table *t)
 void GameController::stateDelay(Table *t)
 {
 #ifndef SERVER_TESTING
-    if ((unsigned int) difftime(time(NULL), t->delay_start) >= t->delay)
+    if ((unsigned int) difftime(now(), t->delay_start) >= t->delay)
         t->delay = 0;
 #else
     t->delay = 0;
@@ -1051,10 +1300,8 @@ void GameController::stateDelay(Table *t)
 
 void GameController::placeTable(int offset, int total_players)
 {
-    Table *t = new Table();
-    t->setTableId(++tid);
-    memset(t->seats, 0, sizeof(Table::Seat) * 10);
     vector<Player*> rndseats;
+    rndseats.reserve(total_players);
 
     players_type::const_iterator start = players.begin();
     for (int i = 0; i < offset; i++) 
@@ -1075,11 +1322,21 @@ void GameController::placeTable(int offset, int total_players)
     random_shuffle(rndseats.begin(), rndseats.end());
 #endif
 
+    createTable(rndseats);
+}
+
+Table* GameController::createTable(const vector<Player*> &seated)
+{
+    Table *t = table_pool.create();
+    t->setTableId(++tid);
+    memset(t->seats, 0, sizeof(Table::Seat) * 10);
+
     for (unsigned int i=0; i < 10; i++)
 	{
         Table::Seat *seat = &(t->seats[i]);
         seat->seat_no = i;
-        seat->occupied = false;
+        t->setOccupied(i, false);
+        t->setInRound(i, false);
 	}
 
     bool chose_dealer = false;
@@ -1097,9 +1354,9 @@ void GameController::placeTable(int offset, int total_players)
         { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }	// 10 players
     };
 
-    const unsigned int place_row = players.size() - 1;
+    const unsigned int place_row = seated.size() - 1;
     unsigned int place_idx = 0;
-    vector<Player*>::const_iterator it = rndseats.begin();
+    vector<Player*>::const_iterator it = seated.begin();
 
     do
     {
@@ -1114,7 +1371,7 @@ void GameController::placeTable(int offset, int total_players)
 
         seat->auto_showcards = false;
         seat->manual_showcards = false;
-        seat->occupied = true;
+        t->setOccupied(place, true);
         seat->player = (Player*)p;
 
         // FIXME: implement choosing dealer correctly
@@ -1129,12 +1386,15 @@ void GameController::placeTable(int offset, int total_players)
 
     tables[tid] = t;
 
-    snprintf(msg, sizeof(msg), "%d", SnapGameStateStart);
-    snap(tid, SnapGameState, msg);
+    MessageWriter w(msg);
+    w << (int)SnapGameStateStart;
+    snap(tid, SnapGameState, w.c_str());
     t->state = Table::GameStart;
 
     sendTableSnapshot(t);
     t->scheduleState(Table::NewRound, 5);
+
+    return t;
 }
 
 vector<int> GameController::calcTables(int players_to_arrange)
@@ -1180,8 +1440,9 @@ void GameController::pause()
         return;
 
     //send SnapGameStatePause snap to all players
-    snprintf(msg, sizeof(msg), "%d", SnapGameStatePause);
-    snap(-1, SnapGameState, msg);
+    MessageWriter w(msg);
+    w << (int)SnapGameStatePause;
+    snap(-1, SnapGameState, w.c_str());
 
     status = Paused;
     log_msg("game", "game %d has been paused", game_id);
@@ -1193,8 +1454,9 @@ void GameController::resume()
         return;
 
     // send SnapGameStateResume snap to all players
-    snprintf(msg, sizeof(msg), "%d", SnapGameStateResume);
-    snap(-1, SnapGameState, msg);
+    MessageWriter w(msg);
+    w << (int)SnapGameStateResume;
+    snap(-1, SnapGameState, w.c_str());
 
     status = Started;
     log_msg("game", "game %d has been resumed", game_id);
@@ -1202,11 +1464,13 @@ void GameController::resume()
 
 void GameController::stateSuspend(Table *t)
 {
+	TraceScope trace("GameController::stateSuspend", t->table_id);
 //	log_msg("game", "state Suspend %d", t->suspend_times);
     if (t->suspend_times == 0)
 	{
-		snprintf(msg, sizeof(msg), "%d %d %d", SnapGameStateTableSuspend, t->suspend_reason, t->max_suspend_times - t->suspend_times);
-		snap(t->table_id, SnapGameState, msg);
+		MessageWriter w(msg);
+		w << (int)SnapGameStateTableSuspend << ' ' << t->suspend_reason << ' ' << (int)(t->max_suspend_times - t->suspend_times);
+		snap(t->table_id, SnapGameState, w.c_str());
 	}
 
 	if (t->suspend_times >= t->max_suspend_times)
@@ -1221,9 +1485,11 @@ void GameController::stateSuspend(Table *t)
 
 void GameController::stateResume(Table * t)
 {
-    log_msg("game", "state Resume");
-	snprintf(msg, sizeof(msg), "%d", SnapGameStateTableResume);
-	snap(t->table_id, SnapGameState, msg);
+    TraceScope trace("GameController::stateResume", t->table_id);
+    log_debug("game", "state Resume");
+	MessageWriter w(msg);
+	w << (int)SnapGameStateTableResume;
+	snap(t->table_id, SnapGameState, w.c_str());
 
 	t->suspend_times = 0;
 	t->max_suspend_times = 0;
@@ -1233,5 +1499,6 @@ void GameController::stateResume(Table * t)
 
 bool GameController::handleBuyInsurance(Table *t, unsigned int round)
 {
+	TraceScope trace("GameController::handleBuyInsurance", t->table_id);
 	return false;
 }
@@ -28,6 +28,7 @@
 #include <string>
 #include <map>
 #include <set>
+#include <deque>
 #include <string>
 #include <ctime>
 
@@ -38,6 +39,8 @@
 #include "Table.hpp"
 #include "Player.hpp"
 #include "GameLogic.hpp"
+#include "ObjectPool.hpp"
+#include "MessageWriter.hpp"
 
 
 class GameController
@@ -51,6 +54,8 @@ public:
 	
 	typedef std::vector<Player*>	finish_list_type;
 	
+	typedef std::set<GameController*>	client_games_type;
+	
 	typedef enum {
 		RingGame = 0x01,   // Cash game
 		FreezeOut,  // Tournament
@@ -139,8 +144,10 @@ public:
 	unsigned int getPlayerCount() const { return players.size(); };
 	
 	virtual bool getPlayerList(std::vector<int> &client_list, bool including_wanna_leave = false) const {return true;};
-	virtual bool getPlayerList(std::vector<std::string> &client_list) const {return true;};
+	//! \brief Append "<cid>:<table>:<seat>:<stake> " of each listed player
+	virtual bool writePlayerList(MessageWriter &w) const {return true;};
 	bool getListenerList(std::vector<int> &client_list) const;
+	const std::vector<int>& getListeners() const { return listeners; };
 	void getFinishList(std::vector<Player*> &player_list) const;
 	
 	void setRestart(bool bRestart) { restart = bRestart; };
@@ -171,13 +178,49 @@ public:
 	bool removeSpectator(int cid);
 	bool isSpectator(int cid) const;
 	
-	void setOwner(int cid) { owner = cid; };
+	void setOwner(int cid);
 	int getOwner() const { return owner; };
 	
-	void chat(int tid, const char* msg);
+	//! \brief Games the client owns, plays in or watches (maintained incrementally)
+	static const client_games_type& getOwnedGames(int cid);
+	static const client_games_type& getPlayerGames(int cid);
+	static const client_games_type& getSpectatorGames(int cid);
+	
+	//! \brief Time source of the game engine (timeouts, delays, blind levels)
+	static time_t now() { return clock_time ? clock_time : time(NULL); };
+	//! \brief Run the engine on a simulated clock; 0 returns to the wall clock
+	static void setClock(time_t t) { clock_time = t; };
+	
+	//! \brief Table broadcast held back for the delayed spectator feed
+	struct SpectatorEvent
+	{
+		time_t time;
+		int tid;
+		int sid;
+		std::string msg;
+	};
+	typedef std::deque<SpectatorEvent>	spectator_feed_type;
+	
+	//! \brief Queue table broadcasts for spectators instead of sending them live
+	static void setSpectatorFeed(bool enabled) { spectator_feed_enabled = enabled; };
+	static bool hasSpectatorFeed() { return spectator_feed_enabled; };
+	
+	//! \brief Move the events queued until 'until' into batch, dropping
+	//! table snapshots superseded by a later one of the same table
+	void releaseSpectatorFeed(time_t until, std::vector<SpectatorEvent> &batch);
+	
+	// all changes of the player and spectator lists go through these to keep the indexes in sync
+	void registerPlayer(int cid, Player *p);
+	void unregisterPlayer(int cid);
+	void clearPlayers();
+	void clearSpectators();
+	
+	virtual void chat(int tid, const char* msg);
 	void chat(int cid, int tid, const char* msg);
 	
 	bool setPlayerAction(int cid, Player::PlayerAction action, chips_type amount);
+	//! \brief Advance the player's table right away if it waits for the player's action
+	void dispatchPlayerAction(int cid);
 	
 	virtual void start() {return ;};
     void pause();
@@ -189,10 +232,13 @@ public:
 	Player* findPlayer(int cid);
 	void selectNewOwner();
 	
-	void snap(int tid, int sid, const char* msg="");
+	virtual void snap(int tid, int sid, const char* msg="");
 	void snap(int cid, int tid, int sid, const char* msg="");
+	//! \brief Queue a table broadcast for the spectators; false if they are served live
+	bool queueSpectatorEvent(int tid, int sid, const char* msg);
 	
 	bool createWinlist(Table *t, std::vector< std::vector<HandStrength> > &winlist);
+	void reserveHandBuffers();
 	chips_type determineMinimumBet(Table *t) const;
 	
 	virtual int handleTable(Table *t) {return 0;};
@@ -202,6 +248,7 @@ public:
 	virtual void stateBlinds(Table *t) ;
 	virtual void stateBetting(Table *t) {return;};
 	void stateBettingEnd(Table *t);   // pseudo-state
+	bool ensureCurrentPlayer(Table *t);
 	void stateAskShow(Table *t);
 	void stateAllFolded(Table *t);
 	void stateShowdown(Table *t);
@@ -215,11 +262,14 @@ public:
 	void dealTurn(Table *t);
 	void dealRiver(Table *t);
 	
-	void sendTableSnapshot(Table *t);
+	void sendTableSnapshot(Table *t, int cid=-1);
+	//! \brief Send the current table state (and hole cards) to a resuming client
+	void sendKeyframe(int cid);
 	void sendPlayerShowSnapshot(Table *t, Player *p);
 	
     virtual void placePlayers() {return;};
     void placeTable(int offset, int total_players);
+    Table* createTable(const std::vector<Player*> &seated);
     std::vector<int> calcTables(int players_to_arrange);
 
     virtual void addBlindLevels() ;
@@ -237,10 +287,21 @@ public:
 	chips_type player_stakes;
 	unsigned int timeout;
 	
+	// storage for this game's players and tables, released with the game
+	ObjectPool<Player>	player_pool;
+	ObjectPool<Table>	table_pool;
+	
 	players_type		players;
 	spectators_type		spectators;
+	std::vector<int>	listeners;	// players and spectators
+	spectator_feed_type	spectator_feed;
 	tables_type		tables;
 	
+	// hand strengths of a showdown or insurance round; kept to reuse their storage
+	std::vector<HandStrength>	strength_buffer;
+	std::vector< std::vector<HandStrength> >	winlist_buffer;
+	std::vector< std::vector<HandStrength> >	winlist_spare;
+	
 	struct {
 		chips_type start;
 		chips_type amount;
@@ -271,6 +332,13 @@ public:
     int tid;
 
     std::vector<BlindLevel> blind_levels;
+
+	static std::map<int,client_games_type> owner_index;
+	static std::map<int,client_games_type> player_index;
+	static std::map<int,client_games_type> spectator_index;
+	
+	static time_t clock_time;
+	static bool spectator_feed_enabled;
 	
 #ifdef DEBUG
 	std::vector<Card> debug_cards;
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#include "Leaderboard.hpp"
+
+using namespace std;
+
+
+Leaderboard::Leaderboard()
+{
+	tree_mask = 1;
+	while (tree_mask * 2 <= MaxScore)
+		tree_mask *= 2;
+	
+	clear();
+}
+
+void Leaderboard::clear()
+{
+	entries.clear();
+	
+	for (int i=0; i <= MaxScore; i++)
+	{
+		buckets[i].clear();
+		tree[i] = 0;
+	}
+}
+
+void Leaderboard::treeAdd(int idx, int delta)
+{
+	for (; idx <= MaxScore; idx += idx & -idx)
+		tree[idx] += delta;
+}
+
+unsigned int Leaderboard::treeSum(int idx) const
+{
+	unsigned int sum = 0;
+	
+	for (; idx > 0; idx -= idx & -idx)
+		sum += tree[idx];
+	
+	return sum;
+}
+
+// find the bucket holding 1-based position rank; before is set to the
+// number of players in all higher buckets
+int Leaderboard::treeFind(unsigned int rank, unsigned int *before) const
+{
+	int idx = 0;
+	unsigned int sum = 0;
+	
+	for (int step = tree_mask; step; step >>= 1)
+	{
+		const int next = idx + step;
+		if (next <= MaxScore && sum + tree[next] < rank)
+		{
+			idx = next;
+			sum += tree[next];
+		}
+	}
+	
+	*before = sum;
+	return idx + 1;
+}
+
+void Leaderboard::unlink(entry *e)
+{
+	vector<entry*> &bucket = buckets[bucketIndex(e->score)];
+	
+	// swap-remove; move the last entry of the bucket into the freed slot
+	entry *last = bucket.back();
+	bucket[e->slot] = last;
+	last->slot = e->slot;
+	bucket.pop_back();
+	
+	treeAdd(bucketIndex(e->score), -1);
+}
+
+void Leaderboard::link(entry *e)
+{
+	vector<entry*> &bucket = buckets[bucketIndex(e->score)];
+	
+	e->slot = bucket.size();
+	bucket.push_back(e);
+	
+	treeAdd(bucketIndex(e->score), 1);
+}
+
+void Leaderboard::update(const string &uuid, const string &name, int score, unsigned int gamecount)
+{
+	if (score > MaxScore)
+		score = MaxScore;
+	else if (score < MinScore)
+		score = MinScore;
+	
+	unordered_map<string,entry>::iterator it = entries.find(uuid);
+	entry *e;
+	
+	if (it == entries.end())
+	{
+		e = &entries[uuid];
+		e->uuid = uuid;
+		e->name = "__unknown__";
+	}
+	else
+	{
+		e = &it->second;
+		unlink(e);
+	}
+	
+	if (name.length())
+		e->name = name;
+	e->score = score;
+	e->gamecount = gamecount;
+	
+	link(e);
+}
+
+const Leaderboard::entry* Leaderboard::find(const string &uuid) const
+{
+	unordered_map<string,entry>::const_iterator it = entries.find(uuid);
+	if (it == entries.end())
+		return 0;
+	
+	return &it->second;
+}
+
+unsigned int Leaderboard::getRank(const string &uuid) const
+{
+	const entry *e = find(uuid);
+	if (!e)
+		return 0;
+	
+	return treeSum(bucketIndex(e->score) - 1) + e->slot + 1;
+}
+
+const Leaderboard::entry* Leaderboard::getEntry(unsigned int rank) const
+{
+	if (!rank || rank > entries.size())
+		return 0;
+	
+	unsigned int before;
+	const int idx = treeFind(rank, &before);
+	
+	return buckets[idx][rank - before - 1];
+}
+
+void Leaderboard::getRange(unsigned int first, unsigned int count, vector<const entry*> &list) const
+{
+	if (!first || first > entries.size())
+		return;
+	
+	unsigned int before;
+	int idx = treeFind(first, &before);
+	unsigned int slot = first - before - 1;
+	
+	// walk the buckets from the located position downwards
+	while (count && idx <= MaxScore)
+	{
+		const vector<entry*> &bucket = buckets[idx];
+		
+		for (; slot < bucket.size() && count; slot++, count--)
+			list.push_back(bucket[slot]);
+		
+		slot = 0;
+		idx++;
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#ifndef _LEADERBOARD_H
+#define _LEADERBOARD_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+//! \brief In-memory order-statistics index over the player rankings
+//
+// Players are kept in one bucket per score value; a Fenwick tree over the
+// bucket sizes answers "how many players rank above score X" and "which
+// bucket holds position N" in O(log MaxScore), independent of player count.
+class Leaderboard
+{
+public:
+	static const int MinScore = 1;
+	static const int MaxScore = 1000;
+	
+	typedef struct {
+		std::string uuid;
+		std::string name;
+		int score;
+		unsigned int gamecount;
+		unsigned int slot;	// index within score bucket
+	} entry;
+	
+	Leaderboard();
+	
+	void clear();
+	
+	//! \brief Insert a player or move it to a new score; an empty name keeps the stored one
+	void update(const std::string &uuid, const std::string &name, int score, unsigned int gamecount);
+	
+	//! \brief Returns NULL if the player has no ranking
+	const entry* find(const std::string &uuid) const;
+	
+	//! \brief 1-based position of player, 0 if not ranked
+	unsigned int getRank(const std::string &uuid) const;
+	
+	//! \brief Player at 1-based position, NULL if out of range
+	const entry* getEntry(unsigned int rank) const;
+	
+	//! \brief Append up to count entries starting at 1-based position first
+	void getRange(unsigned int first, unsigned int count, std::vector<const entry*> &list) const;
+	
+	unsigned int size() const { return entries.size(); };
+	
+private:
+	// buckets are ordered by descending score, index 1 is MaxScore
+	static int bucketIndex(int score) { return MaxScore - score + 1; };
+	
+	void treeAdd(int idx, int delta);
+	unsigned int treeSum(int idx) const;
+	int treeFind(unsigned int rank, unsigned int *before) const;
+	
+	void unlink(entry *e);
+	void link(entry *e);
+	
+	std::unordered_map<std::string,entry> entries;
+	std::vector<entry*> buckets[MaxScore + 1];
+	unsigned int tree[MaxScore + 1];
+	int tree_mask;	// highest power of two <= MaxScore
+};
+
+#endif /* _LEADERBOARD_H */
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <cstring>
+
+#include "RateLimiter.hpp"
+
+
+// commands limited by a class of their own; others only count as RateGeneral
+static const struct {
+	const char *command;
+	rate_class cls;
+} rate_commands[] = {
+	{ "SYNC", RateNone },
+	{ "REQUEST", RateQuery },
+	{ "LOBBY", RateQuery },
+	{ "FOYER", RateQuery },
+	{ "ACTION", RatePlay },
+	{ "STRADDLE", RatePlay },
+	{ "BUYINSURANCE", RatePlay },
+	{ "REBUY", RatePlay },
+	{ "RESPITE", RatePlay },
+	{ "CREATE", RateManage },
+	{ "REGISTER", RateManage },
+	{ "UNREGISTER", RateManage },
+	{ "SUBSCRIBE", RateManage },
+	{ "UNSUBSCRIBE", RateManage },
+	{ "AUTH", RateManage },
+	{ "CONFIG", RateManage },
+};
+
+
+rate_class RateLimiter::commandClass(const char *cmd, int length)
+{
+	int start = 0;
+	while (start < length && cmd[start] == ' ')
+		start++;
+	while (start < length && cmd[start] >= '0' && cmd[start] <= '9')
+		start++;
+	while (start < length && cmd[start] == ' ')
+		start++;
+	
+	int end = start;
+	while (end < length && cmd[end] != ' ')
+		end++;
+	
+	const size_t word = end - start;
+	for (unsigned int i=0; i < sizeof(rate_commands) / sizeof(rate_commands[0]); i++)
+	{
+		if (strlen(rate_commands[i].command) == word &&
+			!memcmp(rate_commands[i].command, cmd + start, word))
+			return rate_commands[i].cls;
+	}
+	
+	return RateGeneral;
+}
+
+void RateLimiter::refill(rate_bucket &bucket, unsigned long long now, double rate, double burst)
+{
+	if (!bucket.last_refill)
+		bucket.tokens = burst;
+	else
+		bucket.tokens += (now - bucket.last_refill) * rate / 1000000.0;
+	
+	if (bucket.tokens > burst)
+		bucket.tokens = burst;
+	
+	bucket.last_refill = now;
+}
+
+RateLimiter::Verdict RateLimiter::check(rate_class cls, unsigned long long now, const Limits &limits)
+{
+	if (cls == RateNone)
+		return Pass;
+	
+	rate_bucket &general = buckets[RateGeneral];
+	rate_bucket &own = buckets[cls];
+	
+	refill(general, now, limits.rate[RateGeneral], limits.burst[RateGeneral]);
+	if (cls != RateGeneral)
+		refill(own, now, limits.rate[cls], limits.burst[cls]);
+	
+	if (general.tokens >= 1 && own.tokens >= 1)
+	{
+		general.tokens -= 1;
+		if (cls != RateGeneral)
+			own.tokens -= 1;
+		
+		if (strikes && now - strike_time > limits.forgive_usec)
+			strikes = 0;
+		
+		delayed = false;
+		return Pass;
+	}
+	
+	// a delayed command being retried is not counted again
+	if (!delayed)
+	{
+		strikes++;
+		strike_time = now;
+	}
+	
+	if (strikes > limits.disconnect_strikes)
+		return Disconnect;
+	
+	if (strikes > limits.delay_strikes)
+	{
+		delayed = false;
+		return Refuse;
+	}
+	
+	delayed = true;
+	return Delay;
+}
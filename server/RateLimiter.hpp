@@ -0,0 +1,91 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#ifndef _RATELIMITER_H
+#define _RATELIMITER_H
+
+
+//! \brief Command classes with their own rate limit
+typedef enum {
+	RateNone = -1,		// not limited (SYNC)
+	RateGeneral = 0,	// all other commands; every command also counts here
+	RateQuery,		// REQUEST, LOBBY, FOYER
+	RatePlay,		// ACTION, STRADDLE, BUYINSURANCE, REBUY, RESPITE
+	RateManage,		// CREATE, (UN)REGISTER, (UN)SUBSCRIBE, AUTH, CONFIG
+	RateClasses
+} rate_class;
+
+//! \brief Token bucket of a command class
+typedef struct {
+	double tokens;
+	unsigned long long last_refill;
+} rate_bucket;
+
+
+//! \brief Token buckets and escalation for the commands of one client
+//
+// A command finding an empty bucket is a strike. Up to delay_strikes strikes
+// the command is delayed until tokens are available, after that it is
+// refused, and beyond disconnect_strikes the client is to be disconnected.
+// Strikes are forgiven once the client has kept to its limits for
+// forgive_usec. A zero-filled RateLimiter is a fresh one with full buckets.
+class RateLimiter
+{
+public:
+	typedef enum {
+		Pass,
+		Delay,
+		Refuse,
+		Disconnect
+	} Verdict;
+	
+	typedef struct {
+		double rate[RateClasses];	// commands per second
+		double burst[RateClasses];	// commands at once
+		unsigned int delay_strikes;
+		unsigned int disconnect_strikes;
+		unsigned long long forgive_usec;
+	} Limits;
+	
+	//! \brief Class of a framed command line; an optional message-id is skipped
+	static rate_class commandClass(const char *cmd, int length);
+	
+	//! \brief Take the tokens for a command of class cls at time now (usec)
+	Verdict check(rate_class cls, unsigned long long now, const Limits &limits);
+	
+	//! \brief The command waiting for tokens is gone or no longer limited
+	void clearDelay() { delayed = false; };
+	
+	bool isDelayed() const { return delayed; };
+	unsigned int getStrikes() const { return strikes; };
+	
+private:
+	static void refill(rate_bucket &bucket, unsigned long long now, double rate, double burst);
+	
+	rate_bucket buckets[RateClasses];
+	unsigned int strikes;			// throttled commands
+	unsigned long long strike_time;		// time of the last strike
+	bool delayed;				// the next command is a retry, not a new strike
+};
+
+#endif /* _RATELIMITER_H */
@@ -29,10 +29,13 @@
 
 #include "Config.h"
 #include "Logger.h"
+#include "Trace.hpp"
 #include "Debug.h"
+#include "SysAccess.h"
 #include "SNGGameController.hpp"
 #include "GameLogic.hpp"
 #include "Card.hpp"
+#include "MessageWriter.hpp"
 
 #include "game.hpp"
 
@@ -82,11 +85,7 @@ SNGGameController::SNGGameController(const GameController& g)
 SNGGameController::~SNGGameController()
 {
 	// remove all players
-	for (players_type::iterator e = players.begin(); e != players.end();)
-	{
-		delete e->second;
-		players.erase(e++);
-	}
+	clearPlayers();
 }
 
 void SNGGameController::addBlindLevels()
@@ -95,7 +94,7 @@ void SNGGameController::addBlindLevels()
         3000, 4000, 6000, 8000, 10000, 12000, 16000, 20000, 24000, 30000, 40000,
         60000, 80000, 100000};
 
-    for (size_t i = 0; i < sizeof(big_blinds); i++ ) {
+    for (size_t i = 0; i < sizeof(big_blinds) / sizeof(big_blinds[0]); i++ ) {
         BlindLevel blind_level;
         blind_level.level = i + 1;
         blind_level.big_blind = big_blinds[i];
@@ -117,14 +116,10 @@ void SNGGameController::reset()
     hand_no = 0;
 
     // remove all players
-    for (players_type::iterator e = players.begin(); e != players.end();)
-    {
-        delete e->second;
-        players.erase(e++);
-    }
+    clearPlayers();
 
     // remove all spectators
-    spectators.clear();
+    clearSpectators();
 
     // clear finish list
     finish_list.clear();
@@ -149,7 +144,7 @@ bool SNGGameController::addPlayer(int cid, const std::string &uuid, chips_type p
     if (isSpectator(cid))
         removeSpectator(cid);
 
-    Player *p = new Player;
+    Player *p = player_pool.create();
     p->client_id = cid;
     p->setStake(player_stake);
     p->setTimeout(timeout);
@@ -157,7 +152,7 @@ bool SNGGameController::addPlayer(int cid, const std::string &uuid, chips_type p
     // save a copy of the UUID (player might disconnect)
     p->uuid = uuid;
 
-    players[cid] = p;
+    registerPlayer(cid, p);
 
     return true;
 }
@@ -177,7 +172,7 @@ bool SNGGameController::removePlayer(int cid)
     if (owner == cid)
         bIsOwner = true;
 
-    players.erase(it);
+    unregisterPlayer(cid);
 
 
     // find a new owner
@@ -198,22 +193,13 @@ bool SNGGameController::getPlayerList(vector<int> &client_list, bool including_w
     return true;
 }
 
-bool SNGGameController::getPlayerList(vector<string> &client_list) const
+bool SNGGameController::writePlayerList(MessageWriter &w) const
 {
-    client_list.clear();
-
     for (players_type::const_iterator e = players.begin(); e != players.end(); e++) {
-        char tmp[1024];
-        string sp = "";
-        snprintf(tmp, sizeof(tmp),
-                "%d:%d:%d:%d ",
-                e->first,
-                e->second->getTableNo(),
-                e->second->getSeatNo(),
-                e->second->getStake());
-
-        sp += tmp;
-        client_list.push_back(sp);
+        w << e->first << ':'
+            << e->second->getTableNo() << ':'
+            << e->second->getSeatNo() << ':'
+            << (int)e->second->getStake() << ' ';
     }
 
     return true;
@@ -230,9 +216,14 @@ void SNGGameController::handleRebuy(Table *t)
         Player *p = e->second;
         p->setStake(p->getStake() + p->getRebuyStake());
         p->setRebuyStake(0); //clear rebuy stake so it wont be added next time
+        if (p->getSeatNo() < 0) {
+            // not seated at this table
+            e++;
+            continue;
+        }
         if (t->seats[p->getSeatNo()].occupied == false && p->getStake() >= blind.amount) {
             // player has gone broken and rebought, mark him as occupied so he can join next round
-            t->seats[p->getSeatNo()].occupied = true;
+            t->setOccupied(p->getSeatNo(), true);
         }
         e++;
     }
@@ -240,12 +231,14 @@ void SNGGameController::handleRebuy(Table *t)
 
 void SNGGameController::stateNewRound(Table *t)
 {
+    TraceScope trace("SNGGameController::stateNewRound", t->table_id);
     handleRebuy(t);
     GameController::stateNewRound(t);
 }
 
 void SNGGameController::stateBlinds(Table *t)
 {
+    TraceScope trace("SNGGameController::stateBlinds", t->table_id);
     int next_level = 0;
     int next_amount = 0;
     if (blind.level < blind_levels.size()) {
@@ -257,9 +250,9 @@ void SNGGameController::stateBlinds(Table *t)
     switch ((int) blind.blindrule)
     {
         case BlindByTime:
-            if (difftime(time(NULL), blind.last_blinds_time) > blind.blinds_time && blind.level < blind_levels.size() )
+            if (difftime(now(), blind.last_blinds_time) > blind.blinds_time && blind.level < blind_levels.size() )
             {
-                blind.last_blinds_time = time(NULL);
+                blind.last_blinds_time = now();
                 BlindLevel blind_level = blind_levels[++blind.level];
                 blind.amount = blind_level.big_blind;
 
@@ -276,21 +269,22 @@ void SNGGameController::stateBlinds(Table *t)
     }
 
     // send out blinds snapshot
-    snprintf(msg, sizeof(msg), "%d %d %d %d %d %d %d", 
-            SnapGameStateBlinds, 
-            blind.amount / 2, 
-            blind.amount, 
-            (int)blind.level, 
-            next_level, 
-            next_amount, 
-            (int)blind.last_blinds_time);
-    snap(t->table_id, SnapGameState, msg);
+    MessageWriter w(msg);
+    w << (int)SnapGameStateBlinds << ' '
+            << (int)(blind.amount / 2) << ' '
+            << (int)blind.amount << ' '
+            << (int)blind.level << ' '
+            << next_level << ' '
+            << next_amount << ' '
+            << (int)blind.last_blinds_time;
+    snap(t->table_id, SnapGameState, w.c_str());
 
     GameController::stateBlinds(t);
 }
 
 void SNGGameController::stateBetting(Table *t)
 {
+    TraceScope trace("SNGGameController::stateBetting", t->table_id);
     Player *p = t->seats[t->cur_player].player;
 
     bool allowed_action = false;  // is action allowed?
@@ -329,12 +323,14 @@ void SNGGameController::stateBetting(Table *t)
 
                 // retry with this action
                 p->next_action.action = Player::Check;
+                stateBetting(t);
                 return;
             }
             else if (t->bet_amount > t->seats[t->cur_player].bet + p->stake)
             {
                 // simply convert this action to allin
                 p->next_action.action = Player::Allin;
+                stateBetting(t);
                 return;
             }
             else
@@ -349,9 +345,9 @@ void SNGGameController::stateBetting(Table *t)
                 chat(p->client_id, t->table_id, "You cannot bet, there was already a bet! Try raise.");
             else if (p->next_action.amount < minimum_bet)
             {
-                snprintf(msg, sizeof(msg), "You cannot bet this amount. Minimum bet is %d.",
-                        minimum_bet);
-                chat(p->client_id, t->table_id, msg);
+                MessageWriter w(msg);
+                w << "You cannot bet this amount. Minimum bet is " << (int)minimum_bet << '.';
+                chat(p->client_id, t->table_id, w.c_str());
             }
             else
             {
@@ -367,13 +363,14 @@ void SNGGameController::stateBetting(Table *t)
 
                 // retry with this action
                 p->next_action.action = Player::Bet;
+                stateBetting(t);
                 return;
             }
             else if (p->next_action.amount < minimum_bet)
             {
-                snprintf(msg, sizeof(msg), "You cannot raise this amount. Minimum bet is %d.",
-                        minimum_bet);
-                chat(p->client_id, t->table_id, msg);
+                MessageWriter w(msg);
+                w << "You cannot raise this amount. Minimum bet is " << (int)minimum_bet << '.';
+                chat(p->client_id, t->table_id, w.c_str());
             }
             else
             {
@@ -394,7 +391,7 @@ void SNGGameController::stateBetting(Table *t)
     { 
         // handle player timeout
 #ifndef SERVER_TESTING
-        if (p->sitout || (unsigned int)difftime(time(NULL), t->timeout_start) > p->getTimeout())
+        if (p->sitout || (unsigned int)difftime(now(), t->timeout_start) > p->getTimeout())
         {
             if (!p->sitout) {
                 p->setTimedoutCount(p->getTimedoutCount() + 1);
@@ -437,15 +434,17 @@ void SNGGameController::stateBetting(Table *t)
     }
     else if (action == Player::Fold)
     {
-        t->seats[t->cur_player].in_round = false;
+        t->setInRound(t->cur_player, false);
 
-        snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionFolded, p->client_id, auto_action ? 1 : 0);
-        snap(t->table_id, SnapPlayerAction, msg);
+        MessageWriter w(msg);
+        w << (int)SnapPlayerActionFolded << ' ' << p->client_id << ' ' << (auto_action ? 1 : 0);
+        snap(t->table_id, SnapPlayerAction, w.c_str());
     }
     else if (action == Player::Check)
     {
-        snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionChecked, p->client_id, auto_action ? 1 : 0);
-        snap(t->table_id, SnapPlayerAction, msg);
+        MessageWriter w(msg);
+        w << (int)SnapPlayerActionChecked << ' ' << p->client_id << ' ' << (auto_action ? 1 : 0);
+        snap(t->table_id, SnapPlayerAction, w.c_str());
     }
     else
     {
@@ -457,6 +456,8 @@ void SNGGameController::stateBetting(Table *t)
         t->seats[t->cur_player].bet += amount;
         p->stake -= amount;
 
+        MessageWriter w(msg);
+
         if (action == Player::Bet || action == Player::Raise || action == Player::Allin)
         {
             // only re-open betting round if amount greater than table-bet
@@ -469,17 +470,17 @@ void SNGGameController::stateBetting(Table *t)
             }
 
             if (action == Player::Allin || p->stake == 0)
-                snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionAllin, p->client_id, t->seats[t->cur_player].bet);
+                w << (int)SnapPlayerActionAllin << ' ' << p->client_id << ' ' << (int)t->seats[t->cur_player].bet;
             else if (action == Player::Bet)
-                snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionBet, p->client_id, t->bet_amount);
+                w << (int)SnapPlayerActionBet << ' ' << p->client_id << ' ' << (int)t->bet_amount;
             else if (action == Player::Raise)
-                snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionRaised, p->client_id, t->bet_amount);
+                w << (int)SnapPlayerActionRaised << ' ' << p->client_id << ' ' << (int)t->bet_amount;
         }
         else
-            snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionCalled, p->client_id, amount);
+            w << (int)SnapPlayerActionCalled << ' ' << p->client_id << ' ' << (int)amount;
 
 
-        snap(t->table_id, SnapPlayerAction, msg);
+        snap(t->table_id, SnapPlayerAction, w.c_str());
     }
 
     // all players except one folded, so end this hand
@@ -494,7 +495,7 @@ void SNGGameController::stateBetting(Table *t)
         t->cur_player = t->getNextActivePlayer(t->cur_player);
 
         // initialize the player's timeout
-        t->timeout_start = time(NULL);
+        t->timeout_start = now();
 
         sendTableSnapshot(t);
         t->resetLastPlayerActions();
@@ -543,7 +544,7 @@ void SNGGameController::stateBetting(Table *t)
                 t->cur_player = t->getNextActivePlayer(t->last_bet_player);
 
                 // initialize the player's timeout
-                t->timeout_start = time(NULL);
+                t->timeout_start = now();
 
 
                 // end of hand, do showdown/ ask for show
@@ -571,7 +572,7 @@ void SNGGameController::stateBetting(Table *t)
         t->cur_player = t->getNextActivePlayer(t->dealer);
 
         // re-initialize the player's timeout
-        t->timeout_start = time(NULL);
+        t->timeout_start = now();
 
 
         // first action for next betting round is at this player
@@ -590,7 +591,7 @@ void SNGGameController::stateBetting(Table *t)
 
         // find next player
         t->cur_player = t->getNextActivePlayer(t->cur_player);
-        t->timeout_start = time(NULL);
+        t->timeout_start = now();
 
         // reset current player's last action
         p = t->seats[t->cur_player].player;
@@ -611,9 +612,13 @@ void SNGGameController::stateBetting(Table *t)
 
 void SNGGameController::stateEndRound(Table *t)
 {
-    multimap<chips_type,unsigned int> broken_players;
-    // assemble stake string
-    string sstake;
+    TraceScope trace("SNGGameController::stateEndRound", t->table_id);
+    // broken players by stake before the hand; equal stakes keep the seat order
+    struct { chips_type stake_before; unsigned int seat_num; } broken_players[10];
+    unsigned int broken_count = 0;
+    // assemble stake string; room for "<cid>:<stake>:<change> " of each seat
+    char sstake[10 * (3 * MessageWriter::IntLength + 3) + 1];
+    MessageWriter ws(sstake);
 
     // find broken players
     for (unsigned int i=0; i < 10; i++)
@@ -624,42 +629,40 @@ void SNGGameController::stateEndRound(Table *t)
         Player *p = t->seats[i].player;
 
         // assemble stake string
-        char tmp[1024];
-        snprintf(tmp, sizeof(tmp), "%d:%d:%d",
-                p->client_id,
-                p->stake,
-                p->stake - p->stake_before);
-        sstake += tmp;
-        sstake += ' ';
+        ws << p->client_id << ':' << (int)p->stake << ':' << (int)(p->stake - p->stake_before) << ' ';
 
         // player has no stake left
         if (p->stake == 0)
-            broken_players.insert(pair<chips_type,int>(p->stake_before, i));
+        {
+            unsigned int k = broken_count++;
+            for (; k > 0 && broken_players[k - 1].stake_before > p->stake_before; k--)
+                broken_players[k] = broken_players[k - 1];
+
+            broken_players[k].stake_before = p->stake_before;
+            broken_players[k].seat_num = i;
+        }
         else
         {
             // there is a net win
             if (p->stake > p->stake_before)
             {
-                snprintf(msg, sizeof(msg), "%d %d %d",
-                        p->client_id,
-                        -1,	/* reserved */
-                        p->stake - p->stake_before);
-                snap(t->table_id, SnapWinAmount, msg);
+                MessageWriter w(msg);
+                w << p->client_id << ' ' << -1 /* reserved */ << ' ' << (int)(p->stake - p->stake_before);
+                snap(t->table_id, SnapWinAmount, w.c_str());
             }
         }
     }
 
     // send stake change
-    snap(t->table_id, SnapStakeChange, sstake.c_str());
+    snap(t->table_id, SnapStakeChange, ws.c_str());
 
     sendTableSnapshot(t);
 
     // remove players in right order: sorted by stake_before
     // FIXME: how to handle players which had the same stake?
-    for (multimap<chips_type,unsigned int>::iterator n = broken_players.begin(); n != broken_players.end(); n++)
+    for (unsigned int n=0; n < broken_count; n++)
     {
-        //const chips_type stake_before = n->first;
-        const unsigned int seat_num = n->second;
+        const unsigned int seat_num = broken_players[n].seat_num;
 
         Player *p = t->seats[seat_num].player;
 
@@ -667,15 +670,13 @@ void SNGGameController::stateEndRound(Table *t)
         finish_list.push_back(p);
 
         // send out player-broke snapshot
-        snprintf(msg, sizeof(msg), "%d %d %d",
-                SnapGameStateBroke,
-                p->client_id,
-                getPlayerCount() - (int)finish_list.size() + 1);
+        MessageWriter w(msg);
+        w << (int)SnapGameStateBroke << ' ' << p->client_id << ' ' << (int)(getPlayerCount() - finish_list.size() + 1);
 
-        snap(t->table_id, SnapGameState, msg);
+        snap(t->table_id, SnapGameState, w.c_str());
 
         // mark seat as unused
-        t->seats[seat_num].occupied = false;
+        t->setOccupied(seat_num, false);
     }
 
 
@@ -694,7 +695,7 @@ int SNGGameController::handleTable(Table *t)
         return 0;
     }
 
-    log_msg("game", "handling table state: %d", t->state);
+    log_debug("game", "handling table state: %d", t->state);
     if (t->state == Table::NewRound)
         stateNewRound(t);
     else if (t->state == Table::Blinds)
@@ -736,15 +737,16 @@ void SNGGameController::start()
     placePlayers();
 
     blind.amount = blind.start;
-    blind.last_blinds_time = time(NULL);
+    blind.last_blinds_time = now();
 
     log_msg("game", "game %d has been started", game_id);
     status = Started;
-    started_time = time(NULL);
+    started_time = now();
 }
 
 int SNGGameController::tick()
 {
+    TraceScope trace("SNGGameController::tick", game_id);
     if (status == Created)
     {
         if (getPlayerCount() == max_players)   {
@@ -762,7 +764,7 @@ int SNGGameController::tick()
     }
     else if (status == Paused)
     {
-        log_msg("game", "game %d is paused ", getGameId());
+        log_debug("game", "game %d is paused ", getGameId());
         return 0;
     }
 
@@ -771,17 +773,23 @@ int SNGGameController::tick()
     {
         Table *t = e->second;
 
+        const int state = t->delay ? -1 : (int) t->state;
+        const unsigned long long tick_start = sys_clock_usec();
+        const int rc = handleTable(t);
+        metrics_table_tick(state, sys_clock_usec() - tick_start);
+
         // table closed?
-        if (handleTable(t) < 0)
+        if (rc < 0)
         {
             // is this the last table?  /* FIXME: very very dirty */
             if (tables.size() == 1)
             {
                 status = Ended;
-                ended_time = time(NULL);
+                ended_time = now();
 
-                snprintf(msg, sizeof(msg), "%d", SnapGameStateEnd);
-                snap(-1, SnapGameState, msg);
+                MessageWriter w(msg);
+                w << (int)SnapGameStateEnd;
+                snap(-1, SnapGameState, w.c_str());
 
                 // push back last remaining player to finish_list
                 for (unsigned int i=0; i < 10; ++i)
@@ -792,7 +800,7 @@ int SNGGameController::tick()
                     }
             }
 
-            delete t;
+            table_pool.destroy(t);
             tables.erase(e++);
         }
         else
@@ -54,7 +54,7 @@ public:
     void reset();
 	
 	bool getPlayerList(std::vector<int> &client_list, bool including_wanna_leave = false) const;
-	bool getPlayerList(std::vector<std::string> &client_list) const;
+	bool writePlayerList(MessageWriter &w) const;
 	
 	void stateNewRound(Table *t) ;
     void stateBetting(Table *t);
@@ -30,10 +30,13 @@
 
 #include "Config.h"
 #include "Logger.h"
+#include "Trace.hpp"
 #include "Debug.h"
+#include "SysAccess.h"
 #include "SitAndGoGameController.hpp"
 #include "GameLogic.hpp"
 #include "Card.hpp"
+#include "MessageWriter.hpp"
 
 #include "game.hpp"
 
@@ -43,6 +46,35 @@ using namespace std;
 // temporary buffer for chat/snap data
 static char msg[1024];
 
+// append the cards of the mask, highest first, as "Ah:Ad:Kc"
+static void format_cards(cardmask_type mask, MessageWriter &w)
+{
+	bool first = true;
+	while (mask)
+	{
+		const unsigned int index = Card::highestMaskIndex(mask);
+		if (!first)
+			w << ':';
+		w.write(Card::fromMaskIndex(index).getName(), 2);
+		first = false;
+		mask &= ~(1ULL << index);
+	}
+}
+
+static bool has_opponent_outs(const Player::InsuranceInfo &info)
+{
+	for (unsigned int i = 0; i < 10; ++i)
+		if (info.every_single_outs[i])
+			return true;
+	return false;
+}
+
+static void clear_opponent_outs(Player::InsuranceInfo &info)
+{
+	for (unsigned int i = 0; i < 10; ++i)
+		info.every_single_outs[i] = 0;
+}
+
 
 SitAndGoGameController::SitAndGoGameController()
 {
@@ -59,6 +91,7 @@ SitAndGoGameController::SitAndGoGameController()
     setOwner(-1);
 
     addBlindLevels();
+    loser_buffer.reserve(10);
 }
 
 SitAndGoGameController::SitAndGoGameController(const GameController& g)
@@ -78,17 +111,14 @@ SitAndGoGameController::SitAndGoGameController(const GameController& g)
 	setPassword(g.getPassword());
 
     addBlindLevels();
+    loser_buffer.reserve(10);
 }
 
 
 SitAndGoGameController::~SitAndGoGameController()
 {
 	// remove all players
-	for (players_type::iterator e = players.begin(); e != players.end();)
-	{
-		delete e->second;
-		players.erase(e++);
-	}
+	clearPlayers();
 }
 
 
@@ -100,18 +130,14 @@ void SitAndGoGameController::reset()
 	blind.blindrule = BlindNone;	
 	
     status = Created;
-    created_time = time(NULL);
+    created_time = now();
 	hand_no = 0;
 	
 	// remove all players
-	for (players_type::iterator e = players.begin(); e != players.end();)
-	{
-		delete e->second;
-		players.erase(e++);
-	}
+	clearPlayers();
 	
 	// remove all spectators
-	spectators.clear();
+	clearSpectators();
 	
 	// clear finish list
 	finish_list.clear();
@@ -120,15 +146,8 @@ void SitAndGoGameController::reset()
 
 unsigned int randomSeat()
 {
-    unsigned int seed;
-    FILE *urandom;
-
-    urandom = fopen ("/dev/urandom", "r");
-    fread (&seed, sizeof (seed), 1, urandom);
-    fclose(urandom);
-
+    // the PRNG is seeded once at server start (see pserver.cpp)
     int max = 8, min = 0;
-    srand(seed);
     int randNum = rand()%(max-min + 1) + min;
 
     return randNum;
@@ -144,7 +163,7 @@ void SitAndGoGameController::takeSeat(Table *t, int seat_no, Player *p)
     //t->seats[seat_no].in_round = false;
     t->seats[seat_no].auto_showcards = false;
     t->seats[seat_no].manual_showcards = false;
-    t->seats[seat_no].occupied = true;
+    t->setOccupied(seat_no, true);
 
     p->setTableNo(t->getTableId());
     p->setSeatNo(seat_no);
@@ -190,10 +209,21 @@ bool SitAndGoGameController::arrangeSeat(int cid)
         }
 		
         takeSeat(t, i, p);
-        break;
+        return true;
 	}
 
-    return true;
+    // random picks missed; take the first free seat
+    for (int i = 0; i < 10; i++)
+    {
+        if (!t->isSeatAvailable(i))
+            continue;
+
+        takeSeat(t, i, p);
+        return true;
+    }
+
+    log_msg("SitAndGoGameController", "no free seat for player %d", cid);
+    return false;
 }
 
 bool SitAndGoGameController::addPlayer(int cid, const std::string &uuid, chips_type player_stake)
@@ -217,7 +247,7 @@ bool SitAndGoGameController::addPlayer(int cid, const std::string &uuid, chips_t
 	if (isSpectator(cid))
 		removeSpectator(cid);
 	
-	Player *p = new Player;
+	Player *p = player_pool.create();
 	p->client_id = cid;
 	p->setStake(player_stake);
     p->setTimeout(timeout);
@@ -225,7 +255,7 @@ bool SitAndGoGameController::addPlayer(int cid, const std::string &uuid, chips_t
 	// save a copy of the UUID (player might disconnect)
 	p->uuid = uuid;
 	
-	players[cid] = p;
+	registerPlayer(cid, p);
 	
     if (tables.size() < 1) {
         placeTable(0, getPlayerCount());
@@ -295,14 +325,11 @@ bool SitAndGoGameController::resumePlayer(int cid)
         log_msg("game ", "sending table snap and hole cards to  %d", cid);
         sendTableSnapshot(t);
 
-        vector<Card> cards;
+        CardArray<2> cards;
         p->holecards.copyCards(&cards);
-        char card1[3], card2[3];
-        strcpy(card1, cards[0].getName());
-        strcpy(card2, cards[1].getName());
-        snprintf(msg, sizeof(msg), "%d %s %s",
-                SnapCardsHole, card1, card2);
-        snap(p->client_id, p->getTableNo(), SnapCards, msg);
+        MessageWriter w(msg);
+        w << (int)SnapCardsHole << ' ' << cards[0].getName() << ' ' << cards[1].getName();
+        snap(p->client_id, p->getTableNo(), SnapCards, w.c_str());
     }
 
 	return true;
@@ -325,23 +352,14 @@ bool SitAndGoGameController::getPlayerList(vector<int> &client_list, bool includ
     return true;
 }
 
-bool SitAndGoGameController::getPlayerList(vector<string> &client_list) const
+bool SitAndGoGameController::writePlayerList(MessageWriter &w) const
 {
-	client_list.clear();
-	
 	for (players_type::const_iterator e = players.begin(); e != players.end(); e++) {
         if (!e->second->wanna_leave) {
-            char tmp[1024];
-            string sp = "";
-            snprintf(tmp, sizeof(tmp),
-                    "%d:%d:%d:%d ",
-                    e->first,
-                    e->second->getTableNo(),
-                    e->second->getSeatNo(),
-                    e->second->getStake());
-
-            sp += tmp;
-            client_list.push_back(sp);
+            w << e->first << ':'
+                << e->second->getTableNo() << ':'
+                << e->second->getSeatNo() << ':'
+                << (int)e->second->getStake() << ' ';
         }
     }
 
@@ -366,11 +384,17 @@ void SitAndGoGameController::handleRebuy(Table *t)
         p->setStake(p->getStake() + p->getRebuyStake());
         p->setRebuyStake(0); //clear rebuy stake so it wont be added next time
 
+        // not seated (no free seat was found for him)
+        if (p->getSeatNo() < 0) {
+            e++;
+            continue;
+        }
+
 		if (p->getStake() >= amount && !p->wanna_leave)
 		{
             // player has gone broken and rebought, mark him as occupied so he can join next round
-            t->seats[p->getSeatNo()].occupied = true;
-            t->seats[p->getSeatNo()].in_round = true;
+            t->setOccupied(p->getSeatNo(), true);
+            t->setInRound(p->getSeatNo(), true);
         }
         e++;
     }
@@ -487,6 +511,7 @@ void SitAndGoGameController::handleWannaLeave(Table *t)
 
 void SitAndGoGameController::stateNewRound(Table *t)
 {
+    TraceScope trace("SitAndGoGameController::stateNewRound", t->table_id);
     handleRebuy(t);
     handleWannaLeave(t);
     if (t->countActivePlayers() < 2) 
@@ -497,6 +522,7 @@ void SitAndGoGameController::stateNewRound(Table *t)
 
 void SitAndGoGameController::stateBlinds(Table *t)
 {
+	TraceScope trace("SitAndGoGameController::stateBlinds", t->table_id);
 	handleAnte(t);
 	handleStraddle(t);
 
@@ -509,6 +535,7 @@ void SitAndGoGameController::stateBlinds(Table *t)
 
 void SitAndGoGameController::stateBetting(Table *t)
 {
+    TraceScope trace("SitAndGoGameController::stateBetting", t->table_id);
     
     Player *p = t->seats[t->cur_player].player;
     
@@ -544,18 +571,20 @@ void SitAndGoGameController::stateBetting(Table *t)
         {
             if (t->bet_amount == 0 || t->bet_amount == t->seats[t->cur_player].bet)
             {
-                log_msg("test", "bet_amount %d,  %d", t->bet_amount, t->seats[t->cur_player].bet);
+                log_debug("test", "bet_amount %d,  %d", t->bet_amount, t->seats[t->cur_player].bet);
                 //chat(p->client_id, t->table_id, "You cannot call, nothing was bet! Try check.");
 
                 // retry with this action
                 p->next_action.action = Player::Check;
+                stateBetting(t);
                 return;
             }
             else if (t->bet_amount > t->seats[t->cur_player].bet + p->stake)
             {
-                log_msg("test", "bet_amount %d,  %d", t->bet_amount, t->seats[t->cur_player].bet + p->stake);
+                log_debug("test", "bet_amount %d,  %d", t->bet_amount, t->seats[t->cur_player].bet + p->stake);
                 // simply convert this action to allin
                 p->next_action.action = Player::Allin;
+                stateBetting(t);
                 return;
             }
             else
@@ -570,9 +599,9 @@ void SitAndGoGameController::stateBetting(Table *t)
                 chat(p->client_id, t->table_id, "You cannot bet, there was already a bet! Try raise.");
             else if (p->next_action.amount < minimum_bet)
             {
-                snprintf(msg, sizeof(msg), "You cannot bet this amount. Minimum bet is %d.",
-                        minimum_bet);
-                chat(p->client_id, t->table_id, msg);
+                MessageWriter w(msg);
+                w << "You cannot bet this amount. Minimum bet is " << (int)minimum_bet << '.';
+                chat(p->client_id, t->table_id, w.c_str());
             }
             else
             {
@@ -588,13 +617,14 @@ void SitAndGoGameController::stateBetting(Table *t)
 
                 // retry with this action
                 p->next_action.action = Player::Bet;
+                stateBetting(t);
                 return;
             }
             else if (p->next_action.amount < minimum_bet)
             {
-                snprintf(msg, sizeof(msg), "You cannot raise this amount. Minimum bet is %d.",
-                        minimum_bet);
-                chat(p->client_id, t->table_id, msg);
+                MessageWriter w(msg);
+                w << "You cannot raise this amount. Minimum bet is " << (int)minimum_bet << '.';
+                chat(p->client_id, t->table_id, w.c_str());
             }
             else
             {
@@ -615,7 +645,7 @@ void SitAndGoGameController::stateBetting(Table *t)
     { 
         // handle player timeout
 #ifndef SERVER_TESTING
-        if (p->sitout || (unsigned int)difftime(time(NULL), t->timeout_start) > p->getTimeout())
+        if (p->sitout || (unsigned int)difftime(now(), t->timeout_start) > p->getTimeout())
         {
             if (!p->sitout) {
                 p->setTimedoutCount(p->getTimedoutCount() + 1);
@@ -625,7 +655,7 @@ void SitAndGoGameController::stateBetting(Table *t)
                 p->sitout = true;
                 p->setTimedoutCount(0);
                 p->wanna_leave = true;
-                t->seats[t->cur_player].in_round = false;
+                t->setInRound(t->cur_player, false);
                 log_msg("game", "player %d timed out more thatn 3 time, marking as wanna_leave", p->getClientId());
             }
 
@@ -659,15 +689,17 @@ void SitAndGoGameController::stateBetting(Table *t)
     }
     else if (action == Player::Fold)
     {
-        t->seats[t->cur_player].in_round = false;
+        t->setInRound(t->cur_player, false);
 
-        snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionFolded, p->client_id, auto_action ? 1 : 0);
-        snap(t->table_id, SnapPlayerAction, msg);
+        MessageWriter w(msg);
+        w << (int)SnapPlayerActionFolded << ' ' << p->client_id << ' ' << (auto_action ? 1 : 0);
+        snap(t->table_id, SnapPlayerAction, w.c_str());
     }
     else if (action == Player::Check)
     {
-        snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionChecked, p->client_id, auto_action ? 1 : 0);
-        snap(t->table_id, SnapPlayerAction, msg);
+        MessageWriter w(msg);
+        w << (int)SnapPlayerActionChecked << ' ' << p->client_id << ' ' << (auto_action ? 1 : 0);
+        snap(t->table_id, SnapPlayerAction, w.c_str());
     }
     else
     {
@@ -679,6 +711,8 @@ void SitAndGoGameController::stateBetting(Table *t)
         t->seats[t->cur_player].bet += amount;
         p->stake -= amount;
 
+        MessageWriter w(msg);
+
         if (action == Player::Bet || action == Player::Raise || action == Player::Allin)
         {
             // only re-open betting round if amount greater than table-bet
@@ -691,17 +725,17 @@ void SitAndGoGameController::stateBetting(Table *t)
             }
 
             if (action == Player::Allin || p->stake == 0)
-                snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionAllin, p->client_id, t->seats[t->cur_player].bet);
+                w << (int)SnapPlayerActionAllin << ' ' << p->client_id << ' ' << (int)t->seats[t->cur_player].bet;
             else if (action == Player::Bet)
-                snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionBet, p->client_id, t->bet_amount);
+                w << (int)SnapPlayerActionBet << ' ' << p->client_id << ' ' << (int)t->bet_amount;
             else if (action == Player::Raise)
-                snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionRaised, p->client_id, t->bet_amount);
+                w << (int)SnapPlayerActionRaised << ' ' << p->client_id << ' ' << (int)t->bet_amount;
         }
         else
-            snprintf(msg, sizeof(msg), "%d %d %d", SnapPlayerActionCalled, p->client_id, amount);
+            w << (int)SnapPlayerActionCalled << ' ' << p->client_id << ' ' << (int)amount;
 
 
-        snap(t->table_id, SnapPlayerAction, msg);
+        snap(t->table_id, SnapPlayerAction, w.c_str());
     }
 
     // all players except one folded, so end this hand
@@ -716,7 +750,7 @@ void SitAndGoGameController::stateBetting(Table *t)
         t->cur_player = t->getNextActivePlayer(t->cur_player);
 
         // initialize the player's timeout
-        t->timeout_start = time(NULL);
+        t->timeout_start = now();
 
         sendTableSnapshot(t);
         t->resetLastPlayerActions();
@@ -742,7 +776,7 @@ void SitAndGoGameController::stateBetting(Table *t)
         {
             if (t->betround == Table::Flop || t->betround == Table::Turn)
 		    {
-                log_msg("insurance", "betround flop or turn, nomoreaction=%d", t->nomoreaction);
+                log_debug("insurance", "betround flop or turn, nomoreaction=%d", t->nomoreaction);
 			    unsigned int round = 0;
 			    if (t->betround == Table::Turn)
 				    round = 1;
@@ -766,13 +800,13 @@ void SitAndGoGameController::stateBetting(Table *t)
             case Table::Preflop:
                 t->betround = Table::Flop;
                 dealFlop(t);
-                log_msg("betround", "Flop");
+                log_debug("betround", "Flop");
                 break;
 
             case Table::Flop:
                 t->betround = Table::Turn;
                 dealTurn(t);
-                log_msg("betround", "Turn");
+                log_debug("betround", "Turn");
 				if (t->nomoreaction && enable_insurance)
 					handleInsuranceBenefits(t, 0);
                 break;
@@ -780,7 +814,7 @@ void SitAndGoGameController::stateBetting(Table *t)
             case Table::Turn:
                 t->betround = Table::River;
                 dealRiver(t);
-                log_msg("betround", "River");
+                log_debug("betround", "River");
 				if (t->nomoreaction && enable_insurance)
 					handleInsuranceBenefits(t, 1);
                 break;
@@ -793,7 +827,7 @@ void SitAndGoGameController::stateBetting(Table *t)
                 t->cur_player = t->getNextActivePlayer(t->last_bet_player);
 
                 // initialize the player's timeout
-                t->timeout_start = time(NULL);
+                t->timeout_start = now();
 
 
                 // end of hand, do showdown/ ask for show
@@ -821,7 +855,7 @@ void SitAndGoGameController::stateBetting(Table *t)
         t->cur_player = t->getNextActivePlayer(t->dealer);
 
         // re-initialize the player's timeout
-        t->timeout_start = time(NULL);
+        t->timeout_start = now();
 
 
         // first action for next betting round is at this player
@@ -839,7 +873,7 @@ void SitAndGoGameController::stateBetting(Table *t)
 
         // find next player
         t->cur_player = t->getNextActivePlayer(t->cur_player);
-        t->timeout_start = time(NULL);
+        t->timeout_start = now();
 
         // reset current player's last action
         p = t->seats[t->cur_player].player;
@@ -860,10 +894,14 @@ void SitAndGoGameController::stateBetting(Table *t)
 
 void SitAndGoGameController::stateEndRound(Table *t)
 {
-    multimap<chips_type,unsigned int> broken_players;
+    TraceScope trace("SitAndGoGameController::stateEndRound", t->table_id);
+    // broken players by stake before the hand; equal stakes keep the seat order
+    struct { chips_type stake_before; unsigned int seat_num; } broken_players[10];
+    unsigned int broken_count = 0;
 
-    // assemble stake string
-    string sstake;
+    // assemble stake string; room for "<cid>:<stake>:<change> " of each seat
+    char sstake[10 * (3 * MessageWriter::IntLength + 3) + 1];
+    MessageWriter ws(sstake);
 
     // find broken players
     for (unsigned int i=0; i < 10; i++)
@@ -874,13 +912,7 @@ void SitAndGoGameController::stateEndRound(Table *t)
         Player *p = t->seats[i].player;
 
         // assemble stake string
-        char tmp[1024];
-        snprintf(tmp, sizeof(tmp), "%d:%d:%d",
-                p->client_id,
-                p->stake,
-                p->stake - p->stake_before);
-        sstake += tmp;
-        sstake += ' ';
+        ws << p->client_id << ':' << (int)p->stake << ':' << (int)(p->stake - p->stake_before) << ' ';
 
         // player has no stake left
 		unsigned int need_stake = 0;
@@ -890,32 +922,36 @@ void SitAndGoGameController::stateEndRound(Table *t)
 		}
 
 		if (p->stake == 0 || p->stake < need_stake)
-            broken_players.insert(pair<chips_type,int>(p->stake_before, i));
+        {
+            unsigned int k = broken_count++;
+            for (; k > 0 && broken_players[k - 1].stake_before > p->stake_before; k--)
+                broken_players[k] = broken_players[k - 1];
+
+            broken_players[k].stake_before = p->stake_before;
+            broken_players[k].seat_num = i;
+        }
         else
         {
             // there is a net win
             if (p->stake > p->stake_before)
             {
-                snprintf(msg, sizeof(msg), "%d %d %d",
-                        p->client_id,
-                        -1,	/* reserved */
-                        p->stake - p->stake_before);
-                snap(t->table_id, SnapWinAmount, msg);
+                MessageWriter w(msg);
+                w << p->client_id << ' ' << -1 /* reserved */ << ' ' << (int)(p->stake - p->stake_before);
+                snap(t->table_id, SnapWinAmount, w.c_str());
             }
         }
     }
 
     // send stake change
-    snap(t->table_id, SnapStakeChange, sstake.c_str());
+    snap(t->table_id, SnapStakeChange, ws.c_str());
 
     sendTableSnapshot(t);
 
     // remove players in right order: sorted by stake_before
     // FIXME: how to handle players which had the same stake?
-    for (multimap<chips_type,unsigned int>::iterator n = broken_players.begin(); n != broken_players.end(); n++)
+    for (unsigned int n=0; n < broken_count; n++)
     {
-        //const chips_type stake_before = n->first;
-        const unsigned int seat_num = n->second;
+        const unsigned int seat_num = broken_players[n].seat_num;
 
         Player *p = t->seats[seat_num].player;
 
@@ -923,15 +959,13 @@ void SitAndGoGameController::stateEndRound(Table *t)
         finish_list.push_back(p);
 
         // send out player-broke snapshot
-        snprintf(msg, sizeof(msg), "%d %d %d",
-                SnapGameStateBroke,
-                p->client_id,
-                getPlayerCount() - (int)finish_list.size() + 1);
+        MessageWriter w(msg);
+        w << (int)SnapGameStateBroke << ' ' << p->client_id << ' ' << (int)(getPlayerCount() - finish_list.size() + 1);
 
-        snap(t->table_id, SnapGameState, msg);
+        snap(t->table_id, SnapGameState, w.c_str());
 
         // mark seat as unused
-        t->seats[seat_num].occupied = false;
+        t->setOccupied(seat_num, false);
     }
 
     // determine next dealer
@@ -972,7 +1006,7 @@ int SitAndGoGameController::handleTable(Table *t)
     }
 	else if (t->state == Table::Resume)
     {
-        log_msg("game","handle table resume");
+        log_debug("game","handle table resume");
         stateResume(t);
     }
     return 0;
@@ -997,24 +1031,26 @@ void SitAndGoGameController::start()
     placePlayers();
 
     blind.amount = blind.start;
-    blind.last_blinds_time = time(NULL);
+    blind.last_blinds_time = now();
 
     log_msg("game", "game %d has been started", game_id);
     status = Started;
-    started_time = time(NULL);
+    started_time = now();
 }
 
 void SitAndGoGameController::expire() 
 {
     status = Ended;
-    ended_time = time(NULL);
+    ended_time = now();
 
-    snprintf(msg, sizeof(msg), "%d", SnapGameStateEnd);
-    snap(-1, SnapGameState, msg);
+    MessageWriter w(msg);
+    w << (int)SnapGameStateEnd;
+    snap(-1, SnapGameState, w.c_str());
 }
 
 int SitAndGoGameController::tick()
 {
+    TraceScope trace("SitAndGoGameController::tick", game_id);
     if (status == Created)
     {
         if ( getPlayerCount() >= 1)   {// for Sit&Go , start game if player count >= 1
@@ -1022,7 +1058,7 @@ int SitAndGoGameController::tick()
             start();
         }
         // handle expiration
-        else if (difftime(time(NULL), created_time) >= expire_in) { 
+        else if (difftime(now(), created_time) >= expire_in) { 
             expire();
             return 0;
         }
@@ -1036,7 +1072,7 @@ int SitAndGoGameController::tick()
     }
     else if (status == Paused)
     {
-        log_msg("game", "game %d is paused ", getGameId());
+        log_debug("game", "game %d is paused ", getGameId());
         return 0;
     }
 
@@ -1045,17 +1081,23 @@ int SitAndGoGameController::tick()
     {
         Table *t = e->second;
 
+        const int state = t->delay ? -1 : (int) t->state;
+        const unsigned long long tick_start = sys_clock_usec();
+        const int rc = handleTable(t);
+        metrics_table_tick(state, sys_clock_usec() - tick_start);
+
         // table closed?
-        if (handleTable(t) < 0)
+        if (rc < 0)
         {
             // is this the last table?  /* FIXME: very very dirty */
             if (tables.size() == 1)
             {
                 status = Ended;
-                ended_time = time(NULL);
+                ended_time = now();
 
-                snprintf(msg, sizeof(msg), "%d", SnapGameStateEnd);
-                snap(-1, SnapGameState, msg);
+                MessageWriter w(msg);
+                w << (int)SnapGameStateEnd;
+                snap(-1, SnapGameState, w.c_str());
 
                 // push back last remaining player to finish_list
                 for (unsigned int i=0; i < 10; ++i)
@@ -1066,7 +1108,7 @@ int SitAndGoGameController::tick()
                     }
             }
 
-            delete t;
+            table_pool.destroy(t);
             tables.erase(e++);
         }
         else
@@ -1074,7 +1116,7 @@ int SitAndGoGameController::tick()
     }
 
     // handle expiration
-    if (difftime(time(NULL), started_time) >= expire_in) { 
+    if (difftime(now(), started_time) >= expire_in) { 
         expire();
     }
 
@@ -1155,8 +1197,9 @@ bool SitAndGoGameController::nextRoundStraddle(int cid)
 	{
 		int pos = t->getNextActivePlayer(t->last_straddle);
 		
-	    snprintf(msg, sizeof(msg), "%d", t->straddle_rate); 
-		snap(t->seats[pos].player->client_id, t->table_id, SnapWantToStraddleNextRound, msg);
+	    MessageWriter w(msg);
+	    w << t->straddle_rate;
+		snap(t->seats[pos].player->client_id, t->table_id, SnapWantToStraddleNextRound, w.c_str());
 	}
 	
 	return true;
@@ -1194,41 +1237,46 @@ void SitAndGoGameController::handleWantToStraddleNextRound(Table *t)
 		cid = t->seats[pos].player->client_id;
 	}
     log_msg("straddle", "cid=%d", cid);
-	snprintf(msg, sizeof(msg), "%d", t->straddle_rate); 
+	MessageWriter w(msg);
+	w << t->straddle_rate;
 
-	snap(cid, t->table_id, SnapWantToStraddleNextRound, msg);
+	snap(cid, t->table_id, SnapWantToStraddleNextRound, w.c_str());
 }
 
 bool SitAndGoGameController::handleBuyInsurance(Table *t, unsigned int round)
 {
+	TraceScope trace("SitAndGoGameController::handleBuyInsurance", t->table_id);
 	bool ret = false;
 	for (size_t i = 0; i < t->pots.size(); ++i)
 	{
-		if (t->pots[i].vseats.size() > 1)
+		if (Table::countSeats(t->pots[i].involved_mask) > 1)
 		{
-			vector<vector<HandStrength> > winlist;
-			vector<HandStrength> wl;
-			for (size_t j = 0; j < t->pots[i].vseats.size(); ++j)
+			vector<vector<HandStrength> > &winlist = winlist_buffer;
+			vector<HandStrength> &wl = strength_buffer;
+			wl.clear();
+			for (unsigned int seat_id = 0; seat_id < 10; ++seat_id)
 			{
-				unsigned int seat_id = t->pots[i].vseats[j];
+				if (!t->isSeatInvolvedInPot(&(t->pots[i]), seat_id))
+					continue;
 				Player *p = t->seats[seat_id].player;
 				HandStrength strength;
 				GameLogic::getStrength(&(p->holecards), &(t->communitycards), &strength);
 				strength.setId(seat_id);
 				wl.push_back(strength);
 			}
-			GameLogic::getWinList(wl, winlist);
+			GameLogic::getWinList(wl, winlist, &winlist_spare);
 			if (winlist.size() > 1)
 			{
 				// ÓÐÊ¤¸º
-				vector<HandStrength> winers = winlist[0];
+				vector<HandStrength> &winers = winlist[0];
 				
 				for (size_t j = 0; j < winers.size(); ++j)
 				{
 					int seat_id = winers[j].getId();
 					Player *p = t->seats[seat_id].player;
 
-					vector<HandStrength> vloser;
+					vector<HandStrength> &vloser = loser_buffer;
+					vloser.clear();
 					for (size_t k = 0; k < wl.size(); ++ k)
 					{
 						if (wl[k].getId() != seat_id)
@@ -1237,19 +1285,11 @@ bool SitAndGoGameController::handleBuyInsurance(Table *t, unsigned int round)
 						}
 					}
 					
-					GameLogic::getInsuranceOuts(&winers[j], &vloser, t->deck, &(p->insuraceInfo[round].outs), &(p->insuraceInfo[round].every_single_outs));
+					GameLogic::getInsuranceOuts(&winers[j], &vloser, t->deck, &(p->insuraceInfo[round].outs), p->insuraceInfo[round].every_single_outs);
                     
                     GameLogic::getInsuranceOutsDivided(&winers[j], wl, &winlist, t->deck, &(p->insuraceInfo[round].outs_divided));
 
-                    for (size_t j = 0; j < p->insuraceInfo[round].outs_divided.size(); ++ j)
-                    {
-                        if (!GameLogic::cardInList(p->insuraceInfo[round].outs_divided[j], &(p->insuraceInfo[round].outs)))
-                        {
-                            p->insuraceInfo[round].outs.push_back(p->insuraceInfo[round].outs_divided[j]);
-                        }
-                    }
-
-                    sort(p->insuraceInfo[round].outs.begin(), p->insuraceInfo[round].outs.end(), greater<Card>());
+                    p->insuraceInfo[round].outs |= p->insuraceInfo[round].outs_divided;
                     /*
                     if (p->insuraceInfo[round].outs.size() > 0)
 					{
@@ -1266,7 +1306,7 @@ bool SitAndGoGameController::handleBuyInsurance(Table *t, unsigned int round)
                                 p->insuraceInfo[round].max_payment += ceil(t->pots[i].amount / winers.size()) - p->insuraceInfo[0].buy_amount;
                             }
 
-                            log_msg("Insurance", "round=%d, pot[%d]=%d, winners=%d, max_payment=%d",round, i, t->pots[i].amount, winers.size(), p->insuraceInfo[round].max_payment);
+                            log_debug("Insurance", "round=%d, pot[%d]=%d, winners=%d, max_payment=%d",round, i, t->pots[i].amount, winers.size(), p->insuraceInfo[round].max_payment);
 							ret = true;
 						}
 					}
@@ -1278,38 +1318,40 @@ bool SitAndGoGameController::handleBuyInsurance(Table *t, unsigned int round)
 
 	for (size_t i = 0; i < t->pots.size(); ++i)
 	{
-		if (t->pots[i].vseats.size() > 1)
+		if (Table::countSeats(t->pots[i].involved_mask) > 1)
 		{
-			vector<vector<HandStrength> > winlist;
-			vector<HandStrength> wl;
-			for (size_t j = 0; j < t->pots[i].vseats.size(); ++j)
+			vector<vector<HandStrength> > &winlist = winlist_buffer;
+			vector<HandStrength> &wl = strength_buffer;
+			wl.clear();
+			for (unsigned int seat_id = 0; seat_id < 10; ++seat_id)
 			{
-				unsigned int seat_id = t->pots[i].vseats[j];
+				if (!t->isSeatInvolvedInPot(&(t->pots[i]), seat_id))
+					continue;
 				Player *p = t->seats[seat_id].player;
 				HandStrength strength;
 				GameLogic::getStrength(&(p->holecards), &(t->communitycards), &strength);
 				strength.setId(seat_id);
 				wl.push_back(strength);
 			}
-			GameLogic::getWinList(wl, winlist);
+			GameLogic::getWinList(wl, winlist, &winlist_spare);
 			if (winlist.size() > 1)
 			{
-				vector<HandStrength> winers = winlist[0];
+				vector<HandStrength> &winers = winlist[0];
 				
 				for (size_t j = 0; j < winers.size(); ++j)
 				{
 					int seat_id = winers[j].getId();
 					Player *p = t->seats[seat_id].player;
 
-                    if (p->insuraceInfo[round].outs.size() > 0)
+                    if (Card::countMask(p->insuraceInfo[round].outs) > 0)
 					{
-						if ((round == 1) || (p->insuraceInfo[round].outs.size() <= 20 && round == 0))
+						if ((round == 1) || (Card::countMask(p->insuraceInfo[round].outs) <= 20 && round == 0))
                         {
                             if (round == 0)
                             {
                                 // 买入金额最大为底池1/3
                                 int buy_amount = t->pots[i].amount / winers.size() / 3;
-                                int payment = buy_amount * insurance_rate[p->insuraceInfo[round].outs.size()];
+                                int payment = buy_amount * insurance_rate[Card::countMask(p->insuraceInfo[round].outs)];
                                 if (payment > (int)(t->pots[i].amount / winers.size()) )
                                 {
                                     // 当赔付额超过底池时，赔付额度为底池大小
@@ -1325,15 +1367,16 @@ bool SitAndGoGameController::handleBuyInsurance(Table *t, unsigned int round)
                                 p->insuraceInfo[round].max_payment += t->pots[i].amount / winers.size();// - p->insuraceInfo[0].buy_amount;
                             }
                             // 记录pot
-                            p->insuraceInfo[round].buy_pots.push_back(t->pots[i].amount);
+                            p->insuraceInfo[round].buy_pots[p->insuraceInfo[round].pots_count] = t->pots[i].amount;
                             // 记录投入金额
-                            p->insuraceInfo[round].pots_investment.push_back(t->pots[i].amount / t->pots[i].vseats.size());
-                            log_msg("Insurance", "round=%d, pot[%d]=%d, winners=%d, max_payment=%d",round, i, t->pots[i].amount, winers.size(), p->insuraceInfo[round].max_payment);
+                            p->insuraceInfo[round].pots_investment[p->insuraceInfo[round].pots_count] = t->pots[i].amount / Table::countSeats(t->pots[i].involved_mask);
+                            p->insuraceInfo[round].pots_count++;
+                            log_debug("Insurance", "round=%d, pot[%d]=%d, winners=%d, max_payment=%d",round, i, t->pots[i].amount, winers.size(), p->insuraceInfo[round].max_payment);
 							ret = true;
 						}
                         else
                         {
-                            log_msg("Insurance", "round 0 outs size > 20");
+                            log_debug("Insurance", "round 0 outs size > 20");
                         }
 					}
 				}
@@ -1351,65 +1394,14 @@ bool SitAndGoGameController::handleBuyInsurance(Table *t, unsigned int round)
 			seat_id = t->getNextActivePlayer(seat_id);
 			Player *p = t->seats[seat_id].player;
 			// ×ªÅÆ:20ÕÅÒÔÉÏ²»ÔÊÐíÂò±£ÏÕ
-			if (p->insuraceInfo[round].outs.size() > 20 && round == 0)
+			if (Card::countMask(p->insuraceInfo[round].outs) > 20 && round == 0)
 			{
-				p->insuraceInfo[round].outs.clear();
-				p->insuraceInfo[round].every_single_outs.clear();
+				p->insuraceInfo[round].outs = 0;
+				clear_opponent_outs(p->insuraceInfo[round]);
 			}
 
-			if (p->insuraceInfo[round].outs.size() > 0)
+			if (p->insuraceInfo[round].outs)
 			{
- 				std::string smsg_outs;
-
-				char scard[5];
-				for (size_t j = 0; j < p->insuraceInfo[round].outs.size(); ++j)
-				{
-					if (j == 0)
-						snprintf(scard, sizeof(scard), "%c%c", p->insuraceInfo[round].outs[j].getFaceSymbol(), p->insuraceInfo[round].outs[j].getSuitSymbol());
-					else
-						snprintf(scard, sizeof(scard), ":%c%c", p->insuraceInfo[round].outs[j].getFaceSymbol(), p->insuraceInfo[round].outs[j].getSuitSymbol());
-					smsg_outs += scard;
-				}
-
-                std::string smsg_divide_outs;
-
-                for (size_t j = 0; j < p->insuraceInfo[round].outs_divided.size(); ++j)
-                {
-                    if (j == 0)
-                        snprintf(scard, sizeof(scard), "%c%c", p->insuraceInfo[round].outs_divided[j].getFaceSymbol(), p->insuraceInfo[round].outs_divided[j].getSuitSymbol());
-                    else
-                        snprintf(scard, sizeof(scard), ":%c%c", p->insuraceInfo[round].outs_divided[j].getFaceSymbol(), p->insuraceInfo[round].outs_divided[j].getSuitSymbol());
-                    smsg_divide_outs += scard;
-                }
-
-                if (p->insuraceInfo[round].outs_divided.size() == 0)
-                {
-                    smsg_divide_outs = "0";
-                }
-
-				std::string smsg_others;
-				map<int, vector<Card> >::iterator it = p->insuraceInfo[round].every_single_outs.begin();
-
-				char sother[20];
-				while (it != p->insuraceInfo[round].every_single_outs.end())
-				{
-					if (it->second.size() > 0)
-					{
-						snprintf(sother, sizeof(sother), "%d:%d:%c%c:%c%c",
-							it->first,
-							(int)it->second.size(),
-							t->seats[it->first].player->holecards.getC1()->getFaceSymbol(),
-							t->seats[it->first].player->holecards.getC1()->getSuitSymbol(),
-							t->seats[it->first].player->holecards.getC2()->getFaceSymbol(),
-							t->seats[it->first].player->holecards.getC2()->getSuitSymbol());
-					}
-					smsg_others += sother;
-					++it;
-					if (it != p->insuraceInfo[round].every_single_outs.end())
-					{
-						smsg_others += '-';
-					}
-				}
                 int min_buy = 0;
                 if (round == 1)
                 {
@@ -1419,41 +1411,52 @@ bool SitAndGoGameController::handleBuyInsurance(Table *t, unsigned int round)
                     }
                 }
 
-                std::string smsg_pots;
-              
-                char spots[20];
-                for (size_t j = 0; j < p->insuraceInfo[round].buy_pots.size(); ++j)
+				// <max-payment> <min-buy> <outs> <divided-outs> <others> <pots> <investment>
+				MessageWriter w(msg);
+				w << (int)p->insuraceInfo[round].max_payment << ' ' << min_buy << ' ';
+
+				format_cards(p->insuraceInfo[round].outs, w);
+				w << ' ';
+
+                if (p->insuraceInfo[round].outs_divided)
+                    format_cards(p->insuraceInfo[round].outs_divided, w);
+                else
+                    w << '0';
+                w << ' ';
+
+				bool first = true;
+				for (unsigned int seat = 0; seat < 10; ++seat)
+				{
+					const cardmask_type seat_outs = p->insuraceInfo[round].every_single_outs[seat];
+					if (!seat_outs)
+						continue;
+
+					if (!first)
+						w << '-';
+					w << seat << ':' << Card::countMask(seat_outs) << ':';
+					w.write(t->seats[seat].player->holecards.getC1()->getName(), 2) << ':';
+					w.write(t->seats[seat].player->holecards.getC2()->getName(), 2);
+					first = false;
+				}
+				w << ' ';
+
+                for (size_t j = 0; j < p->insuraceInfo[round].pots_count; ++j)
                 {
-                    if (j == 0)
-                        snprintf(spots, sizeof(spots), "%d", p->insuraceInfo[round].buy_pots[j]);
-                    else
-                        snprintf(spots, sizeof(spots), ":%d", p->insuraceInfo[round].buy_pots[j]);
-                    smsg_pots += spots;
+                    if (j)
+                        w << ':';
+                    w << (int)p->insuraceInfo[round].buy_pots[j];
                 }
-                
-                std::string smsg_investment;
-		
-                char sinvest[20];
-                for (size_t j = 0; j < p->insuraceInfo[round].pots_investment.size(); ++j)
+                w << ' ';
+
+                for (size_t j = 0; j < p->insuraceInfo[round].pots_count; ++j)
                 {
-                    if (j == 0)
-                        snprintf(sinvest, sizeof(sinvest), "%d", p->insuraceInfo[round].pots_investment[j]);
-                    else
-                        snprintf(sinvest, sizeof(sinvest), ":%d", p->insuraceInfo[round].pots_investment[j]);
-                    smsg_investment += sinvest;
+                    if (j)
+                        w << ':';
+                    w << (int)p->insuraceInfo[round].pots_investment[j];
                 }
 
-                snprintf(msg, sizeof(msg), "%d %d %s %s %s %s %s",
-					p->insuraceInfo[round].max_payment, 
-                    min_buy,
-                    smsg_outs.c_str(),
-                    smsg_divide_outs.c_str(),
-					smsg_others.c_str(),
-                    smsg_pots.c_str(),
-                    smsg_investment.c_str());
-
- 				snap(p->client_id, t->table_id, SnapBuyInsurance, msg);
-			    log_msg("Insurance", "cid=%d, tid=%d, %s",p->client_id, t->table_id, msg);
+ 				snap(p->client_id, t->table_id, SnapBuyInsurance, w.c_str());
+			    log_debug("Insurance", "cid=%d, tid=%d, %s",p->client_id, t->table_id, w.c_str());
                 ret = true;
  			}
 		}
@@ -1520,7 +1523,7 @@ bool SitAndGoGameController::clientBuyInsurance(int cid, chips_type buy_amount,
 		return false;
 	}
 
-	if (p->insuraceInfo[round].bought || p->insuraceInfo[round].outs.size() == 0)
+	if (p->insuraceInfo[round].bought || !p->insuraceInfo[round].outs)
 	{
 		log_msg("clientBuyInsurance", "insurance has bought");
 		return false;
@@ -1529,33 +1532,24 @@ bool SitAndGoGameController::clientBuyInsurance(int cid, chips_type buy_amount,
 	if (cards.size() < 1 || buy_amount == 0)
 	{
 		// ²»¹ºÂò±£ÏÕ
-		p->insuraceInfo[round].every_single_outs.clear();
+		clear_opponent_outs(p->insuraceInfo[round]);
 		// p->insuraceInfo[round].outs.clear();
 	}
 	else
 	{
 		// ÅÆÊÇ·ñÕýÈ·
+		cardmask_type buy_cards = 0;
 		for (size_t i = 0; i < cards.size(); ++i)
+			buy_cards |= cards[i].getMask();
+
+		if (buy_cards & ~p->insuraceInfo[round].outs)
 		{
-			bool find = false;
-			for (size_t j = 0; j < p->insuraceInfo[round].outs.size(); ++ j)
-			{
-				if (cards[i].getFace() == p->insuraceInfo[round].outs[j].getFace() &&
-					cards[i].getSuit() == p->insuraceInfo[round].outs[j].getSuit())
-				{
-					find = true;
-					break;
-				}
-			}
-			if (!find)
-			{
-				log_msg("clientBuyInsurance", "buy card not in outs, round = %d , outs size = %d", round, p->insuraceInfo[round].outs.size());
-				return false;
-			}
+			log_msg("clientBuyInsurance", "buy card not in outs, round = %d , outs size = %d", round, Card::countMask(p->insuraceInfo[round].outs));
+			return false;
 		}
 
 		// ¼ÆËã¹ºÂòµÄÊýÁ¿ÊÇ·ñºÏ·¨
-		size_t index = cards.size();
+		size_t index = Card::countMask(buy_cards);
 		index = index > 20 ? 20 : index;
 		float rate = insurance_rate[index];
 		chips_type max_buy = p->insuraceInfo[round].max_payment;
@@ -1572,7 +1566,7 @@ bool SitAndGoGameController::clientBuyInsurance(int cid, chips_type buy_amount,
 	
 		p->insuraceInfo[round].bought = true;
 		p->insuraceInfo[round].buy_amount = buy_amount;
-		p->insuraceInfo[round].buy_cards.insert(p->insuraceInfo[round].buy_cards.begin(), cards.begin(), cards.end());
+		p->insuraceInfo[round].buy_cards |= buy_cards;
 	    log_msg("clientBuyInsurance", "round = %d buy_amount = %d", round, buy_amount);
     }
 
@@ -1583,7 +1577,7 @@ bool SitAndGoGameController::clientBuyInsurance(int cid, chips_type buy_amount,
 	{
 		pos = t->getNextActivePlayer(pos);
 		Player *player = t->seats[pos].player;
-		if (player->insuraceInfo[round].every_single_outs.size() > 0 && player->insuraceInfo[round].bought == false)
+		if (has_opponent_outs(player->insuraceInfo[round]) && player->insuraceInfo[round].bought == false)
 		{
 			all_bought = false;
 			break;
@@ -1600,6 +1594,7 @@ bool SitAndGoGameController::clientBuyInsurance(int cid, chips_type buy_amount,
 
 void SitAndGoGameController::stateShowdown(Table *t)
 {
+	TraceScope trace("SitAndGoGameController::stateShowdown", t->table_id);
 	GameController::stateShowdown(t);
     if (!enable_insurance)
         return;
@@ -1619,11 +1614,12 @@ void SitAndGoGameController::stateShowdown(Table *t)
 		// ¼ÆËã±£ÏÕÖ§³ö
 		if (insurance_res > 0)
 		{
-            log_msg("insurance","insurance_res:%d", insurance_res);
+            log_debug("insurance","insurance_res:%d", insurance_res);
 			p->stake -= insurance_res;
 			// ·¢ÏûÏ¢
-		    snprintf(msg, sizeof(msg), "-%d", insurance_res);
-            snap(p->client_id, t->table_id, SnapInsuranceBenefits, msg);
+		    MessageWriter w(msg);
+		    w << '-' << (int)insurance_res;
+            snap(p->client_id, t->table_id, SnapInsuranceBenefits, w.c_str());
         }
 		
 	}
@@ -1631,8 +1627,8 @@ void SitAndGoGameController::stateShowdown(Table *t)
 
 void SitAndGoGameController::handleInsuranceBenefits(Table *t, unsigned int round)
 {
-    log_msg("insurance", "Benefits : %d", round);
-	vector<Card> cards;
+    log_debug("insurance", "Benefits : %d", round);
+	CardArray<5> cards;
 	t->communitycards.copyCards(&cards);
 	size_t card_index = 3;
 	if (round == 1)
@@ -1654,18 +1650,18 @@ void SitAndGoGameController::handleInsuranceBenefits(Table *t, unsigned int roun
 		{
 			do 
 			{
-				if (!GameLogic::cardInList(card, &(p->insuraceInfo[round].outs)))
+				if (!(card.getMask() & p->insuraceInfo[round].outs))
 				{
 					// ·¢³öµÄÅÆ²»ÔÚoutsÖÐ£¬¼ÌÐøÁìÏÈ£¬½áËãÊ±£¬ÐèÒª¿Û¹ºÂò±£ÏÕµÄ·ÑÓÃ
 					// ¼ÆËã±£ÏÕ·Ñ
-					if (p->insuraceInfo[round].outs.size() == p->insuraceInfo[round].buy_cards.size())
+					if (Card::countMask(p->insuraceInfo[round].outs) == Card::countMask(p->insuraceInfo[round].buy_cards))
 					{
 						// È«Âò
 						p->insuraceInfo[round].res_amount = p->insuraceInfo[round].buy_amount;
 					}
 					else
 					{
-						size_t no_buy_card_size = p->insuraceInfo[round].outs.size() - p->insuraceInfo[round].buy_cards.size();
+						size_t no_buy_card_size = Card::countMask(p->insuraceInfo[round].outs) - Card::countMask(p->insuraceInfo[round].buy_cards);
 						if(no_buy_card_size > 20)
                             no_buy_card_size = 20;
 						chips_type take_back_amount = (chips_type)ceil(p->insuraceInfo[round].buy_amount / insurance_rate[no_buy_card_size]);
@@ -1676,9 +1672,9 @@ void SitAndGoGameController::handleInsuranceBenefits(Table *t, unsigned int roun
 				}
 
 				// ÔÚ¹ºÂòµÄoutsÖÐ
-				if (GameLogic::cardInList(card, &(p->insuraceInfo[round].buy_cards)))
+				if (card.getMask() & p->insuraceInfo[round].buy_cards)
 				{
-					size_t rate_index = p->insuraceInfo[round].buy_cards.size();
+					size_t rate_index = Card::countMask(p->insuraceInfo[round].buy_cards);
 					
                     if (rate_index > 20)
                         rate_index = 20;
@@ -1687,18 +1683,19 @@ void SitAndGoGameController::handleInsuranceBenefits(Table *t, unsigned int roun
 					if (payment > p->insuraceInfo[round].max_payment)
                         payment = p->insuraceInfo[round].max_payment;
 
-					if (p->insuraceInfo[round].outs.size() == p->insuraceInfo[round].buy_cards.size())
+					if (Card::countMask(p->insuraceInfo[round].outs) == Card::countMask(p->insuraceInfo[round].buy_cards))
 					{
 						// È«Âò,Åâ¸¶
 						p->stake += payment;
 						// ·¢ËÍÏûÏ¢£¬ÅâÇ®
-				        snprintf(msg, sizeof(msg), "%d", payment);
-                        snap(p->client_id, t->table_id, SnapInsuranceBenefits, msg);
-                        log_msg("Insurance", "get benefits %d", payment);
+				        MessageWriter w(msg);
+				        w << (int)payment;
+                        snap(p->client_id, t->table_id, SnapInsuranceBenefits, w.c_str());
+                        log_debug("Insurance", "get benefits %d", payment);
                     }
 					else
 					{
-						size_t no_buy_card_size = p->insuraceInfo[round].outs.size() - p->insuraceInfo[round].buy_cards.size();
+						size_t no_buy_card_size = Card::countMask(p->insuraceInfo[round].outs) - Card::countMask(p->insuraceInfo[round].buy_cards);
 						
 						if (no_buy_card_size > 20)
                             no_buy_card_size = 20;
@@ -1707,10 +1704,11 @@ void SitAndGoGameController::handleInsuranceBenefits(Table *t, unsigned int roun
 						payment -= take_back_amount;
 						p->stake += payment;
 						// ·¢ËÍÏûÏ¢£¬ÅâÇ®
-					    snprintf(msg, sizeof(msg), "%d", payment);
-                        snap(p->client_id, t->table_id, SnapInsuranceBenefits, msg);
+					    MessageWriter w(msg);
+					    w << (int)payment;
+                        snap(p->client_id, t->table_id, SnapInsuranceBenefits, w.c_str());
 
-                        log_msg("Insurance", "get benefits %d", payment);
+                        log_debug("Insurance", "get benefits %d", payment);
                     }
 					break;
 				}
@@ -1725,10 +1723,11 @@ void SitAndGoGameController::handleInsuranceBenefits(Table *t, unsigned int roun
 
 void SitAndGoGameController::stateResume(Table * t)
 {
+	TraceScope trace("SitAndGoGameController::stateResume", t->table_id);
    
 	if (t->suspend_reason == Table::BuyInsurace)
 	{
-		//log_msg("insurance", "state resume %d", t->betround);
+		//log_debug("insurance", "state resume %d", t->betround);
         // µÚËÄÂÖ¹ºÂò±£ÏÕµÄµÚÎåÂÖ±ØÐë¹ºÂò
 		if (t->betround == Table::Turn)
 		{
@@ -1738,31 +1737,31 @@ void SitAndGoGameController::stateResume(Table * t)
 				pos = t->getNextActivePlayer(pos);
                 Player *p = t->seats[pos].player;
 
-                log_msg("insurance", "p0 bought = %d p1 bought = %d, p1 outs %d", (int)(p->insuraceInfo[0].bought), (int)(p->insuraceInfo[1].bought), p->insuraceInfo[1].outs.size());
+                log_debug("insurance", "p0 bought = %d p1 bought = %d, p1 outs %d", (int)(p->insuraceInfo[0].bought), (int)(p->insuraceInfo[1].bought), Card::countMask(p->insuraceInfo[1].outs));
 				if (p->insuraceInfo[0].bought && !p->insuraceInfo[1].bought)
 				{
-					if (p->insuraceInfo[1].outs.size() > 0)
+					if (Card::countMask(p->insuraceInfo[1].outs) > 0)
 					{
 						p->insuraceInfo[1].bought = true;
 						p->insuraceInfo[1].buy_cards = p->insuraceInfo[1].outs;
-						size_t rate_index = p->insuraceInfo[1].outs.size();
+						size_t rate_index = Card::countMask(p->insuraceInfo[1].outs);
 						if (rate_index > 20)
                             rate_index = 20;
 						p->insuraceInfo[1].buy_amount = ceil(p->insuraceInfo[0].buy_amount / insurance_rate[rate_index]);
-				        log_msg("insurance", "take back bought %d", p->insuraceInfo[1].buy_amount);
+				        log_debug("insurance", "take back bought %d", p->insuraceInfo[1].buy_amount);
                     }
 				}
                 if (p->insuraceInfo[0].bought && p->insuraceInfo[1].bought)
                 {
                     //计算第五轮收益，是否比第四轮购买的保险数量要小
-				    size_t rate_index = p->insuraceInfo[1].buy_cards.size();
+				    size_t rate_index = Card::countMask(p->insuraceInfo[1].buy_cards);
 					if (rate_index > 20)
                         rate_index = 20;
                     chips_type benefits = p->insuraceInfo[1].buy_amount * insurance_rate[rate_index];
                     if (benefits < p->insuraceInfo[0].buy_amount)
                     {
                         p->insuraceInfo[1].buy_amount = ceil(benefits / insurance_rate[rate_index] );
-                        log_msg("insurance", "1 take back bought %d", p->insuraceInfo[1].buy_amount);
+                        log_debug("insurance", "1 take back bought %d", p->insuraceInfo[1].buy_amount);
                     }
                 }
 	    	}
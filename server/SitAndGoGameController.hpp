@@ -57,7 +57,7 @@ public:
     void reset();
 	
 	bool getPlayerList(std::vector<int> &client_list, bool including_wanna_leave = false) const;
-	bool getPlayerList(std::vector<std::string> &client_list) const;
+	bool writePlayerList(MessageWriter &w) const;
 
 	bool nextRoundStraddle(int cid);
 	
@@ -95,6 +95,7 @@ private:
     int expire_in;  // game is expiring in expire_in seconds
 	std::map<unsigned, float> insurance_rate;
     bool hasAskBuyInsurance[2];
+	std::vector<HandStrength> loser_buffer;	// losers of the insurance round, reused
 };
 
 #endif /* _SITANDGOGAMECONTROLLER_H */
@@ -24,6 +24,7 @@
 #include "Logger.h"
 #include "Debug.h"
 #include "Table.hpp"
+#include "GameController.hpp"
 
 #include <ctime>
 
@@ -32,114 +33,131 @@ using namespace std;
 Table::Table()
 {
 	table_id = -1;
+	
+	state = GameStart;
+	resume_state = GameStart;
+	betround = Preflop;
+	nomoreaction = false;
+	delay = 0;
+	delay_start = 0;
+	timeout_start = 0;
+	bet_amount = 0;
+	last_bet_amount = 0;
+	
+	// seat positions are read (snapshots, action dispatch) before the first round sets them
+	dealer = 0;
+	sb = 0;
+	bb = 0;
+	cur_player = -1;
+	last_bet_player = 0;
+	occupied_mask = 0;
+	in_round_mask = 0;
 	last_straddle = -1;
 	suspend_times = 0;
 	max_suspend_times = 0;
 	suspend_reason = NoReason;
     straddle_amount = 0;
     straddle_rate = 1;
+    
+    // at most one pot per seat
+    pots.reserve(10);
 }
 
-int Table::getNextPlayer(unsigned int pos)
+// number of seats in the mask
+static unsigned int seat_count(unsigned int mask)
 {
-	unsigned int start = pos;
-	unsigned int cur = pos;
-	bool found = false;
+#if defined(__GNUC__)
+	return __builtin_popcount(mask);
+#else
+	unsigned int count = 0;
+	for (; mask; count++)
+		mask &= mask - 1;
 	
-	do
+	return count;
+#endif
+}
+
+// lowest and highest seat of a non-empty mask
+static unsigned int seat_lowest(unsigned int mask)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(mask);
+#else
+	unsigned int seat = 0;
+	while (!(mask & 1))
 	{
-		cur += 1;
-		if (cur >= 10)
-			cur = 0;
-		
-		// no active player left
-		if (start == cur)
-			return -1;
-		
-		if (seats[cur].occupied)
-			found = true;
-		
-	} while (!found);
+		mask >>= 1;
+		seat++;
+	}
 	
-	return cur;
+	return seat;
+#endif
 }
 
-int Table::getPrePlayer(unsigned int pos)
+static unsigned int seat_highest(unsigned int mask)
 {
-	unsigned int start = pos;
-	unsigned int cur = pos;
-	bool found = false;
-
-	do
-	{
-		cur -= 1;
-		if (cur < 0)
-			cur = 9;
+#if defined(__GNUC__)
+	return 31 - __builtin_clz(mask);
+#else
+	unsigned int seat = 0;
+	while (mask >>= 1)
+		seat++;
+	
+	return seat;
+#endif
+}
 
-		// no active player left
-		if (start == cur)
-			return -1;
+// next seat of the mask after pos, wrapping around; pos itself doesn't count
+static int seat_next(unsigned int mask, unsigned int pos)
+{
+	if (pos < 10)
+		mask &= ~(1u << pos);
+	
+	if (!mask)
+		return -1;
+	
+	const unsigned int after = (pos < 10) ? mask & ~((2u << pos) - 1) : 0;
+	
+	return seat_lowest(after ? after : mask);
+}
 
-		if (seats[cur].occupied)
-			found = true;
+static int seat_previous(unsigned int mask, unsigned int pos)
+{
+	if (pos < 10)
+		mask &= ~(1u << pos);
+	
+	if (!mask)
+		return -1;
+	
+	const unsigned int before = (pos < 10) ? mask & ((1u << pos) - 1) : 0;
+	
+	return seat_highest(before ? before : mask);
+}
 
-	} while (!found);
+int Table::getNextPlayer(unsigned int pos)
+{
+	return seat_next(occupied_mask, pos);
+}
 
-	return cur;
+int Table::getPrePlayer(unsigned int pos)
+{
+	return seat_previous(occupied_mask, pos);
 }
 
 int Table::getNextActivePlayer(unsigned int pos)
 {
-	unsigned int start = pos;
-	unsigned int cur = pos;
-	bool found = false;
-	
-	do
-	{
-		cur = getNextPlayer(cur);
-		
-		// no active player left
-		if (start == cur)
-			return -1;
-		
-		if (seats[cur].in_round)
-			found = true;
-	} while (!found);
-	
-	return cur;
+	return seat_next(occupied_mask & in_round_mask, pos);
 }
 
 int Table::getPreActivePlayer(unsigned int pos)
 {
-    unsigned int start = pos;
-    unsigned int cur = pos;
-    bool found = false;
-    do
-    {
-        cur = getPrePlayer(cur);
-        
-        if(start == cur)
-            return -1;
-
-        if(seats[cur].in_round)
-            found = true;
-    }while(!found);
-
-    return cur;
+	return seat_previous(occupied_mask & in_round_mask, pos);
 }
 
 
 unsigned int Table::countPlayers()
 {
-	unsigned int count = 0;
-	
-	for (unsigned int i=0; i < 10; i++)
-	{
-		if (seats[i].occupied)
-			count++;
-	}
-	
-	return count;
+	return seat_count(occupied_mask);
 }
 
 int Table::getSeatNumber(int cid)
@@ -154,24 +172,42 @@ int Table::getSeatNumber(int cid)
 
 unsigned int Table::countActivePlayers()
 {
-	unsigned int count = 0;
+	return seat_count(occupied_mask & in_round_mask);
+}
+
+void Table::setOccupied(unsigned int seat_no, bool occupied)
+{
+	if (seat_no >= 10)
+		return;
 	
-	for (unsigned int i=0; i < 10; i++)
-	{
-		if (seats[i].occupied && seats[i].in_round)
-			count++;
-	}
+	seats[seat_no].occupied = occupied;
 	
-	return count;
+	if (occupied)
+		occupied_mask |= 1u << seat_no;
+	else
+		occupied_mask &= ~(1u << seat_no);
+}
+
+void Table::setInRound(unsigned int seat_no, bool in_round)
+{
+	if (seat_no >= 10)
+		return;
+	
+	seats[seat_no].in_round = in_round;
+	
+	if (in_round)
+		in_round_mask |= 1u << seat_no;
+	else
+		in_round_mask &= ~(1u << seat_no);
 }
 
 // remove a player from table seats when player calls game.leavegame
 unsigned int Table::removePlayer(int seat_no)
 {
     if (seat_no != -1) {
-        seats[seat_no].occupied = false;
+        setOccupied(seat_no, false);
         seats[seat_no].player = NULL;
-        seats[seat_no].in_round = false;
+        setInRound(seat_no, false);
         return seat_no;
     }
 
@@ -189,19 +225,15 @@ bool Table::isSeatAvailable(int seat_no)
 bool Table::isAllin()
 {
     unsigned int count = 0;
-    unsigned int active_players = 0;
+    unsigned int active = occupied_mask & in_round_mask;
+    const unsigned int active_players = seat_count(active);
 
-    for (unsigned int i=0; i < 10; i++)
+    for (; active; active &= active - 1)
     {
-        if (seats[i].occupied && seats[i].in_round)
-        {
-            active_players++;
-
-            Player *p = seats[i].player;
+        Player *p = seats[seat_lowest(active)].player;
 
-            if (p->getStake() == 0)
-                count++;
-        }
+        if (p->getStake() == 0)
+            count++;
     }
 
     return (count >= active_players - 1);
@@ -209,148 +241,110 @@ bool Table::isAllin()
 
 bool Table::isSeatInvolvedInPot(Pot *pot, unsigned int s)
 {
-    for (unsigned int i=0; i < pot->vseats.size(); i++)
-    {
-        if (pot->vseats[i] == s)
-            return true;
-    }
-
-    return false;
+    return (pot->involved_mask >> s) & 1;
 }
 
 unsigned int Table::getInvolvedInPotCount(Pot *pot, std::vector<HandStrength> &wl)
 {
-    unsigned int involved_count = 0;
+    unsigned int mask = 0;
 
-    for (unsigned int i=0; i < pot->vseats.size(); i++)
-    {
-        const unsigned int s = pot->vseats[i];
+    for (unsigned int i=0; i < wl.size(); i++)
+        mask |= 1u << wl[i].getId();
 
-        for (unsigned int j=0; j < wl.size(); j++)
-        {
-            if ((unsigned int) wl[j].getId() == s)
-                involved_count++;
-        }
-    }
+    return seat_count(pot->involved_mask & mask);
+}
 
-    return involved_count;
+unsigned int Table::countSeats(unsigned int mask)
+{
+    return seat_count(mask);
 }
 
 void Table::collectBets()
 {
-    do
+    // players still in the hand with a bet, smallest bet first
+    unsigned int order[10];
+    unsigned int count = 0;
+
+    for (unsigned int active = occupied_mask & in_round_mask; active; active &= active - 1)
     {
-        // find smallest bet
-        chips_type smallest_bet = 0;
-        bool need_sidepot = false;
+        const unsigned int s = seat_lowest(active);
+        if (seats[s].bet == 0)
+            continue;
 
-        for (unsigned int i=0; i < 10; i++)
-        {
-            // skip folded and already handled players
-            if (!seats[i].occupied || !seats[i].in_round || seats[i].bet == 0)
-                continue;
-
-            if (smallest_bet == 0)   // set an initial value
-                smallest_bet = seats[i].bet;
-            else if (seats[i].bet < smallest_bet)  // new smallest bet
-            {
-                smallest_bet = seats[i].bet;
-                need_sidepot = true;
-            }
-            else if (seats[i].bet > smallest_bet)  // bets are not equal,
-                need_sidepot = true;           // so there must be a smallest bet
-        }
+        unsigned int k = count++;
+        for (; k > 0 && seats[order[k - 1]].bet > seats[s].bet; k--)
+            order[k] = order[k - 1];
+        order[k] = s;
+    }
 
+    // there are no bets, do nothing
+    if (count == 0)
+        return;
 
-#if 0
-        log_msg("collectBets", "smallest_bet: sidepot=%s with %d", 
-                need_sidepot ? "true" : "false", smallest_bet);
-#endif
-        // there are no bets, do nothing
-        if (smallest_bet == 0)
-            return;
 
+    // last pot is current pot
+    Pot *cur_pot = &(pots[pots.size() - 1]);
+
+    // if current pot is final, create a new one
+    if (cur_pot->final)
+    {
+        Pot pot;
+        pot.amount = 0;
+        pot.involved_mask = 0;
+        pot.final = false;
+        pots.push_back(pot);
+
+        cur_pot = &(pots[pots.size() - 1]);
+    }
+
+    // bets of folded players go to the current pot
+    for (unsigned int folded = occupied_mask & ~in_round_mask; folded; folded &= folded - 1)
+    {
+        Seat *seat = &(seats[seat_lowest(folded)]);
+
+        cur_pot->amount += seat->bet;
+        seat->bet = 0;
+    }
 
-        // last pot is current pot
-        Pot *cur_pot = &(pots[pots.size() - 1]);
+    // each distinct bet level closes a layer: every player who bet at least
+    // this much pays the difference to the previous level into the pot
+    chips_type level = 0;
+    for (unsigned int k=0; k < count; )
+    {
+        const chips_type next_level = seats[order[k]].bet;
+        const chips_type layer = next_level - level;
 
-        // if current pot is final, create a new one
+        // a pot becomes final if at least one player is allin; the next layer is a side-pot
         if (cur_pot->final)
         {
             Pot pot;
             pot.amount = 0;
+            pot.involved_mask = 0;
             pot.final = false;
             pots.push_back(pot);
 
             cur_pot = &(pots[pots.size() - 1]);
         }
 
-
-        // collect the bet of each player
-        for (unsigned int i=0; i < 10; i++)
+        for (unsigned int j=k; j < count; j++)
         {
-            // skip invalid seats
-            if (!seats[i].occupied)
-                continue;
-
-            // skip already handled players
-            if (seats[i].bet == 0)
-                continue;
-
-            // collect bet of folded players and skip them
-            if (!seats[i].in_round)
-            {
-                cur_pot->amount += seats[i].bet;
-                seats[i].bet = 0;
-                continue;
-            }
-
-            // collect the bet into pot
-            if (!need_sidepot)
-            {
-                cur_pot->amount += seats[i].bet;
-                seats[i].bet = 0;
-            }
-            else
-            {
-                cur_pot->amount += smallest_bet;
-                seats[i].bet -= smallest_bet;
-            }
-
-            // mark pot as final if at least one player is allin
-            Player *p = seats[i].player;
-            if (p->getStake() == 0)
-                cur_pot->final = true;
-
-            // set player 'involved in pot'
-            if (!isSeatInvolvedInPot(cur_pot, i))
-                cur_pot->vseats.push_back(i);
-        }
+            const unsigned int s = order[j];
 
+            cur_pot->amount += layer;
+            cur_pot->involved_mask |= 1u << s;
 
-        if (!need_sidepot)  // all player bets are the same, end here
-            break;
-
-    } while (true);
+            if (seats[s].player->getStake() == 0)
+                cur_pot->final = true;
+        }
 
-#if 0
-    for (unsigned int i=0; i < pots.size(); i++)
-    {
-        log_msg("pot", "#%d: amount=%0.2f players=%d",
-                i+1, pots[i].amount, (int)pots[i].players.size());
+        while (k < count && seats[order[k]].bet == next_level)
+            k++;
 
-        for (unsigned int j=0; j < pots[i].players.size(); j++)
-        {
-            Player *p = pots[i].players[j];
-            log_msg("pot", "    player %d", p->getClientId());
-        }
+        level = next_level;
     }
 
-    for (unsigned int i=0; i < seats.size(); i++)
-    {
-        log_msg("seat-bets", "seat-%d: %.2f", i, seats[i].bet);
-    }
-#endif
+    for (unsigned int k=0; k < count; k++)
+        seats[order[k]].bet = 0;
 }
 
 void Table::resetLastPlayerActions()
@@ -369,5 +363,5 @@ void Table::scheduleState(State sched_state, unsigned int delay_sec)
 {
     state = sched_state;
     delay = delay_sec;
-    delay_start = time(NULL);
+    delay_start = GameController::now();
 }
@@ -36,7 +36,10 @@ class Table
 friend class GameController;
 friend class SitAndGoGameController;
 friend class SNGGameController;
+friend class TournamentGameController;
 friend class TestCaseGameController;
+friend class BenchTable;
+friend class TestCaseTable;
 
 public:
 	typedef enum {
@@ -66,6 +69,7 @@ public:
 		BuyInsurace
 	} SuspendReason;
 	
+	// occupied and in_round are only written through setOccupied() and setInRound()
 	typedef struct {
 		bool occupied;
 		unsigned int seat_no;
@@ -78,7 +82,7 @@ public:
 	
 	typedef struct {
 		chips_type amount;
-		std::vector<unsigned int> vseats;
+		unsigned int involved_mask;  // bit n: seat n is involved in the pot
 		bool final;
 	} Pot;
 	
@@ -94,6 +98,10 @@ public:
 	int getPreActivePlayer(unsigned int pos);
     unsigned int countPlayers();
 	unsigned int countActivePlayers();
+	
+	//! \brief Set the seat flag and the matching bit of the seat mask
+	void setOccupied(unsigned int seat_no, bool occupied);
+	void setInRound(unsigned int seat_no, bool in_round);
 	unsigned int removePlayer(int seat_no);
 	bool isAllin();
 	void resetLastPlayerActions();
@@ -104,6 +112,7 @@ public:
 	void collectBets();
 	bool isSeatInvolvedInPot(Pot *pot, unsigned int s);
 	unsigned int getInvolvedInPotCount(Pot *pot, std::vector<HandStrength> &wl);
+	static unsigned int countSeats(unsigned int mask);
 	
 	void scheduleState(State sched_state, unsigned int delay_sec);
 	void tick();
@@ -135,6 +144,9 @@ private:
 	BettingRound betround;
 	
 	Seat seats[10];
+	// bit n is set if seats[n] is occupied / in the current hand
+	unsigned int occupied_mask;
+	unsigned int in_round_mask;
 	int dealer, sb, bb, last_straddle;
 	int cur_player;
 	int last_bet_player;
@@ -0,0 +1,491 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <cstdio>
+#include <ctime>
+#include <algorithm>
+
+#include "Config.h"
+#include "Logger.h"
+#include "Trace.hpp"
+#include "SysAccess.h"
+#include "TournamentGameController.hpp"
+
+#include "game.hpp"
+
+
+using namespace std;
+
+// temporary buffer for chat/snap data
+static char msg[1024];
+
+
+TournamentGameController::TournamentGameController()
+{
+    reset();
+
+    setPlayerMax(SeatsPerTable * 2);
+    hand_for_hand_players = SeatsPerTable + 1;
+}
+
+void TournamentGameController::reset()
+{
+    SNGGameController::reset();
+
+    type = FreezeOut;
+
+    table_infos.clear();
+    table_loads.clear();
+
+    players_left = 0;
+    hfh_waiting_count = 0;
+    hfh_generation = 0;
+}
+
+void TournamentGameController::start()
+{
+    // at least 2 players needed
+    if (status == Started || players.size() < 2)
+        return;
+
+    vector<Player*> entrants;
+    entrants.reserve(players.size());
+
+    for (players_type::const_iterator e = players.begin(); e != players.end(); e++)
+        entrants.push_back(e->second);
+
+#ifndef SERVER_TESTING
+    random_shuffle(entrants.begin(), entrants.end());
+#endif
+
+    // deal the field round-robin so table sizes differ by one at most
+    const unsigned int table_count = (entrants.size() + SeatsPerTable - 1) / SeatsPerTable;
+    vector< vector<Player*> > seating(table_count);
+
+    for (unsigned int i=0; i < table_count; i++)
+        seating[i].reserve((entrants.size() + table_count - 1) / table_count);
+
+    for (unsigned int i=0; i < entrants.size(); i++)
+        seating[i % table_count].push_back(entrants[i]);
+
+    table_pool.setChunkSize(table_count);
+    table_loads.reserve(table_count);
+
+    for (unsigned int i=0; i < table_count; i++)
+    {
+        Table *t = createTable(seating[i]);
+
+        table_info &info = table_infos[t->table_id];
+        info.load = seating[i].size();
+        info.hfh_waiting = false;
+        info.hfh_pass = -1;
+        info.arrivals.reserve(SeatsPerTable);
+
+        insertLoad(info.load, t->table_id);
+    }
+
+    players_left = entrants.size();
+
+    blind.amount = blind.start;
+    blind.last_blinds_time = now();
+
+    log_msg("game", "tournament %d has been started with %d players on %d tables",
+            game_id, players_left, table_count);
+    status = Started;
+    started_time = now();
+}
+
+int TournamentGameController::tick()
+{
+    TraceScope trace("TournamentGameController::tick", game_id);
+    if (status == Created)
+    {
+        if (getPlayerCount() == max_players)
+        {
+            log_msg("game", "starting tournament %d", getGameId());
+            start();
+        }
+        else	// nothing to do, exit early
+            return 0;
+    }
+    else if (status == Ended || status == Expired)
+    {
+        log_msg("game", "game %d is ended ", getGameId());
+        return -1;
+    }
+    else if (status == Paused)
+        return 0;
+
+    // handle all tables
+    for (tables_type::iterator e = tables.begin(); e != tables.end();)
+    {
+        Table *t = e->second;
+
+        const int state = t->delay ? -1 : (int) t->state;
+        const unsigned long long tick_start = sys_clock_usec();
+        const int rc = handleTable(t);
+        metrics_table_tick(state, sys_clock_usec() - tick_start);
+
+        // table closed?
+        if (rc < 0)
+        {
+            // the final table is done
+            if (tables.size() == 1)
+            {
+                status = Ended;
+                ended_time = now();
+
+                MessageWriter w(msg);
+                w << (int)SnapGameStateEnd;
+                snap(-1, SnapGameState, w.c_str());
+
+                // push back last remaining player to finish_list
+                for (unsigned int i=0; i < 10; ++i)
+                    if (t->seats[i].occupied)
+                    {
+                        finish_list.push_back(t->seats[i].player);
+                        break;
+                    }
+            }
+
+            removeTable(t->table_id);
+            table_pool.destroy(t);
+            tables.erase(e++);
+        }
+        else
+            ++e;
+    }
+
+    // all tables finished the hand-for-hand hand (or it is over)
+    if (hfh_waiting_count && (hfh_waiting_count >= tables.size() || !isHandForHand()))
+        releaseHandForHand();
+
+    return 0;
+}
+
+int TournamentGameController::handleTable(Table *t)
+{
+    SNGGameController::handleTable(t);
+
+    // broken up, everyone has been moved
+    if (!t->countPlayers() && table_infos[t->table_id].arrivals.empty())
+        return -1;
+
+    // winner is determined
+    if (players_left == 1 && tables.size() == 1)
+        return -1;
+
+    return 0;
+}
+
+void TournamentGameController::stateNewRound(Table *t)
+{
+    TraceScope trace("TournamentGameController::stateNewRound", t->table_id);
+    table_info &info = table_infos[t->table_id];
+
+    // hand-for-hand: wait here until every table has played the hand
+    if (isHandForHand())
+    {
+        if (info.hfh_pass != hfh_generation)
+        {
+            if (!info.hfh_waiting)
+            {
+                info.hfh_waiting = true;
+                hfh_waiting_count++;
+            }
+            return;
+        }
+
+        info.hfh_pass = -1;
+    }
+
+    seatArrivals(t);
+
+    // a short table waits for players to be moved here
+    if (t->countPlayers() < 2)
+        return;
+
+    // no rebuys in a freeze-out; SNG's rebuy pass would walk the whole field
+    GameController::stateNewRound(t);
+}
+
+void TournamentGameController::stateEndRound(Table *t)
+{
+    TraceScope trace("TournamentGameController::stateEndRound", t->table_id);
+    const unsigned int seated_before = t->countPlayers();
+
+    SNGGameController::stateEndRound(t);
+
+    const unsigned int seated = t->countPlayers();
+    players_left -= seated_before - seated;
+
+    setLoad(t->table_id, seated + table_infos[t->table_id].arrivals.size());
+
+    if (tables.size() < 2)
+        return;
+
+    // the field fits on one table less
+    if (players_left <= (tables.size() - 1) * SeatsPerTable)
+        breakTable(t);
+    else
+        balanceTable(t);
+}
+
+void TournamentGameController::snap(int tid, int sid, const char* msg)
+{
+    if (tid == -1 || tables.find(tid) == tables.end())
+    {
+        GameController::snap(tid, sid, msg);
+        return;
+    }
+
+    // with the delayed feed spectators get the event later
+    const bool live_spectators = !queueSpectatorEvent(tid, sid, msg);
+    getTableListeners(tid, table_listeners, live_spectators);
+
+    for (unsigned int i=0; i < table_listeners.size(); i++)
+        client_snapshot(game_id, tid, table_listeners[i], sid, msg);
+}
+
+void TournamentGameController::chat(int tid, const char* msg)
+{
+    if (tid == -1 || tables.find(tid) == tables.end())
+    {
+        GameController::chat(tid, msg);
+        return;
+    }
+
+    getTableListeners(tid, table_listeners);
+
+    for (unsigned int i=0; i < table_listeners.size(); i++)
+        client_chat(game_id, tid, table_listeners[i], msg);
+}
+
+void TournamentGameController::getTableListeners(int tid, vector<int> &client_list, bool with_spectators) const
+{
+    client_list.clear();
+
+    const Table *t = tables.find(tid)->second;
+    for (unsigned int i=0; i < 10; i++)
+        if (t->seats[i].occupied)
+            client_list.push_back(t->seats[i].player->getClientId());
+
+    table_infos_type::const_iterator it = table_infos.find(tid);
+    if (it != table_infos.end())
+        for (unsigned int i=0; i < it->second.arrivals.size(); i++)
+            client_list.push_back(it->second.arrivals[i]->getClientId());
+
+    // spectators follow all tables
+    if (with_spectators)
+        client_list.insert(client_list.end(), spectators.begin(), spectators.end());
+}
+
+bool TournamentGameController::isHandForHand() const
+{
+    return tables.size() > 1 && players_left <= hand_for_hand_players;
+}
+
+void TournamentGameController::releaseHandForHand()
+{
+    hfh_generation++;
+
+    for (table_infos_type::iterator e = table_infos.begin(); e != table_infos.end(); e++)
+    {
+        e->second.hfh_waiting = false;
+        e->second.hfh_pass = hfh_generation;
+    }
+
+    hfh_waiting_count = 0;
+}
+
+void TournamentGameController::setLoad(int tid, unsigned int load)
+{
+    table_info &info = table_infos[tid];
+    if (info.load == load)
+        return;
+
+    eraseLoad(info.load, tid);
+    info.load = load;
+    insertLoad(info.load, tid);
+}
+
+void TournamentGameController::insertLoad(unsigned int load, int tid)
+{
+    const pair<unsigned int,int> key(load, tid);
+    table_loads.insert(lower_bound(table_loads.begin(), table_loads.end(), key), key);
+}
+
+void TournamentGameController::eraseLoad(unsigned int load, int tid)
+{
+    const pair<unsigned int,int> key(load, tid);
+    table_loads_type::iterator it = lower_bound(table_loads.begin(), table_loads.end(), key);
+    if (it != table_loads.end() && *it == key)
+        table_loads.erase(it);
+}
+
+void TournamentGameController::movePlayer(Table *from, unsigned int seat_no, int to_tid)
+{
+    Player *p = from->seats[seat_no].player;
+
+    // tell the old table before the player leaves it
+    MessageWriter w(msg);
+    w << (int)SnapGameStateSeat << ' ' << p->getClientId() << ' ' << from->table_id << ' ' << to_tid;
+    snap(from->table_id, SnapGameState, w.c_str());
+
+    from->setOccupied(seat_no, false);
+
+    p->setTableNo(to_tid);
+    table_infos[to_tid].arrivals.push_back(p);
+    setLoad(to_tid, table_infos[to_tid].load + 1);
+
+    log_debug("game", "tournament %d: moved player %d from table %d to %d",
+            game_id, p->getClientId(), from->table_id, to_tid);
+}
+
+void TournamentGameController::forwardArrival(int from_tid, int to_tid)
+{
+    vector<Player*> &arrivals = table_infos[from_tid].arrivals;
+
+    Player *p = arrivals.back();
+    arrivals.pop_back();
+
+    p->setTableNo(to_tid);
+    table_infos[to_tid].arrivals.push_back(p);
+    setLoad(to_tid, table_infos[to_tid].load + 1);
+}
+
+void TournamentGameController::seatArrivals(Table *t)
+{
+    vector<Player*> &arrivals = table_infos[t->table_id].arrivals;
+    unsigned int seat_no = 0;
+
+    while (!arrivals.empty())
+    {
+        while (seat_no < 10 && t->seats[seat_no].occupied)
+            seat_no++;
+
+        if (seat_no == 10)
+            break;
+
+        Player *p = arrivals.back();
+        arrivals.pop_back();
+
+        Table::Seat *seat = &(t->seats[seat_no]);
+        seat->seat_no = seat_no;
+        t->setOccupied(seat_no, true);
+        seat->player = p;
+        seat->bet = 0;
+        t->setInRound(seat_no, false);
+        seat->auto_showcards = false;
+        seat->manual_showcards = false;
+
+        p->setTableNo(t->table_id);
+        p->setSeatNo(seat_no);
+
+        MessageWriter w(msg);
+        w << (int)SnapGameStateSeat << ' ' << p->getClientId() << ' ' << t->table_id << ' ' << seat_no;
+        snap(t->table_id, SnapGameState, w.c_str());
+    }
+}
+
+void TournamentGameController::balanceTable(Table *t)
+{
+    for (;;)
+    {
+        const table_loads_type::const_iterator shortest = table_loads.begin();
+        const table_info &info = table_infos[t->table_id];
+        const unsigned int load = info.load;
+
+        if (shortest->second == t->table_id || load <= shortest->first + 1)
+            return;
+
+        // players on their way here haven't sat down yet; pass them on first
+        if (!info.arrivals.empty())
+        {
+            forwardArrival(t->table_id, shortest->second);
+            setLoad(t->table_id, load - 1);
+            continue;
+        }
+
+        // move the player who would post the big blind next
+        const int sb = t->getNextPlayer(t->dealer);
+        const int bb = (sb < 0) ? -1 : t->getNextPlayer(sb);
+        if (bb < 0)
+            return;
+
+        movePlayer(t, bb, shortest->second);
+        setLoad(t->table_id, load - 1);
+    }
+}
+
+void TournamentGameController::breakTable(Table *t)
+{
+    table_info &info = table_infos[t->table_id];
+
+    log_msg("game", "tournament %d: breaking table %d (%d players left)",
+            game_id, t->table_id, players_left);
+
+    // take the table out of the rotation before moving anyone
+    eraseLoad(info.load, t->table_id);
+
+    for (unsigned int i=0; i < 10; i++)
+    {
+        if (!t->seats[i].occupied)
+            continue;
+
+        const table_loads_type::const_iterator shortest = table_loads.begin();
+        if (shortest->first >= SeatsPerTable)
+            break;
+
+        movePlayer(t, i, shortest->second);
+    }
+
+    // forward players who were on their way here
+    while (!info.arrivals.empty())
+    {
+        const table_loads_type::const_iterator shortest = table_loads.begin();
+        if (shortest == table_loads.end() || shortest->first >= SeatsPerTable)
+            break;
+
+        forwardArrival(t->table_id, shortest->second);
+    }
+
+    // anyone left behind (no room elsewhere) keeps playing here
+    info.load = t->countPlayers() + info.arrivals.size();
+    if (info.load)
+        insertLoad(info.load, t->table_id);
+}
+
+void TournamentGameController::removeTable(int tid)
+{
+    table_infos_type::iterator it = table_infos.find(tid);
+    if (it == table_infos.end())
+        return;
+
+    if (it->second.hfh_waiting && hfh_waiting_count)
+        hfh_waiting_count--;
+
+    eraseLoad(it->second.load, tid);
+    table_infos.erase(it);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _TOURNAMENTGAMECONTROLLER_H
+#define _TOURNAMENTGAMECONTROLLER_H
+
+#include <vector>
+#include <map>
+#include <utility>
+
+#include "Table.hpp"
+#include "Player.hpp"
+#include "SNGGameController.hpp"
+
+
+//! \brief Multi-table freeze-out tournament
+//!
+//! Players are dealt onto tables once at start. Between hands a table hands
+//! players over to the shortest table or breaks up as soon as the field fits
+//! on one table less. Moved players are seated at the next hand of their new
+//! table. Blind levels are shared by all tables.
+class TournamentGameController : public SNGGameController
+{
+friend class BenchTournament;
+
+public:
+	TournamentGameController();
+	
+	void reset();
+	
+	void start();
+	int tick();
+	int handleTable(Table *t);
+	
+	void stateNewRound(Table *t);
+	void stateEndRound(Table *t);
+	
+	using GameController::snap;
+	using GameController::chat;
+	void snap(int tid, int sid, const char* msg="");
+	void chat(int tid, const char* msg);
+	
+	//! \brief Play hand-for-hand when this many players (or less) are left on several tables
+	void setHandForHand(unsigned int players) { hand_for_hand_players = players; };
+	unsigned int getHandForHand() const { return hand_for_hand_players; };
+	
+	unsigned int getPlayersLeft() const { return players_left; };
+	
+	static const unsigned int SeatsPerTable = 9;
+	
+private:
+	typedef struct {
+		std::vector<Player*> arrivals;	// moved here, seated with the next hand
+		unsigned int load;		// seated players and arrivals
+		bool hfh_waiting;		// done with the hand-for-hand hand
+		int hfh_pass;			// hand-for-hand generation the table may play
+	} table_info;
+	
+	typedef std::map<int,table_info>		table_infos_type;
+	typedef std::vector< std::pair<unsigned int,int> >	table_loads_type;
+	
+	bool isHandForHand() const;
+	void releaseHandForHand();
+	
+	void setLoad(int tid, unsigned int load);
+	void insertLoad(unsigned int load, int tid);
+	void eraseLoad(unsigned int load, int tid);
+	void movePlayer(Table *from, unsigned int seat_no, int to_tid);
+	void forwardArrival(int from_tid, int to_tid);
+	void seatArrivals(Table *t);
+	void balanceTable(Table *t);
+	void breakTable(Table *t);
+	void removeTable(int tid);
+	
+	void getTableListeners(int tid, std::vector<int> &client_list, bool with_spectators = true) const;
+	
+	table_infos_type table_infos;
+	table_loads_type table_loads;	// (load, tid) sorted, shortest table first; sized at start
+	
+	unsigned int players_left;
+	unsigned int hand_for_hand_players;
+	unsigned int hfh_waiting_count;
+	int hfh_generation;
+	
+	std::vector<int> table_listeners;	// reused by snap() and chat()
+};
+
+#endif /* _TOURNAMENTGAMECONTROLLER_H */
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#if !defined(PLATFORM_WINDOWS)
+# include <netinet/tcp.h>
+# include <poll.h>
+#endif
+
+#include "Config.h"
+#include "Platform.h"
+#include "Logger.h"
+#include "Debug.h"
+#include "Network.h"
+
+#include "server_config.hpp"
+#include "acceptor.hpp"
+
+using namespace std;
+
+// defined in pserver.cpp
+int listensock_create(unsigned int port, int backlog, bool local, bool reuseport);
+
+// connections taken from a listening socket per wakeup; the rest waits for the next one
+#define ACCEPTOR_BATCH		256
+
+// acceptor threads check for shutdown this often (ms)
+#define ACCEPTOR_POLL_TIMEOUT	500
+
+
+// socket options, fixed at startup (threads must not read srvconf)
+static bool tcp_nodelay = true;
+static int buffer_size = 0;
+
+// open connections by IPv4 address (network byte order)
+static unordered_map<unsigned int,unsigned int> ip_connections;
+
+static socktype main_listenfd = -1;
+static bool main_tcp = true;
+
+#if !defined(PLATFORM_WINDOWS) && defined(SO_REUSEPORT)
+# define ACCEPTOR_THREADS
+#endif
+
+#ifdef ACCEPTOR_THREADS
+static vector<thread> acceptor_threads;
+static vector<accepted_connection> acceptor_queue;
+static mutex acceptor_mutex;
+static atomic<bool> acceptor_stopping(false);
+static int wakeup_pipe[2] = { -1, -1 };
+#endif
+
+
+static unsigned int accept_batch(socktype listenfd, bool tcp, vector<accepted_connection> &conns, unsigned int max)
+{
+	unsigned int count = 0;
+	
+	while (count < max)
+	{
+		accepted_connection c;
+		unsigned int saddrlen = sizeof(c.saddr);
+		memset(&c.saddr, 0, sizeof(c.saddr));
+		
+		c.sock = socket_accept_nonblocking(listenfd, (struct sockaddr*) &c.saddr, &saddrlen);
+		if (c.sock == -1)
+			break;   // drained (or failed, e.g. out of descriptors)
+		
+		if (tcp)
+		{
+			const int nodelay = tcp_nodelay ? 1 : 0;
+			socket_setopt(c.sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+			
+			if (buffer_size > 0)
+			{
+				socket_setopt(c.sock, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+				socket_setopt(c.sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+			}
+		}
+		else
+			c.saddr.sin_family = AF_UNIX;
+		
+		conns.push_back(c);
+		count++;
+	}
+	
+	return count;
+}
+
+#ifdef ACCEPTOR_THREADS
+static void acceptor_thread(socktype listenfd)
+{
+	vector<accepted_connection> conns;
+	
+	while (!acceptor_stopping)
+	{
+		struct pollfd pfd;
+		pfd.fd = listenfd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		
+		if (poll(&pfd, 1, ACCEPTOR_POLL_TIMEOUT) <= 0)
+			continue;
+		
+		conns.clear();
+		if (!accept_batch(listenfd, true, conns, ACCEPTOR_BATCH))
+			continue;
+		
+		{
+			lock_guard<mutex> lock(acceptor_mutex);
+			acceptor_queue.insert(acceptor_queue.end(), conns.begin(), conns.end());
+		}
+		
+		// a full pipe already guarantees a wakeup
+		const char c = 0;
+		if (write(wakeup_pipe[1], &c, 1) < 0)
+			continue;
+	}
+}
+#endif
+
+bool acceptor_start(socktype listenfd, unsigned int port, bool tcp)
+{
+	main_listenfd = listenfd;
+	main_tcp = tcp;
+	tcp_nodelay = srvconf.tcp_nodelay;
+	buffer_size = srvconf.socket_buffer_size;
+	
+	if (srvconf.accept_threads <= 0 || !tcp)
+		return true;
+	
+#ifdef ACCEPTOR_THREADS
+	if (pipe(wakeup_pipe) < 0)
+	{
+		log_msg("acceptor", "pipe() failed (%d: %s)", errno, strerror(errno));
+		return false;
+	}
+	
+	socket_setnonblocking(wakeup_pipe[0]);
+	socket_setnonblocking(wakeup_pipe[1]);
+	
+	// the kernel spreads new connections over all sockets bound with SO_REUSEPORT
+	vector<socktype> listeners(1, listenfd);
+	for (int i=1; i < srvconf.accept_threads; i++)
+	{
+		const int fd = listensock_create(port, srvconf.listen_backlog, false, true);
+		if (fd < 0)
+		{
+			log_msg("acceptor", "(%d) error creating socket for acceptor thread", fd);
+			break;
+		}
+		
+		listeners.push_back(fd);
+	}
+	
+	for (unsigned int i=0; i < listeners.size(); i++)
+		acceptor_threads.push_back(thread(acceptor_thread, listeners[i]));
+	
+	log_msg("acceptor", "accepting with %d threads", (int) acceptor_threads.size());
+#else
+	log_msg("acceptor", "acceptor threads not supported on this platform");
+#endif
+	
+	return true;
+}
+
+void acceptor_stop()
+{
+#ifdef ACCEPTOR_THREADS
+	acceptor_stopping = true;
+	
+	for (unsigned int i=0; i < acceptor_threads.size(); i++)
+		acceptor_threads[i].join();
+	
+	acceptor_threads.clear();
+#endif
+}
+
+socktype acceptor_descriptor()
+{
+#ifdef ACCEPTOR_THREADS
+	if (acceptor_threads.size())
+		return wakeup_pipe[0];
+#endif
+	
+	return main_listenfd;
+}
+
+void acceptor_collect(vector<accepted_connection> &conns)
+{
+	conns.clear();
+	
+#ifdef ACCEPTOR_THREADS
+	if (acceptor_threads.size())
+	{
+		char buf[64];
+		while (read(wakeup_pipe[0], buf, sizeof(buf)) > 0)
+			;
+		
+		lock_guard<mutex> lock(acceptor_mutex);
+		conns.swap(acceptor_queue);
+		return;
+	}
+#endif
+	
+	accept_batch(main_listenfd, main_tcp, conns, ACCEPTOR_BATCH);
+}
+
+bool acceptor_admit(const sockaddr_in *saddr, unsigned int connections)
+{
+	if (connections >= (unsigned int) srvconf.max_clients)
+	{
+		dbg_msg("acceptor", "refused connection (%s): max_clients reached",
+			inet_ntoa(saddr->sin_addr));
+		return false;
+	}
+	
+	if (saddr->sin_family != AF_INET)
+		return true;
+	
+	unsigned int &count = ip_connections[saddr->sin_addr.s_addr];
+	if (count >= (unsigned int) srvconf.max_connections_per_ip)
+	{
+		dbg_msg("acceptor", "refused connection (%s): max_connections_per_ip reached",
+			inet_ntoa(saddr->sin_addr));
+		
+		if (!count)
+			ip_connections.erase(saddr->sin_addr.s_addr);
+		return false;
+	}
+	
+	count++;
+	
+	return true;
+}
+
+void acceptor_release(const sockaddr_in *saddr)
+{
+	if (saddr->sin_family != AF_INET)
+		return;
+	
+	unordered_map<unsigned int,unsigned int>::iterator it = ip_connections.find(saddr->sin_addr.s_addr);
+	if (it == ip_connections.end())
+		return;
+	
+	if (--it->second == 0)
+		ip_connections.erase(it);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _ACCEPTOR_H
+#define _ACCEPTOR_H
+
+#include <vector>
+
+#include "Network.h"
+
+//! \brief Connection taken from a listening socket, not yet known to the game
+typedef struct {
+	socktype sock;
+	sockaddr_in saddr;	// sin_family is AF_UNIX for gateway links
+} accepted_connection;
+
+//! \brief Start accepting on the server's listening socket
+//!
+//! Pending connections are drained in one go as non-blocking sockets; TCP
+//! connections get TCP_NODELAY and the configured buffer sizes. With
+//! accept_threads > 0 (and SO_REUSEPORT support) the port is served by
+//! threads, each on its own SO_REUSEPORT socket; listenfd must have been
+//! created with SO_REUSEPORT then. Otherwise the main loop accepts itself.
+bool acceptor_start(socktype listenfd, unsigned int port, bool tcp);
+void acceptor_stop();
+
+//! \brief Descriptor signaling new connections to select()
+socktype acceptor_descriptor();
+//! \brief Connections accepted since the last call; call when acceptor_descriptor() is readable
+void acceptor_collect(std::vector<accepted_connection> &conns);
+
+//! \brief Apply max_clients and max_connections_per_ip to a new connection and count it
+//!
+//! Gateway links (AF_UNIX) are only subject to max_clients; the gateway
+//! limits the connections per IP itself.
+bool acceptor_admit(const sockaddr_in *saddr, unsigned int connections);
+//! \brief Stop counting a closed connection that was admitted before
+void acceptor_release(const sockaddr_in *saddr);
+
+#endif /* _ACCEPTOR_H */
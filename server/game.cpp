@@ -25,17 +25,29 @@
 #include <cstdlib>
 #include <cstring>
 #include <climits>
+#include <unordered_map>
 
 #include "Config.h"
 #include "Platform.h"
 #include "Network.h"
+#include "SysAccess.h"
 #include "Debug.h"
 #include "Logger.h"
+#include "Trace.hpp"
 #include "Tokenizer.hpp"
 #include "ConfigParser.hpp"
+#include "Metrics.hpp"
+#include "MessageWriter.hpp"
+#include "SocketPoller.hpp"
+#include "SocketWriter.hpp"
 
 #include "game.hpp"
 #include "ranking.hpp"
+#include "lobby.hpp"
+#include "ConnectionArchive.hpp"
+#include "EventRing.hpp"
+#include "server_config.hpp"
+#include "acceptor.hpp"
 #include <sstream>
 
 
@@ -47,17 +59,100 @@ extern ConfigParser config;
 #define MSG_BUFFER_SIZE  (1024*16)
 static char msg[MSG_BUFFER_SIZE];
 
+// number of leaderboard entries per page (default and maximum)
+#define RANKING_PAGE_DEFAULT  10
+#define RANKING_PAGE_MAX      50
+
+// ids accepted by one REQUEST gameinfo/clientinfo
+#define REQUEST_ITEMS_MAX     50
+
+// rate limits of the command classes besides RateGeneral (configured): commands per second, burst
+static const struct {
+	double rate;
+	double burst;
+} rate_limits[RateClasses] = {
+	{ 0, 0 },	// RateGeneral; rate_commands, rate_burst
+	{ 10, 20 },	// RateQuery
+	{ 5, 10 },	// RatePlay
+	{ 1, 5 },	// RateManage
+};
+
+// strikes of a client keeping to its limits for this long are forgiven
+#define RATE_FORGIVE_USEC     (10 * 1000000ULL)
+
 static games_type games;
 
 static clients_type clients;
 
+// readiness of client sockets and their queued output
+static SocketPoller client_poller;
+static SocketWriter client_writer;
+static vector<socktype> client_failed;
+
+// clients not reading their output are dropped beyond this
+#define CLIENT_MAX_OUTPUT	(1024 * 1024)
+
+
+static ConnectionArchive con_archive;
+
+// recent events per client id, kept across reconnects for resuming a session
+typedef struct {
+	EventRing events;
+	time_t logout_time;	// 0 while the client is connected
+} event_session;
 
-static clientconar_type con_archive;
-static time_t last_conarchive_cleanup = 0;   // last time scan
+static unordered_map<int,event_session> event_sessions;
+static time_t last_session_expire = 0;
 
 static server_stats stats;
 
 
+// metrics exported by the scrape endpoint and SERVERINFO
+static MetricsRegistry metrics;
+
+typedef struct {
+	MetricCounter *count;
+	MetricHistogram *latency;
+} command_metrics;
+
+static std::map<std::string,command_metrics> cmd_metrics;
+static command_metrics cmd_metrics_unknown;
+
+static struct {
+	MetricHistogram *execute;
+	MetricHistogram *gameloop;
+	MetricHistogram *table_tick[Table::Resume + 2];  // [0] is the delay pseudo-state
+	MetricHistogram *db_query;
+	MetricGauge *clients;
+	MetricGauge *games;
+	MetricGauge *tables;
+	MetricGauge *output_queued;
+	MetricCounter *output_syscalls;
+	MetricCounter *rate_limited;
+	MetricGauge *db_latency;
+	MetricCounter *player_chunks;
+	MetricCounter *player_creates;
+	MetricCounter *table_chunks;
+	MetricCounter *table_creates;
+} smetrics;
+
+
+// foyer presence changes collected since the last broadcast
+typedef struct {
+	bool was_present;	// state last announced to subscribers
+	bool present;
+	string name;
+} foyer_change;
+
+static map<int,foyer_change> foyer_pending;
+static unsigned long long last_foyer_flush = 0;
+
+// batches of the delayed spectator feed; buffers are reused between flushes
+static unsigned long long last_spectator_flush = 0;
+static vector<GameController::SpectatorEvent> spectator_batch;
+static string spectator_payload;
+
+
 
 GameController* get_game_by_id(int gid)
 {
@@ -74,6 +169,16 @@ clients_type& get_client_vector()
 	return clients;
 }
 
+SocketPoller& get_client_poller()
+{
+	return client_poller;
+}
+
+games_type& get_game_map()
+{
+	return games;
+}
+
 clientcon* get_client_by_sock(socktype sock)
 {
 	for (unsigned int i=0; i < clients.size(); i++)
@@ -92,19 +197,146 @@ clientcon* get_client_by_id(int cid)
 	return NULL;
 }
 
-int send_msg(socktype sock, const char *message)
+static void metrics_init()
+{
+	static const char *commands[] = {
+		"PCLIENT", "INFO", "CHAT", "REQUEST", "REBUY", "RESPITE",
+		"REGISTER", "UNREGISTER", "SUBSCRIBE", "UNSUBSCRIBE", "ACTION",
+		"CREATE", "AUTH", "CONFIG", "TRACE", "FOYER", "LOBBY", "STRADDLE", "BUYINSURANCE", "QUIT", "SYNC"
+	};
+	
+	// same order as Table::State, shifted by one for the delay pseudo-state
+	static const char *states[] = {
+		"Delay", "GameStart", "ElectDealer", "NewRound", "Blinds", "Betting",
+		"BettingEnd", "AskShow", "AllFolded", "Showdown", "EndRound",
+		"Suspend", "Resume"
+	};
+	
+	char label[64];
+	
+	for (unsigned int i=0; i < sizeof(commands) / sizeof(commands[0]); i++)
+	{
+		snprintf(label, sizeof(label), "command=\"%s\"", commands[i]);
+		
+		command_metrics cm;
+		cm.count = metrics.addCounter("holdingnuts_commands_total",
+			"Client commands executed", label);
+		cm.latency = metrics.addHistogram("holdingnuts_command_duration_seconds",
+			"Time spent executing client commands", label);
+		
+		cmd_metrics[commands[i]] = cm;
+	}
+	
+	cmd_metrics_unknown.count = metrics.addCounter("holdingnuts_commands_total",
+		"Client commands executed", "command=\"unknown\"");
+	cmd_metrics_unknown.latency = metrics.addHistogram("holdingnuts_command_duration_seconds",
+		"Time spent executing client commands", "command=\"unknown\"");
+	
+	smetrics.execute = metrics.addHistogram("holdingnuts_client_execute_duration_seconds",
+		"Time spent in client_execute for all commands");
+	smetrics.gameloop = metrics.addHistogram("holdingnuts_gameloop_duration_seconds",
+		"Duration of one gameloop pass over all games");
+	
+	for (unsigned int i=0; i < sizeof(states) / sizeof(states[0]); i++)
+	{
+		snprintf(label, sizeof(label), "state=\"%s\"", states[i]);
+		smetrics.table_tick[i] = metrics.addHistogram("holdingnuts_table_tick_duration_seconds",
+			"Duration of handleTable by table state", label);
+	}
+	
+	smetrics.db_query = metrics.addHistogram("holdingnuts_db_query_duration_seconds",
+		"Duration of database updates");
+	
+	smetrics.clients = metrics.addGauge("holdingnuts_clients", "Connected clients");
+	smetrics.games = metrics.addGauge("holdingnuts_games", "Existing games");
+	smetrics.tables = metrics.addGauge("holdingnuts_tables", "Tables of all games");
+	smetrics.output_queued = metrics.addGauge("holdingnuts_output_queued_bytes",
+		"Bytes queued for sending to clients");
+	smetrics.output_syscalls = metrics.addCounter("holdingnuts_output_syscalls_total",
+		"System calls spent sending queued client output");
+	smetrics.rate_limited = metrics.addCounter("holdingnuts_commands_rate_limited_total",
+		"Commands delayed or refused by client rate limits");
+	smetrics.db_latency = metrics.addGauge("holdingnuts_db_latency_seconds",
+		"Duration of the last database update");
+	
+	// pools are sized by the player limit, so a game normally takes one chunk of each
+	smetrics.player_chunks = metrics.addCounter("holdingnuts_pool_chunk_allocs_total",
+		"Chunks allocated from the heap by object pools", "type=\"Player\"");
+	smetrics.player_creates = metrics.addCounter("holdingnuts_pool_objects_total",
+		"Objects handed out by object pools", "type=\"Player\"");
+	smetrics.table_chunks = metrics.addCounter("holdingnuts_pool_chunk_allocs_total",
+		"Chunks allocated from the heap by object pools", "type=\"Table\"");
+	smetrics.table_creates = metrics.addCounter("holdingnuts_pool_objects_total",
+		"Objects handed out by object pools", "type=\"Table\"");
+}
+
+static void metrics_refresh()
+{
+	unsigned int table_count = 0;
+	for (games_type::const_iterator e = games.begin(); e != games.end(); e++)
+		table_count += e->second->tables.size();
+	
+	unsigned int queued = client_writer.pending();
+	for (clients_type::const_iterator e = clients.begin(); e != clients.end(); e++)
+	{
+		const int bytes = socket_pending_output(e->sock);
+		if (bytes > 0)
+			queued += bytes;
+	}
+	
+	smetrics.clients->set(clients.size());
+	smetrics.games->set(games.size());
+	smetrics.tables->set(table_count);
+	smetrics.output_queued->set(queued);
+	smetrics.output_syscalls->inc(client_writer.syscalls() - smetrics.output_syscalls->get());
+	
+	// pool totals are kept by the pools themselves; forward the increase
+	smetrics.player_chunks->inc(ObjectPool<Player>::chunkAllocs() - smetrics.player_chunks->get());
+	smetrics.player_creates->inc(ObjectPool<Player>::creates() - smetrics.player_creates->get());
+	smetrics.table_chunks->inc(ObjectPool<Table>::chunkAllocs() - smetrics.table_chunks->get());
+	smetrics.table_creates->inc(ObjectPool<Table>::creates() - smetrics.table_creates->get());
+}
+
+static void metrics_command(const string &command, unsigned long long usec)
+{
+	std::map<std::string,command_metrics>::iterator it = cmd_metrics.find(command);
+	command_metrics &cm = (it != cmd_metrics.end()) ? it->second : cmd_metrics_unknown;
+	
+	cm.count->inc();
+	cm.latency->record(usec);
+	smetrics.execute->record(usec);
+}
+
+void metrics_table_tick(int state, unsigned long long usec)
+{
+	const unsigned int idx = state + 1;
+	
+	if (idx < sizeof(smetrics.table_tick) / sizeof(smetrics.table_tick[0]))
+		smetrics.table_tick[idx]->record(usec);
+}
+
+void metrics_db_query(unsigned long long usec)
+{
+	smetrics.db_query->record(usec);
+	smetrics.db_latency->set(usec / 1000000.0);
+}
+
+void metrics_scrape(string &out)
+{
+	metrics_refresh();
+	metrics.format(out);
+}
+
+int send_msg(socktype sock, const char *message, size_t length)
 {
 	char buf[MSG_BUFFER_SIZE];
-	const int len = snprintf(buf, sizeof(buf), "%s\r\n", message);
-	const int bytes = socket_write(sock, buf, len);
+	MessageWriter w(buf);
+	w.write(message, length) << "\r\n";
 	
-	// FIXME: send remaining bytes if not all have been sent
-	// FIXME: handle client-dead case
-	if (len != bytes)
-		dbg_msg("clientsock", "message %s: (%d) warning: not all bytes written (%d != %d).",
-			message, sock, len, bytes);
+	// sent with the output of all clients by client_flush()
+	client_writer.queue(sock, buf, w.length());
 	
-	return bytes;
+	return w.length();
 }
 
 bool send_response(socktype sock, bool is_success, int last_msgid, int code=0, const char *str="")
@@ -131,6 +363,14 @@ bool send_err(clientcon *client, int code=0, const char *str="")
 }
 
 // from client/foyer to client/foyer
+// store an event for replaying it to the client after a reconnect
+static void event_record(int cid, const char *message)
+{
+	unordered_map<int,event_session>::iterator it = event_sessions.find(cid);
+	if (it != event_sessions.end())
+		it->second.events.push(message);
+}
+
 bool client_chat(int from, int to, const char *message)
 {
 	char msg[256];
@@ -180,6 +420,8 @@ bool client_chat(int from_gid, int from_tid, int to, const char *message)
 	snprintf(msg, sizeof(msg), "MSG %d:%d %s %s",
 		from_gid, from_tid, (from_tid == -1) ? "game" : "table", message);
 	
+	event_record(to, msg);
+	
 	clientcon* toclient = get_client_by_id(to);
 	if (toclient)
 		send_msg(toclient->sock, msg);
@@ -208,6 +450,8 @@ bool table_chat(int from_cid, int to_gid, int to_tid, const char *message)
 			(fromclient) ? fromclient->info.name : "???",
 			message);
 		
+		event_record(client_list[i], msg);
+		
 		clientcon* toclient = get_client_by_id(client_list[i]);
 		if (toclient)
 			send_msg(toclient->sock, msg);
@@ -219,12 +463,14 @@ bool table_chat(int from_cid, int to_gid, int to_tid, const char *message)
 bool client_snapshot(int from_gid, int from_tid, int to, int sid, const char *message)
 {
 	char buf[MSG_BUFFER_SIZE];
-	snprintf(buf, sizeof(buf), "SNAP %d:%d %d %s",
-		from_gid, from_tid, sid, message);
+	MessageWriter w(buf);
+	w << "SNAP " << from_gid << ':' << from_tid << ' ' << sid << ' ' << message;
+	
+	event_record(to, w.c_str());
 	
 	clientcon* toclient = get_client_by_id(to);
 	if (toclient && toclient->state & Introduced) {
-		send_msg(toclient->sock, buf);
+		send_msg(toclient->sock, w.c_str(), w.length());
     }
 	
 	return true;
@@ -253,6 +499,182 @@ bool send_ok_game(int gid, clientcon *client)
     return true;
 }
 
+void foyer_join(const clientcon *client)
+{
+	map<int,foyer_change>::iterator it = foyer_pending.find(client->id);
+	if (it == foyer_pending.end())
+	{
+		foyer_change &c = foyer_pending[client->id];
+		c.was_present = false;
+		c.present = true;
+		c.name = client->info.name;
+	}
+	else
+	{
+		// re-join within the interval; only announce if the name changed
+		foyer_change &c = it->second;
+		c.present = true;
+		if (c.name != client->info.name)
+		{
+			c.name = client->info.name;
+			c.was_present = false;
+		}
+	}
+}
+
+void foyer_leave(const clientcon *client)
+{
+	map<int,foyer_change>::iterator it = foyer_pending.find(client->id);
+	if (it == foyer_pending.end())
+	{
+		foyer_change &c = foyer_pending[client->id];
+		c.was_present = true;
+		c.present = false;
+		c.name = client->info.name;
+	}
+	else
+		it->second.present = false;
+}
+
+// split entries into snapshot messages fitting into the message buffer
+static void foyer_pack(const vector<string> &entries, vector<string> &bodies)
+{
+	const unsigned int max_length = MSG_BUFFER_SIZE - 64;   // room for SNAP header
+	
+	string body;
+	for (unsigned int i=0; i < entries.size(); i++)
+	{
+		if (body.length() && body.length() + entries[i].length() > max_length)
+		{
+			bodies.push_back(body);
+			body.clear();
+		}
+		
+		body += entries[i];
+	}
+	
+	if (body.length())
+		bodies.push_back(body);
+}
+
+// send a foyer snapshot without looking up the client by id
+static void foyer_send(const clientcon *client, const char *body)
+{
+	snprintf(msg, sizeof(msg), "SNAP -1:-1 %d %s", SnapFoyer, body);
+	event_record(client->id, msg);
+	send_msg(client->sock, msg);
+}
+
+void foyer_flush()
+{
+	if (foyer_pending.empty())
+		return;
+	
+	vector<string> entries;
+	for (map<int,foyer_change>::const_iterator e = foyer_pending.begin(); e != foyer_pending.end(); e++)
+	{
+		const foyer_change &c = e->second;
+		char entry[64];
+		
+		if (c.present && !c.was_present)
+			snprintf(entry, sizeof(entry), " +%d \"%s\"", e->first, c.name.c_str());
+		else if (!c.present && c.was_present)
+			snprintf(entry, sizeof(entry), " -%d", e->first);
+		else	// joined and left within the same interval
+			continue;
+		
+		entries.push_back(entry);
+	}
+	
+	foyer_pending.clear();
+	
+	vector<string> bodies;
+	foyer_pack(entries, bodies);
+	
+	for (unsigned int i=0; i < bodies.size(); i++)
+	{
+		char body[MSG_BUFFER_SIZE];
+		snprintf(body, sizeof(body), "%d%s", SnapFoyerUpdate, bodies[i].c_str());
+		
+		for (clients_type::iterator e = clients.begin(); e != clients.end(); e++)
+			if (e->foyer)
+				foyer_send(&*e, body);
+	}
+}
+
+void foyer_send_roster(clientcon *client)
+{
+	vector<string> entries;
+	for (clients_type::const_iterator e = clients.begin(); e != clients.end(); e++)
+	{
+		if (!(e->state & SentInfo))
+			continue;
+		
+		char entry[64];
+		snprintf(entry, sizeof(entry), " %d \"%s\"", e->id, e->info.name);
+		entries.push_back(entry);
+	}
+	
+	vector<string> bodies;
+	foyer_pack(entries, bodies);
+	
+	// the last message of the roster has the more-flag cleared
+	if (bodies.empty())
+		bodies.push_back("");
+	
+	for (unsigned int i=0; i < bodies.size(); i++)
+	{
+		char body[MSG_BUFFER_SIZE];
+		snprintf(body, sizeof(body), "%d %d%s",
+			SnapFoyerRoster, (i + 1 < bodies.size()) ? 1 : 0, bodies[i].c_str());
+		
+		foyer_send(client, body);
+	}
+}
+
+// send the due spectator events of each game as one payload shared by all its spectators
+// (every line is recorded for each spectator, also while disconnected, to be replayed on resume)
+void spectator_flush()
+{
+	// with the feed switched off, whatever is still queued goes out right away
+	const time_t until = GameController::hasSpectatorFeed() ?
+		GameController::now() - srvconf.spectator_delay : GameController::now();
+	
+	for (games_type::iterator e = games.begin(); e != games.end(); e++)
+	{
+		GameController *g = e->second;
+		if (g->spectator_feed.empty())
+			continue;
+		
+		g->releaseSpectatorFeed(until, spectator_batch);
+		if (spectator_batch.empty())
+			continue;
+		
+		spectator_payload.clear();
+		for (unsigned int i=0; i < spectator_batch.size(); i++)
+		{
+			const GameController::SpectatorEvent &ev = spectator_batch[i];
+			
+			char line[MSG_BUFFER_SIZE];
+			MessageWriter w(line);
+			w << "SNAP " << g->getGameId() << ':' << ev.tid << ' ' << ev.sid << ' ' << ev.msg;
+			
+			for (GameController::spectators_type::const_iterator s = g->spectators.begin(); s != g->spectators.end(); s++)
+				event_record(*s, w.c_str());
+			
+			w << "\r\n";
+			spectator_payload.append(w.c_str(), w.length());
+		}
+		
+		for (GameController::spectators_type::const_iterator s = g->spectators.begin(); s != g->spectators.end(); s++)
+		{
+			clientcon *client = get_client_by_id(*s);
+			if (client && client->state & Introduced)
+				client_writer.queue(client->sock, spectator_payload.data(), spectator_payload.length());
+		}
+	}
+}
+
 bool client_add(socktype sock, sockaddr_in *saddr)
 {
 	// add the client
@@ -265,6 +687,14 @@ bool client_add(socktype sock, sockaddr_in *saddr)
 	// set initial state
 	client.state |= Connected;
 	
+	if (!client_poller.add(sock))
+	{
+		log_msg("clientsock", "(%d) error: cannot watch socket", sock);
+		socket_close(sock);
+		acceptor_release(saddr);
+		return false;
+	}
+	
 	clients.push_back(client);
 	
 	
@@ -280,43 +710,52 @@ bool client_remove(socktype sock)
 	{
 		if (client->sock == sock)
 		{
+			// a final error message may still be queued
+			client_poller.remove(sock);
+			client_writer.finish(sock);
+			
 			socket_close(client->sock);
+			acceptor_release(&client->saddr);
 			
-			bool send_msg = false;
 			if (client->state & SentInfo)
 			{
-				// remove player from unstarted games
-				for (games_type::iterator e = games.begin(); e != games.end(); e++)
+				// remove player from unstarted games (removing may modify the index)
+				const GameController::client_games_type player_games = GameController::getPlayerGames(client->id);
+				for (GameController::client_games_type::const_iterator e = player_games.begin(); e != player_games.end(); e++)
 				{
-					GameController *g = e->second;
-					if (!g->isStarted() && g->isPlayer(client->id))
+					GameController *g = *e;
+					if (!g->isStarted())
 						g->removePlayer(client->id);
 				}
 				
 				
-				snprintf(msg, sizeof(msg),
-					"%d %d \"%s\"",
-					SnapFoyerLeave, client->id, client->info.name);
-				
-				send_msg = true;
+				foyer_leave(&*client);
 				
 				// save client-con in archive
 				string uuid = client->uuid;
 				
 				if (uuid.length())
 				{
-					// FIXME: only add max. 3 entries for each IP
-					con_archive[uuid].logout_time = time(NULL);
+					// limits may have changed on config reload
+					con_archive.setLimits(srvconf.conarchive_max_per_ip, srvconf.conarchive_max);
+					con_archive.logout(uuid, client->saddr.sin_addr.s_addr,
+						time(NULL) + srvconf.conarchive_expire);
 				}
 			}
 			
+			// keep recording events for a later resume
+			if (client->state & Introduced)
+			{
+				unordered_map<int,event_session>::iterator it = event_sessions.find(client->id);
+				if (it != event_sessions.end())
+					it->second.logout_time = time(NULL);
+			}
+			
 			log_msg("clientsock", "(%d) connection closed", client->sock);
 			
-			clients.erase(client);
+			lobby_unsubscribe(client->id);
 			
-			// send foyer snapshot to all remaining clients
-			if (send_msg)
-				client_snapshot(-1, SnapFoyer, msg);
+			clients.erase(client);
 			
 			break;
 		}
@@ -325,12 +764,86 @@ bool client_remove(socktype sock)
 	return true;
 }
 
+bool send_gameinfo(clientcon *client, int gid);
+bool send_playerlist(int gid, clientcon *client);
+
+// continue the event log of a previous connection, or start a new one
+static void session_start(clientcon *client, bool resume, unsigned int last_seq)
+{
+	unordered_map<int,event_session>::iterator it = event_sessions.find(client->id);
+	
+	if (!srvconf.resume_events)
+	{
+		if (it != event_sessions.end())
+			event_sessions.erase(it);
+		return;
+	}
+	
+	if (it != event_sessions.end() && !it->second.logout_time)
+		return;  // cid is still in use by another connection
+	
+	if (it == event_sessions.end() || !resume)
+	{
+		event_session &es = event_sessions[client->id];
+		es.events.reset(srvconf.resume_events);
+		es.logout_time = 0;
+		return;
+	}
+	
+	event_session &es = it->second;
+	es.logout_time = 0;
+	
+	vector<const string*> missed;
+	if (es.events.getSince(last_seq, missed))
+	{
+		snprintf(msg, sizeof(msg), "RESUME replay %u", last_seq);
+		send_msg(client->sock, msg);
+		
+		for (unsigned int i=0; i < missed.size(); i++)
+			send_msg(client->sock, missed[i]->c_str());
+		
+		log_msg("resume", "(%d) replayed %d events to cid %d",
+			client->sock, (int) missed.size(), client->id);
+		return;
+	}
+	
+	// gap too large; send the current state of the client's games instead
+	snprintf(msg, sizeof(msg), "RESUME keyframe %u", es.events.getSeq());
+	send_msg(client->sock, msg);
+	
+	GameController::client_games_type keyframe_games = GameController::getPlayerGames(client->id);
+	
+	// a live keyframe would bypass the spectator delay
+	if (!GameController::hasSpectatorFeed())
+	{
+		const GameController::client_games_type &spectated = GameController::getSpectatorGames(client->id);
+		keyframe_games.insert(spectated.begin(), spectated.end());
+	}
+	
+	for (GameController::client_games_type::const_iterator e = keyframe_games.begin(); e != keyframe_games.end(); e++)
+	{
+		GameController *g = *e;
+		
+		send_gameinfo(client, g->getGameId());
+		send_playerlist(g->getGameId(), client);
+		g->sendKeyframe(client->id);
+	}
+	
+	log_msg("resume", "(%d) sent keyframe of %d games to cid %d",
+		client->sock, (int) keyframe_games.size(), client->id);
+}
+
 int client_cmd_pclient(clientcon *client, Tokenizer &t)
 {
 	unsigned int version = t.getNextInt();
 	string uuid = t.getNext();
     unsigned int cid = t.getNextInt();
 	
+	// optional: sequence number of the last event received before a reconnect
+	string sseq;
+	const bool resume = t.getNext(sseq);
+	const unsigned int last_seq = Tokenizer::string2int(sseq);
+	
 	if (version < VERSION_COMPAT)
 	{
 		log_msg("client", "client %d version (%d) too old", client->sock, version);
@@ -363,14 +876,14 @@ int client_cmd_pclient(clientcon *client, Tokenizer &t)
 		
 		if (uuid.length())
 		{
-			clientconar_type::iterator it = con_archive.find(uuid);
+			const ConnectionArchive::entry *ar = con_archive.find(uuid);
 			
-			if (it != con_archive.end())
+			if (ar)
 			{
-				clientcon *conc = get_client_by_id(it->second.id);
+				clientcon *conc = get_client_by_id(ar->id);
 				if (!conc)
 				{
-					client->id = it->second.id;
+					client->id = ar->id;
 					use_prev_cid = true;
 					
 					log_msg("uuid", "(%d) using previous cid (%d) for uuid '%s'", client->sock, client->id, client->uuid);
@@ -403,6 +916,8 @@ int client_cmd_pclient(clientcon *client, Tokenizer &t)
 			
 		send_msg(client->sock, msg);
 		
+		session_start(client, resume, last_seq);
+		
 		
 		// send warning if UUID is already in use
 		if (uuid_inuse)
@@ -442,16 +957,11 @@ int client_cmd_info(clientcon *client, Tokenizer &t)
 	{
 		// store UUID in connection-archive
 		if (*client->uuid)
-		{
-			clientcon_archive ar;
-			memset(&ar, 0, sizeof(ar));
-			ar.id = client->id;
-			con_archive[client->uuid] = ar;
-		}
+			con_archive.add(client->uuid, client->id);
 		
 		
 		// send welcome message
-		const string welcome_message = config.get("welcome_message");
+		const string welcome_message = srvconf.welcome_message;
 		if (welcome_message.length())
 		{
 			snprintf(msg, sizeof(msg),
@@ -462,12 +972,8 @@ int client_cmd_info(clientcon *client, Tokenizer &t)
 		}
 		
 		
-		// send foyer snapshot broadcast
-		snprintf(msg, sizeof(msg),
-			"%d %d \"%s\"",
-			SnapFoyerJoin, client->id, client->info.name);
-		
-		client_snapshot(-1, SnapFoyer, msg);
+		// announce client with the next foyer update
+		foyer_join(client);
 	}
 	
 	client->state |= SentInfo;
@@ -493,7 +999,7 @@ int client_cmd_chat(clientcon *client, Tokenizer &t)
 			return 0;
 		}
 		
-		if ((unsigned int)time_since_last_chat > (unsigned int) config.getInt("flood_chat_interval"))
+		if ((unsigned int)time_since_last_chat > (unsigned int) srvconf.flood_chat_interval)
 		{
 			// reset flood-measure for new interval
 			client->last_chat = time(NULL);
@@ -501,12 +1007,12 @@ int client_cmd_chat(clientcon *client, Tokenizer &t)
 		}
 		
 		// is client flooding?
-		if (++client->chat_count >= (unsigned int) config.getInt("flood_chat_per_interval"))
+		if (++client->chat_count >= (unsigned int) srvconf.flood_chat_per_interval)
 		{
 			log_msg("flooding", "client (%d) caught flooding the chat", client->id);
 			
 			// mute client for n-seconds
-			client->last_chat = time(NULL) + config.getInt("flood_chat_mute");
+			client->last_chat = time(NULL) + srvconf.flood_chat_mute;
 			client->chat_count = 0;
 			
 			send_err(client, 0, "you have been muted for some time");
@@ -547,55 +1053,10 @@ int client_cmd_chat(clientcon *client, Tokenizer &t)
 bool send_gameinfo(clientcon *client, int gid)
 {
 	const GameController *g;
-	if (!(g = get_game_by_id(gid)))
+	if (!client || !(g = get_game_by_id(gid)))
 		return false;
 	
-	int game_mode = 0;
-	switch ((int)g->getGameType())
-	{
-	case GameController::SNG:
-		game_mode = GameModeSNG;
-		break;
-	case GameController::FreezeOut:
-		game_mode = GameModeFreezeOut;
-		break;
-	case GameController::RingGame:
-		game_mode = GameModeRingGame;
-		break;
-	}
-	
-	int state = 0;
-	if (g->isEnded())
-		state = GameStateEnded;
-	else if (g->isStarted())
-		state = GameStateStarted;
-	else if (g->isPaused())
-        state = GameStatePaused;
-    else
-		state = GameStateWaiting;
-	
-	snprintf(msg, sizeof(msg),
-		"GAMEINFO %d %d:%d:%d:%d:%d:%d:%d:%d %d:%d:%d:%d:%d:%d \"%s\"",
-		gid,
-		(int) GameTypeHoldem,
-		game_mode,
-		state,
-		(g->isPlayer(client->id) ? GameInfoRegistered : 0) |
-			(g->isSpectator(client->id) ? GameInfoSubscribed : 0) |
-			(g->hasPassword() ? GameInfoPassword : 0) |
-			(g->getOwner() == client->id ? GameInfoOwner : 0) |
-			(g->getRestart() ? GameInfoRestart : 0),
-		g->getPlayerMax(),
-		g->getPlayerCount(),
-		g->getPlayerTimeout(),
-		g->getPlayerStakes(),
-		g->getBlindsStart(),
-		g->getBlindsFactor(),
-		g->getBlindsTime(),
- 		g->getAnte(),
-		(g->getMandatoryStraddle() ? 1 : 0),
-		(g->getEnableInsurance() ? 1 : 0),
-        g->getName().c_str());
+	lobby_gameinfo(g, client->id, msg, sizeof(msg));
 	
 	send_msg(client->sock, msg);
 	
@@ -605,8 +1066,11 @@ bool send_gameinfo(clientcon *client, int gid)
 bool client_cmd_request_gameinfo(clientcon *client, Tokenizer &t)
 {
 	string sgid;
-	while (t.getNext(sgid))   // FIXME: have maximum for count of requests
+	for (unsigned int i=0; t.getNext(sgid); i++)
 	{
+		if (i == REQUEST_ITEMS_MAX)
+			return false;
+		
 		const int gid = Tokenizer::string2int(sgid);
 		send_gameinfo(client, gid);
 	}
@@ -617,8 +1081,11 @@ bool client_cmd_request_gameinfo(clientcon *client, Tokenizer &t)
 bool client_cmd_request_clientinfo(clientcon *client, Tokenizer &t)
 {
 	string scid;
-	while (t.getNext(scid))   // FIXME: have maximum for count of requests
+	for (unsigned int i=0; t.getNext(scid); i++)
 	{
+		if (i == REQUEST_ITEMS_MAX)
+			return false;
+		
 		const socktype cid = Tokenizer::string2int(scid);
 		const clientcon *c;
 		if ((c = get_client_by_id(cid)))
@@ -660,17 +1127,11 @@ bool send_playerlist(int gid, clientcon *client)
 	if (!g)
 		return false;
 	
-	vector<string> client_list;
-	g->getPlayerList(client_list);
+	MessageWriter w(msg);
+	w << "PLAYERLIST " << gid << ' ';
+	g->writePlayerList(w);
 	
-	string slist;
-	for (unsigned int i=0; i < client_list.size(); i++)
-	{
-		slist += client_list[i];
-	}
-	
-	snprintf(msg, sizeof(msg), "PLAYERLIST %d %s", gid, slist.c_str());
-	send_msg(client->sock, msg);
+	send_msg(client->sock, w.c_str(), w.length());
 	
 	return true;
 }
@@ -685,8 +1146,11 @@ bool client_cmd_request_playerlist(clientcon *client, Tokenizer &t)
 
 bool client_cmd_request_serverinfo(clientcon *client, Tokenizer &t)
 {
+	metrics_refresh();
+	
 	snprintf(msg, sizeof(msg), "SERVERINFO "
-		"%d:%d %d:%d %d:%d %d:%d %d:%d %d:%d %d:%d %d:%d",
+		"%d:%d %d:%d %d:%d %d:%d %d:%d %d:%d %d:%d %d:%d "
+		"%d:%u %d:%u %d:%u %d:%u %d:%u %d:%u %d:%u %d:%u",
 		StatsServerStarted,		(unsigned int) stats.server_started,
 		StatsClientsConnected,		(unsigned int) stats.clients_connected,
 		StatsClientsIntroduced,		(unsigned int) stats.clients_introduced,
@@ -694,10 +1158,103 @@ bool client_cmd_request_serverinfo(clientcon *client, Tokenizer &t)
 		StatsGamesCreated,		(unsigned int) stats.games_created,
 		StatsClientCount,		(unsigned int) clients.size(),
 		StatsGamesCount,		(unsigned int) games.size(),
-		StatsConarchiveCount,		(unsigned int) con_archive.size());
+		StatsConarchiveCount,		(unsigned int) con_archive.size(),
+		StatsCommandsExecuted,		(unsigned int) smetrics.execute->count(),
+		StatsCommandLatencyMedian,	(unsigned int) smetrics.execute->quantile(0.5),
+		StatsCommandLatencyP99,		(unsigned int) smetrics.execute->quantile(0.99),
+		StatsGameloopMedian,		(unsigned int) smetrics.gameloop->quantile(0.5),
+		StatsGameloopP99,		(unsigned int) smetrics.gameloop->quantile(0.99),
+		StatsDatabaseLatency,		(unsigned int)(smetrics.db_latency->get() * 1000000),
+		StatsTablesCount,		(unsigned int) smetrics.tables->get(),
+		StatsOutputQueued,		(unsigned int) smetrics.output_queued->get());
+	
+	send_msg(client->sock, msg);
+	
+	return true;
+}
+
+bool send_ranklist(clientcon *client, unsigned int first, unsigned int count)
+{
+	const Leaderboard &board = get_leaderboard();
 	
+	if (count > RANKING_PAGE_MAX)
+		count = RANKING_PAGE_MAX;
+	
+	vector<const Leaderboard::entry*> list;
+	board.getRange(first, count, list);
+	
+	snprintf(msg, sizeof(msg), "RANKLIST %u %u %u",
+		first, (unsigned int) list.size(), board.size());
 	send_msg(client->sock, msg);
 	
+	for (unsigned int i=0; i < list.size(); i++)
+	{
+		snprintf(msg, sizeof(msg),
+			"RANKINFO %u %d %u \"name:%s\"",
+			first + i,
+			list[i]->score, list[i]->gamecount, list[i]->name.c_str());
+		
+		send_msg(client->sock, msg);
+	}
+	
+	return true;
+}
+
+bool client_cmd_request_ranktop(clientcon *client, Tokenizer &t)
+{
+	const int count = t.getNextInt();
+	
+	return send_ranklist(client, 1, (count > 0) ? count : RANKING_PAGE_DEFAULT);
+}
+
+bool client_cmd_request_rankpage(clientcon *client, Tokenizer &t)
+{
+	const socktype cid = t.getNextInt();
+	int count = t.getNextInt();
+	
+	const clientcon *c = get_client_by_id(cid);
+	if (!c || !*c->uuid)
+		return false;
+	
+	const unsigned int rank = get_leaderboard().getRank(c->uuid);
+	if (!rank)
+		return false;
+	
+	if (count <= 0)
+		count = RANKING_PAGE_DEFAULT;
+	else if (count > RANKING_PAGE_MAX)
+		count = RANKING_PAGE_MAX;
+	
+	// center the page around the player
+	const unsigned int first = (rank > (unsigned int) count / 2) ? rank - count / 2 : 1;
+	
+	return send_ranklist(client, first, count);
+}
+
+bool client_cmd_request_rank(clientcon *client, Tokenizer &t)
+{
+	const Leaderboard &board = get_leaderboard();
+	
+	string scid;
+	for (unsigned int i=0; i < RANKING_PAGE_MAX && t.getNext(scid); i++)
+	{
+		const socktype cid = Tokenizer::string2int(scid);
+		const clientcon *c = get_client_by_id(cid);
+		if (!c)
+			continue;
+		
+		// unranked players are reported with rank 0
+		const unsigned int rank = *c->uuid ? board.getRank(c->uuid) : 0;
+		const Leaderboard::entry *e = board.getEntry(rank);
+		
+		snprintf(msg, sizeof(msg),
+			"PLAYERRANK %d %u %u %d %u",
+			cid, rank, board.size(),
+			e ? e->score : 0, e ? e->gamecount : 0);
+		
+		send_msg(client->sock, msg);
+	}
+	
 	return true;
 }
 
@@ -789,10 +1346,18 @@ int client_cmd_request(clientcon *client, Tokenizer &t)
 		cmderr = !client_cmd_request_gameinfo(client, t);
 	else if (request == "gamelist")
 		cmderr = !client_cmd_request_gamelist(client, t);
+	else if (request == "lobby")
+		cmderr = !lobby_send_page(client, t);
 	else if (request == "playerlist")
 		cmderr = !client_cmd_request_playerlist(client, t);
 	else if (request == "serverinfo")
 		cmderr = !client_cmd_request_serverinfo(client, t);
+	else if (request == "ranktop")
+		cmderr = !client_cmd_request_ranktop(client, t);
+	else if (request == "rankpage")
+		cmderr = !client_cmd_request_rankpage(client, t);
+	else if (request == "rank")
+		cmderr = !client_cmd_request_rank(client, t);
 	else if (request == "start")
 		cmderr = !client_cmd_request_gamestart(client, t);
 	else if (request == "restart")
@@ -934,11 +1499,6 @@ int client_cmd_register(clientcon *client, Tokenizer &t)
 	}
 
 	log_msg("game ", "registering user %d to game %d", client->id, gid);
-    vector<int> player_list;
-    g->getPlayerList(player_list);
-    for (vector<int>::iterator e1 = player_list.begin(); e1 != player_list.end(); e1++) {
-        log_msg("game ", " found player %d for game %d", *e1, gid);
-    }
 
 	
 	if (g->isStarted() && g->getGameType() != GameController::RingGame)
@@ -974,20 +1534,11 @@ int client_cmd_register(clientcon *client, Tokenizer &t)
 	}
 	
 	// check for max-games-register limit
-	const unsigned int register_limit = config.getInt("max_register_per_player");
-	unsigned int count = 0;
-	for (games_type::const_iterator e = games.begin(); e != games.end(); e++)
+	const unsigned int register_limit = srvconf.max_register_per_player;
+	if (GameController::getPlayerGames(client->id).size() >= register_limit)
 	{
-		GameController *g = e->second;
-		
-		if (g->isPlayer(client->id))
-		{
-			if (++count == register_limit)
-			{
-				send_err(client, 0 /*FIXME*/, "register limit per player is reached");
-				return 1;
-			}
-		}
+		send_err(client, 0 /*FIXME*/, "register limit per player is reached");
+		return 1;
 	}
 	
 	if (!g->addPlayer(client->id, client->uuid, player_stake))
@@ -1007,8 +1558,12 @@ int client_cmd_register(clientcon *client, Tokenizer &t)
     // send gameinfo so user gbc can update user_game_history.joined_at = 0 for current user
     send_gameinfo(client, gid);
 
-    // send playerlist to all registered players
-    send_playerlist_all(gid);
+	// send playerlist to all registered players; a tournament field is too
+	// large to rebroadcast on every registration, they ask with REQUEST playerlist
+	if (g->getGameType() == GameController::FreezeOut)
+		send_playerlist(gid, client);
+	else
+		send_playerlist_all(gid);
 	
 	return 0;
 }
@@ -1072,11 +1627,14 @@ int client_cmd_unregister(clientcon *client, Tokenizer &t)
         //unregister a specific game
         return unregister_game(client, gid);
     } else {
-        //unregister all games
-        for (games_type::const_iterator e = games.begin(); e != games.end(); e++) {
-            int id = e->first;
-            unregister_game(client, id);
-        }
+        //unregister all games the client is registered to
+        vector<int> gids;
+        const GameController::client_games_type &player_games = GameController::getPlayerGames(client->id);
+        for (GameController::client_games_type::const_iterator e = player_games.begin(); e != player_games.end(); e++)
+            gids.push_back((*e)->getGameId());
+
+        for (unsigned int i=0; i < gids.size(); i++)
+            unregister_game(client, gids[i]);
     }
 
     return 0;
@@ -1111,20 +1669,11 @@ int client_cmd_subscribe(clientcon *client, Tokenizer &t)
 	}
 	
 	// check for max-games-subscribe limit
-	const unsigned int subscribe_limit = config.getInt("max_subscribe_per_player");
-	unsigned int count = 0;
-	for (games_type::const_iterator e = games.begin(); e != games.end(); e++)
+	const unsigned int subscribe_limit = srvconf.max_subscribe_per_player;
+	if (GameController::getSpectatorGames(client->id).size() >= subscribe_limit)
 	{
-		GameController *g = e->second;
-		
-		if (g->isSpectator(client->id))
-		{
-			if (++count == subscribe_limit)
-			{
-				send_err(client, 0 /*FIXME*/, "subscribe limit per player is reached");
-				return 1;
-			}
-		}
+		send_err(client, 0 /*FIXME*/, "subscribe limit per player is reached");
+		return 1;
 	}
 
 	// password is control by gbc
@@ -1247,7 +1796,8 @@ int client_cmd_action(clientcon *client, Tokenizer &t)
 	}
 	
 	
-	g->setPlayerAction(client->id, a, arg);
+	if (g->setPlayerAction(client->id, a, arg))
+		g->dispatchPlayerAction(client->id);
 	
 	return 0;
 }
@@ -1330,14 +1880,14 @@ int client_cmd_buy_insurance(clientcon *client, Tokenizer &t)
 
 int client_cmd_create(clientcon *client, Tokenizer &t)
 {
-	if (!config.getBool("perm_create_user") && !(client->state & Authed))
+	if (!srvconf.perm_create_user && !(client->state & Authed))
 	{
 		send_err(client, ErrNoPermission, "no permission");
 		return 1;
 	}
 	
 	// check for server games count limit
-	if (games.size() >= (unsigned int) config.getInt("max_games"))
+	if (games.size() >= (unsigned int) srvconf.max_games)
 	{
 		send_err(client, 0 /*FIXME*/, "server games count reached");
 		return 1;
@@ -1345,20 +1895,11 @@ int client_cmd_create(clientcon *client, Tokenizer &t)
 	
 	
 	// check for max-games-create limit
-	unsigned int create_limit = config.getInt("max_create_per_player");
-	unsigned int count = 0;
-	for (games_type::const_iterator e = games.begin(); e != games.end(); e++)
+	const unsigned int create_limit = srvconf.max_create_per_player;
+	if (GameController::getOwnedGames(client->id).size() >= create_limit)
 	{
-		GameController *g = e->second;
-		
-		if (g->getOwner() == client->id)
-		{
-			if (++count == create_limit)
-			{
-				send_err(client, 0 /*FIXME*/, "create limit per player is reached");
-				return 1;
-			}
-		}
+		send_err(client, 0 /*FIXME*/, "create limit per player is reached");
+		return 1;
 	}
 	
 	bool cmderr = false;
@@ -1524,6 +2065,8 @@ int client_cmd_create(clientcon *client, Tokenizer &t)
             ((SitAndGoGameController*)g)->setExpireIn(ginfo.expire_in);
         } else if (ginfo.type == GameController::SNG) {
             g = new SNGGameController();
+        } else if (ginfo.type == GameController::FreezeOut) {
+            g = new TournamentGameController();
         }
 
         const int gid = ginfo.game_id;
@@ -1563,7 +2106,7 @@ int client_cmd_auth(clientcon *client, Tokenizer &t)
 {
 	bool cmderr = true;
 	
-	if (t.count() >= 2 && config.get("auth_password").length())
+	if (t.count() >= 2 && srvconf.auth_password.length())
 	{
 		const int type = t.getNextInt();
 		const string passwd = t.getNext();
@@ -1571,7 +2114,7 @@ int client_cmd_auth(clientcon *client, Tokenizer &t)
 		// -1 is server-auth
 		if (type == -1)
 		{
-			if (passwd == config.get("auth_password"))
+			if (passwd == srvconf.auth_password)
 			{
 				client->state |= Authed;
 				
@@ -1618,11 +2161,19 @@ int client_cmd_config(clientcon *client, Tokenizer &t)
 			const string varvalue = t.getNext();
 			
 			config.set(varname, varvalue);
+			server_config_apply(config, &srvconf);
 			
 			log_msg("config", "%s (%d) set var '%s' to '%s'",
 				client->info.name, client->id,
 				varname.c_str(), varvalue.c_str());
 		}
+		else if (action == "reload")
+		{
+			if (server_config_reload())
+				client_chat(-1, client->id, "Config reloaded");
+			else
+				cmderr = true;
+		}
 		else if (action == "save")
 		{
 			char cfgfile[1024];
@@ -1648,30 +2199,125 @@ int client_cmd_config(clientcon *client, Tokenizer &t)
 	return 0;
 }
 
-int client_execute(clientcon *client, const char *cmd)
+int client_cmd_trace(clientcon *client, Tokenizer &t)
 {
-	Tokenizer t(" ");
-	t.parse(cmd);  // parse the command line
+	bool cmderr = false;
 	
-	// ignore blank command
-	if (!t.count())
-		return 0;
+	if (client->state & Authed)
+	{
+		const string action = t.getNext();
+		
+		if (action == "start")
+		{
+			trace_start();
+			log_msg("trace", "%s (%d) started trace recording",
+				client->info.name, client->id);
+		}
+		else if (action == "stop")
+		{
+			trace_stop();
+			log_msg("trace", "%s (%d) stopped trace recording",
+				client->info.name, client->id);
+		}
+		else if (action == "dump")
+		{
+			string filename = t.getNext();
+			
+			// only plain file names inside the log directory
+			if (!filename.length())
+			{
+				snprintf(msg, sizeof(msg), "trace-%u.json", (unsigned int) time(NULL));
+				filename = msg;
+			}
+			
+			if (filename.find('/') != string::npos || filename.find('\\') != string::npos || filename[0] == '.')
+				cmderr = true;
+			else
+			{
+				char tracefile[1024];
+				snprintf(tracefile, sizeof(tracefile), "%s/../logs/%s", sys_config_path(), filename.c_str());
+				
+				if (trace_dump(tracefile))
+				{
+					snprintf(msg, sizeof(msg), "Trace written to %s", tracefile);
+					client_chat(-1, client->id, msg);
+				}
+				else
+					cmderr = true;
+			}
+		}
+		else
+			cmderr = true;
+	}
+	else
+		cmderr = true;
 	
-	//dbg_msg("clientsock", "(%d) executing '%s'", client->sock, cmd);
+	if (!cmderr)
+		send_ok(client);
+	else
+		send_err(client, 0, "trace request failed");
 	
-	// FIXME: could be done better...
-	// extract message-id if present
-	const char firstchar = t[0][0];
-	if (firstchar >= '0' && firstchar <= '9')
-		client->last_msgid = t.getNextInt();
+	return 0;
+}
+
+int client_cmd_foyer(clientcon *client, Tokenizer &t)
+{
+	string request;
+	t >> request;
+	
+	if (request == "subscribe")
+	{
+		client->foyer = true;
+		send_ok(client);
+		foyer_send_roster(client);
+	}
+	else if (request == "unsubscribe")
+	{
+		client->foyer = false;
+		send_ok(client);
+	}
 	else
-		client->last_msgid = -1;
+	{
+		send_err(client, ErrParameters);
+		return 1;
+	}
 	
+	return 0;
+}
+
+int client_cmd_lobby(clientcon *client, Tokenizer &t)
+{
+	string request;
+	t >> request;
 	
-	// get command argument
-	const string command = t.getNext();
+	if (request == "subscribe" && lobby_subscribe(client, t))
+	{
+		send_ok(client);
+		lobby_send_subscribed(client);
+	}
+	else if (request == "unsubscribe")
+	{
+		lobby_unsubscribe(client->id);
+		send_ok(client);
+	}
+	else
+	{
+		send_err(client, ErrParameters);
+		return 1;
+	}
+	
+	return 0;
+}
+
+int client_execute_command(clientcon *client, const string &command, Tokenizer &t)
+{
+	// gateway marker for the end of a command's reply; valid in any state
+	if (command == "SYNC")
+	{
+		send_msg(client->sock, "SYNC");
+		return 0;
+	}
 	
-	//log_msg("client execute", "cmd = %s", command.c_str());
 	if (!(client->state & Introduced))  // state: not introduced
 	{
 		if (command == "PCLIENT")
@@ -1709,6 +2355,12 @@ int client_execute(clientcon *client, const char *cmd)
 		return client_cmd_auth(client, t);
 	else if (command == "CONFIG")
 		return client_cmd_config(client, t);
+	else if (command == "TRACE")
+		return client_cmd_trace(client, t);
+	else if (command == "FOYER")
+		return client_cmd_foyer(client, t);
+	else if (command == "LOBBY")
+		return client_cmd_lobby(client, t);
 	else if (command == "STRADDLE")
 		return client_cmd_nextroundstraddle(client, t);
 	else if (command == "BUYINSURANCE")
@@ -1724,6 +2376,73 @@ int client_execute(clientcon *client, const char *cmd)
 	return 0;
 }
 
+int client_execute(clientcon *client, const char *cmd)
+{
+	TraceScope trace("client_execute", client->id);
+	const unsigned long long exec_start = sys_clock_usec();
+	
+	Tokenizer t(" ");
+	t.parse(cmd);  // parse the command line
+	
+	// ignore blank command
+	if (!t.count())
+		return 0;
+	
+	//dbg_msg("clientsock", "(%d) executing '%s'", client->sock, cmd);
+	
+	// FIXME: could be done better...
+	// extract message-id if present
+	const char firstchar = t[0][0];
+	if (firstchar >= '0' && firstchar <= '9')
+		client->last_msgid = t.getNextInt();
+	else
+		client->last_msgid = -1;
+	
+	
+	// get command argument
+	const string command = t.getNext();
+	
+	//log_msg("client execute", "cmd = %s", command.c_str());
+	const int rc = client_execute_command(client, command, t);
+	
+	metrics_command(command, sys_clock_usec() - exec_start);
+	
+	return rc;
+}
+
+// token bucket check of a framed command line, done before it is tokenized;
+// throttled commands are delayed at first, then refused, then the client gets disconnected
+static RateLimiter::Verdict client_ratelimit(clientcon *client, const char *cmd, int length)
+{
+	if (srvconf.rate_commands <= 0)
+	{
+		client->rate.clearDelay();
+		return RateLimiter::Pass;
+	}
+	
+	RateLimiter::Limits limits;
+	for (unsigned int i=0; i < RateClasses; i++)
+	{
+		limits.rate[i] = rate_limits[i].rate;
+		limits.burst[i] = rate_limits[i].burst;
+	}
+	
+	limits.rate[RateGeneral] = srvconf.rate_commands;
+	limits.burst[RateGeneral] = srvconf.rate_burst;
+	limits.delay_strikes = srvconf.rate_delay_strikes;
+	limits.disconnect_strikes = srvconf.rate_disconnect_strikes;
+	limits.forgive_usec = RATE_FORGIVE_USEC;
+	
+	const unsigned int strikes = client->rate.getStrikes();
+	const RateLimiter::Verdict verdict = client->rate.check(
+		RateLimiter::commandClass(cmd, length), sys_clock_usec(), limits);
+	
+	if (client->rate.getStrikes() > strikes)
+		smetrics.rate_limited->inc();
+	
+	return verdict;
+}
+
 // returns zero if no cmd was found or no bytes remaining after exec
 int client_parsebuffer(clientcon *client)
 {
@@ -1746,13 +2465,44 @@ int client_parsebuffer(clientcon *client)
 	// is there a command in queue?
 	if (found_nl != -1)
 	{
+		const RateLimiter::Verdict verdict = client_ratelimit(client, client->msgbuf, found_nl);
+		
+		// the command stays queued and client_ratelimit_resume() retries it;
+		// the socket isn't read meanwhile, so the sender is held back by TCP
+		if (verdict == RateLimiter::Delay)
+		{
+			if (!client->rate_paused)
+			{
+				client_poller.remove(client->sock);
+				client->rate_paused = true;
+			}
+			
+			return 0;
+		}
+		
+		if (verdict == RateLimiter::Disconnect)
+		{
+			log_msg("flooding", "client (%d) disconnected for exceeding the rate limit", client->id);
+			client_remove(client->sock);
+			return 0;
+		}
+		
 		// extract command
 		char cmd[sizeof(client->msgbuf)];
 		memcpy(cmd, client->msgbuf, found_nl);
 		cmd[found_nl] = '\0';
 		
 		//log_msg("clientsock", "(%d) command: '%s' (len=%d)", client->sock, cmd, found_nl);
-		if (client_execute(client, cmd) != -1)  // client quitted ?
+		int rc = 0;
+		if (verdict == RateLimiter::Refuse)
+		{
+			client->last_msgid = (cmd[0] >= '0' && cmd[0] <= '9') ? atoi(cmd) : -1;
+			send_err(client, ErrRateLimit, "rate limit exceeded");
+		}
+		else
+			rc = client_execute(client, cmd);
+		
+		if (rc != -1)  // client quitted ?
 		{
 			// move the rest to front
 			memmove(client->msgbuf, client->msgbuf + found_nl + 1, client->buflen - (found_nl + 1));
@@ -1773,6 +2523,40 @@ int client_parsebuffer(clientcon *client)
 	return retval;
 }
 
+// continue the queued commands of clients waiting for rate limit tokens
+static void client_ratelimit_resume()
+{
+	// executing commands may remove clients, so they are looked up by socket
+	static vector<socktype> paused;
+	
+	paused.clear();
+	for (clients_type::const_iterator e = clients.begin(); e != clients.end(); e++)
+		if (e->rate_paused)
+			paused.push_back(e->sock);
+	
+	for (unsigned int i=0; i < paused.size(); i++)
+	{
+		clientcon *client = get_client_by_sock(paused[i]);
+		if (!client)
+			continue;
+		
+		while (client_parsebuffer(client));
+		
+		// the queued commands are through (or gone); read the socket again
+		client = get_client_by_sock(paused[i]);
+		if (client && !client->rate.isDelayed())
+		{
+			client->rate_paused = false;
+			
+			if (!client_poller.add(client->sock))
+			{
+				log_msg("clientsock", "(%d) error: cannot watch socket", client->sock);
+				client_remove(client->sock);
+			}
+		}
+	}
+}
+
 int client_handle(socktype sock)
 {
 	char buf[1024];
@@ -1809,36 +2593,49 @@ int client_handle(socktype sock)
 	return bytes;
 }
 
-void remove_expired_conar_entries()
+void client_flush()
 {
-	time_t curtime = time(NULL);
-	unsigned int expire = config.getInt("conarchive_expire");
+	client_failed.clear();
+	client_writer.flush(client_failed);
 	
-#if 0
-	dbg_msg("clientar", "scanning for expired entries");
-#endif
+	// clients falling too far behind would keep their output queued forever
+	for (clients_type::const_iterator e = clients.begin(); e != clients.end(); e++)
+		if (client_writer.pending(e->sock) > CLIENT_MAX_OUTPUT)
+			client_failed.push_back(e->sock);
 	
-	for (clientconar_type::iterator e = con_archive.begin(); e != con_archive.end();)
+	for (unsigned int i=0; i < client_failed.size(); i++)
 	{
-		clientcon_archive *conar = &(e->second);
+		const socktype sock = client_failed[i];
 		
-		if (conar->logout_time && (unsigned int)difftime(curtime, conar->logout_time) > expire)
-		{
-			dbg_msg("clientar", "removing expired entry %s", e->first.c_str());
-			con_archive.erase(e++);
-		}
-		else
-			++e;
+		// a failed socket might also have exceeded the limit
+		if (!get_client_by_sock(sock))
+			continue;
+		
+		log_msg("clientsock", "(%d) dropping client: output not deliverable (%d queued)",
+			sock, (int) client_writer.pending(sock));
+		client_remove(sock);
 	}
 }
 
-
 int gameinit()
 {
 	// initialize server stats struct
 	memset(&stats, 0, sizeof(server_stats));
 	stats.server_started = time(NULL);
 	
+	metrics_init();
+	
+	con_archive.setLimits(srvconf.conarchive_max_per_ip, srvconf.conarchive_max);
+	
+	// io_backend: auto, io_uring, epoll or select
+	const string &backend = srvconf.io_backend;
+	client_poller.init(backend != "select");
+	if (!client_writer.init(backend == "auto" || backend == "io_uring") && backend == "io_uring")
+		log_msg("server", "io_uring not available; writing sockets directly");
+	
+	log_msg("server", "socket backend: %s polling, %s output",
+		client_poller.backendName(), client_writer.backendName());
+	
 	
 #ifndef NOSQLITE
 	ranking_setup();
@@ -1849,7 +2646,7 @@ int gameinit()
 	// initially add games for debugging purpose
 	if (!games.size())
 	{
-		for (int i=0; i < config.getInt("dbg_testgame_games"); i++)
+		for (int i=0; i < srvconf.dbg_testgame_games; i++)
 		{
 			GameController *g = new GameController();
 			const int gid = i;
@@ -1857,13 +2654,13 @@ int gameinit()
 			g->setName("test game");
 			g->setRestart(true);
 			g->setOwner(-1);
-			g->setPlayerMax(config.getInt("dbg_testgame_players"));
-			g->setPlayerTimeout(config.getInt("dbg_testgame_timeout"));
-			g->setPlayerStakes(config.getInt("dbg_testgame_stakes"));
+			g->setPlayerMax(srvconf.dbg_testgame_players);
+			g->setPlayerTimeout(srvconf.dbg_testgame_timeout);
+			g->setPlayerStakes(srvconf.dbg_testgame_stakes);
 			
-			if (config.getBool("dbg_stresstest") && i > 10)
+			if (srvconf.dbg_stresstest && i > 10)
 			{
-                for (int j=0; j < config.getInt("dbg_testgame_players"); j++)
+                for (int j=0; j < srvconf.dbg_testgame_players; j++)
                      g->addPlayer(j*1000 + i, "DEBUG");
             }
             games[gid] = g;
@@ -1876,6 +2673,10 @@ int gameinit()
 
 int gameloop()
 {
+	const unsigned long long loop_start = sys_clock_usec();
+	
+	GameController::setSpectatorFeed(srvconf.spectator_interval > 0);
+	
 	// handle all games
 	for (games_type::iterator e = games.begin(); e != games.end();)
 	{
@@ -1928,12 +2729,51 @@ int gameloop()
 	
 	
 	// delete all expired archived connection-data (con_archive)
-	if ((unsigned int)difftime(time(NULL), last_conarchive_cleanup) > 5 * 60)
+	const unsigned int expired = con_archive.expire(time(NULL));
+	if (expired)
+		dbg_msg("clientar", "removed %d expired entries", expired);
+	
+	// drop event logs of clients not coming back; they expire with the archive
+	const time_t now = time(NULL);
+	if (now - last_session_expire >= 10)
 	{
-		remove_expired_conar_entries();
+		for (unordered_map<int,event_session>::iterator e = event_sessions.begin(); e != event_sessions.end();)
+		{
+			if (e->second.logout_time && now - e->second.logout_time > srvconf.conarchive_expire)
+				e = event_sessions.erase(e);
+			else
+				++e;
+		}
 		
-		last_conarchive_cleanup = time(NULL);
+		last_session_expire = now;
+	}
+	
+	// announce changed and deleted games to lobby subscribers
+	lobby_update();
+	
+	client_ratelimit_resume();
+	
+	// send the batched, delayed table events to spectators
+	const unsigned long long spectator_interval = srvconf.spectator_interval * 1000ULL;
+	if (loop_start - last_spectator_flush >= spectator_interval)
+	{
+		spectator_flush();
+		last_spectator_flush = loop_start;
 	}
 	
+	// broadcast collected foyer presence changes
+	const unsigned long long foyer_interval = srvconf.foyer_interval * 1000ULL;
+	if (loop_start - last_foyer_flush >= foyer_interval)
+	{
+		foyer_flush();
+		last_foyer_flush = loop_start;
+	}
+	
+#ifndef NOSQLITE
+	ranking_poll();
+#endif /* !NOSQLITE */
+	
+	smetrics.gameloop->record(sys_clock_usec() - loop_start);
+	
 	return 0;
 }
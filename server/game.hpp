@@ -28,15 +28,19 @@
 #include <map>
 #include <string>
 #include <ctime>
+#include <cstring>
 
 #include "Config.h"
 #include "Platform.h"
 #include "Network.h"
+#include "SocketPoller.hpp"
 #include "Protocol.h"
 
 #include "GameController.hpp"
 #include "SitAndGoGameController.hpp"
 #include "SNGGameController.hpp"
+#include "TournamentGameController.hpp"
+#include "RateLimiter.hpp"
 
 
 //! \brief Client connection states
@@ -82,24 +86,22 @@ typedef struct {
 	time_t last_chat;
 	//! \brief Flood-protection: count of sent messages per interval
 	unsigned int chat_count;
+	
+	//! \brief Client receives foyer presence updates
+	bool foyer;
+	
+	//! \brief Rate limiting: token buckets and strikes
+	RateLimiter rate;
+	//! \brief Rate limiting: socket not read while queued commands wait for tokens
+	bool rate_paused;
 } clientcon;
 
-//! \brief Archived client connection information
-typedef struct {
-	int id;
-	//sockaddr_in saddr;
-	time_t logout_time;
-} clientcon_archive;
-
 //! \brief Type for list of games
 typedef std::map<int,GameController*>	games_type;
 
 //! \brief Type for list of client connection information
 typedef std::vector<clientcon>	clients_type;
 
-//! \brief Type for list of archived client connection information
-typedef std::map<std::string,clientcon_archive>	clientconar_type;
-
 //! \brief Server stats
 typedef struct {
 	time_t		server_started;
@@ -113,7 +115,10 @@ typedef struct {
 // used by pserver.cpp
 int gameinit();
 int gameloop();
+void metrics_scrape(std::string &out);
 clients_type& get_client_vector();
+SocketPoller& get_client_poller();
+void client_flush();
 bool client_add(socktype sock, sockaddr_in *saddr);
 bool client_remove(socktype sock);
 int client_handle(socktype sock);
@@ -121,9 +126,16 @@ int client_handle(socktype sock);
 // used by GameController.cpp
 bool client_chat(int from_gid, int from_tid, int to, const char *message);
 bool client_snapshot(int from_gid, int from_tid, int to, int sid, const char *message);
+void metrics_table_tick(int state, unsigned long long usec);
 
 // used by ranking.cpp
 clientcon* get_client_by_id(int cid);
+void metrics_db_query(unsigned long long usec);
+
+// used by lobby.cpp
+games_type& get_game_map();
+int send_msg(socktype sock, const char *message, size_t length);
+inline int send_msg(socktype sock, const char *message) { return send_msg(sock, message, strlen(message)); }
 
 
 #endif /* _GAME_H */
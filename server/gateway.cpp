@@ -0,0 +1,705 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <deque>
+
+#if !defined(PLATFORM_WINDOWS)
+# include <sys/un.h>
+#endif
+
+#include "Config.h"
+#include "Platform.h"
+#include "Logger.h"
+#include "Network.h"
+#include "Tokenizer.hpp"
+#include "SocketPoller.hpp"
+
+#include "server_config.hpp"
+#include "gateway.hpp"
+#include "acceptor.hpp"
+
+using namespace std;
+
+// defined in pserver.cpp
+int listensock_create(unsigned int port, int backlog, bool local, bool reuseport);
+
+// a client not reading its data gets dropped beyond this
+#define GATEWAY_MAX_OUTPUT	(1024 * 1024)
+
+
+// how to treat the reply lines of a command sent to a backend
+typedef enum {
+	ReplyForward,	// pass everything to the client
+	ReplySwallow,	// shadow copy of a command; only pass game events
+	ReplyCollect	// part of a merged reply (game list, lobby page)
+} reply_mode;
+
+typedef struct {
+	reply_mode mode;
+	unsigned int job;	// collect job the reply belongs to
+} pending_reply;
+
+typedef struct {
+	socktype sock;
+	string inbuf;
+	string outbuf;
+	bool writing;			// watched for output
+	deque<pending_reply> pending;	// one entry per command sent, closed by SYNC
+} gw_link;
+
+typedef enum {
+	CollectGamelist,
+	CollectLobby
+} collect_kind;
+
+typedef struct {
+	unsigned int seq;
+	collect_kind kind;
+	unsigned int remaining;		// backends yet to answer
+	bool failed;			// an error was reported instead
+	string gamelist;
+	unsigned int lobby_total;
+	unsigned int lobby_offset;
+	unsigned int lobby_count;
+	vector<string> lines;
+} collect_job;
+
+typedef struct {
+	socktype sock;
+	sockaddr_in saddr;
+	string inbuf;
+	string outbuf;
+	bool writing;
+	vector<gw_link> links;		// one per backend; backend 0 is home
+	deque<collect_job> jobs;
+	unsigned int job_seq;
+	unsigned int index;		// within gw_clients
+	bool touched;			// read from or became writable during this pass
+	bool dead;
+} gw_client;
+
+typedef vector<gw_client*> gw_clients_type;
+
+// client a descriptor belongs to; link is -1 for the client's own socket
+typedef struct {
+	gw_client *client;
+	int link;
+} gw_owner;
+
+static vector<string> backends;
+static gw_clients_type gw_clients;
+static vector<gw_owner> gw_owners;	// indexed by descriptor
+static SocketPoller gw_poller;
+
+
+static socktype gateway_connect(const string &path)
+{
+#if !defined(PLATFORM_WINDOWS)
+	socktype sock = socket_create(PF_UNIX, SOCK_STREAM, 0);
+	if (sock == -1)
+		return -1;
+	
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+	
+	if (socket_connect(sock, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+	{
+		socket_close(sock);
+		return -1;
+	}
+	
+	socket_setnonblocking(sock);
+	
+	return sock;
+#else
+	return -1;
+#endif
+}
+
+static unsigned int gateway_backend(int gid)
+{
+	if (gid < 0)
+		return 0;
+	
+	return gid % backends.size();
+}
+
+// lines passed on from backends even while a command's reply is swallowed
+static bool gateway_is_event(Tokenizer &t)
+{
+	if (!t.count())
+		return false;
+	
+	const string &type = t[0];
+	
+	if (type == "SNAP" || type == "GAMEINFO" || type == "GAMEDEL")
+		return true;
+	
+	// game and table chat carry gid:tid
+	if (type == "MSG" && t.count() > 1 && t[1].find(':') != string::npos)
+		return true;
+	
+	return false;
+}
+
+static void gateway_send(gw_client *c, unsigned int backend, const string &line,
+	reply_mode mode, unsigned int job=0)
+{
+	gw_link &link = c->links[backend];
+	
+	// SYNC marks where the reply of this command ends
+	link.outbuf += line;
+	link.outbuf += "\nSYNC\n";
+	
+	pending_reply pr;
+	pr.mode = mode;
+	pr.job = job;
+	link.pending.push_back(pr);
+}
+
+static void gateway_send_all(gw_client *c, const string &line)
+{
+	for (unsigned int i=0; i < c->links.size(); i++)
+		gateway_send(c, i, line, i ? ReplySwallow : ReplyForward);
+}
+
+static void gateway_collect(gw_client *c, collect_kind kind, const string &line)
+{
+	collect_job job;
+	job.seq = c->job_seq++;
+	job.kind = kind;
+	job.remaining = c->links.size();
+	job.failed = false;
+	job.lobby_total = 0;
+	job.lobby_offset = 0;
+	job.lobby_count = 0;
+	c->jobs.push_back(job);
+	
+	for (unsigned int i=0; i < c->links.size(); i++)
+		gateway_send(c, i, line, ReplyCollect, job.seq);
+}
+
+static collect_job* gateway_find_job(gw_client *c, unsigned int seq)
+{
+	for (deque<collect_job>::iterator e = c->jobs.begin(); e != c->jobs.end(); e++)
+		if (e->seq == seq)
+			return &*e;
+	
+	return NULL;
+}
+
+// send merged replies in the order they were requested
+static void gateway_emit_jobs(gw_client *c)
+{
+	while (!c->jobs.empty() && !c->jobs.front().remaining)
+	{
+		const collect_job &job = c->jobs.front();
+		char buf[128];
+		
+		// the error has already been passed on
+		if (job.failed)
+		{
+			c->jobs.pop_front();
+			continue;
+		}
+		
+		if (job.kind == CollectGamelist)
+			c->outbuf += "GAMELIST " + job.gamelist + "\r\n";
+		else
+		{
+			snprintf(buf, sizeof(buf), "LOBBY %u %u %u\r\n",
+				job.lobby_total, job.lobby_offset, job.lobby_count);
+			c->outbuf += buf;
+			
+			for (unsigned int i=0; i < job.lines.size(); i++)
+				c->outbuf += job.lines[i] + "\r\n";
+		}
+		
+		c->jobs.pop_front();
+	}
+}
+
+static void gateway_route(gw_client *c, const string &line)
+{
+	Tokenizer t(" ");
+	t.parse(line);
+	
+	if (!t.count())
+		return;
+	
+	// keep the message-id for split commands
+	string msgid;
+	const char firstchar = t[0][0];
+	if (firstchar >= '0' && firstchar <= '9')
+		msgid = t.getNext() + " ";
+	
+	const string command = t.getNext();
+	
+	if (command == "PCLIENT" || command == "INFO" || command == "AUTH" ||
+		command == "QUIT" || command == "LOBBY")
+	{
+		// every backend needs to know the client
+		gateway_send_all(c, line);
+	}
+	else if (command == "REGISTER" || command == "SUBSCRIBE" || command == "UNSUBSCRIBE" ||
+		command == "ACTION" || command == "RESPITE" || command == "STRADDLE" ||
+		command == "BUYINSURANCE" || command == "REBUY")
+	{
+		gateway_send(c, gateway_backend(t.getNextInt()), line, ReplyForward);
+	}
+	else if (command == "UNREGISTER")
+	{
+		const int gid = t.getNextInt();
+		
+		if (gid == -1)  // from all games
+			gateway_send_all(c, line);
+		else
+			gateway_send(c, gateway_backend(gid), line, ReplyForward);
+	}
+	else if (command == "CHAT")
+	{
+		// gid:tid goes to the game, foyer and private chat stay at home
+		Tokenizer ct(":");
+		ct.parse(t.getNext());
+		
+		gateway_send(c, (ct.count() == 2) ? gateway_backend(ct.getNextInt()) : 0,
+			line, ReplyForward);
+	}
+	else if (command == "CREATE")
+	{
+		int gid = 0;
+		string infostr;
+		
+		while (t.getNext(infostr))
+			if (infostr.compare(0, 8, "game_id:") == 0)
+				gid = Tokenizer::string2int(infostr.substr(8));
+		
+		gateway_send(c, gateway_backend(gid), line, ReplyForward);
+	}
+	else if (command == "REQUEST")
+	{
+		const string request = t.getNext();
+		
+		if (request == "gamelist")
+			gateway_collect(c, CollectGamelist, line);
+		else if (request == "lobby")
+			gateway_collect(c, CollectLobby, line);
+		else if (request == "gameinfo")
+		{
+			// split the requested gids by backend
+			vector<string> per_backend(backends.size());
+			string sgid;
+			
+			while (t.getNext(sgid))
+				per_backend[gateway_backend(Tokenizer::string2int(sgid))] += " " + sgid;
+			
+			for (unsigned int i=0; i < per_backend.size(); i++)
+				if (per_backend[i].length())
+					gateway_send(c, i, msgid + "REQUEST gameinfo" + per_backend[i], ReplyForward);
+		}
+		else if (request == "playerlist" || request == "start" || request == "restart" ||
+			request == "pause" || request == "resume")
+		{
+			gateway_send(c, gateway_backend(t.getNextInt()), line, ReplyForward);
+		}
+		else
+			gateway_send(c, 0, line, ReplyForward);
+	}
+	else
+		gateway_send(c, 0, line, ReplyForward);
+}
+
+static void gateway_reply(gw_client *c, unsigned int backend, const string &line)
+{
+	gw_link &link = c->links[backend];
+	
+	if (line == "SYNC")
+	{
+		if (link.pending.empty())
+			return;
+		
+		const pending_reply pr = link.pending.front();
+		link.pending.pop_front();
+		
+		if (pr.mode == ReplyCollect)
+		{
+			collect_job *job = gateway_find_job(c, pr.job);
+			if (job)
+				job->remaining--;
+			
+			gateway_emit_jobs(c);
+		}
+		
+		return;
+	}
+	
+	// lines outside of any reply are events
+	const reply_mode mode = link.pending.empty() ? ReplyForward : link.pending.front().mode;
+	
+	if (mode == ReplyForward)
+	{
+		c->outbuf += line + "\r\n";
+		return;
+	}
+	
+	Tokenizer t(" ");
+	t.parse(line);
+	
+	if (gateway_is_event(t) && !(mode == ReplyCollect && t[0] == "GAMEINFO"))
+	{
+		c->outbuf += line + "\r\n";
+		return;
+	}
+	
+	if (mode != ReplyCollect)
+		return;
+	
+	collect_job *job = gateway_find_job(c, link.pending.front().job);
+	if (!job || !t.count())
+		return;
+	
+	if (t[0] == "GAMELIST")
+	{
+		string sgid;
+		t.getNext();
+		while (t.getNext(sgid))
+			job->gamelist += sgid + " ";
+	}
+	else if (t[0] == "LOBBY")
+	{
+		t.getNext();
+		job->lobby_total += t.getNextInt();
+		job->lobby_offset = t.getNextInt();
+		job->lobby_count += t.getNextInt();
+	}
+	else if (t[0] == "GAMEINFO")
+		job->lines.push_back(line);
+	else
+	{
+		job->failed = true;
+		
+		// errors are reported once, by home
+		if (backend == 0)
+			c->outbuf += line + "\r\n";
+	}
+}
+
+// split buffered input into lines; returns false if the peer is gone
+static bool gateway_read(socktype sock, string &inbuf, vector<string> &lines)
+{
+	char buf[4096];
+	const int bytes = socket_read(sock, buf, sizeof(buf));
+	
+	if (bytes <= 0)
+		return false;
+	
+	inbuf.append(buf, bytes);
+	
+	string::size_type pos;
+	while ((pos = inbuf.find('\n')) != string::npos)
+	{
+		string line = inbuf.substr(0, pos);
+		inbuf.erase(0, pos + 1);
+		
+		if (line.length() && line[line.length() - 1] == '\r')
+			line.erase(line.length() - 1);
+		
+		lines.push_back(line);
+	}
+	
+	return true;
+}
+
+static bool gateway_flush(socktype sock, string &outbuf)
+{
+	if (outbuf.empty())
+		return true;
+	
+	const int bytes = socket_write(sock, outbuf.data(), outbuf.length());
+	
+	if (bytes > 0)
+		outbuf.erase(0, bytes);
+	else if (bytes < 0 && !network_isinprogress())
+		return false;
+	
+	return outbuf.length() <= GATEWAY_MAX_OUTPUT;
+}
+
+// keep a socket watched for output exactly while some is pending
+static void gateway_watch(socktype sock, bool &writing, const string &outbuf)
+{
+	if (writing != !outbuf.empty())
+	{
+		writing = !outbuf.empty();
+		gw_poller.watchWrite(sock, writing);
+	}
+}
+
+static bool gateway_own(socktype sock, gw_client *c, int link)
+{
+	if (!gw_poller.add(sock))
+		return false;
+	
+	if ((unsigned int) sock >= gw_owners.size())
+		gw_owners.resize(sock + 1);
+	
+	gw_owners[sock].client = c;
+	gw_owners[sock].link = link;
+	
+	return true;
+}
+
+static void gateway_disown(socktype sock)
+{
+	gw_poller.remove(sock);
+	
+	if ((unsigned int) sock < gw_owners.size())
+		gw_owners[sock].client = NULL;
+	
+	socket_close(sock);
+}
+
+static void gateway_remove(gw_client *c)
+{
+	acceptor_release(&c->saddr);
+	
+	for (unsigned int i=0; i < c->links.size(); i++)
+		if (c->links[i].sock != -1)
+			gateway_disown(c->links[i].sock);
+	
+	log_msg("gateway", "(%d) connection closed", c->sock);
+	
+	gateway_disown(c->sock);
+	
+	// the last client takes over the slot
+	gw_clients[c->index] = gw_clients.back();
+	gw_clients[c->index]->index = c->index;
+	gw_clients.pop_back();
+	
+	delete c;
+}
+
+static void gateway_touch(gw_client *c, vector<gw_client*> &touched)
+{
+	if (!c->touched)
+	{
+		c->touched = true;
+		touched.push_back(c);
+	}
+}
+
+static void gateway_accept(const accepted_connection &conn, vector<gw_client*> &touched)
+{
+	const socktype sock = conn.sock;
+	const sockaddr_in &saddr = conn.saddr;
+	
+	// refuse before any client state is set up
+	if (!acceptor_admit(&saddr, gw_clients.size()))
+	{
+		socket_close(sock);
+		return;
+	}
+	
+	gw_client *c = new gw_client;
+	c->sock = sock;
+	c->saddr = saddr;
+	c->writing = false;
+	c->job_seq = 0;
+	c->index = gw_clients.size();
+	c->touched = false;
+	c->dead = false;
+	c->links.resize(backends.size());
+	
+	gw_clients.push_back(c);
+	
+	// the select() fallback can't watch descriptors beyond FD_SETSIZE
+	bool polled = gateway_own(sock, c, -1);
+	
+	for (unsigned int i=0; i < backends.size(); i++)
+	{
+		c->links[i].writing = false;
+		c->links[i].sock = gateway_connect(backends[i]);
+		
+		if (c->links[i].sock == -1)
+		{
+			log_msg("gateway", "(%d) backend %s not reachable", sock, backends[i].c_str());
+			c->dead = true;
+		}
+		else if (!gateway_own(c->links[i].sock, c, i))
+			polled = false;
+	}
+	
+	if (!polled)
+	{
+		log_msg("gateway", "(%d) too many descriptors to watch", sock);
+		c->dead = true;
+	}
+	
+	log_msg("gateway", "(%d) accepted connection (%s)",
+		sock, inet_ntoa((struct in_addr) saddr.sin_addr));
+	
+	// gets removed at the end of the pass if dead
+	gateway_touch(c, touched);
+}
+
+// send what the pass queued for the client and its backends
+static void gateway_pass_flush(gw_client *c)
+{
+	for (unsigned int i=0; i < c->links.size() && !c->dead; i++)
+	{
+		gw_link &link = c->links[i];
+		
+		if (!gateway_flush(link.sock, link.outbuf))
+			c->dead = true;
+		else
+			gateway_watch(link.sock, link.writing, link.outbuf);
+	}
+	
+	// last words (e.g. the reply to QUIT) still go out
+	if (!gateway_flush(c->sock, c->outbuf))
+		c->dead = true;
+	else if (!c->dead)
+		gateway_watch(c->sock, c->writing, c->outbuf);
+}
+
+int gateway_run()
+{
+	Tokenizer bt(",");
+	bt.parse(srvconf.gateway_backends);
+	
+	string path;
+	while (bt.getNext(path))
+		backends.push_back(path);
+	
+	if (backends.empty())
+		return 1;
+	
+	int listenfd;
+	if ((listenfd = listensock_create(srvconf.port, srvconf.listen_backlog, false, srvconf.accept_threads > 0)) < 0)
+	{
+		log_msg("listensock", "(%d) error creating socket", listenfd);
+		return 1;
+	}
+	
+	if (!acceptor_start(listenfd, srvconf.port, true))
+		return 1;
+	
+	// each client needs one descriptor per backend besides its own
+	gw_poller.init(srvconf.io_backend != "select");
+	
+	const socktype acceptfd = acceptor_descriptor();
+	gw_poller.add(acceptfd);
+	
+	vector<accepted_connection> accepted;
+	vector<socktype> ready, writable;
+	vector<gw_client*> touched;
+	vector<string> lines;
+	
+	log_msg("gateway", "routing to %d backends (%s polling)",
+		(int) backends.size(), gw_poller.backendName());
+	
+	for (;;)
+	{
+		if (server_config_reload_pending())
+			server_config_reload();
+		
+		// a signal interrupting the wait returns no descriptors
+		if (!gw_poller.wait(SERVER_SELECT_TIMEOUT_USEC, ready, writable))
+			continue;
+		
+		touched.clear();
+		
+		for (unsigned int r=0; r < ready.size(); r++)
+		{
+			const socktype fd = ready[r];
+			
+			if (fd == acceptfd)
+			{
+				acceptor_collect(accepted);
+				for (unsigned int i=0; i < accepted.size(); i++)
+					gateway_accept(accepted[i], touched);
+				
+				continue;
+			}
+			
+			if ((unsigned int) fd >= gw_owners.size() || !gw_owners[fd].client)
+				continue;
+			
+			gw_client *c = gw_owners[fd].client;
+			const int link = gw_owners[fd].link;
+			
+			gateway_touch(c, touched);
+			
+			if (c->dead)
+				continue;
+			
+			lines.clear();
+			
+			if (link == -1)
+			{
+				if (!gateway_read(c->sock, c->inbuf, lines))
+					c->dead = true;
+				
+				for (unsigned int i=0; i < lines.size(); i++)
+					gateway_route(c, lines[i]);
+			}
+			else
+			{
+				if (!gateway_read(fd, c->links[link].inbuf, lines))
+					c->dead = true;
+				
+				for (unsigned int i=0; i < lines.size(); i++)
+					gateway_reply(c, link, lines[i]);
+			}
+		}
+		
+		for (unsigned int w=0; w < writable.size(); w++)
+		{
+			const socktype fd = writable[w];
+			
+			if ((unsigned int) fd < gw_owners.size() && gw_owners[fd].client)
+				gateway_touch(gw_owners[fd].client, touched);
+		}
+		
+		for (unsigned int i=0; i < touched.size(); i++)
+		{
+			gw_client *c = touched[i];
+			c->touched = false;
+			
+			gateway_pass_flush(c);
+			
+			if (c->dead)
+				gateway_remove(c);
+		}
+	}
+	
+	return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _GATEWAY_H
+#define _GATEWAY_H
+
+//! \brief Run as gateway: accept clients and route their commands to backend servers
+//!
+//! Every client gets one connection to each backend (listed in gateway_backends).
+//! Commands naming a game go to the backend owning the gid (gid % backends).
+//! Identity commands go to all backends, foyer and other server-wide commands
+//! go to the first (home) backend. Game lists and lobby pages are merged.
+int gateway_run();
+
+#endif /* _GATEWAY_H */
@@ -0,0 +1,407 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Config.h"
+#include "Platform.h"
+#include "Debug.h"
+#include "Logger.h"
+#include "Tokenizer.hpp"
+
+#include "game.hpp"
+#include "lobby.hpp"
+
+
+using namespace std;
+
+// number of games per lobby page (default and maximum)
+#define LOBBY_PAGE_DEFAULT  20
+#define LOBBY_PAGE_MAX      50
+
+
+//! \brief Game attributes the cached GAMEINFO and the filters depend on
+typedef struct {
+	int type;
+	int state;
+	unsigned int player_max;
+	unsigned int player_count;
+	chips_type stakes;
+	bool insurance;
+	bool password;
+	bool restart;
+} lobby_attribs;
+
+//! \brief Cached client-independent parts of a GAMEINFO line
+typedef struct {
+	lobby_attribs attr;	// state the cached text was built from
+	lobby_attribs prev;	// state last announced to subscribers
+	bool announced;		// prev is valid
+	bool changed;		// attr differs from prev
+	std::string prefix;	// text before the client-dependent flags
+	std::string suffix;	// text after the flags
+} lobby_entry;
+
+//! \brief Lobby filter sent with REQUEST lobby or LOBBY subscribe
+typedef struct {
+	int type;			// 0 = any
+	int state;			// 0 = any
+	chips_type stakes_min;
+	chips_type stakes_max;		// 0 = unlimited
+	unsigned int seats_free;
+	int insurance;			// -1 = any
+} lobby_filter;
+
+typedef struct {
+	socktype sock;
+	lobby_filter filter;
+} lobby_subscriber;
+
+static map<int,lobby_entry> lobby;
+static map<int,lobby_subscriber> subscribers;
+
+
+static void lobby_attributes(const GameController *g, lobby_attribs *a)
+{
+	a->type = g->getGameType();
+	
+	if (g->isEnded())
+		a->state = GameStateEnded;
+	else if (g->isStarted())
+		a->state = GameStateStarted;
+	else if (g->isPaused())
+		a->state = GameStatePaused;
+	else
+		a->state = GameStateWaiting;
+	
+	a->player_max = g->getPlayerMax();
+	a->player_count = g->getPlayerCount();
+	a->stakes = g->getPlayerStakes();
+	a->insurance = g->getEnableInsurance();
+	a->password = g->hasPassword();
+	a->restart = g->getRestart();
+}
+
+static bool lobby_attributes_equal(const lobby_attribs &a, const lobby_attribs &b)
+{
+	return (a.type == b.type && a.state == b.state &&
+		a.player_max == b.player_max && a.player_count == b.player_count &&
+		a.stakes == b.stakes && a.insurance == b.insurance &&
+		a.password == b.password && a.restart == b.restart);
+}
+
+// get the cache entry of a game, re-encoding it if the game has changed
+static lobby_entry* lobby_get(const GameController *g)
+{
+	lobby_attribs attr;
+	lobby_attributes(g, &attr);
+	
+	map<int,lobby_entry>::iterator it = lobby.find(g->getGameId());
+	if (it != lobby.end() && lobby_attributes_equal(it->second.attr, attr))
+		return &it->second;
+	
+	lobby_entry &e = lobby[g->getGameId()];
+	if (it == lobby.end())
+		e.announced = false;
+	
+	e.attr = attr;
+	e.changed = true;
+	
+	int game_mode = 0;
+	switch (attr.type)
+	{
+	case GameController::SNG:
+		game_mode = GameModeSNG;
+		break;
+	case GameController::FreezeOut:
+		game_mode = GameModeFreezeOut;
+		break;
+	case GameController::RingGame:
+		game_mode = GameModeRingGame;
+		break;
+	}
+	
+	char buf[512];
+	snprintf(buf, sizeof(buf), "GAMEINFO %d %d:%d:%d:",
+		g->getGameId(),
+		(int) GameTypeHoldem,
+		game_mode,
+		attr.state);
+	e.prefix = buf;
+	
+	snprintf(buf, sizeof(buf), ":%d:%d:%d:%d %d:%d:%d:%d:%d:%d \"%s\"",
+		attr.player_max,
+		attr.player_count,
+		g->getPlayerTimeout(),
+		attr.stakes,
+		g->getBlindsStart(),
+		g->getBlindsFactor(),
+		g->getBlindsTime(),
+		g->getAnte(),
+		(g->getMandatoryStraddle() ? 1 : 0),
+		(attr.insurance ? 1 : 0),
+		g->getName().c_str());
+	e.suffix = buf;
+	
+	return &e;
+}
+
+static void lobby_format(const GameController *g, const lobby_entry *e, int cid, char *buf, size_t size)
+{
+	const int flags =
+		(g->isPlayer(cid) ? GameInfoRegistered : 0) |
+		(g->isSpectator(cid) ? GameInfoSubscribed : 0) |
+		(e->attr.password ? GameInfoPassword : 0) |
+		(g->getOwner() == cid ? GameInfoOwner : 0) |
+		(e->attr.restart ? GameInfoRestart : 0);
+	
+	snprintf(buf, size, "%s%d%s", e->prefix.c_str(), flags, e->suffix.c_str());
+}
+
+static bool lobby_match(const lobby_filter &f, const lobby_attribs &a)
+{
+	if (f.type && f.type != a.type)
+		return false;
+	
+	if (f.state && f.state != a.state)
+		return false;
+	
+	if (a.stakes < f.stakes_min || (f.stakes_max && a.stakes > f.stakes_max))
+		return false;
+	
+	if (f.seats_free && a.player_count + f.seats_free > a.player_max)
+		return false;
+	
+	if (f.insurance != -1 && f.insurance != (a.insurance ? 1 : 0))
+		return false;
+	
+	return true;
+}
+
+// parse filter and paging arguments of the form key:value
+static bool lobby_parse(Tokenizer &t, lobby_filter *f, unsigned int *offset, unsigned int *count)
+{
+	f->type = 0;
+	f->state = 0;
+	f->stakes_min = 0;
+	f->stakes_max = 0;
+	f->seats_free = 0;
+	f->insurance = -1;
+	
+	*offset = 0;
+	*count = LOBBY_PAGE_DEFAULT;
+	
+	string argstr;
+	Tokenizer it(":");
+	
+	while (t.getNext(argstr))
+	{
+		it.parse(argstr);
+		
+		string argtype, arg;
+		it.getNext(argtype);
+		
+		if (!it.getNext(arg))
+			return false;
+		
+		const int value = Tokenizer::string2int(arg);
+		if (value < 0)
+			return false;
+		
+		if (argtype == "type")
+			f->type = value;
+		else if (argtype == "state")
+			f->state = value;
+		else if (argtype == "stake_min")
+			f->stakes_min = value;
+		else if (argtype == "stake_max")
+			f->stakes_max = value;
+		else if (argtype == "free")
+			f->seats_free = value;
+		else if (argtype == "insurance")
+			f->insurance = value ? 1 : 0;
+		else if (argtype == "offset")
+			*offset = value;
+		else if (argtype == "count")
+			*count = (value > LOBBY_PAGE_MAX) ? LOBBY_PAGE_MAX : value;
+		else
+			return false;
+	}
+	
+	return true;
+}
+
+
+bool lobby_gameinfo(const GameController *g, int cid, char *buf, size_t size)
+{
+	const lobby_entry *e = lobby_get(g);
+	
+	lobby_format(g, e, cid, buf, size);
+	
+	return true;
+}
+
+bool lobby_send_page(clientcon *client, Tokenizer &t)
+{
+	lobby_filter filter;
+	unsigned int offset, count;
+	
+	if (!lobby_parse(t, &filter, &offset, &count))
+		return false;
+	
+	games_type &games = get_game_map();
+	
+	vector<const GameController*> page;
+	unsigned int total = 0;
+	
+	for (games_type::const_iterator it = games.begin(); it != games.end(); it++)
+	{
+		const GameController *g = it->second;
+		const lobby_entry *e = lobby_get(g);
+		
+		if (!lobby_match(filter, e->attr))
+			continue;
+		
+		if (total >= offset && page.size() < count)
+			page.push_back(g);
+		
+		total++;
+	}
+	
+	char msg[1024];
+	
+	snprintf(msg, sizeof(msg), "LOBBY %u %u %u",
+		total, offset, (unsigned int) page.size());
+	send_msg(client->sock, msg);
+	
+	for (unsigned int i=0; i < page.size(); i++)
+	{
+		lobby_format(page[i], lobby_get(page[i]), client->id, msg, sizeof(msg));
+		send_msg(client->sock, msg);
+	}
+	
+	return true;
+}
+
+bool lobby_subscribe(clientcon *client, Tokenizer &t)
+{
+	lobby_subscriber sub;
+	unsigned int offset, count;
+	
+	if (!lobby_parse(t, &sub.filter, &offset, &count))
+		return false;
+	
+	sub.sock = client->sock;
+	subscribers[client->id] = sub;
+	
+	return true;
+}
+
+void lobby_send_subscribed(clientcon *client)
+{
+	map<int,lobby_subscriber>::const_iterator s = subscribers.find(client->id);
+	if (s == subscribers.end())
+		return;
+	
+	games_type &games = get_game_map();
+	char msg[1024];
+	
+	// initial state of all matching games; deltas follow with lobby_update()
+	for (games_type::const_iterator it = games.begin(); it != games.end(); it++)
+	{
+		const GameController *g = it->second;
+		const lobby_entry *e = lobby_get(g);
+		
+		if (!lobby_match(s->second.filter, e->attr))
+			continue;
+		
+		lobby_format(g, e, client->id, msg, sizeof(msg));
+		send_msg(client->sock, msg);
+	}
+}
+
+void lobby_unsubscribe(int cid)
+{
+	subscribers.erase(cid);
+}
+
+void lobby_update()
+{
+	games_type &games = get_game_map();
+	char msg[1024];
+	
+	// announce changed games to subscribers whose filter matched before or after
+	for (games_type::const_iterator it = games.begin(); it != games.end(); it++)
+	{
+		const GameController *g = it->second;
+		lobby_entry *e = lobby_get(g);
+		
+		if (!e->changed)
+			continue;
+		
+		for (map<int,lobby_subscriber>::const_iterator s = subscribers.begin(); s != subscribers.end(); s++)
+		{
+			const bool matched = e->announced && lobby_match(s->second.filter, e->prev);
+			
+			if (lobby_match(s->second.filter, e->attr))
+			{
+				lobby_format(g, e, s->first, msg, sizeof(msg));
+				send_msg(s->second.sock, msg);
+			}
+			else if (matched)
+			{
+				snprintf(msg, sizeof(msg), "GAMEDEL %d", it->first);
+				send_msg(s->second.sock, msg);
+			}
+		}
+		
+		e->prev = e->attr;
+		e->announced = true;
+		e->changed = false;
+	}
+	
+	// drop cache entries of deleted games
+	for (map<int,lobby_entry>::iterator it = lobby.begin(); it != lobby.end();)
+	{
+		if (games.find(it->first) != games.end())
+		{
+			++it;
+			continue;
+		}
+		
+		if (it->second.announced)
+		{
+			snprintf(msg, sizeof(msg), "GAMEDEL %d", it->first);
+			
+			for (map<int,lobby_subscriber>::const_iterator s = subscribers.begin(); s != subscribers.end(); s++)
+				if (lobby_match(s->second.filter, it->second.prev))
+					send_msg(s->second.sock, msg);
+		}
+		
+		lobby.erase(it++);
+	}
+}
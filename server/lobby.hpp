@@ -0,0 +1,39 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#ifndef _LOBBY_H
+#define _LOBBY_H
+
+#include <cstddef>
+
+#include "Tokenizer.hpp"
+#include "game.hpp"
+
+bool lobby_gameinfo(const GameController *g, int cid, char *buf, size_t size);
+bool lobby_send_page(clientcon *client, Tokenizer &t);
+bool lobby_subscribe(clientcon *client, Tokenizer &t);
+void lobby_send_subscribed(clientcon *client);
+void lobby_unsubscribe(int cid);
+void lobby_update();
+
+#endif /* _LOBBY_H */
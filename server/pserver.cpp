@@ -28,9 +28,13 @@
 
 #if !defined(PLATFORM_WINDOWS)
 # include <signal.h>
+# include <unistd.h>
+# include <sys/un.h>
 #endif
 
 #include <vector>
+#include <algorithm>
+#include <string>
 
 #ifndef NOSQLITE
 #include "Database.hpp"
@@ -45,6 +49,10 @@
 #include "SysAccess.h"
 #include "ConfigParser.hpp"
 #include "game.hpp"
+#include "ranking.hpp"
+#include "server_config.hpp"
+#include "gateway.hpp"
+#include "acceptor.hpp"
 
 using namespace std;
 
@@ -54,17 +62,14 @@ ConfigParser config;
 Database *db;
 #endif /* !NOSQLITE */
 
-socktype fdset_get_descriptor(fd_set *fds)
+#if !defined(PLATFORM_WINDOWS)
+static void sighup_handler(int sig)
 {
-        socktype i = 0;
-
-        while(!FD_ISSET(i, fds))
-                i++;
-
-        return i;
+	server_config_request_reload();
 }
+#endif
 
-int listensock_create(unsigned int port, int backlog)
+int listensock_create(unsigned int port, int backlog, bool local=false, bool reuseport=false)
 {
 	int listenfd;
 	socktype sock;
@@ -79,7 +84,7 @@ int listensock_create(unsigned int port, int backlog)
 	sock = listenfd;
 	
 	addr.sin_family = AF_INET;
-	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_addr.s_addr = local ? htonl(INADDR_LOOPBACK) : INADDR_ANY;
 	addr.sin_port = htons(port);
 	
 	/* Use address even it is in use (TIME_WAIT) */
@@ -90,6 +95,15 @@ int listensock_create(unsigned int port, int backlog)
 		return -4;
 	}
 	
+#if defined(SO_REUSEPORT)
+	/* several sockets share the port, one per acceptor thread */
+	if (reuseport && socket_setopt(sock, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
+	{
+		log_msg("listensock", "setsockopt:SO_REUSEPORT failed");
+		return -4;
+	}
+#endif
+	
 	socket_setnonblocking(sock);
 	
 	if (socket_bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1)
@@ -110,19 +124,123 @@ int listensock_create(unsigned int port, int backlog)
 	return sock;
 }
 
+#if !defined(PLATFORM_WINDOWS)
+// listening socket for a backend behind the gateway
+int listensock_create_unix(const char *path, int backlog)
+{
+	socktype sock;
+	struct sockaddr_un addr;
+	
+	if ((sock = socket_create(PF_UNIX, SOCK_STREAM, 0)) == -1)
+	{
+		log_msg("listensock", "socket() failed (%d: %s)", errno, strerror(errno));
+		return -1;
+	}
+	
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	
+	// remove a stale socket of a previous run
+	unlink(path);
+	
+	socket_setnonblocking(sock);
+	
+	if (socket_bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+	{
+		log_msg("listensock", "bind() failed: (%d: %s)", errno, strerror(errno));
+		return -2;
+	}
+	
+	if (socket_listen(sock, backlog) == -1)
+	{
+		log_msg("listensock", "listen() failed: (%d: %s)", errno, strerror(errno));
+		return -3;
+	}
+	
+	log_msg("listensock", "listening (socket: %s)", path);
+	
+	return sock;
+}
+#endif
+
+// answer a scrape request on the local metrics port and close the connection
+void metrics_serve(socktype sock)
+{
+	char buf[4096];
+	
+	// consume the request; its content doesn't matter
+	if (socket_read(sock, buf, sizeof(buf)) > 0)
+	{
+		string body;
+		metrics_scrape(body);
+		
+		snprintf(buf, sizeof(buf),
+			"HTTP/1.0 200 OK\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n"
+			"Content-Length: %u\r\n"
+			"Connection: close\r\n\r\n",
+			(unsigned int) body.length());
+		
+		const string response = buf + body;
+		size_t written = 0;
+		while (written < response.length())
+		{
+			const int bytes = socket_write(sock, response.data() + written, response.length() - written);
+			if (bytes <= 0)
+				break;
+			
+			written += bytes;
+		}
+	}
+	
+	socket_close(sock);
+}
+
 int mainloop()
 {
 	int listenfd;
-	if ((listenfd = listensock_create(config.getInt("port"), SERVER_LISTEN_BACKLOG)) < 0)
+	bool tcp = true;
+#if !defined(PLATFORM_WINDOWS)
+	if (srvconf.backend_socket.length())
+	{
+		listenfd = listensock_create_unix(srvconf.backend_socket.c_str(), srvconf.listen_backlog);
+		tcp = false;
+	}
+	else
+#endif
+		listenfd = listensock_create(srvconf.port, srvconf.listen_backlog, false, srvconf.accept_threads > 0);
+	
+	if (listenfd < 0)
 	{
 		log_msg("listensock", "(%d) error creating socket", listenfd);
 		return 1;
 	}
 	
+	if (!acceptor_start(listenfd, srvconf.port, tcp))
+		return 1;
+	
+	// optional metrics endpoint, only reachable from localhost
+	int metricsfd = -1;
+	if (srvconf.metrics_port > 0 &&
+		(metricsfd = listensock_create(srvconf.metrics_port, SERVER_LISTEN_BACKLOG, true)) < 0)
+	{
+		log_msg("metrics", "(%d) error creating socket; endpoint disabled", metricsfd);
+		metricsfd = -1;
+	}
+	
+	vector<socktype> metrics_clients;
+	vector<accepted_connection> accepted;
+	vector<socktype> ready;
+	
+	
+	socktype sock = acceptor_descriptor();
 	
-	socktype sock = listenfd;
-	socktype max;     /* highest socket number select() uses */
-	fd_set fds;
+	/* listening socket (or acceptor wakeup) and metrics socket share the clients' poller */
+	SocketPoller &poller = get_client_poller();
+	poller.add(sock);
+	if (metricsfd != -1)
+		poller.add(metricsfd);
 	
 	
 	for (;;)
@@ -130,100 +248,94 @@ int mainloop()
 		// handle game
 		gameloop();
 		
-		struct timeval timeout;  /* timeout for select */
-		timeout.tv_sec  = 0;
-		timeout.tv_usec = SERVER_SELECT_TIMEOUT_USEC;
+		// apply a config reload requested by SIGHUP between game passes
+		if (server_config_reload_pending())
+			server_config_reload();
 		
-		FD_ZERO(&fds);
+		// send everything queued by the game pass and the last requests at once
+		client_flush();
 		
-		/* add listening socket to the fd-set */
-		FD_SET(sock, &fds);
-		max = sock;
+		// a signal interrupting the wait returns no descriptors
+		if (!poller.wait(SERVER_SELECT_TIMEOUT_USEC, ready))
+			continue;
 		
-		/* add control clients to select-SET */
-		vector<clientcon> &clientvec = get_client_vector();
-		for (unsigned int i=0; i < clientvec.size(); i++)
+		// handle all descriptors which became ready
+		for (unsigned int r=0; r < ready.size(); r++)
 		{
-			socktype client_sock = clientvec[i].sock;
-			FD_SET(client_sock, &fds);
+			const socktype fd = ready[r];
 			
-			if (client_sock > max)
-				max = client_sock;
-		}
-		
-		
-		// are there any modified descriptors?
-		if (select(max + 1, &fds, NULL, NULL, &timeout))
-		{
-			// listen socket
-			if (FD_ISSET(sock, &fds))
+			// listen socket; take all pending connections at once
+			if (fd == sock)
 			{
-				sockaddr_in saddr;
-				unsigned int saddrlen = sizeof(saddr);
-				memset(&saddr, 0, sizeof(sockaddr_in));
-				
-				socktype client_sock = socket_accept(sock, (struct sockaddr*) &saddr, &saddrlen);
-				log_msg("listensock", "(%d) accepted connection (%s)",
-					client_sock, inet_ntoa((struct in_addr) saddr.sin_addr));
+				acceptor_collect(accepted);
 				
-				socket_setnonblocking(client_sock);
-				
-				client_add(client_sock, &saddr);
+				for (unsigned int i=0; i < accepted.size(); i++)
+				{
+					accepted_connection &c = accepted[i];
+					
+					// refuse before any client state is set up
+					if (!acceptor_admit(&c.saddr, get_client_vector().size()))
+					{
+						socket_close(c.sock);
+						continue;
+					}
+					
+					log_msg("listensock", "(%d) accepted connection (%s)",
+						c.sock, inet_ntoa((struct in_addr) c.saddr.sin_addr));
+					
+					client_add(c.sock, &c.saddr);
+				}
 				
-				FD_CLR(sock, &fds);
+				continue;
 			}
-			else
+			
+			if (fd == metricsfd)
 			{
-				// handle only one client-request per iteration
-				socktype sender = fdset_get_descriptor(&fds);
+				sockaddr_in saddr;
+				unsigned int saddrlen = sizeof(saddr);
 				
-				int status = client_handle(sender);
-				if (status <= 0)
+				socktype client_sock = socket_accept(metricsfd, (struct sockaddr*) &saddr, &saddrlen);
+				if (client_sock != -1)
 				{
-					if (!status)
-						errno = 0;
-					log_msg("clientsock", "(%d) socket closed (%d: %s)", sender, errno, strerror(errno));
-
-					client_remove(sender);
-					
-					FD_CLR(sender, &fds);
+					if (poller.add(client_sock))
+						metrics_clients.push_back(client_sock);
+					else
+						socket_close(client_sock);
 				}
+				
+				continue;
+			}
+			
+			// pending scrape request?
+			vector<socktype>::iterator e = find(metrics_clients.begin(), metrics_clients.end(), fd);
+			if (e != metrics_clients.end())
+			{
+				metrics_clients.erase(e);
+				poller.remove(fd);
+				metrics_serve(fd);
+				continue;
+			}
+			
+			int status = client_handle(fd);
+			
+			// nothing to read; the descriptor may have been reused by a connection accepted above
+			if (status < 0 && network_isinprogress())
+				continue;
+			
+			if (status <= 0)
+			{
+				if (!status)
+					errno = 0;
+				log_msg("clientsock", "(%d) socket closed (%d: %s)", fd, errno, strerror(errno));
+				
+				client_remove(fd);
 			}
-		}
-		else
-		{
-			// select-timeout occured
-			//fprintf(stderr, ".\n"); fflush(stderr);
 		}
 	}
 	
 	return 0;
 }
 
-bool config_load()
-{
-	// include defaults
-	#include "server_variables.hpp"
-	
-	
-	// create config-dir if it doesn't yet exist
-	sys_mkdir(sys_config_path());
-	
-	
-	char cfgfile[1024];
-	snprintf(cfgfile, sizeof(cfgfile), "%s/holdingnuts.cfg", sys_config_path());
-	
-	if (config.load(cfgfile))
-		log_msg("config", "Loaded configuration from %s", cfgfile);
-	else
-	{
-		if (config.save(cfgfile))
-			log_msg("config", "Saved initial configuration to %s", cfgfile);
-	}
-	
-	return true;
-}
-
 #ifndef NOSQLITE
 int database_init()
 {
@@ -254,6 +366,9 @@ int main(int argc, char **argv)
 #if !defined(PLATFORM_WINDOWS)
 	// ignore broken-pipe signal eventually caused by sockets
 	signal(SIGPIPE, SIG_IGN);
+	
+	// re-read the config file on SIGHUP
+	signal(SIGHUP, sighup_handler);
 #endif
 	
 	// init PRNG
@@ -271,17 +386,17 @@ int main(int argc, char **argv)
 	
 	
 	// load config
-	config_load();
+	server_config_load();
 	config.print();
 	
 	
 	// start logging
 	filetype *fplog = NULL;
-	if (config.getBool("log"))
+	if (srvconf.log)
 	{
 		char logfile[1024];
 		snprintf(logfile, sizeof(logfile), "%s/../logs/holdingnuts.log", sys_config_path());
-		fplog = file_open(logfile, config.getBool("log_append")
+		fplog = file_open(logfile, srvconf.log_append
 				  ? mode_append
 				  : mode_write);
 		
@@ -289,17 +404,33 @@ int main(int argc, char **argv)
 		log_set(stdout, fplog);
 		
 		// log timestamp
-		if (config.getBool("log_timestamp"))
+		if (srvconf.log_timestamp)
 			log_use_timestamp(1);
 	}
 	
+	log_set_severity(srvconf.log_level);
+	
+	// move log writing off the game thread
+	if (srvconf.log_flush_interval > 0 &&
+		log_start_async(srvconf.log_flush_interval))
+		log_msg("main", "asynchronous logging not available");
+	
 	
 	network_init();
+	
+	// a gateway only relays, games run on the backends
+	if (srvconf.gateway_backends.length())
+	{
+		const int ret = gateway_run();
+		log_stop_async();
+		return ret;
+	}
 
 #ifndef NOSQLITE
 	if (database_init())
 	{
 		log_msg("sqlite", "Error initializing database handle");
+		log_stop_async();
 		return 1;
 	}
 #endif /* !NOSQLITE */
@@ -308,12 +439,16 @@ int main(int argc, char **argv)
 	
 	mainloop();
 	
+	acceptor_stop();
+	
 #ifndef NOSQLITE
+	ranking_shutdown();
 	delete db;
 #endif /* !NOSQLITE */
 
 	network_shutdown();
 	
+	log_stop_async();
 	
 	// close log-file
 	if (fplog)
@@ -22,17 +22,36 @@
 
 
 #include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #include "Config.h"
 #include "Platform.h"
 #include "Debug.h"
 #include "Logger.h"
+#include "Trace.hpp"
+#include "SysAccess.h"
 #include "Database.hpp"
 
 #include "game.hpp"
 #include "Player.hpp"
 
 #include "ranking.hpp"
+#include "Leaderboard.hpp"
+
+
+static Leaderboard leaderboard;
+
+
+const Leaderboard& get_leaderboard()
+{
+	return leaderboard;
+}
 
 
 #ifndef NOSQLITE
@@ -162,102 +181,195 @@ static unsigned int calc_score(unsigned int score, unsigned int num_players, uns
 }
 
 
+// the writer waits this long for more finished games before committing (ms)
+#define RANKING_BATCH_DELAY  1000
+
+// ... unless this many results are already queued
+#define RANKING_BATCH_MAX    512
+
+//! \brief New ranking of one player in a finished game, queued for the writer thread
+typedef struct {
+	std::string uuid;
+	std::string name;	// empty if client is not connected anymore
+	int score;
+} ranking_job;
+
+static std::deque<ranking_job> ranking_queue;
+static std::vector<unsigned long long> ranking_latencies;   // batch durations for metrics
+static std::mutex ranking_mutex;
+static std::condition_variable ranking_cond;
+static std::thread ranking_writer;
+static bool ranking_stop = false;
+
+
+static bool ranking_write(const ranking_job &job)
+{
+	Statement *st;
+	
+	// update player name only if client is connected
+	if (job.name.length())
+	{
+		if (!(st = db->prepare("UPDATE players "
+				"SET name = ?2, t_lastgame = datetime('now'), gamecount = gamecount + 1, ranking = ?3 "
+				"WHERE uuid = ?1;")))
+			return false;
+		
+		st->bind(2, job.name);
+	}
+	else if (!(st = db->prepare("UPDATE players "
+				"SET t_lastgame = datetime('now'), gamecount = gamecount + 1, ranking = ?3 "
+				"WHERE uuid = ?1;")))
+		return false;
+	
+	st->bind(1, job.uuid);
+	st->bind(3, job.score);
+	
+	int rc = st->step();
+	st->reset();
+	
+	if (rc != SQLITE_DONE)
+		return false;
+	else if (db->changes())
+		return true;
+	
+	// insert new row
+	dbg_msg("SQL", "no rows, inserting...");
+	
+	if (!(st = db->prepare("INSERT INTO players "
+			"(uuid,name,t_lastgame,gamecount,ranking) VALUES(?1,?2,datetime('now'),1,?3);")))
+		return false;
+	
+	st->bind(1, job.uuid);
+	st->bind(2, job.name.length() ? job.name : std::string("__unknown__"));
+	st->bind(3, job.score);
+	
+	rc = st->step();
+	st->reset();
+	
+	return (rc == SQLITE_DONE);
+}
+
+static void ranking_thread()
+{
+	std::unique_lock<std::mutex> lock(ranking_mutex);
+	
+	for (;;)
+	{
+		while (!ranking_stop && ranking_queue.empty())
+			ranking_cond.wait(lock);
+		
+		// collect results of more games into the same transaction; notifications
+		// of finished games don't end the wait, only a full batch or the deadline
+		const std::chrono::steady_clock::time_point deadline =
+			std::chrono::steady_clock::now() + std::chrono::milliseconds(RANKING_BATCH_DELAY);
+		ranking_cond.wait_until(lock, deadline, [] {
+			return ranking_stop || ranking_queue.size() >= RANKING_BATCH_MAX;
+		});
+		
+		std::deque<ranking_job> batch;
+		batch.swap(ranking_queue);
+		
+		if (batch.empty() && ranking_stop)
+			break;
+		
+		lock.unlock();
+		
+		TraceScope trace("ranking_write", batch.size());
+		const unsigned long long write_start = sys_clock_usec();
+		
+		unsigned int failed = 0;
+		db->query("BEGIN TRANSACTION;");
+		
+		// a failing result is rolled back alone; the rest of the batch is kept
+		for (unsigned int i=0; i < batch.size(); i++)
+		{
+			db->query("SAVEPOINT ranking_result;");
+			
+			if (!ranking_write(batch[i]))
+			{
+				db->query("ROLLBACK TO ranking_result;");
+				log_msg("update_scores", "There was an error updating %s. Result dropped.",
+					batch[i].uuid.c_str());
+				failed++;
+			}
+			
+			db->query("RELEASE ranking_result;");
+		}
+		
+		db->query("COMMIT;");
+		
+		if (failed)
+			log_msg("update_scores", "%d of %d results could not be written.",
+				failed, (int) batch.size());
+		
+		const unsigned long long duration = sys_clock_usec() - write_start;
+		
+		lock.lock();
+		ranking_latencies.push_back(duration);
+	}
+}
+
 void ranking_update(const GameController *g)
 {
+	TraceScope trace("ranking_update", g->getGameId());
+	
 	std::vector<Player*> player_list;
 	g->getFinishList(player_list);
 	
-	bool query_error = false;
-	int rc = db->query("BEGIN TRANSACTION;");
+	std::vector<ranking_job> jobs;
 	
 	for (unsigned int u=0; u < player_list.size(); u++)
 	{
 		const Player* player = player_list[u];
-		const std::string &uuid = player->getPlayerUUID();
 		const int place = g->getPlayerCount() - u;
 		
-		dbg_msg("finish", "%s finished @ #%d",
-			uuid.c_str(), place);
+		ranking_job job;
+		job.uuid = player->getPlayerUUID();
 		
 		// skip empty UUID
-		if (!uuid.length())
+		if (!job.uuid.length())
 			continue;
 		
-		QueryResult *result;
-		rc = db->query(&result, "SELECT ranking FROM players WHERE uuid = '%q' LIMIT 1;", uuid.c_str());
+		dbg_msg("finish", "%s finished @ #%d", job.uuid.c_str(), place);
 		
-		if (rc)
-		{
-			query_error = true;
-			db->freeQueryResult(&result);
-			break;
-		}
-		else
-		{
-			const clientcon *client = get_client_by_id(player->getClientId());
-			std::string player_name = "__unknown__";
-			
-			// use either stored or current player name
-			if (client)
-				player_name = client->info.name;
-			
-			
-			if (!result->numRows())	// insert new row
-			{
-				dbg_msg("SQL", "no rows, inserting...");
-				
-				const int initial_score = 500;
-				rc = db->query("INSERT INTO players "
-					"(uuid,name,t_lastgame,gamecount,ranking) VALUES('%q','%q',datetime('now'),%d,%d);",
-						uuid.c_str(), player_name.c_str(),
-						1, calc_score(initial_score, g->getPlayerCount(), place));
-				
-				if (rc)
-				{
-					query_error = true;
-					db->freeQueryResult(&result);
-					break;
-				}
-			}
-			else		// update row
-			{
-				const int old_score = atoi(result->getRow(0,0));
-				const int new_score = calc_score(old_score, g->getPlayerCount(), place);
-				
-				dbg_msg("RATING", "uuid=%s  old_score=%d  new_score=%d",
-					uuid.c_str(), old_score, new_score);
-				
-				// update player name only if client is connected
-				char *q_setname = 0;	// Note: mingw32 compiler warning if not set to 0
-				if (client)
-					q_setname = db->createQueryString("name = '%q',", player_name.c_str());
-				
-				rc = db->query("UPDATE players "
-					"SET %s t_lastgame = datetime('now'), gamecount = gamecount + 1, ranking = %d "
-					"WHERE uuid = '%q';", (client) ? q_setname : "", new_score, uuid.c_str());
-				
-				if (client)
-					db->freeQueryString(q_setname);
-				
-				if (rc)
-				{
-					query_error = true;
-					db->freeQueryResult(&result);
-					break;
-				}
-			}
-		}
+		// use current player name if connected
+		const clientcon *client = get_client_by_id(player->getClientId());
+		if (client)
+			job.name = client->info.name;
+		
+		// the leaderboard holds the current scores; the database only mirrors them
+		const Leaderboard::entry *e = leaderboard.find(job.uuid);
+		const int old_score = e ? e->score : 500;
+		const unsigned int gamecount = e ? e->gamecount + 1 : 1;
+		
+		job.score = calc_score(old_score, g->getPlayerCount(), place);
+		
+		dbg_msg("RATING", "uuid=%s  old_score=%d  new_score=%d",
+			job.uuid.c_str(), old_score, job.score);
 		
-		db->freeQueryResult(&result);
+		// an empty name keeps the one already known, like ranking_write() does
+		leaderboard.update(job.uuid, job.name, job.score, gamecount);
+		
+		jobs.push_back(job);
 	}
 	
-	if (!query_error)
-		rc = db->query("COMMIT;");
-	else
+	// hand over to the writer thread; never wait for the database here
+	std::lock_guard<std::mutex> lock(ranking_mutex);
+	ranking_queue.insert(ranking_queue.end(), jobs.begin(), jobs.end());
+	ranking_cond.notify_one();
+}
+
+void ranking_poll()
+{
+	std::vector<unsigned long long> latencies;
+	
 	{
-		rc = db->query("ROLLBACK;");
-		log_msg("update_scores", "There was an error during transaction. Rolling back.");
+		std::lock_guard<std::mutex> lock(ranking_mutex);
+		latencies.swap(ranking_latencies);
 	}
+	
+	for (unsigned int i=0; i < latencies.size(); i++)
+		metrics_db_query(latencies[i]);
 }
 
 
@@ -267,6 +379,39 @@ void ranking_setup()
 	db->query("CREATE TABLE IF NOT EXISTS players "
 		"(uuid varchar(50) NOT NULL PRIMARY KEY, name varchar(50), "
 		"t_lastgame DATE NOT NULL, gamecount INT NOT NULL, ranking INT NOT NULL);");
+	
+	if (db->enableWAL())
+		log_msg("sqlite", "Warning: unable to enable write-ahead logging");
+	
+	// load all rankings into the leaderboard
+	Statement *st = db->prepare("SELECT uuid, name, gamecount, ranking FROM players;");
+	if (st)
+	{
+		while (st->step() == SQLITE_ROW)
+		{
+			const char *name = st->getText(1);
+			leaderboard.update(st->getText(0), name ? name : "", st->getInt(3), st->getInt(2));
+		}
+		
+		st->reset();
+	}
+	
+	log_msg("ranking", "loaded %d player rankings", leaderboard.size());
+	
+	// from now on the database is only accessed by the writer thread
+	ranking_writer = std::thread(ranking_thread);
+}
+
+void ranking_shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(ranking_mutex);
+		ranking_stop = true;
+		ranking_cond.notify_one();
+	}
+	
+	if (ranking_writer.joinable())
+		ranking_writer.join();
 }
 
 #endif /* !NOSQLITE */
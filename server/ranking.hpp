@@ -22,7 +22,12 @@
 
 
 #include "GameController.hpp"
+#include "Leaderboard.hpp"
 
 void ranking_update(const GameController *g);
+void ranking_poll();
 void ranking_setup();
+void ranking_shutdown();
+
+const Leaderboard& get_leaderboard();
 
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <cstdio>
+#include <csignal>
+
+#include "Config.h"
+#include "Version.h"
+#include "Logger.h"
+#include "SysAccess.h"
+
+#include "server_config.hpp"
+
+using namespace std;
+
+extern ConfigParser config;
+
+server_config srvconf;
+
+static volatile sig_atomic_t reload_requested = 0;
+
+
+void server_config_defaults(ConfigParser &cfg)
+{
+#define SERVER_VAR_INT(name, def)	cfg.set(#name, (int) (def));
+#define SERVER_VAR_BOOL(name, def)	cfg.set(#name, (bool) (def));
+#define SERVER_VAR_STRING(name, def)	cfg.set(#name, def);
+#include "server_variables.hpp"
+#undef SERVER_VAR_INT
+#undef SERVER_VAR_BOOL
+#undef SERVER_VAR_STRING
+}
+
+void server_config_apply(const ConfigParser &cfg, server_config *sc)
+{
+#define SERVER_VAR_INT(name, def)	sc->name = cfg.getInt(#name);
+#define SERVER_VAR_BOOL(name, def)	sc->name = cfg.getBool(#name);
+#define SERVER_VAR_STRING(name, def)	sc->name = cfg.get(#name);
+#include "server_variables.hpp"
+#undef SERVER_VAR_INT
+#undef SERVER_VAR_BOOL
+#undef SERVER_VAR_STRING
+}
+
+const char* server_config_file()
+{
+	static char cfgfile[1024];
+	snprintf(cfgfile, sizeof(cfgfile), "%s/holdingnuts.cfg", sys_config_path());
+	return cfgfile;
+}
+
+bool server_config_load()
+{
+	server_config_defaults(config);
+	
+	// create config-dir if it doesn't yet exist
+	sys_mkdir(sys_config_path());
+	
+	const char *cfgfile = server_config_file();
+	
+	if (config.load(cfgfile))
+		log_msg("config", "Loaded configuration from %s", cfgfile);
+	else
+	{
+		if (config.save(cfgfile))
+			log_msg("config", "Saved initial configuration to %s", cfgfile);
+	}
+	
+	server_config_apply(config, &srvconf);
+	
+	return true;
+}
+
+bool server_config_reload()
+{
+	const char *cfgfile = server_config_file();
+	
+	ConfigParser cfg;
+	server_config_defaults(cfg);
+	
+	if (!cfg.load(cfgfile))
+	{
+		log_msg("config", "Reloading %s failed, keeping current configuration", cfgfile);
+		return false;
+	}
+	
+	server_config sc;
+	server_config_apply(cfg, &sc);
+	
+	// sockets and log file are set up once at startup
+	sc.port = srvconf.port;
+	sc.metrics_port = srvconf.metrics_port;
+	sc.log = srvconf.log;
+	sc.log_append = srvconf.log_append;
+	sc.log_timestamp = srvconf.log_timestamp;
+	sc.log_flush_interval = srvconf.log_flush_interval;
+	sc.listen_backlog = srvconf.listen_backlog;
+	sc.accept_threads = srvconf.accept_threads;
+	sc.tcp_nodelay = srvconf.tcp_nodelay;
+	sc.socket_buffer_size = srvconf.socket_buffer_size;
+	sc.io_backend = srvconf.io_backend;
+	
+	cfg.set("port", sc.port);
+	cfg.set("metrics_port", sc.metrics_port);
+	cfg.set("log", sc.log);
+	cfg.set("log_append", sc.log_append);
+	cfg.set("log_timestamp", sc.log_timestamp);
+	cfg.set("log_flush_interval", sc.log_flush_interval);
+	cfg.set("listen_backlog", sc.listen_backlog);
+	cfg.set("accept_threads", sc.accept_threads);
+	cfg.set("tcp_nodelay", sc.tcp_nodelay);
+	cfg.set("socket_buffer_size", sc.socket_buffer_size);
+	cfg.set("io_backend", sc.io_backend);
+	
+	config = cfg;
+	srvconf = sc;
+	
+	log_set_severity(srvconf.log_level);
+	
+	log_msg("config", "Reloaded configuration from %s", cfgfile);
+	
+	return true;
+}
+
+void server_config_request_reload()
+{
+	reload_requested = 1;
+}
+
+bool server_config_reload_pending()
+{
+	if (!reload_requested)
+		return false;
+	
+	reload_requested = 0;
+	return true;
+}
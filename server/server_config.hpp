@@ -0,0 +1,55 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _SERVER_CONFIG_H
+#define _SERVER_CONFIG_H
+
+#include <string>
+
+#include "ConfigParser.hpp"
+
+//! \brief Server variables parsed once from the ConfigParser store
+struct server_config
+{
+#define SERVER_VAR_INT(name, def)	int name;
+#define SERVER_VAR_BOOL(name, def)	bool name;
+#define SERVER_VAR_STRING(name, def)	std::string name;
+#include "server_variables.hpp"
+#undef SERVER_VAR_INT
+#undef SERVER_VAR_BOOL
+#undef SERVER_VAR_STRING
+};
+
+extern server_config srvconf;
+
+void server_config_defaults(ConfigParser &cfg);
+void server_config_apply(const ConfigParser &cfg, server_config *sc);
+const char* server_config_file();
+bool server_config_load();
+bool server_config_reload();
+
+void server_config_request_reload();
+bool server_config_reload_pending();
+
+#endif /* _SERVER_CONFIG_H */
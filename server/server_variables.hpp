@@ -18,32 +18,55 @@
  */
 
 
-// Server defaults
+// Server variables and their defaults
+//
+// Each includer defines SERVER_VAR_INT, SERVER_VAR_BOOL and SERVER_VAR_STRING
+// as (name, default) before including this list (see server_config.cpp).
 
-config.set("version",			VERSION);		// config file version
-config.set("port",			DEFAULT_SERVER_PORT);	// port the server is listening on
-config.set("max_clients",		200);			// limit for client connections
-config.set("max_games",			100);			// limit for games
-config.set("max_connections_per_ip",	3);			// limit for connections per IP
-config.set("max_register_per_player",	2);			// limit for register per player
-config.set("max_subscribe_per_player",	2);			// limit for subscribe per player
-config.set("max_create_per_player",	2);			// limit for create per player
-config.set("log",			true);			// log into file
-config.set("log_append",		false);			// append to log file instead of overwriting
-config.set("log_timestamp",		true);			// log with timestamp
-config.set("auth_password",		"");			// server authentication password
-config.set("perm_create_user",		true);			// allow regular user to create games
-config.set("conarchive_expire",		30 * 60);		// stored connection data expiration (seconds)
-config.set("flood_chat_interval",	10);			// flood-protect: interval for measureing (seconds)
-config.set("flood_chat_per_interval",	5);			// flood-protect: count of messages allowed in interval
-config.set("flood_chat_mute",		60);			// flood-protect: mute time (seconds)
-config.set("welcome_message",		"");			// welcome message sent on state info
+SERVER_VAR_INT(version,			VERSION)		// config file version
+SERVER_VAR_INT(port,			DEFAULT_SERVER_PORT)	// port the server is listening on
+SERVER_VAR_INT(metrics_port,		0)			// local port for Prometheus metrics (0 = disabled)
+SERVER_VAR_INT(max_clients,		200)			// limit for client connections
+SERVER_VAR_INT(listen_backlog,		1024)			// pending connections queued by the kernel
+SERVER_VAR_INT(accept_threads,		0)			// acceptor threads with SO_REUSEPORT sockets (0 = accept in main loop)
+SERVER_VAR_BOOL(tcp_nodelay,		true)			// send client messages without Nagle delay
+SERVER_VAR_INT(socket_buffer_size,	0)			// send/receive buffer of client sockets in bytes (0 = system default)
+SERVER_VAR_STRING(io_backend,		"auto")			// client socket backend: auto, io_uring, epoll or select
+SERVER_VAR_INT(max_games,			100)			// limit for games
+SERVER_VAR_INT(max_connections_per_ip,	3)			// limit for connections per IP
+SERVER_VAR_INT(max_register_per_player,	2)			// limit for register per player
+SERVER_VAR_INT(max_subscribe_per_player,	2)			// limit for subscribe per player
+SERVER_VAR_INT(max_create_per_player,	2)			// limit for create per player
+SERVER_VAR_BOOL(log,			true)			// log into file
+SERVER_VAR_BOOL(log_append,		false)			// append to log file instead of overwriting
+SERVER_VAR_BOOL(log_timestamp,		true)			// log with timestamp
+SERVER_VAR_INT(log_level,			1)			// minimum severity: 0=debug 1=info 2=warning 3=error
+SERVER_VAR_INT(log_flush_interval,	100)			// background log writer interval in ms (0 = synchronous)
+SERVER_VAR_STRING(auth_password,		"")			// server authentication password
+SERVER_VAR_BOOL(perm_create_user,		true)			// allow regular user to create games
+SERVER_VAR_INT(conarchive_expire,		30 * 60)		// stored connection data expiration (seconds)
+SERVER_VAR_INT(conarchive_max_per_ip,	3)			// stored connection data entries per IP
+SERVER_VAR_INT(conarchive_max,		100000)		// limit for stored connection data entries
+SERVER_VAR_INT(resume_events,		256)			// events kept per client for resuming a session (0 = off)
+SERVER_VAR_INT(flood_chat_interval,	10)			// flood-protect: interval for measureing (seconds)
+SERVER_VAR_INT(flood_chat_per_interval,	5)			// flood-protect: count of messages allowed in interval
+SERVER_VAR_INT(flood_chat_mute,		60)			// flood-protect: mute time (seconds)
+SERVER_VAR_INT(rate_commands,		20)			// rate limit: commands per second per client (0 = off)
+SERVER_VAR_INT(rate_burst,		40)			// rate limit: commands a client may send at once
+SERVER_VAR_INT(rate_delay_strikes,	10)			// rate limit: throttled commands delayed before refusing them
+SERVER_VAR_INT(rate_disconnect_strikes,	50)			// rate limit: throttled commands before disconnecting
+SERVER_VAR_STRING(welcome_message,		"")			// welcome message sent on state info
+SERVER_VAR_INT(foyer_interval,		500)			// interval for batched foyer presence updates (ms)
+SERVER_VAR_INT(spectator_interval,	500)			// interval for batched spectator updates (ms, 0 = live)
+SERVER_VAR_INT(spectator_delay,		0)			// spectator updates lag behind the game (seconds)
+SERVER_VAR_STRING(backend_socket,		"")			// run as gateway backend listening on this unix socket
+SERVER_VAR_STRING(gateway_backends,	"")			// run as gateway for these backend sockets (comma separated)
 
 
 #ifdef DEBUG
-config.set("dbg_testgame_players",	3);		// testgames with X players
-config.set("dbg_testgame_games",	0);		// start X testgames
-config.set("dbg_testgame_timeout",	30);		// player timeout in seconds
-config.set("dbg_testgame_stakes",	1500);		// initial player stake
-config.set("dbg_stresstest",		false);		// stress-testing the server
+SERVER_VAR_INT(dbg_testgame_players,	3)		// testgames with X players
+SERVER_VAR_INT(dbg_testgame_games,	0)		// start X testgames
+SERVER_VAR_INT(dbg_testgame_timeout,	30)		// player timeout in seconds
+SERVER_VAR_INT(dbg_testgame_stakes,	1500)		// initial player stake
+SERVER_VAR_BOOL(dbg_stresstest,		false)		// stress-testing the server
 #endif
@@ -35,11 +35,15 @@ Database::Database()
 
 Database::Database(const char *filename)
 {
+	db = 0;
 	open(filename);
 }
 
 Database::~Database()
 {
+	for (statements_type::iterator e = statements.begin(); e != statements.end(); e++)
+		delete e->second;
+	
 	if (db)
 		sqlite3_close(db);
 }
@@ -130,11 +134,11 @@ int Database::query(QueryResult **qr, const char *q, ...)
 
 void Database::freeQueryResult(QueryResult **qr)
 {
-	if (qr)
+	if (!qr || !*qr)
 		return;
 	
-	delete qr;
-	qr = 0;
+	delete *qr;
+	*qr = 0;
 }
 
 char* Database::createQueryString(const char *q, ...)
@@ -154,6 +158,83 @@ void Database::freeQueryString(char *q)
 	sqlite3_free(q);
 }
 
+Statement* Database::prepare(const char *sql)
+{
+	if (!db)
+		return 0;
+	
+	statements_type::iterator it = statements.find(sql);
+	if (it != statements.end())
+		return it->second;
+	
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK)
+	{
+		dbg_msg("sqlite", "Error: %s", sqlite3_errmsg(db));
+		return 0;
+	}
+	
+	Statement *st = new Statement(stmt);
+	statements[sql] = st;
+	
+	return st;
+}
+
+int Database::enableWAL()
+{
+	int rc = query("PRAGMA journal_mode=WAL;");
+	if (rc == SQLITE_OK)
+		rc = query("PRAGMA synchronous=NORMAL;");
+	
+	return rc;
+}
+
+int Database::changes()
+{
+	return db ? sqlite3_changes(db) : 0;
+}
+
+Statement::Statement(sqlite3_stmt *stmt)
+{
+	this->stmt = stmt;
+}
+
+Statement::~Statement()
+{
+	sqlite3_finalize(stmt);
+}
+
+bool Statement::bind(int idx, int value)
+{
+	return sqlite3_bind_int(stmt, idx, value) == SQLITE_OK;
+}
+
+bool Statement::bind(int idx, const std::string &value)
+{
+	return sqlite3_bind_text(stmt, idx, value.c_str(), value.length(), SQLITE_TRANSIENT) == SQLITE_OK;
+}
+
+int Statement::step()
+{
+	return sqlite3_step(stmt);
+}
+
+void Statement::reset()
+{
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+}
+
+int Statement::getInt(int col)
+{
+	return sqlite3_column_int(stmt, col);
+}
+
+const char* Statement::getText(int col)
+{
+	return (const char*) sqlite3_column_text(stmt, col);
+}
+
 QueryResult::QueryResult(char **result, int nrow, int ncol)
 {
 	this->result = result;
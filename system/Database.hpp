@@ -46,6 +46,29 @@ private:
 	int nrow, ncol;
 };
 
+//! \brief Prepared statement; owned and cached by Database
+class Statement
+{
+friend class Database;
+
+public:
+	bool bind(int idx, int value);
+	bool bind(int idx, const std::string &value);
+	
+	//! \brief Execute or fetch next row; returns SQLITE_ROW, SQLITE_DONE or an error code
+	int step();
+	//! \brief Make the statement ready for re-execution and clear its bindings
+	void reset();
+	
+	int getInt(int col);
+	const char* getText(int col);
+	
+private:
+	Statement(sqlite3_stmt *stmt);
+	~Statement();
+	sqlite3_stmt *stmt;
+};
+
 class Database
 {
 public:
@@ -62,9 +85,19 @@ public:
 	char* createQueryString(const char *q, ...);
 	void freeQueryString(char *q);
 	
+	//! \brief Compile a statement once and return the cached instance on later calls
+	Statement* prepare(const char *sql);
+	
+	//! \brief Switch to write-ahead logging with relaxed syncing
+	int enableWAL();
+	
+	int changes();
+	
 private:
-	sqlite3 *db;
+	typedef std::map<std::string,Statement*>	statements_type;
 	
+	sqlite3 *db;
+	statements_type statements;
 };
 
 #endif /* DATABASE_H */
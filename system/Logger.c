@@ -28,23 +28,79 @@
 
 #include "Logger.h"
 
+/* asynchronous logging needs threads and atomic builtins */
+#if defined(__GNUC__) && !defined(PLATFORM_WINDOWS)
+# define LOG_ASYNC
+# include <pthread.h>
+# include <sched.h>
+#endif
+
 
 #if defined __cplusplus
         extern "C" {
 #endif
 
+/* max. length of a single message */
+#define LOG_LINE_SIZE	1024
+
+/* count of queued messages (power of two) */
+#define LOG_RING_SIZE	1024
+
+/* write buffer of the background thread */
+#define LOG_BATCH_SIZE	(64 * 1024)
+
+
 static filetype *logger[2] = { 0, 0 };
 static int log_timestamp = 0;
 
-void log_msg(const char *level, const char *format, ...)
+int log_severity = LogInfo;
+
+/* timestamp of the last formatted second; each formatting thread keeps its own */
+typedef struct {
+	time_t time;
+	char text[32];
+} log_stampcache;
+
+static const char* log_stamp(log_stampcache *stamp, time_t t)
 {
-	va_list args;
-	char msg[1024];
-	unsigned int i;
+	struct tm tm;
 	
-	va_start(args, format);
-	vsnprintf(msg, sizeof(msg), format, args);
-	va_end(args);
+	if (stamp->time == t && stamp->text[0])
+		return stamp->text;
+	
+#if defined(PLATFORM_WINDOWS)
+	localtime_s(&tm, &t);
+#else
+	localtime_r(&t, &tm);
+#endif
+	strftime(stamp->text, sizeof(stamp->text), "%Y-%m-%d %H:%M:%S", &tm);
+	stamp->time = t;
+	
+	return stamp->text;
+}
+
+static int log_format(char *buf, size_t size, log_stampcache *stamp, time_t t, const char *level, const char *text)
+{
+	int len;
+	
+	if (log_timestamp)
+		len = snprintf(buf, size, "[%s %10s]  %s\n", log_stamp(stamp, t), level, text);
+	else
+		len = snprintf(buf, size, "[%10s]  %s\n", level, text);
+	
+	// message got truncated
+	if (len >= (int) size)
+	{
+		len = size - 1;
+		buf[len - 1] = '\n';
+	}
+	
+	return len;
+}
+
+static void log_write(const char *buf, size_t len)
+{
+	unsigned int i;
 	
 	// if there was no log target specified with log_set()
 	if (!logger[0])
@@ -52,21 +108,243 @@ void log_msg(const char *level, const char *format, ...)
 	
 	for (i=0; i < 2; i++)
 	{
-		if (!logger[i])
-			continue;
+		if (logger[i])
+			fwrite(buf, 1, len, logger[i]);
+	}
+}
+
+static void log_flush()
+{
+	unsigned int i;
+	
+	for (i=0; i < 2; i++)
+	{
+		if (logger[i])
+			fflush(logger[i]);
+	}
+}
+
+
+#ifdef LOG_ASYNC
+
+typedef struct {
+	unsigned long seq;
+	time_t time;
+	char level[16];
+	char text[LOG_LINE_SIZE];
+} log_entry;
+
+/* bounded multi-producer queue; the background thread is the only consumer */
+static log_entry ring[LOG_RING_SIZE];
+static unsigned long enqueue_pos = 0;
+static unsigned long dequeue_pos = 0;
+static unsigned long dropped = 0;
+
+static int async_active = 0;
+static int async_writers = 0;	/* callers between checking async_active and enqueueing */
+static int async_running = 0;
+static unsigned int async_interval = 100;
+static pthread_t async_thread;
+
+static char batch[LOG_BATCH_SIZE];
+static log_stampcache batch_stamp;	/* only used by log_drain() */
+
+
+static int log_enqueue(const char *level, const char *format, va_list args)
+{
+	log_entry *e;
+	unsigned long pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+	
+	for (;;)
+	{
+		e = &ring[pos & (LOG_RING_SIZE - 1)];
+		const long diff = (long) __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) - (long) pos;
 		
-		if (log_timestamp) {
-            char s[100];
-            time_t t = time(NULL);
-            struct tm * p = localtime(&t);
-            strftime(s, 100, "%F %H:%M:%S", p);
-			fprintf(logger[i], "[%s %10s]  %s\n", s, level, msg);
-        } else {
-			fprintf(logger[i], "[%10s]  %s\n", level, msg);
-        }
+		if (diff == 0)
+		{
+			if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// queue is full; never block the caller
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			return -1;
+		}
+		else
+			pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+	}
+	
+	e->time = time(NULL);
+	snprintf(e->level, sizeof(e->level), "%s", level);
+	vsnprintf(e->text, sizeof(e->text), format, args);
+	
+	__atomic_store_n(&e->seq, pos + 1, __ATOMIC_RELEASE);
+	
+	return 0;
+}
+
+static void log_drain()
+{
+	size_t len = 0;
+	unsigned long lost;
+	
+	for (;;)
+	{
+		log_entry *e = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+		
+		if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != dequeue_pos + 1)
+			break;
+		
+		if (len + LOG_LINE_SIZE + 64 > sizeof(batch))
+		{
+			log_write(batch, len);
+			len = 0;
+		}
+		
+		len += log_format(batch + len, sizeof(batch) - len, &batch_stamp, e->time, e->level, e->text);
+		
+		// hand the slot back to the producers
+		__atomic_store_n(&e->seq, dequeue_pos + LOG_RING_SIZE, __ATOMIC_RELEASE);
+		dequeue_pos++;
+	}
+	
+	if ((lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED)))
+	{
+		char text[64];
+		snprintf(text, sizeof(text), "%lu messages dropped (queue full)", lost);
+		len += log_format(batch + len, sizeof(batch) - len, &batch_stamp, time(NULL), "logger", text);
+	}
+	
+	if (len)
+	{
+		log_write(batch, len);
+		log_flush();
+	}
+}
+
+static void* log_thread(void *arg)
+{
+	struct timespec ts;
+	ts.tv_sec = async_interval / 1000;
+	ts.tv_nsec = (async_interval % 1000) * 1000000L;
+	
+	while (__atomic_load_n(&async_running, __ATOMIC_ACQUIRE))
+	{
+		nanosleep(&ts, NULL);
+		log_drain();
+	}
+	
+	return NULL;
+}
+
+int log_start_async(unsigned int interval_ms)
+{
+	unsigned long i;
+	
+	if (async_active)
+		return 0;
+	
+	for (i=0; i < LOG_RING_SIZE; i++)
+		ring[i].seq = i;
+	
+	enqueue_pos = dequeue_pos = 0;
+	async_interval = interval_ms ? interval_ms : 1;
+	async_running = 1;
+	
+	if (pthread_create(&async_thread, NULL, log_thread, NULL))
+	{
+		async_running = 0;
+		return -1;
+	}
+	
+	__atomic_store_n(&async_active, 1, __ATOMIC_RELEASE);
+	
+	return 0;
+}
+
+void log_stop_async()
+{
+	if (!async_active)
+		return;
+	
+	__atomic_store_n(&async_active, 0, __ATOMIC_SEQ_CST);
+	
+	// let callers which already chose the queue finish their message
+	while (__atomic_load_n(&async_writers, __ATOMIC_SEQ_CST))
+		sched_yield();
+	
+	__atomic_store_n(&async_running, 0, __ATOMIC_RELEASE);
+	pthread_join(async_thread, NULL);
+	
+	// write out what was queued meanwhile
+	log_drain();
+}
+
+#else /* !LOG_ASYNC */
+
+int log_start_async(unsigned int interval_ms)
+{
+	return -1;
+}
+
+void log_stop_async()
+{
+}
+
+#endif /* LOG_ASYNC */
+
+
+static void log_vmsg(int severity, const char *level, const char *format, va_list args)
+{
+	char msg[LOG_LINE_SIZE];
+	char line[LOG_LINE_SIZE + 64];
+	log_stampcache stamp;
+	int len;
+	
+	if (severity < log_severity)
+		return;
+	
+#ifdef LOG_ASYNC
+	if (__atomic_load_n(&async_active, __ATOMIC_ACQUIRE))
+	{
+		// log_stop_async() waits for this caller before draining the queue
+		__atomic_fetch_add(&async_writers, 1, __ATOMIC_SEQ_CST);
+		const int queued = __atomic_load_n(&async_active, __ATOMIC_SEQ_CST);
+		if (queued)
+			log_enqueue(level, format, args);
+		__atomic_fetch_sub(&async_writers, 1, __ATOMIC_SEQ_CST);
 		
-		fflush(logger[i]);
+		if (queued)
+			return;
 	}
+#endif
+	
+	vsnprintf(msg, sizeof(msg), format, args);
+	
+	stamp.text[0] = '\0';
+	len = log_format(line, sizeof(line), &stamp, time(NULL), level, msg);
+	log_write(line, len);
+	log_flush();
+}
+
+void log_msg(const char *level, const char *format, ...)
+{
+	va_list args;
+	
+	va_start(args, format);
+	log_vmsg(LogInfo, level, format, args);
+	va_end(args);
+}
+
+void log_msg_severity(int severity, const char *level, const char *format, ...)
+{
+	va_list args;
+	
+	va_start(args, format);
+	log_vmsg(severity, level, format, args);
+	va_end(args);
 }
 
 void log_set(filetype *stream1, filetype *stream2)
@@ -80,6 +358,11 @@ void log_use_timestamp(int use_timestamp)
 	log_timestamp = use_timestamp;
 }
 
+void log_set_severity(int severity)
+{
+	log_severity = severity;
+}
+
 #if defined __cplusplus
     }
 #endif
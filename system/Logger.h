@@ -34,9 +34,44 @@
 #endif
 
 
+/* message severities; log_msg() logs with LogInfo */
+typedef enum {
+	LogDebug = 0,
+	LogInfo,
+	LogWarning,
+	LogError
+} logseverity;
+
+/* messages below this severity are compiled out of the log_debug()... macros */
+#ifndef LOG_COMPILE_SEVERITY
+# define LOG_COMPILE_SEVERITY  LogDebug
+#endif
+
+/* runtime threshold; read without locking on every call */
+extern int log_severity;
+
+#define log_enabled(severity) \
+	((severity) >= LOG_COMPILE_SEVERITY && (severity) >= log_severity)
+
+#define log_debug(level, ...) \
+	do { if (log_enabled(LogDebug)) log_msg_severity(LogDebug, level, __VA_ARGS__); } while (0)
+#define log_warn(level, ...) \
+	do { if (log_enabled(LogWarning)) log_msg_severity(LogWarning, level, __VA_ARGS__); } while (0)
+#define log_error(level, ...) \
+	do { if (log_enabled(LogError)) log_msg_severity(LogError, level, __VA_ARGS__); } while (0)
+
+
 void log_msg(const char *level, const char *format, ...);
+void log_msg_severity(int severity, const char *level, const char *format, ...);
 void log_set(filetype *stream1, filetype *stream2);
 void log_use_timestamp(int use_timestamp);
+void log_set_severity(int severity);
+
+/* hand writing over to a background thread flushing every interval_ms;
+   returns non-zero if not supported (logging stays synchronous) */
+int log_start_async(unsigned int interval_ms);
+/* write out all queued messages and return to synchronous logging */
+void log_stop_async();
 
 #if defined __cplusplus
     }
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include "MessageWriter.hpp"
+
+
+// two decimal digits per lookup; "00" "01" ... "99"
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+// write the digits of u right-aligned into the end of buf, return the first digit
+static char* format_digits(unsigned long long u, char *end)
+{
+	char *p = end;
+	
+	while (u >= 100)
+	{
+		const unsigned int pair = (unsigned int) (u % 100) * 2;
+		u /= 100;
+		*--p = digit_pairs[pair + 1];
+		*--p = digit_pairs[pair];
+	}
+	
+	if (u >= 10)
+	{
+		*--p = digit_pairs[u * 2 + 1];
+		*--p = digit_pairs[u * 2];
+	}
+	else
+		*--p = (char) ('0' + u);
+	
+	return p;
+}
+
+MessageWriter& MessageWriter::operator<<(unsigned long long u)
+{
+	char tmp[24];
+	char *end = tmp + sizeof(tmp);
+	const char *start = format_digits(u, end);
+	
+	return write(start, end - start);
+}
+
+MessageWriter& MessageWriter::operator<<(long long i)
+{
+	char tmp[24];
+	char *end = tmp + sizeof(tmp);
+	
+	// negate in unsigned arithmetic so LLONG_MIN does not overflow
+	const unsigned long long u = (i < 0) ? 0ULL - (unsigned long long) i : (unsigned long long) i;
+	char *start = format_digits(u, end);
+	if (i < 0)
+		*--start = '-';
+	
+	return write(start, end - start);
+}
+
+MessageWriter& MessageWriter::operator<<(int i)
+{
+	return *this << (long long) i;
+}
+
+MessageWriter& MessageWriter::operator<<(unsigned int u)
+{
+	return *this << (unsigned long long) u;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _MESSAGEWRITER_H
+#define _MESSAGEWRITER_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+
+//! \brief Text serializer writing into a caller-provided fixed buffer
+//!
+//! Replaces snprintf() and std::string appends when assembling protocol
+//! messages: integers are converted without format-string parsing and no
+//! heap memory is touched. Text not fitting the buffer is dropped (like
+//! snprintf would truncate it) and reported by truncated().
+class MessageWriter
+{
+public:
+	//! \brief Maximum length of a formatted int ("-2147483648")
+	static const size_t IntLength = 11;
+	
+	MessageWriter(char *buffer, size_t size)
+		: buf(buffer), len(0), cap(size - 1), overflow(false) { buf[0] = '\0'; };
+	
+	template <size_t N>
+	explicit MessageWriter(char (&buffer)[N])
+		: buf(buffer), len(0), cap(N - 1), overflow(false) { buf[0] = '\0'; };
+	
+	MessageWriter& write(const char *s, size_t n)
+	{
+		if (n > cap - len)
+		{
+			n = cap - len;
+			overflow = true;
+		}
+		
+		memcpy(buf + len, s, n);
+		len += n;
+		
+		return *this;
+	};
+	
+	MessageWriter& operator<<(char c)
+	{
+		if (len < cap)
+			buf[len++] = c;
+		else
+			overflow = true;
+		
+		return *this;
+	};
+	
+	MessageWriter& operator<<(const char *s) { return write(s, strlen(s)); };
+	MessageWriter& operator<<(const std::string &s) { return write(s.data(), s.length()); };
+	
+	MessageWriter& operator<<(int i);
+	MessageWriter& operator<<(unsigned int u);
+	MessageWriter& operator<<(long long i);
+	MessageWriter& operator<<(unsigned long long u);
+	
+	//! \brief NUL-terminated contents of the buffer
+	const char* c_str() const { buf[len] = '\0'; return buf; };
+	size_t length() const { return len; };
+	bool empty() const { return !len; };
+	bool truncated() const { return overflow; };
+	
+	void clear() { len = 0; overflow = false; };
+	
+private:
+	MessageWriter(const MessageWriter&);
+	MessageWriter& operator=(const MessageWriter&);
+	
+	char *buf;
+	size_t len;
+	size_t cap;
+	bool overflow;
+};
+
+#endif /* _MESSAGEWRITER_H */
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#include <cstdio>
+#include <cstring>
+
+#include "Platform.h"
+#include "Metrics.hpp"
+
+using namespace std;
+
+
+static unsigned int highest_bit(unsigned long long value)
+{
+#if defined(__GNUC__)
+	return 63 - __builtin_clzll(value);
+#else
+	unsigned int bit = 0;
+	while (value >>= 1)
+		bit++;
+	return bit;
+#endif
+}
+
+
+MetricHistogram::MetricHistogram()
+{
+	reset();
+}
+
+void MetricHistogram::reset()
+{
+	memset(counts, 0, sizeof(counts));
+	total_count = 0;
+	total_sum = 0;
+	max_value = 0;
+}
+
+unsigned int MetricHistogram::bucketIndex(unsigned long long value)
+{
+	// values below 2^SubBucketBits get an exact bucket each
+	if (value < (1ULL << SubBucketBits))
+		return (unsigned int) value;
+	
+	// keep the SubBucketBits most significant bits
+	const unsigned int exponent = highest_bit(value) - (SubBucketBits - 1);
+	if (exponent > MaxExponent)
+		return BucketCount - 1;
+	
+	return exponent * SubBucketHalf + (unsigned int)(value >> exponent);
+}
+
+unsigned long long MetricHistogram::bucketUpperBound(unsigned int index)
+{
+	if (index < (1U << SubBucketBits))
+		return index;
+	
+	const unsigned int exponent = index / SubBucketHalf - 1;
+	const unsigned long long mantissa = index % SubBucketHalf + SubBucketHalf;
+	
+	return ((mantissa + 1) << exponent) - 1;
+}
+
+void MetricHistogram::record(unsigned long long value)
+{
+	counts[bucketIndex(value)]++;
+	total_count++;
+	total_sum += value;
+	
+	if (value > max_value)
+		max_value = value;
+}
+
+unsigned long long MetricHistogram::quantile(double q) const
+{
+	if (!total_count)
+		return 0;
+	
+	unsigned long long rank = (unsigned long long)(q * total_count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	else if (rank > total_count)
+		rank = total_count;
+	
+	unsigned long long seen = 0;
+	for (unsigned int i=0; i < BucketCount; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			const unsigned long long upper = bucketUpperBound(i);
+			return (upper < max_value) ? upper : max_value;
+		}
+	}
+	
+	return max_value;
+}
+
+
+MetricsRegistry::~MetricsRegistry()
+{
+	for (unsigned int i=0; i < entries.size(); i++)
+	{
+		switch ((int)entries[i].type)
+		{
+		case TypeCounter:
+			delete (MetricCounter*) entries[i].metric;
+			break;
+		case TypeGauge:
+			delete (MetricGauge*) entries[i].metric;
+			break;
+		case TypeHistogram:
+			delete (MetricHistogram*) entries[i].metric;
+			break;
+		}
+	}
+}
+
+void MetricsRegistry::add(const string &name, const string &help, const string &labels,
+		MetricType type, double scale, void *metric)
+{
+	entry_type e;
+	e.name = name;
+	e.help = help;
+	e.labels = labels;
+	e.type = type;
+	e.scale = scale;
+	e.metric = metric;
+	
+	entries.push_back(e);
+}
+
+MetricCounter* MetricsRegistry::addCounter(const string &name, const string &help, const string &labels)
+{
+	MetricCounter *m = new MetricCounter();
+	add(name, help, labels, TypeCounter, 1.0, m);
+	return m;
+}
+
+MetricGauge* MetricsRegistry::addGauge(const string &name, const string &help, const string &labels)
+{
+	MetricGauge *m = new MetricGauge();
+	add(name, help, labels, TypeGauge, 1.0, m);
+	return m;
+}
+
+MetricHistogram* MetricsRegistry::addHistogram(const string &name, const string &help, const string &labels, double scale)
+{
+	MetricHistogram *m = new MetricHistogram();
+	add(name, help, labels, TypeHistogram, scale, m);
+	return m;
+}
+
+void MetricsRegistry::format(string &out) const
+{
+	static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	char buf[512];
+	
+	vector<bool> done(entries.size(), false);
+	
+	// emit each family once, followed by all its label sets
+	for (unsigned int i=0; i < entries.size(); i++)
+	{
+		if (done[i])
+			continue;
+		
+		const entry_type &family = entries[i];
+		const char *type = (family.type == TypeCounter) ? "counter" :
+			(family.type == TypeGauge) ? "gauge" : "summary";
+		
+		snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s %s\n",
+			family.name.c_str(), family.help.c_str(),
+			family.name.c_str(), type);
+		out += buf;
+		
+		for (unsigned int j=i; j < entries.size(); j++)
+		{
+			const entry_type &e = entries[j];
+			if (done[j] || e.name != family.name)
+				continue;
+			
+			done[j] = true;
+			
+			const char *name = e.name.c_str();
+			const string lblock = e.labels.length() ? "{" + e.labels + "}" : "";
+			const char *labels = lblock.c_str();
+			const char *sep = e.labels.length() ? "," : "";
+			
+			switch ((int)e.type)
+			{
+			case TypeCounter:
+				snprintf(buf, sizeof(buf), "%s%s %llu\n", name, labels,
+					((MetricCounter*) e.metric)->get());
+				out += buf;
+				break;
+			case TypeGauge:
+				snprintf(buf, sizeof(buf), "%s%s %g\n", name, labels,
+					((MetricGauge*) e.metric)->get());
+				out += buf;
+				break;
+			case TypeHistogram:
+			{
+				const MetricHistogram *h = (MetricHistogram*) e.metric;
+				
+				for (unsigned int q=0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+				{
+					snprintf(buf, sizeof(buf), "%s{%s%squantile=\"%g\"} %g\n",
+						name, e.labels.c_str(), sep, quantiles[q],
+						h->quantile(quantiles[q]) / e.scale);
+					out += buf;
+				}
+				
+				snprintf(buf, sizeof(buf), "%s_sum%s %g\n%s_count%s %llu\n",
+					name, labels, h->sum() / e.scale,
+					name, labels, h->count());
+				out += buf;
+				break;
+			}
+			}
+		}
+	}
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <string>
+#include <vector>
+
+
+//! \brief Monotonic event counter
+class MetricCounter
+{
+public:
+	MetricCounter() : value(0) {};
+	
+	void inc(unsigned long long n=1) { value += n; };
+	unsigned long long get() const { return value; };
+	
+private:
+	unsigned long long value;
+};
+
+//! \brief Point-in-time value, may go up and down
+class MetricGauge
+{
+public:
+	MetricGauge() : value(0) {};
+	
+	void set(double v) { value = v; };
+	void add(double v) { value += v; };
+	double get() const { return value; };
+	
+private:
+	double value;
+};
+
+//! \brief HDR-style histogram with log-linear buckets (~3% relative error)
+//!
+//! Values are recorded as unsigned integers (the server uses microseconds).
+//! Recording is a handful of integer operations without any allocation.
+class MetricHistogram
+{
+public:
+	MetricHistogram();
+	
+	void record(unsigned long long value);
+	void reset();
+	
+	unsigned long long count() const { return total_count; };
+	unsigned long long sum() const { return total_sum; };
+	unsigned long long max() const { return max_value; };
+	
+	//! \brief Value at the given quantile (0.0 - 1.0); upper bound of the matching bucket
+	unsigned long long quantile(double q) const;
+	
+	// sub-bucket resolution: 2^SubBucketBits linear buckets per power of two
+	static const unsigned int SubBucketBits = 5;
+	static const unsigned int SubBucketHalf = 1 << (SubBucketBits - 1);
+	static const unsigned int MaxExponent = 32;
+	static const unsigned int BucketCount = (MaxExponent + 2) * SubBucketHalf;
+	
+private:
+	static unsigned int bucketIndex(unsigned long long value);
+	static unsigned long long bucketUpperBound(unsigned int index);
+	
+	unsigned long long counts[BucketCount];
+	unsigned long long total_count;
+	unsigned long long total_sum;
+	unsigned long long max_value;
+};
+
+//! \brief Collection of named metrics rendered in Prometheus text format
+//!
+//! Metrics are owned by the registry and live as long as it does; callers
+//! keep the returned pointers as handles for the hot path.
+class MetricsRegistry
+{
+public:
+	~MetricsRegistry();
+	
+	MetricCounter* addCounter(const std::string &name, const std::string &help, const std::string &labels="");
+	MetricGauge* addGauge(const std::string &name, const std::string &help, const std::string &labels="");
+	//! \brief Histogram of values in units of 1/scale; exported as summary in base units
+	MetricHistogram* addHistogram(const std::string &name, const std::string &help, const std::string &labels="", double scale=1000000.0);
+	
+	void format(std::string &out) const;
+	
+private:
+	typedef enum {
+		TypeCounter,
+		TypeGauge,
+		TypeHistogram
+	} MetricType;
+	
+	typedef struct {
+		std::string name;
+		std::string help;
+		std::string labels;
+		MetricType type;
+		double scale;
+		void *metric;
+	} entry_type;
+	
+	void add(const std::string &name, const std::string &help, const std::string &labels,
+		MetricType type, double scale, void *metric);
+	
+	std::vector<entry_type> entries;
+};
+
+#endif /* _METRICS_H */
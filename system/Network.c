@@ -21,8 +21,17 @@
  */
 
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE	/* accept4() */
+#endif
+
 #include "Network.h"
 
+#if defined(__linux__)
+# include <sys/ioctl.h>
+# include <linux/sockios.h>
+#endif
+
 /*
 Windows <-> Linux differences:  (http://www.andreadrian.de/select/#mozTocId243918)
 - header file is winsock2.h
@@ -62,6 +71,24 @@ int socket_accept(socktype sockfd, struct sockaddr *addr, unsigned int *addrlen)
 #endif
 }
 
+int socket_accept_nonblocking(socktype sockfd, struct sockaddr *addr, unsigned int *addrlen)
+{
+#if defined(__linux__) && defined(SOCK_NONBLOCK)
+	/* saves the fcntl() calls of socket_setnonblocking() */
+	return accept4(sockfd, addr, (socklen_t*) addrlen, SOCK_NONBLOCK);
+#else
+	socktype sock = socket_accept(sockfd, addr, addrlen);
+	
+	if (sock != -1 && socket_setnonblocking(sock) < 0)
+	{
+		socket_close(sock);
+		return -1;
+	}
+	
+	return sock;
+#endif
+}
+
 int socket_connect(socktype sockfd, const struct sockaddr *addr, unsigned int addrlen)
 {
 	return connect(sockfd, addr, addrlen);
@@ -123,6 +150,20 @@ int socket_setnonblocking(socktype sock)
 	return 0;
 }
 
+int socket_pending_output(socktype sock)
+{
+#if defined(SIOCOUTQ)
+	int bytes = 0;
+	
+	if (ioctl(sock, SIOCOUTQ, &bytes) < 0)
+		return -1;
+	
+	return bytes;
+#else
+	return -1;  // not supported on this platform
+#endif
+}
+
 int network_isinprogress()
 {
 #if defined(PLATFORM_WINDOWS)
@@ -56,6 +56,7 @@ int socket_create(int domain, int type, int protocol);
 int socket_bind(socktype sockfd, const struct sockaddr *addr, unsigned int addrlen);
 int socket_listen(socktype sockfd, int backlog);
 int socket_accept(socktype sockfd, struct sockaddr *addr, unsigned int *addrlen);
+int socket_accept_nonblocking(socktype sockfd, struct sockaddr *addr, unsigned int *addrlen);
 int socket_connect(socktype sockfd, const struct sockaddr *addr, unsigned int addrlen);
 int socket_close(socktype fd);
 
@@ -64,6 +65,7 @@ int socket_write(socktype fd, const void *buf, size_t count);
 
 int socket_setopt(socktype s, int level, int optname, const void *optval, int optlen);
 int socket_setnonblocking(socktype sock);
+int socket_pending_output(socktype sock);
 
 int network_isinprogress();
 
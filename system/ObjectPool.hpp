@@ -0,0 +1,164 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _OBJECTPOOL_H
+#define _OBJECTPOOL_H
+
+#include <new>
+#include <vector>
+#include <cstddef>
+
+
+//! \brief Free-list pool of T carved out of fixed-size chunks
+//!
+//! Chunks only grow while the pool lives; destroyed objects go back onto
+//! the free-list and are reused by the next create(). All chunks (and
+//! objects still alive in them) are released at once by the destructor.
+template <typename T, unsigned int ChunkSize = 16>
+class ObjectPool
+{
+public:
+	ObjectPool() : free_list(NULL), live(0), chunk_size(ChunkSize), slots(0) {};
+	~ObjectPool() { clear(); };
+	
+	//! \brief Number of objects the next chunk taken from the heap holds
+	void setChunkSize(unsigned int size) { chunk_size = size ? size : 1; };
+	
+	T* create()
+	{
+		if (!free_list)
+			grow();
+		
+		slot *s = free_list;
+		free_list = s->next;
+		
+		T *obj = new (s->storage.data) T();
+		s->used = true;
+		
+		live++;
+		total_creates++;
+		
+		return obj;
+	};
+	
+	void destroy(T *obj)
+	{
+		if (!obj)
+			return;
+		
+		// storage is the first member, so the object address is the slot address
+		slot *s = reinterpret_cast<slot*>(obj);
+		
+		obj->~T();
+		s->used = false;
+		s->next = free_list;
+		free_list = s;
+		
+		live--;
+	};
+	
+	//! \brief Destroy all live objects and give the chunks back to the heap
+	void clear()
+	{
+		for (unsigned int i=0; i < chunks.size(); i++)
+		{
+			for (unsigned int j=0; j < chunks[i].size; j++)
+			{
+				slot *s = &chunks[i].slots[j];
+				if (s->used)
+					reinterpret_cast<T*>(s->storage.data)->~T();
+			}
+			
+			delete[] chunks[i].slots;
+		}
+		
+		chunks.clear();
+		free_list = NULL;
+		live = 0;
+		slots = 0;
+	};
+	
+	unsigned int count() const { return live; };
+	unsigned int capacity() const { return slots; };
+	
+	//! \brief Chunks taken from the heap by all pools of this type
+	static unsigned long long chunkAllocs() { return total_chunks; };
+	//! \brief Objects handed out by all pools of this type
+	static unsigned long long creates() { return total_creates; };
+	
+private:
+	// not copyable; a copied game starts with its own pool
+	ObjectPool(const ObjectPool&);
+	ObjectPool& operator=(const ObjectPool&);
+	
+	struct slot {
+		union {
+			char data[sizeof(T)];
+			long double align_ld;
+			long long align_ll;
+			void *align_ptr;
+		} storage;
+		slot *next;
+		bool used;
+	};
+	
+	struct chunk {
+		slot *slots;
+		unsigned int size;
+	};
+	
+	void grow()
+	{
+		chunk c;
+		c.slots = new slot[chunk_size];
+		c.size = chunk_size;
+		chunks.push_back(c);
+		slots += chunk_size;
+		total_chunks++;
+		
+		for (unsigned int i=c.size; i > 0; i--)
+		{
+			c.slots[i-1].used = false;
+			c.slots[i-1].next = free_list;
+			free_list = &c.slots[i-1];
+		}
+	};
+	
+	std::vector<chunk> chunks;
+	slot *free_list;
+	unsigned int live;
+	unsigned int chunk_size;
+	unsigned int slots;
+	
+	static unsigned long long total_chunks;
+	static unsigned long long total_creates;
+};
+
+template <typename T, unsigned int ChunkSize>
+unsigned long long ObjectPool<T, ChunkSize>::total_chunks = 0;
+
+template <typename T, unsigned int ChunkSize>
+unsigned long long ObjectPool<T, ChunkSize>::total_creates = 0;
+
+#endif /* _OBJECTPOOL_H */
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <algorithm>
+
+#if defined(HAVE_EPOLL)
+# include <sys/epoll.h>
+#endif
+
+#include "SocketPoller.hpp"
+
+using namespace std;
+
+// events taken from the kernel per epoll_wait()
+#define POLLER_MAX_EVENTS	256
+
+
+SocketPoller::SocketPoller()
+{
+	epfd = -1;
+}
+
+SocketPoller::~SocketPoller()
+{
+#if defined(HAVE_EPOLL)
+	if (epfd != -1)
+		close(epfd);
+#endif
+}
+
+bool SocketPoller::init(bool use_epoll)
+{
+#if defined(HAVE_EPOLL)
+	if (use_epoll)
+		epfd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+	
+	return true;
+}
+
+bool SocketPoller::add(socktype sock)
+{
+#if defined(HAVE_EPOLL)
+	if (epfd != -1)
+	{
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = sock;
+		
+		return epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev) == 0;
+	}
+#endif
+	
+	if (sock >= FD_SETSIZE)
+		return false;
+	
+	socks.push_back(sock);
+	
+	return true;
+}
+
+void SocketPoller::remove(socktype sock)
+{
+#if defined(HAVE_EPOLL)
+	if (epfd != -1)
+	{
+		struct epoll_event ev;   // ignored, but must not be NULL on old kernels
+		epoll_ctl(epfd, EPOLL_CTL_DEL, sock, &ev);
+		return;
+	}
+#endif
+	
+	vector<socktype>::iterator it = find(socks.begin(), socks.end(), sock);
+	if (it != socks.end())
+	{
+		*it = socks.back();
+		socks.pop_back();
+	}
+	
+	watchWrite(sock, false);
+}
+
+bool SocketPoller::watchWrite(socktype sock, bool watch)
+{
+#if defined(HAVE_EPOLL)
+	if (epfd != -1)
+	{
+		struct epoll_event ev;
+		ev.events = EPOLLIN | (watch ? EPOLLOUT : 0);
+		ev.data.fd = sock;
+		
+		return epoll_ctl(epfd, EPOLL_CTL_MOD, sock, &ev) == 0;
+	}
+#endif
+	
+	vector<socktype>::iterator it = find(wsocks.begin(), wsocks.end(), sock);
+	
+	if (watch && it == wsocks.end())
+		wsocks.push_back(sock);
+	else if (!watch && it != wsocks.end())
+	{
+		*it = wsocks.back();
+		wsocks.pop_back();
+	}
+	
+	return true;
+}
+
+unsigned int SocketPoller::wait(unsigned int timeout_usec, vector<socktype> &ready)
+{
+	return waitEvents(timeout_usec, ready, NULL);
+}
+
+unsigned int SocketPoller::wait(unsigned int timeout_usec, vector<socktype> &ready, vector<socktype> &writable)
+{
+	return waitEvents(timeout_usec, ready, &writable);
+}
+
+unsigned int SocketPoller::waitEvents(unsigned int timeout_usec, vector<socktype> &ready, vector<socktype> *writable)
+{
+	ready.clear();
+	if (writable)
+		writable->clear();
+	
+#if defined(HAVE_EPOLL)
+	if (epfd != -1)
+	{
+		struct epoll_event events[POLLER_MAX_EVENTS];
+		
+		// a signal interrupting the wait returns -1
+		const int count = epoll_wait(epfd, events, POLLER_MAX_EVENTS, timeout_usec / 1000);
+		for (int i=0; i < count; i++)
+		{
+			if (events[i].events & ~EPOLLOUT)
+				ready.push_back(events[i].data.fd);
+			if ((events[i].events & EPOLLOUT) && writable)
+				writable->push_back(events[i].data.fd);
+		}
+		
+		return ready.size() + (writable ? writable->size() : 0);
+	}
+#endif
+	
+	struct timeval timeout;
+	timeout.tv_sec  = timeout_usec / 1000000;
+	timeout.tv_usec = timeout_usec % 1000000;
+	
+	fd_set fds, wfds;
+	FD_ZERO(&fds);
+	FD_ZERO(&wfds);
+	
+	socktype max = 0;
+	for (unsigned int i=0; i < socks.size(); i++)
+	{
+		FD_SET(socks[i], &fds);
+		if (socks[i] > max)
+			max = socks[i];
+	}
+	
+	if (writable)
+	{
+		// only added sockets are watched, so these are below FD_SETSIZE as well
+		for (unsigned int i=0; i < wsocks.size(); i++)
+			FD_SET(wsocks[i], &wfds);
+	}
+	
+	// a signal interrupting select() leaves fds undefined
+	if (select(max + 1, &fds, writable ? &wfds : NULL, NULL, &timeout) <= 0)
+		return 0;
+	
+	for (unsigned int i=0; i < socks.size(); i++)
+		if (FD_ISSET(socks[i], &fds))
+			ready.push_back(socks[i]);
+	
+	if (writable)
+	{
+		for (unsigned int i=0; i < wsocks.size(); i++)
+			if (FD_ISSET(wsocks[i], &wfds))
+				writable->push_back(wsocks[i]);
+	}
+	
+	return ready.size() + (writable ? writable->size() : 0);
+}
+
+const char* SocketPoller::backendName() const
+{
+	return (epfd != -1) ? "epoll" : "select";
+}
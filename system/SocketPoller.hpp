@@ -0,0 +1,70 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _SOCKETPOLLER_H
+#define _SOCKETPOLLER_H
+
+#include <vector>
+
+#include "Network.h"
+
+//! \brief Readiness notification for a set of sockets
+//!
+//! Uses epoll where available (HAVE_EPOLL) and select() otherwise. Sockets
+//! must be removed before they are closed.
+class SocketPoller
+{
+public:
+	SocketPoller();
+	~SocketPoller();
+	
+	//! \brief Set up the backend; select() is used if use_epoll is false or epoll fails
+	bool init(bool use_epoll);
+	
+	bool add(socktype sock);
+	void remove(socktype sock);
+	
+	//! \brief Also report the socket when it becomes writable (while output is pending)
+	bool watchWrite(socktype sock, bool watch);
+	
+	//! \brief Wait for readable sockets; returns their count
+	unsigned int wait(unsigned int timeout_usec, std::vector<socktype> &ready);
+	
+	//! \brief Wait for readable sockets and writable ones among those watched; returns their count
+	unsigned int wait(unsigned int timeout_usec, std::vector<socktype> &ready, std::vector<socktype> &writable);
+	
+	const char* backendName() const;
+	
+private:
+	SocketPoller(const SocketPoller&);
+	SocketPoller& operator=(const SocketPoller&);
+	
+	unsigned int waitEvents(unsigned int timeout_usec, std::vector<socktype> &ready, std::vector<socktype> *writable);
+	
+	int epfd;
+	std::vector<socktype> socks;	// select() backend
+	std::vector<socktype> wsocks;	// select() backend, watched for output
+};
+
+#endif /* _SOCKETPOLLER_H */
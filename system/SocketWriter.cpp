@@ -0,0 +1,382 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#include <cstring>
+
+#if defined(HAVE_IO_URING)
+# include <cstdint>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <linux/io_uring.h>
+#endif
+
+#include "SocketWriter.hpp"
+
+using namespace std;
+
+
+SocketWriter::SocketWriter()
+{
+	total = 0;
+	calls = 0;
+	
+#if defined(HAVE_IO_URING)
+	memset(&ring, 0, sizeof(ring));
+	ring.fd = -1;
+#endif
+}
+
+SocketWriter::~SocketWriter()
+{
+#if defined(HAVE_IO_URING)
+	uring_exit();
+#endif
+}
+
+bool SocketWriter::init(bool use_uring, unsigned int entries)
+{
+#if defined(HAVE_IO_URING)
+	if (!use_uring || ring.fd != -1)
+		return true;
+	
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	
+	ring.fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring.fd < 0)
+	{
+		ring.fd = -1;
+		return false;
+	}
+	
+	// IORING_OP_SEND arrived shortly before fast-poll; older kernels keep plain writes
+	if (!(p.features & IORING_FEAT_FAST_POLL))
+	{
+		uring_exit();
+		return false;
+	}
+	
+	ring.sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring.cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	
+	ring.sq_ring = mmap(NULL, ring.sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+	ring.cq_ring = mmap(NULL, ring.cq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+	void *sqes = mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+	
+	if (ring.sq_ring == MAP_FAILED || ring.cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		if (ring.sq_ring == MAP_FAILED)
+			ring.sq_ring = NULL;
+		if (ring.cq_ring == MAP_FAILED)
+			ring.cq_ring = NULL;
+		if (sqes != MAP_FAILED)
+			ring.sqes = (struct io_uring_sqe*) sqes;
+		
+		uring_exit();
+		return false;
+	}
+	
+	char *sq = (char*) ring.sq_ring;
+	char *cq = (char*) ring.cq_ring;
+	
+	ring.sqes = (struct io_uring_sqe*) sqes;
+	ring.sq_head = (unsigned int*) (sq + p.sq_off.head);
+	ring.sq_tail = (unsigned int*) (sq + p.sq_off.tail);
+	ring.sq_mask = (unsigned int*) (sq + p.sq_off.ring_mask);
+	ring.sq_array = (unsigned int*) (sq + p.sq_off.array);
+	ring.cq_head = (unsigned int*) (cq + p.cq_off.head);
+	ring.cq_tail = (unsigned int*) (cq + p.cq_off.tail);
+	ring.cq_mask = (unsigned int*) (cq + p.cq_off.ring_mask);
+	ring.cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+	ring.entries = p.sq_entries;
+#endif
+	
+	return true;
+}
+
+#if defined(HAVE_IO_URING)
+void SocketWriter::uring_exit()
+{
+	if (ring.sqes)
+		munmap(ring.sqes, ring.sqes_size);
+	if (ring.cq_ring)
+		munmap(ring.cq_ring, ring.cq_ring_size);
+	if (ring.sq_ring)
+		munmap(ring.sq_ring, ring.sq_ring_size);
+	if (ring.fd != -1)
+		close(ring.fd);
+	
+	memset(&ring, 0, sizeof(ring));
+	ring.fd = -1;
+}
+#endif
+
+void SocketWriter::queue(socktype sock, const char *data, size_t length)
+{
+	if (!length)
+		return;
+	
+	string &out = outputs[sock];
+	if (out.empty())
+		waiting.push_back(sock);
+	
+	out.append(data, length);
+	total += length;
+}
+
+void SocketWriter::finish(socktype sock)
+{
+	outputs_type::iterator it = outputs.find(sock);
+	if (it == outputs.end())
+		return;
+	
+	if (!it->second.empty())
+	{
+		socket_write(sock, it->second.data(), it->second.length());
+		calls++;
+	}
+	
+	drop(sock);
+}
+
+void SocketWriter::drop(socktype sock)
+{
+	outputs_type::iterator it = outputs.find(sock);
+	if (it == outputs.end())
+		return;
+	
+	total -= it->second.length();
+	outputs.erase(it);
+	
+	// a reused descriptor must not be listed twice
+	for (unsigned int i=0; i < waiting.size(); i++)
+	{
+		if (waiting[i] == sock)
+		{
+			waiting.erase(waiting.begin() + i);
+			break;
+		}
+	}
+}
+
+size_t SocketWriter::pending(socktype sock) const
+{
+	outputs_type::const_iterator it = outputs.find(sock);
+	return (it != outputs.end()) ? it->second.length() : 0;
+}
+
+bool SocketWriter::sent(string &out, int bytes)
+{
+	if (bytes < 0)
+	{
+		total -= out.length();
+		out.clear();
+		return false;
+	}
+	
+	// partial sends are rare; the remainder waits for the next flush
+	total -= bytes;
+	out.erase(0, bytes);
+	
+	return true;
+}
+
+void SocketWriter::flush(vector<socktype> &failed)
+{
+	if (waiting.empty())
+		return;
+	
+#if defined(HAVE_IO_URING)
+	if (ring.fd != -1)
+		flush_uring(failed);
+	else
+#endif
+		flush_write(failed);
+	
+	// keep sockets with remaining output for the next flush
+	unsigned int count = 0;
+	for (unsigned int i=0; i < waiting.size(); i++)
+	{
+		outputs_type::iterator it = outputs.find(waiting[i]);
+		if (it == outputs.end())
+			continue;
+		
+		if (it->second.empty())
+			outputs.erase(it);
+		else
+			waiting[count++] = waiting[i];
+	}
+	
+	waiting.resize(count);
+}
+
+void SocketWriter::flush_write(vector<socktype> &failed)
+{
+	for (unsigned int i=0; i < waiting.size(); i++)
+		write_queue(waiting[i], failed);
+}
+
+void SocketWriter::write_queue(socktype sock, vector<socktype> &failed)
+{
+	outputs_type::iterator it = outputs.find(sock);
+	if (it == outputs.end() || it->second.empty())
+		return;
+	
+	string &out = it->second;
+	
+	int bytes = socket_write(sock, out.data(), out.length());
+	calls++;
+	
+	if (bytes < 0 && network_isinprogress())
+		bytes = 0;
+	
+	if (!sent(out, bytes))
+		failed.push_back(sock);
+}
+
+#if defined(HAVE_IO_URING)
+void SocketWriter::flush_uring(vector<socktype> &failed)
+{
+	unsigned int next = 0;
+	
+	while (next < waiting.size())
+	{
+		// fill the submission queue with one send per socket
+		const unsigned int tail = *ring.sq_tail;
+		unsigned int count = 0;
+		
+		batch.clear();
+		
+		for (; next < waiting.size() && count < ring.entries; next++)
+		{
+			outputs_type::iterator it = outputs.find(waiting[next]);
+			if (it == outputs.end() || it->second.empty())
+				continue;
+			
+			const unsigned int index = (tail + count) & *ring.sq_mask;
+			struct io_uring_sqe *sqe = &ring.sqes[index];
+			
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_SEND;
+			sqe->fd = waiting[next];
+			sqe->addr = (uintptr_t) it->second.data();
+			sqe->len = it->second.length();
+			sqe->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+			sqe->user_data = (uint64_t) count;
+			
+			ring.sq_array[index] = index;
+			batch.push_back(waiting[next]);
+			count++;
+		}
+		
+		if (!count)
+			break;
+		
+		__atomic_store_n(ring.sq_tail, tail + count, __ATOMIC_RELEASE);
+		
+		// submit all sends and wait for their completions at once
+		unsigned int submit = count;
+		unsigned int reaped = 0;
+		while (reaped < count)
+		{
+			const int ret = syscall(__NR_io_uring_enter, ring.fd, submit, count - reaped,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+			calls++;
+			
+			if (ret >= 0)
+				submit = ((unsigned int) ret < submit) ? submit - ret : 0;
+			else if (errno == EINTR)
+				continue;
+			
+			// completions already posted are taken even if the call failed
+			unsigned int head = *ring.cq_head;
+			const unsigned int cq_tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+			
+			for (; head != cq_tail; head++, reaped++)
+			{
+				const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+				const unsigned int k = (unsigned int) cqe->user_data;
+				const socktype sock = batch[k];
+				
+				int bytes = cqe->res;
+				if (bytes == -EAGAIN || bytes == -EINTR)
+					bytes = 0;
+				
+				if (!sent(outputs[sock], bytes))
+					failed.push_back(sock);
+				
+				batch[k] = -1;
+			}
+			
+			__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+			
+			if (ret < 0)
+			{
+				uring_fail(tail, failed);
+				
+				// the ring is unusable; write the sockets not yet queued directly
+				for (; next < waiting.size(); next++)
+					write_queue(waiting[next], failed);
+				
+				return;
+			}
+		}
+	}
+}
+
+void SocketWriter::uring_fail(unsigned int tail, vector<socktype> &failed)
+{
+	// the kernel takes entries from the head of the submission queue in order
+	const unsigned int consumed = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) - tail;
+	
+	for (unsigned int k=0; k < batch.size(); k++)
+	{
+		const socktype sock = batch[k];
+		if (sock == -1)
+			continue;
+		
+		// an unsubmitted send is written directly; one still in flight may have
+		// sent part of the queue already, so that stream can't be continued
+		if (k >= consumed)
+			write_queue(sock, failed);
+		else if (!sent(outputs[sock], -1))
+			failed.push_back(sock);
+	}
+	
+	uring_exit();
+}
+#endif
+
+const char* SocketWriter::backendName() const
+{
+#if defined(HAVE_IO_URING)
+	if (ring.fd != -1)
+		return "io_uring";
+#endif
+	return "write";
+}
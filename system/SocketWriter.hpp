@@ -0,0 +1,107 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+#ifndef _SOCKETWRITER_H
+#define _SOCKETWRITER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "Network.h"
+
+//! \brief Per-socket output queues flushed in one pass
+//!
+//! Messages are appended to the queue of their socket and sent by flush().
+//! With io_uring (HAVE_IO_URING) the sends of all waiting sockets are
+//! submitted together, costing one system call per flush; otherwise each
+//! socket is written separately. Sockets are expected to be non-blocking.
+class SocketWriter
+{
+public:
+	SocketWriter();
+	~SocketWriter();
+	
+	//! \brief Set up the backend; plain writes are used if use_uring is false or io_uring is unavailable
+	bool init(bool use_uring, unsigned int entries = 256);
+	
+	void queue(socktype sock, const char *data, size_t length);
+	
+	//! \brief Send queued output; sockets failing with an error are appended to failed
+	void flush(std::vector<socktype> &failed);
+	
+	//! \brief Write what the socket takes right away and discard the rest; used before closing
+	void finish(socktype sock);
+	
+	//! \brief Discard the queue of a socket
+	void drop(socktype sock);
+	
+	size_t pending(socktype sock) const;
+	size_t pending() const { return total; };
+	
+	//! \brief System calls issued by flush() so far
+	unsigned long long syscalls() const { return calls; };
+	
+	const char* backendName() const;
+	
+private:
+	SocketWriter(const SocketWriter&);
+	SocketWriter& operator=(const SocketWriter&);
+	
+	typedef std::unordered_map<socktype,std::string> outputs_type;
+	
+	// account for bytes sent from a queue (negative on error); returns false on error
+	bool sent(std::string &out, int bytes);
+	
+	void flush_write(std::vector<socktype> &failed);
+	void write_queue(socktype sock, std::vector<socktype> &failed);
+	
+	outputs_type outputs;
+	std::vector<socktype> waiting;
+	size_t total;
+	unsigned long long calls;
+	
+#if defined(HAVE_IO_URING)
+	void flush_uring(std::vector<socktype> &failed);
+	void uring_exit();
+	void uring_fail(unsigned int tail, std::vector<socktype> &failed);
+	
+	// sockets of the sends in the submission queue, by position; -1 once completed
+	std::vector<socktype> batch;
+	
+	struct uring {
+		int fd;
+		void *sq_ring, *cq_ring;
+		size_t sq_ring_size, cq_ring_size;
+		struct io_uring_sqe *sqes;
+		size_t sqes_size;
+		unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+		unsigned int *cq_head, *cq_tail, *cq_mask;
+		struct io_uring_cqe *cqes;
+		unsigned int entries;
+	} ring;
+#endif
+};
+
+#endif /* _SOCKETWRITER_H */
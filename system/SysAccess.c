@@ -31,6 +31,8 @@
 # include <tchar.h>
 #else
 # include <unistd.h>
+# include <time.h>
+# include <sys/time.h>
 #endif
 
 #include <sys/stat.h>
@@ -291,3 +293,26 @@ const char* sys_username()
 #endif
 	return username;
 }
+
+unsigned long long sys_clock_usec()
+{
+#if defined(PLATFORM_WINDOWS)
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+	
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	
+	QueryPerformanceCounter(&now);
+	return (unsigned long long)(now.QuadPart / freq.QuadPart) * 1000000ULL +
+		(unsigned long long)(now.QuadPart % freq.QuadPart) * 1000000ULL / freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (unsigned long long) tv.tv_sec * 1000000ULL + tv.tv_usec;
+#endif
+}
@@ -73,6 +73,9 @@ const char* sys_config_path();
 const char* sys_data_path();
 const char* sys_username();
 
+/* monotonic clock in microseconds; only meaningful for measuring intervals */
+unsigned long long sys_clock_usec();
+
 #if defined __cplusplus
     }
 #endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#include <cstdio>
+
+#include "Platform.h"
+#include "SysAccess.h"
+#include "Trace.hpp"
+
+
+// events kept per thread (power of two); older events get overwritten
+#define TRACE_RING_SIZE  16384
+
+typedef struct {
+	const char *name;
+	int arg;
+	unsigned long long start;
+	unsigned long long duration;
+} trace_event;
+
+// single-producer ring owned by one thread; readers only look at committed events
+typedef struct trace_ring {
+	trace_event events[TRACE_RING_SIZE];
+	std::atomic<unsigned long> head;   // count of events ever written
+	unsigned int tid;
+	struct trace_ring *next;
+} trace_ring;
+
+
+std::atomic<bool> trace_active(false);
+
+static std::atomic<trace_ring*> rings(0);
+static std::atomic<unsigned int> ring_count(0);
+static std::atomic<unsigned long long> trace_since(0);
+
+static thread_local trace_ring *local_ring = 0;
+
+
+static trace_ring* get_ring()
+{
+	if (!local_ring)
+	{
+		// first span on this thread: allocate and publish its ring (never freed)
+		trace_ring *r = new trace_ring;
+		r->head.store(0);
+		r->tid = ++ring_count;
+		r->next = rings.load();
+		
+		while (!rings.compare_exchange_weak(r->next, r))
+			;
+		
+		local_ring = r;
+	}
+	
+	return local_ring;
+}
+
+void TraceScope::begin(const char *name, int arg)
+{
+	span_name = name;
+	span_arg = arg;
+	span_start = sys_clock_usec();
+}
+
+void TraceScope::end()
+{
+	const unsigned long long now = sys_clock_usec();
+	trace_ring *r = get_ring();
+	
+	const unsigned long h = r->head.load(std::memory_order_relaxed);
+	trace_event *ev = &(r->events[h & (TRACE_RING_SIZE - 1)]);
+	ev->name = span_name;
+	ev->arg = span_arg;
+	ev->start = span_start;
+	ev->duration = now - span_start;
+	
+	r->head.store(h + 1, std::memory_order_release);
+}
+
+
+void trace_start()
+{
+	// spans recorded before this point are not dumped
+	trace_since.store(sys_clock_usec());
+	trace_active.store(true);
+}
+
+void trace_stop()
+{
+	trace_active.store(false);
+}
+
+bool trace_enabled()
+{
+	return trace_active.load();
+}
+
+bool trace_dump(const char *filename)
+{
+	filetype *fp = file_open(filename, mode_write);
+	if (!fp)
+		return false;
+	
+	const unsigned long long since = trace_since.load();
+	bool first = true;
+	
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	
+	for (trace_ring *r = rings.load(); r; r = r->next)
+	{
+		fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+			first ? "" : ",", r->tid, r->tid);
+		first = false;
+		
+		// Note: events written while dumping may show up torn; stop tracing first for exact output
+		const unsigned long head = r->head.load(std::memory_order_acquire);
+		const unsigned long from = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+		
+		for (unsigned long i=from; i < head; i++)
+		{
+			const trace_event *ev = &(r->events[i & (TRACE_RING_SIZE - 1)]);
+			
+			if (ev->start < since)
+				continue;
+			
+			fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu",
+				ev->name, r->tid, ev->start, ev->duration);
+			
+			if (ev->arg != -1)
+				fprintf(fp, ",\"args\":{\"id\":%d}", ev->arg);
+			
+			fprintf(fp, "}");
+		}
+	}
+	
+	fprintf(fp, "\n]}\n");
+	file_close(fp);
+	
+	return true;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <atomic>
+
+#if defined(__GNUC__)
+# define TRACE_UNLIKELY(x)  __builtin_expect(!!(x), 0)
+#else
+# define TRACE_UNLIKELY(x)  (x)
+#endif
+
+//! \brief Runtime switch for trace recording; read with a plain load on the hot path
+extern std::atomic<bool> trace_active;
+
+void trace_start();
+void trace_stop();
+bool trace_enabled();
+
+//! \brief Write all recorded spans as Chrome/Perfetto trace-event JSON
+bool trace_dump(const char *filename);
+
+
+//! \brief Scoped span; recorded into the calling thread's ring buffer on destruction
+//!
+//! The name must be a string literal (only the pointer is stored). When
+//! tracing is off the constructor costs one predictable branch.
+class TraceScope
+{
+public:
+	TraceScope(const char *name, int arg=-1)
+	{
+		if (TRACE_UNLIKELY(trace_active.load(std::memory_order_relaxed)))
+			begin(name, arg);
+		else
+			span_name = 0;
+	};
+	
+	~TraceScope()
+	{
+		if (span_name)
+			end();
+	};
+	
+private:
+	void begin(const char *name, int arg);
+	void end();
+	
+	const char *span_name;
+	int span_arg;
+	unsigned long long span_start;
+};
+
+#endif /* _TRACE_H */
@@ -0,0 +1,621 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+/* Micro-benchmarks for the hot paths of libpoker, system and server.
+ *
+ *   bench [-n iterations] [-w warmup] [-o file.json] [name-filter]
+ *
+ * Results (ns/op and heap allocations/op) are printed to stderr and
+ * written as JSON to stdout or the given file, for comparing runs.
+ * The PRNG is seeded with a fixed value, so all runs use the same input.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Config.h"
+#include "Platform.h"
+#include "Logger.h"
+#include "SysAccess.h"
+#include "Tokenizer.hpp"
+
+#include "Card.hpp"
+#include "Deck.hpp"
+#include "HoleCards.hpp"
+#include "CommunityCards.hpp"
+#include "GameLogic.hpp"
+
+#include "GameController.hpp"
+#include "Table.hpp"
+
+
+using namespace std;
+
+
+// every heap allocation of the process is counted
+static unsigned long long alloc_count = 0;
+
+// kept out of line; once inlined, GCC takes malloc()/free() for a mismatched new/delete
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void* operator new(size_t size)
+{
+	alloc_count++;
+	
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw bad_alloc();
+	
+	return p;
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void *p) throw()
+{
+	free(p);
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void *p, size_t) throw()
+{
+	free(p);
+}
+
+
+// GameController sends its messages through these (see game.cpp)
+bool client_chat(int from_gid, int from_tid, int to, const char *message)
+{
+	return true;
+}
+
+bool client_snapshot(int from_gid, int from_tid, int to, int sid, const char *message)
+{
+	return true;
+}
+
+
+// results are accumulated here so the measured work can't be optimized away
+static volatile unsigned int sink = 0;
+
+
+class Benchmark
+{
+public:
+	Benchmark(const char *name, unsigned int iterations)
+		: m_name(name), m_iterations(iterations) {};
+	virtual ~Benchmark() {};
+	
+	//! \brief Prepare the input data; not measured
+	virtual void setup() {};
+	
+	//! \brief One measured operation
+	virtual void run() = 0;
+	
+	const char* name() const { return m_name; };
+	unsigned int iterations() const { return m_iterations; };
+	
+private:
+	const char *m_name;
+	unsigned int m_iterations;	// default count of measured operations
+};
+
+
+//! \brief Access to Table and Player internals for the table benchmarks
+class BenchTable
+{
+public:
+	//! \brief Seat a new player directly (GameController can't add players itself)
+	static Player* addPlayer(GameController *g, int cid, chips_type stake)
+	{
+		Player *p = g->player_pool.create();
+		p->client_id = cid;
+		p->stake = stake;
+		g->registerPlayer(cid, p);
+		
+		return p;
+	}
+	
+	//! \brief Six seats with uneven bets (two all-ins, one fold) and an empty pot
+	static void prepareBets(Table *t, Player *players)
+	{
+		static const chips_type bets[] = { 400, 150, 400, 90, 400, 20 };
+		
+		for (unsigned int i=0; i < 10; i++)
+		{
+			Table::Seat *s = &(t->seats[i]);
+			
+			t->setOccupied(i, i < 6);
+			t->setInRound(i, i != 5);
+			s->bet = (i < 6) ? bets[i] : 0;
+			s->player = &players[i];
+			
+			players[i].setStake((i == 1 || i == 3) ? 0 : 1000);
+		}
+		
+		t->pots.resize(1);
+		t->pots[0].amount = 0;
+		t->pots[0].final = false;
+		t->pots[0].involved_mask = 0;
+	}
+	
+	static unsigned int collectBets(Table *t)
+	{
+		t->collectBets();
+		return t->pots.size();
+	}
+	
+	//! \brief Mid-hand state on the flop with bets and side pots
+	static void prepareSnapshot(Table *t)
+	{
+		t->state = Table::Betting;
+		t->betround = Table::Flop;
+		t->nomoreaction = false;
+		// seats of six players are 1, 2, 4, 6, 7 and 9
+		t->dealer = 1;
+		t->sb = 2;
+		t->bb = 4;
+		t->cur_player = 6;
+		t->last_bet_player = 4;
+		t->timeout_start = time(NULL);
+		
+		t->communitycards.setFlop(Card("Ah"), Card("Td"), Card("7c"));
+		
+		for (unsigned int i=0; i < 10; i++)
+		{
+			Table::Seat *s = &(t->seats[i]);
+			if (!s->occupied)
+				continue;
+			
+			t->setInRound(i, true);
+			s->bet = 40 * (i % 3);
+			s->player->holecards.setCards(Card("Ks"), Card("Qs"));
+		}
+		
+		Table::Pot pot;
+		pot.amount = 600;
+		pot.involved_mask = 0x2d6;	// seats 1, 2, 4, 6, 7 and 9
+		pot.final = true;
+		t->pots.assign(2, pot);
+		t->pots[1].final = false;
+	}
+};
+
+
+class BenchCardParse : public Benchmark
+{
+public:
+	BenchCardParse() : Benchmark("card_parse", 2000000) {};
+	
+	void setup()
+	{
+		Deck d;
+		d.fill();
+		
+		Card c;
+		while (d.pop(c))
+			names.push_back(c.getName());
+		
+		pos = 0;
+	}
+	
+	void run()
+	{
+		Card c(names[pos++ % names.size()].c_str());
+		sink += c.getFace();
+	}
+	
+private:
+	vector<string> names;
+	unsigned int pos;
+};
+
+class BenchDeckShuffle : public Benchmark
+{
+public:
+	BenchDeckShuffle() : Benchmark("deck_fill_shuffle", 200000) {};
+	
+	void run()
+	{
+		Deck d;
+		d.fill();
+		d.shuffle();
+		sink += d.count();
+	}
+};
+
+// random hole and community cards, dealt from shuffled decks
+static void deal_hands(unsigned int count, unsigned int players,
+	vector<HoleCards> &holes, vector<CommunityCards> &boards, unsigned int board_cards, Deck *rest=NULL)
+{
+	for (unsigned int n=0; n < count; n++)
+	{
+		Deck d;
+		d.fill();
+		d.shuffle();
+		
+		for (unsigned int p=0; p < players; p++)
+		{
+			Card c1, c2;
+			d.pop(c1);
+			d.pop(c2);
+			
+			HoleCards h;
+			h.setCards(c1, c2);
+			holes.push_back(h);
+		}
+		
+		Card f1, f2, f3, turn, river;
+		d.pop(f1);
+		d.pop(f2);
+		d.pop(f3);
+		d.pop(turn);
+		
+		CommunityCards cc;
+		cc.setFlop(f1, f2, f3);
+		cc.setTurn(turn);
+		
+		if (board_cards == 5)
+		{
+			d.pop(river);
+			cc.setRiver(river);
+		}
+		
+		boards.push_back(cc);
+		
+		if (rest)
+			rest[n] = d;
+	}
+}
+
+class BenchStrength : public Benchmark
+{
+public:
+	BenchStrength() : Benchmark("gamelogic_getstrength_7", 500000) {};
+	
+	void setup()
+	{
+		deal_hands(1024, 1, holes, boards, 5);
+		pos = 0;
+	}
+	
+	void run()
+	{
+		const unsigned int i = pos++ % holes.size();
+		
+		HandStrength hs;
+		GameLogic::getStrength(&holes[i], &boards[i], &hs);
+		sink += hs.getRanking();
+	}
+	
+private:
+	vector<HoleCards> holes;
+	vector<CommunityCards> boards;
+	unsigned int pos;
+};
+
+class BenchWinList : public Benchmark
+{
+public:
+	BenchWinList() : Benchmark("gamelogic_getwinlist_6", 200000) {};
+	
+	void setup()
+	{
+		vector<HoleCards> holes;
+		vector<CommunityCards> boards;
+		deal_hands(256, 6, holes, boards, 5);
+		
+		sets.resize(boards.size());
+		for (unsigned int n=0; n < boards.size(); n++)
+		{
+			for (unsigned int p=0; p < 6; p++)
+			{
+				HandStrength hs;
+				GameLogic::getStrength(&holes[n * 6 + p], &boards[n], &hs);
+				hs.setId(p);
+				sets[n].push_back(hs);
+			}
+		}
+		
+		pos = 0;
+	}
+	
+	void run()
+	{
+		vector< vector<HandStrength> > winlist;
+		GameLogic::getWinList(sets[pos++ % sets.size()], winlist);
+		sink += winlist.size();
+	}
+	
+private:
+	vector< vector<HandStrength> > sets;
+	unsigned int pos;
+};
+
+class BenchInsuranceOuts : public Benchmark
+{
+public:
+	BenchInsuranceOuts() : Benchmark("gamelogic_getinsuranceouts", 5000) {};
+	
+	void setup()
+	{
+		const unsigned int count = 64;
+		vector<HoleCards> holes;
+		vector<CommunityCards> boards;
+		Deck rest[count];
+		
+		// heads-up all-in on the turn; the river comes from the remaining deck
+		deal_hands(count, 2, holes, boards, 4, rest);
+		
+		for (unsigned int n=0; n < count; n++)
+		{
+			HandStrength a, b;
+			GameLogic::getStrength(&holes[n * 2], &boards[n], &a);
+			GameLogic::getStrength(&holes[n * 2 + 1], &boards[n], &b);
+			a.setId(0);
+			b.setId(1);
+			
+			if (a == b)
+				continue;
+			
+			spot s;
+			s.winner = (a > b) ? a : b;
+			s.losers.push_back((a > b) ? b : a);
+			s.deck = rest[n];
+			spots.push_back(s);
+		}
+		
+		pos = 0;
+	}
+	
+	void run()
+	{
+		spot &s = spots[pos++ % spots.size()];
+		
+		cardmask_type outs = 0;
+		GameLogic::getInsuranceOuts(&s.winner, &s.losers, s.deck, &outs, NULL);
+		sink += Card::countMask(outs);
+	}
+	
+private:
+	typedef struct {
+		HandStrength winner;
+		vector<HandStrength> losers;
+		Deck deck;
+	} spot;
+	
+	vector<spot> spots;
+	unsigned int pos;
+};
+
+class BenchCollectBets : public Benchmark
+{
+public:
+	BenchCollectBets() : Benchmark("table_collectbets", 500000) {};
+	
+	void run()
+	{
+		// resetting the bets is part of the measured operation
+		BenchTable::prepareBets(&table, players);
+		sink += BenchTable::collectBets(&table);
+	}
+	
+private:
+	Table table;
+	Player players[10];
+};
+
+class BenchTokenizer : public Benchmark
+{
+public:
+	BenchTokenizer() : Benchmark("tokenizer_parse", 1000000), t(" ") {};
+	
+	void setup()
+	{
+		lines.push_back("12 ACTION 3 raise 400");
+		lines.push_back("CHAT 3:0 nice hand");
+		lines.push_back("REQUEST gameinfo 1 2 3 4 5 6 7 8");
+		lines.push_back("PCLIENT 9999 b8c3a5e2-77f1-4a0e-9d1c-0e4d2f1a6b3c 1234");
+		pos = 0;
+	}
+	
+	void run()
+	{
+		t.parse(lines[pos++ % lines.size()]);
+		sink += t.count();
+	}
+	
+private:
+	Tokenizer t;
+	vector<string> lines;
+	unsigned int pos;
+};
+
+class BenchTableSnapshot : public Benchmark
+{
+public:
+	BenchTableSnapshot() : Benchmark("gamecontroller_sendtablesnapshot", 200000), game(NULL) {};
+	~BenchTableSnapshot() { delete game; };
+	
+	void setup()
+	{
+		game = new GameController();
+		game->setPlayerMax(6);
+		
+		vector<Player*> seated;
+		for (int cid=1; cid <= 6; cid++)
+			seated.push_back(BenchTable::addPlayer(game, cid, 1500));
+		
+		table = game->createTable(seated);
+		
+		BenchTable::prepareSnapshot(table);
+	}
+	
+	void run()
+	{
+		game->sendTableSnapshot(table);
+		sink++;
+	}
+	
+private:
+	GameController *game;
+	Table *table;
+};
+
+
+typedef struct {
+	const char *name;
+	unsigned int iterations;
+	double ns_per_op;
+	double allocs_per_op;
+} bench_result;
+
+static bench_result bench_measure(Benchmark *b, unsigned int iterations, unsigned int warmup)
+{
+	b->setup();
+	
+	for (unsigned int i=0; i < warmup; i++)
+		b->run();
+	
+	const unsigned long long allocs_start = alloc_count;
+	const unsigned long long start = sys_clock_usec();
+	
+	for (unsigned int i=0; i < iterations; i++)
+		b->run();
+	
+	const unsigned long long usec = sys_clock_usec() - start;
+	
+	bench_result r;
+	r.name = b->name();
+	r.iterations = iterations;
+	r.ns_per_op = usec * 1000.0 / iterations;
+	r.allocs_per_op = (double) (alloc_count - allocs_start) / iterations;
+	
+	return r;
+}
+
+static void bench_json(FILE *fp, const vector<bench_result> &results)
+{
+	fprintf(fp, "{\n\t\"timestamp\": %u,\n\t\"benchmarks\": [\n", (unsigned int) time(NULL));
+	
+	for (unsigned int i=0; i < results.size(); i++)
+	{
+		const bench_result &r = results[i];
+		
+		fprintf(fp, "\t\t{ \"name\": \"%s\", \"iterations\": %u, \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f }%s\n",
+			r.name, r.iterations, r.ns_per_op, r.allocs_per_op,
+			(i + 1 < results.size()) ? "," : "");
+	}
+	
+	fprintf(fp, "\t]\n}\n");
+}
+
+
+int main(int argc, char **argv)
+{
+	unsigned int iterations = 0;	// 0: each benchmark's default
+	int warmup = -1;		// -1: a tenth of the iterations
+	const char *outfile = NULL;
+	const char *filter = NULL;
+	
+	for (int i=1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+			warmup = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			outfile = argv[++i];
+		else if (argv[i][0] != '-')
+			filter = argv[i];
+		else
+		{
+			fprintf(stderr, "usage: %s [-n iterations] [-w warmup] [-o file.json] [name-filter]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	// only errors of the benchmarked code are of interest
+	log_set_severity(LogError);
+	
+	// same input data on every run
+	srand(12345);
+	
+	Benchmark *benchmarks[] = {
+		new BenchCardParse(),
+		new BenchDeckShuffle(),
+		new BenchStrength(),
+		new BenchWinList(),
+		new BenchInsuranceOuts(),
+		new BenchCollectBets(),
+		new BenchTokenizer(),
+		new BenchTableSnapshot(),
+	};
+	const unsigned int bench_count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+	
+	vector<bench_result> results;
+	
+	for (unsigned int i=0; i < bench_count; i++)
+	{
+		Benchmark *b = benchmarks[i];
+		
+		if (!filter || strstr(b->name(), filter))
+		{
+			const unsigned int n = iterations ? iterations : b->iterations();
+			const unsigned int w = (warmup >= 0) ? (unsigned int) warmup : n / 10;
+			
+			const bench_result r = bench_measure(b, n, w);
+			results.push_back(r);
+			
+			fprintf(stderr, "%-36s %10u ops %12.1f ns/op %8.2f allocs/op\n",
+				r.name, r.iterations, r.ns_per_op, r.allocs_per_op);
+		}
+		
+		delete b;
+	}
+	
+	FILE *fp = outfile ? fopen(outfile, "w") : stdout;
+	if (!fp)
+	{
+		fprintf(stderr, "cannot write %s\n", outfile);
+		return 1;
+	}
+	
+	bench_json(fp, results);
+	
+	if (outfile)
+		fclose(fp);
+	
+	return 0;
+}
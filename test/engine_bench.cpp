@@ -0,0 +1,673 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+
+
+/* Throughput benchmark of the whole game engine, without any networking.
+ *
+ *   engine_bench [-t sitandgo|sng|tournament] [-g games] [-p players] [-s steps] [-i] [-o file.json]
+ *
+ * Runs several games in-process with scripted bots. The engine takes its time
+ * from GameController::now(); the clock is advanced by one second per step, so
+ * table delays and player timeouts pass without waiting. Snapshots and chat
+ * messages are formatted like game.cpp does and then only counted.
+ * Insurance (-i) is only offered in Sit&Go ring games; SNG has none.
+ *
+ * A tournament (one of 1000 entrants by default) also checks its seating: after
+ * each hand a table holds at most one player more than the shortest table,
+ * a broken table empties out unless all other tables are full, and
+ * hand-for-hand play is released within BENCH_HFH_STALL steps. Each finished
+ * tournament must end with a single winner. Violations are reported and make
+ * the bench fail.
+ *
+ * Reported: hands/sec and ticks/sec (wall clock), p50/p99 latency of the
+ * tick per table state and of the dispatched player actions, the snapshot
+ * bytes sent per hand and the heap allocations per hand (counted by the
+ * operator new below, so pool chunks and STL storage are both included).
+ * Allocations for replacing a finished game by a new one and of the tick
+ * that starts a game (seating, opening the tables) are reported separately
+ * as setup; the bots themselves reuse their buffers.
+ * The PRNG is seeded with a fixed value, so all runs play the same hands.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "Config.h"
+#include "Platform.h"
+#include "Logger.h"
+#include "SysAccess.h"
+#include "Metrics.hpp"
+#include "Protocol.h"
+
+#include "Card.hpp"
+#include "Player.hpp"
+
+#include "GameController.hpp"
+#include "SitAndGoGameController.hpp"
+#include "SNGGameController.hpp"
+#include "TournamentGameController.hpp"
+#include "Table.hpp"
+#include "ObjectPool.hpp"
+
+
+using namespace std;
+
+
+// steps a tournament may wait for a hand-for-hand release
+#define BENCH_HFH_STALL  600
+
+
+// every heap allocation of the process is counted
+static unsigned long long alloc_count = 0;
+
+// kept out of line; once inlined, GCC takes malloc()/free() for a mismatched new/delete
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void* operator new(size_t size)
+{
+	alloc_count++;
+	
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw bad_alloc();
+	
+	return p;
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void *p) throw()
+{
+	free(p);
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void *p, size_t) throw()
+{
+	free(p);
+}
+
+
+// something for a bot to react on; queued by the snapshot sink
+typedef struct {
+	int sid;
+	int gid;
+	int cid;
+	char message[256];
+} bot_event;
+
+// swapped by bot_events(); both keep their storage
+static vector<bot_event> events, pending_events;
+
+static unsigned long long snapshot_count = 0;
+static unsigned long long snapshot_bytes = 0;
+static unsigned long long chat_bytes = 0;
+
+// index 0 is a table in delay, the others are Table::State + 1
+static const unsigned int TableStates = Table::Resume + 2;
+static MetricHistogram table_tick[TableStates];
+static MetricHistogram player_action;
+
+static const char *state_names[TableStates] = {
+	"delay", "gamestart", "electdealer", "newround", "blinds", "betting",
+	"bettingend", "askshow", "allfolded", "showdown", "endround",
+	"suspend", "resume"
+};
+
+
+// GameController sends its messages through these (see game.cpp)
+bool client_chat(int from_gid, int from_tid, int to, const char *message)
+{
+	char msg[1024];
+	
+	chat_bytes += snprintf(msg, sizeof(msg), "MSG %d:%d %s %s",
+		from_gid, from_tid, (from_tid == -1) ? "game" : "table", message) + 2;
+	
+	return true;
+}
+
+bool client_snapshot(int from_gid, int from_tid, int to, int sid, const char *message)
+{
+	char buf[1024];
+	
+	snapshot_count++;
+	snapshot_bytes += snprintf(buf, sizeof(buf), "SNAP %d:%d %d %s",
+		from_gid, from_tid, sid, message) + 2;
+	
+	if (sid == SnapBuyInsurance ||
+		(sid == SnapGameState && atoi(message) == SnapGameStateBroke))
+	{
+		events.resize(events.size() + 1);
+		bot_event &e = events.back();
+		e.sid = sid;
+		e.gid = from_gid;
+		e.cid = to;
+		snprintf(e.message, sizeof(e.message), "%s", message);
+	}
+	
+	return true;
+}
+
+void metrics_table_tick(int state, unsigned long long usec)
+{
+	const unsigned int idx = state + 1;
+	
+	if (idx < TableStates)
+		table_tick[idx].record(usec);
+}
+
+
+//! \brief Access to Table and Player internals for the bots
+class BenchTable
+{
+public:
+	//! \brief Client-id of the player the table waits for, or -1
+	static int waitingPlayer(Table *t, chips_type *to_call, chips_type *stake)
+	{
+		if (t->delay || t->state != Table::Betting || t->nomoreaction || t->cur_player < 0)
+			return -1;
+		
+		Table::Seat *s = &(t->seats[t->cur_player]);
+		if (!s->occupied || !s->player || s->player->stake == 0 || s->player->next_action.valid)
+			return -1;
+		
+		*to_call = t->bet_amount - s->bet;
+		*stake = s->player->stake;
+		
+		return s->player->client_id;
+	}
+	
+	static chips_type seatBet(Table *t)
+	{
+		return t->seats[t->cur_player].bet;
+	}
+};
+
+
+typedef enum {
+	SitAndGo,
+	SNG,
+	Tournament
+} bench_type;
+
+static const char *type_names[] = { "sitandgo", "sng", "tournament" };
+
+static unsigned long long tables_broken = 0;
+static unsigned long long hfh_releases = 0;
+static unsigned long long violations = 0;
+
+
+static void bench_violation(int gid, const char *what)
+{
+	// the first ones are enough to look into it
+	if (violations++ < 10)
+		fprintf(stderr, "game %d: %s\n", gid, what);
+}
+
+//! \brief Tournament checking its seating after every hand and every tick
+class BenchTournament : public TournamentGameController
+{
+public:
+	BenchTournament() : seen_generation(0), stalled_steps(0) { };
+	
+	int tick()
+	{
+		const int rc = TournamentGameController::tick();
+		
+		// emptied tables are removed in the same tick
+		for (set<int>::const_iterator e = emptied.begin(); e != emptied.end(); e++)
+			if (tables.find(*e) != tables.end())
+				bench_violation(game_id, "broken table still open");
+		emptied.clear();
+		
+		if (hfh_generation != seen_generation)
+		{
+			hfh_releases += hfh_generation - seen_generation;
+			seen_generation = hfh_generation;
+			stalled_steps = 0;
+		}
+		else if (hfh_waiting_count && ++stalled_steps == BENCH_HFH_STALL)
+			bench_violation(game_id, "hand-for-hand not released");
+		
+		if (rc < 0 && (players_left != 1 || finish_list.size() != max_players))
+			bench_violation(game_id, "ended without a single winner");
+		
+		return rc;
+	};
+	
+	void stateEndRound(Table *t)
+	{
+		TournamentGameController::stateEndRound(t);
+		
+		if (tables.size() < 2)
+			return;
+		
+		const int tid = t->getTableId();
+		const unsigned int load = table_infos[tid].load;
+		
+		// shortest table besides this one
+		unsigned int shortest = SeatsPerTable;
+		for (table_loads_type::const_iterator e = table_loads.begin(); e != table_loads.end(); e++)
+			if (e->second != tid)
+			{
+				shortest = e->first;
+				break;
+			}
+		
+		// same condition as in stateEndRound()
+		if (players_left <= (tables.size() - 1) * SeatsPerTable)
+		{
+			tables_broken++;
+			
+			if (!load)
+				emptied.insert(tid);
+			else if (shortest < SeatsPerTable)
+				bench_violation(game_id, "broken table kept players while others had room");
+		}
+		else if (load > shortest + 1)
+			bench_violation(game_id, "table left unbalanced");
+	};
+	
+private:
+	int seen_generation;
+	unsigned int stalled_steps;
+	set<int> emptied;
+};
+
+typedef struct {
+	bench_type type;
+	unsigned int games;
+	unsigned int players;
+	unsigned int steps;
+	bool insurance;
+	chips_type stake;
+} bench_config;
+
+static bench_config cfg;
+static map<int,GameController*> games;
+static int next_gid = 1;
+static int next_cid = 1;
+static unsigned long long hands = 0;
+static unsigned long long games_finished = 0;
+static unsigned long long rebuys = 0;
+static unsigned long long insurance_asked = 0;
+static unsigned long long insurance_bought = 0;
+
+
+static string bot_uuid(int cid)
+{
+	char uuid[32];
+	snprintf(uuid, sizeof(uuid), "bot-%d", cid);
+	return uuid;
+}
+
+static GameController* game_create()
+{
+	GameController *g;
+	
+	if (cfg.type == SitAndGo)
+	{
+		SitAndGoGameController *sg = new SitAndGoGameController();
+		sg->setExpireIn(1 << 30);
+		g = sg;
+	}
+	else if (cfg.type == SNG)
+		g = new SNGGameController();
+	else
+		g = new BenchTournament();
+	
+	const int gid = next_gid++;
+	
+	g->setGameId(gid);
+	g->setPlayerMax(cfg.players);
+	g->setPlayerTimeout(30);
+	g->setPlayerStakes(cfg.stake);
+	g->setName("bench");
+	g->setBlindsStart(20);
+	g->setBlindsFactor(20);
+	g->setBlindsTime(300);
+	g->setRestart(false);
+	g->setEnableInsurance(cfg.insurance);
+	
+	for (unsigned int i=0; i < cfg.players; i++)
+	{
+		const int cid = next_cid++;
+		g->addPlayer(cid, bot_uuid(cid), cfg.stake);
+	}
+	
+	games[gid] = g;
+	
+	return g;
+}
+
+// bots fold 10%, call 60%, raise the minimum 25% and go all-in 5% of the time
+static void bot_act(GameController *g, Table *t)
+{
+	// a table takes at most one action per seat before it has to tick again
+	for (unsigned int i=0; i < 10; i++)
+	{
+		chips_type to_call, stake;
+		const int cid = BenchTable::waitingPlayer(t, &to_call, &stake);
+		if (cid < 0)
+			return;
+		
+		const int r = rand() % 100;
+		Player::PlayerAction action;
+		chips_type amount = 0;
+		
+		if (r < 10)
+			action = to_call ? Player::Fold : Player::Check;
+		else if (r < 70)
+			action = Player::Call;
+		else if (r < 95)
+		{
+			amount = g->determineMinimumBet(t);
+			action = (amount < BenchTable::seatBet(t) + stake) ? Player::Raise : Player::Allin;
+		}
+		else
+			action = Player::Allin;
+		
+		const unsigned long long start = sys_clock_usec();
+		g->setPlayerAction(cid, action, amount);
+		g->dispatchPlayerAction(cid);
+		player_action.record(sys_clock_usec() - start);
+	}
+}
+
+// half of the offers are declined, otherwise the smallest amount on the first out is bought
+static void bot_insurance(GameController *g, const bot_event &e)
+{
+	int max_payment, min_buy;
+	char outs[256];
+	
+	if (sscanf(e.message, "%d %d %255s", &max_payment, &min_buy, outs) != 3)
+		return;
+	
+	insurance_asked++;
+	
+	static vector<Card> cards;
+	cards.clear();
+	chips_type amount = 0;
+	
+	if (rand() % 2 && strlen(outs) >= 2)
+	{
+		outs[2] = '\0';
+		cards.push_back(Card(outs));
+		amount = (min_buy > 0) ? min_buy : 1;
+	}
+	
+	if (amount && g->clientBuyInsurance(e.cid, amount, cards))
+		insurance_bought++;
+	else
+	{
+		cards.clear();
+		g->clientBuyInsurance(e.cid, 0, cards);
+	}
+}
+
+static void bot_events()
+{
+	// reacting may queue new events
+	vector<bot_event> &pending = pending_events;
+	pending.clear();
+	pending.swap(events);
+	
+	for (unsigned int i=0; i < pending.size(); i++)
+	{
+		const bot_event &e = pending[i];
+		
+		map<int,GameController*>::iterator it = games.find(e.gid);
+		if (it == games.end())
+			continue;
+		
+		GameController *g = it->second;
+		
+		if (e.sid == SnapBuyInsurance)
+			bot_insurance(g, e);
+		else if (cfg.type == SitAndGo)
+		{
+			// broke in a ring game: the bot buys in again for the next round
+			int broke_cid;
+			if (sscanf(e.message, "%*d %d", &broke_cid) != 1 || broke_cid != e.cid)
+				continue;
+			
+			g->rebuy(broke_cid, cfg.stake);
+			rebuys++;
+		}
+	}
+}
+
+
+static void quantiles_json(FILE *fp, const char *name, const MetricHistogram &h, bool last)
+{
+	fprintf(fp, "\t\t\"%s\": { \"count\": %llu, \"p50_usec\": %llu, \"p99_usec\": %llu, \"max_usec\": %llu }%s\n",
+		name, h.count(), h.quantile(0.5), h.quantile(0.99), h.max(), last ? "" : ",");
+}
+
+
+int main(int argc, char **argv)
+{
+	cfg.type = SitAndGo;
+	cfg.games = 0;
+	cfg.players = 0;
+	cfg.steps = 2000;
+	cfg.insurance = false;
+	cfg.stake = 1500;
+	
+	const char *outfile = NULL;
+	
+	for (int i=1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-t") && i + 1 < argc)
+		{
+			const char *type = argv[++i];
+			if (!strcmp(type, "sitandgo"))
+				cfg.type = SitAndGo;
+			else if (!strcmp(type, "sng"))
+				cfg.type = SNG;
+			else if (!strcmp(type, "tournament"))
+				cfg.type = Tournament;
+			else
+			{
+				fprintf(stderr, "unknown game type %s\n", type);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "-g") && i + 1 < argc)
+			cfg.games = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+			cfg.players = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+			cfg.steps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-i"))
+			cfg.insurance = true;
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			outfile = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [-t sitandgo|sng|tournament] [-g games] [-p players] [-s steps] [-i] [-o file.json]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	// a tournament is played by a whole field
+	const unsigned int max_players = (cfg.type == Tournament) ? 10000 : 10;
+	if (!cfg.games)
+		cfg.games = (cfg.type == Tournament) ? 1 : 1000;
+	if (!cfg.players)
+		cfg.players = (cfg.type == Tournament) ? 1000 : 6;
+	
+	if (cfg.games < 1 || cfg.players < 2 || cfg.players > max_players)
+	{
+		fprintf(stderr, "need at least one game and 2-%u players\n", max_players);
+		return 1;
+	}
+	
+	// only errors of the engine are of interest
+	log_set_severity(LogError);
+	
+	// same hands on every run
+	srand(12345);
+	
+	time_t clock = time(NULL);
+	GameController::setClock(clock);
+	
+	for (unsigned int i=0; i < cfg.games; i++)
+		game_create();
+	
+	unsigned long long ticks = 0;
+	const unsigned long long start = sys_clock_usec();
+	const unsigned long long allocs_start = alloc_count;
+	unsigned long long allocs_setup = 0;
+	
+	for (unsigned int step=0; step < cfg.steps; step++)
+	{
+		for (map<int,GameController*>::iterator e = games.begin(); e != games.end();)
+		{
+			GameController *g = e->second;
+			
+			ticks++;
+			const bool starting = !g->isStarted();
+			const unsigned long long tick_start = alloc_count;
+			
+			if (g->tick() < 0)
+			{
+				// a finished game is replaced by a new one
+				hands += g->hand_no;
+				games_finished++;
+				
+				const unsigned long long setup_start = alloc_count;
+				
+				delete g;
+				games.erase(e++);
+				
+				game_create();
+				
+				allocs_setup += alloc_count - setup_start;
+				continue;
+			}
+			
+			if (starting && g->isStarted())
+				allocs_setup += alloc_count - tick_start;
+			
+			for (GameController::tables_type::iterator t = g->tables.begin(); t != g->tables.end(); t++)
+				bot_act(g, t->second);
+			
+			++e;
+		}
+		
+		bot_events();
+		
+		GameController::setClock(++clock);
+	}
+	
+	const unsigned long long usec = sys_clock_usec() - start;
+	const unsigned long long allocs = alloc_count - allocs_start - allocs_setup;
+	
+	for (map<int,GameController*>::iterator e = games.begin(); e != games.end(); e++)
+	{
+		hands += e->second->hand_no;
+		delete e->second;
+	}
+	
+	const double sec = usec / 1000000.0;
+	
+	fprintf(stderr, "%s: %u games x %u players, %u steps in %.2f s\n",
+		type_names[cfg.type], cfg.games, cfg.players, cfg.steps, sec);
+	fprintf(stderr, "%llu hands (%.0f/s), %llu ticks (%.0f/s), %llu games finished, %llu rebuys\n",
+		hands, hands / sec, ticks, ticks / sec, games_finished, rebuys);
+	fprintf(stderr, "%llu snapshots, %.0f snapshot bytes/hand, %llu/%llu insurance offers bought\n",
+		snapshot_count, hands ? (double) snapshot_bytes / hands : 0.0, insurance_bought, insurance_asked);
+	fprintf(stderr, "%llu heap allocations (%.1f/hand), %llu for new games, pool chunks: %llu player, %llu table\n",
+		allocs, hands ? (double) allocs / hands : 0.0, allocs_setup,
+		ObjectPool<Player>::chunkAllocs(), ObjectPool<Table>::chunkAllocs());
+	
+	if (cfg.type == Tournament)
+		fprintf(stderr, "%llu tables broken, %llu hand-for-hand releases, %llu seating violations\n",
+			tables_broken, hfh_releases, violations);
+	
+	for (unsigned int i=0; i < TableStates; i++)
+		if (table_tick[i].count())
+			fprintf(stderr, "  %-12s %10llu ticks  p50 %6llu us  p99 %6llu us\n",
+				state_names[i], table_tick[i].count(), table_tick[i].quantile(0.5), table_tick[i].quantile(0.99));
+	
+	fprintf(stderr, "  %-12s %10llu calls  p50 %6llu us  p99 %6llu us\n",
+		"action", player_action.count(), player_action.quantile(0.5), player_action.quantile(0.99));
+	
+	FILE *fp = outfile ? fopen(outfile, "w") : stdout;
+	if (!fp)
+	{
+		fprintf(stderr, "cannot write %s\n", outfile);
+		return 1;
+	}
+	
+	fprintf(fp, "{\n\t\"timestamp\": %u,\n", (unsigned int) time(NULL));
+	fprintf(fp, "\t\"type\": \"%s\",\n\t\"games\": %u,\n\t\"players\": %u,\n\t\"steps\": %u,\n\t\"insurance\": %s,\n",
+		type_names[cfg.type], cfg.games, cfg.players, cfg.steps,
+		cfg.insurance ? "true" : "false");
+	fprintf(fp, "\t\"hands\": %llu,\n\t\"hands_per_sec\": %.1f,\n\t\"ticks\": %llu,\n\t\"ticks_per_sec\": %.1f,\n",
+		hands, hands / sec, ticks, ticks / sec);
+	fprintf(fp, "\t\"snapshots\": %llu,\n\t\"snapshot_bytes_per_hand\": %.1f,\n\t\"chat_bytes\": %llu,\n",
+		snapshot_count, hands ? (double) snapshot_bytes / hands : 0.0, chat_bytes);
+	fprintf(fp, "\t\"games_finished\": %llu,\n\t\"rebuys\": %llu,\n", games_finished, rebuys);
+	fprintf(fp, "\t\"tables_broken\": %llu,\n\t\"hfh_releases\": %llu,\n\t\"seating_violations\": %llu,\n",
+		tables_broken, hfh_releases, violations);
+	fprintf(fp, "\t\"heap_allocs\": %llu,\n\t\"heap_allocs_per_hand\": %.1f,\n\t\"heap_allocs_setup\": %llu,\n",
+		allocs, hands ? (double) allocs / hands : 0.0, allocs_setup);
+	fprintf(fp, "\t\"pool_chunks_player\": %llu,\n\t\"pool_chunks_table\": %llu,\n",
+		ObjectPool<Player>::chunkAllocs(), ObjectPool<Table>::chunkAllocs());
+	fprintf(fp, "\t\"insurance_offers\": %llu,\n\t\"insurance_bought\": %llu,\n",
+		insurance_asked, insurance_bought);
+	fprintf(fp, "\t\"latency\": {\n");
+	
+	for (unsigned int i=0; i < TableStates; i++)
+		quantiles_json(fp, state_names[i], table_tick[i], false);
+	
+	quantiles_json(fp, "action", player_action, true);
+	
+	fprintf(fp, "\t}\n}\n");
+	
+	if (outfile)
+		fclose(fp);
+	
+	// a tournament bench that never saw the field shrink to one table checked nothing
+	if (cfg.type == Tournament && !games_finished)
+	{
+		fprintf(stderr, "no tournament finished within %u steps\n", cfg.steps);
+		return 1;
+	}
+	
+	return violations ? 1 : 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+/* Card masks and insurance outs over fixed boards; no randomness involved. */
+
+#include <cstdio>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Card.hpp"
+#include "Deck.hpp"
+#include "HoleCards.hpp"
+#include "CommunityCards.hpp"
+#include "GameLogic.hpp"
+
+#include "TestCase.hpp"
+
+
+using namespace std;
+
+
+static cardmask_type mask_of(const char *cards)
+{
+	cardmask_type mask = 0;
+
+	for (const char *c = cards; c[0] && c[1]; c += (c[2] ? 3 : 2))
+		mask |= Card(c).getMask();
+
+	return mask;
+}
+
+
+//! \brief Bit layout of cardmask_type and the helpers working on it
+class TestCardMask : public TestCase
+{
+public:
+	TestCardMask() { setName("TestCardMask"); };
+
+	bool run()
+	{
+		cardmask_type all = 0;
+		bool unique = true, roundtrip = true;
+
+		for (int f = Card::FirstFace; f <= Card::LastFace; f++)
+		{
+			for (int s = Card::FirstSuit; s <= Card::LastSuit; s++)
+			{
+				const Card c((Card::Face) f, (Card::Suit) s);
+				const Card back = Card::fromMaskIndex(c.getMaskIndex());
+
+				if (all & c.getMask())
+					unique = false;
+				all |= c.getMask();
+
+				if (back.getFace() != c.getFace() || back.getSuit() != c.getSuit())
+					roundtrip = false;
+			}
+		}
+
+		test(unique, "every card has its own bit");
+		test(roundtrip, "fromMaskIndex(getMaskIndex()) gives the same card");
+		test(all == (1ULL << 52) - 1, "52 cards fill the lowest 52 bits");
+
+		test(Card("2c").getMaskIndex() == 0, "2c is bit 0");
+		test(Card("As").getMaskIndex() == 51, "As is bit 51");
+		test(Card("Td").getMaskIndex() == 33, "Td is bit 33");
+
+		test(Card::countMask(0) == 0, "empty mask counts 0");
+		test(Card::countMask(all) == 52, "full mask counts 52");
+		test(Card::countMask(mask_of("Ah Ad Ah")) == 2, "duplicate card counts once");
+
+		test(Card::highestMaskIndex(1) == 0, "highest of 2c is 0");
+		test(Card::highestMaskIndex(mask_of("3d Kh 7s")) == Card("Kh").getMaskIndex(), "highest of 3d Kh 7s is Kh");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+//! \brief Outs of heads-up and multi-way hands on the turn
+class TestInsuranceOuts : public TestCase
+{
+public:
+	//! \param losers  hole cards of the losing hands, two cards each
+	TestInsuranceOuts(const char *name, const char *winner, const vector<string> &losers, const char *board,
+		unsigned int outs, unsigned int divided, cardmask_type expected)
+		: m_winner(winner), m_losers(losers), m_board(board),
+		m_outs(outs), m_divided(divided), m_expected(expected)
+	{
+		setName(name);
+	};
+
+	bool run()
+	{
+		CommunityCards cc;
+		cc.setFlop(Card(m_board), Card(m_board + 3), Card(m_board + 6));
+		cc.setTurn(Card(m_board + 9));
+
+		Deck deck;
+		deck.fill();
+		removeCards(&deck, m_board);
+		removeCards(&deck, m_winner);
+
+		HandStrength winner = strength(m_winner, &cc, 0);
+
+		vector<HandStrength> losers, all;
+		all.push_back(winner);
+		for (unsigned int i=0; i < m_losers.size(); i++)
+		{
+			removeCards(&deck, m_losers[i].c_str());
+			losers.push_back(strength(m_losers[i].c_str(), &cc, i + 1));
+			all.push_back(losers.back());
+		}
+
+		vector< vector<HandStrength> > winlist;
+		GameLogic::getWinList(all, winlist);
+		if (!test(winlist[0].size() == 1 && winlist[0][0].getId() == 0, "winner leads on the turn"))
+			return false;
+
+		cardmask_type outs = 0, divided = 0;
+		cardmask_type every_single_outs[10] = { 0 };
+
+		GameLogic::getInsuranceOuts(&winner, &losers, deck, &outs, every_single_outs);
+		GameLogic::getInsuranceOutsDivided(&winner, all, &winlist, deck, &divided);
+
+		char desc[64];
+		snprintf(desc, sizeof(desc), "%u outs", m_outs);
+		test(Card::countMask(outs) == m_outs, desc);
+
+		snprintf(desc, sizeof(desc), "%u split cards", m_divided);
+		test(Card::countMask(divided) == m_divided, desc);
+
+		test((outs | divided) == m_expected, "outs and split cards are the expected cards");
+
+		cardmask_type merged = 0;
+		for (unsigned int i=0; i < 10; i++)
+			merged |= every_single_outs[i];
+		test(merged == outs, "outs per seat add up to all outs");
+		test(every_single_outs[0] == 0, "winner has no outs against itself");
+
+		return (countFailed() == 0);
+	};
+
+private:
+	static void removeCards(Deck *deck, const char *cards)
+	{
+		for (const char *c = cards; c[0] && c[1]; c += (c[2] ? 3 : 2))
+			deck->debugRemoveCard(Card(c));
+	};
+
+	static HandStrength strength(const char *hole, const CommunityCards *cc, int id)
+	{
+		HoleCards h;
+		h.setCards(Card(hole), Card(hole + 3));
+
+		HandStrength hs;
+		GameLogic::getStrength(&h, cc, &hs);
+		hs.setId(id);
+
+		return hs;
+	};
+
+	const char *m_winner;
+	vector<string> m_losers;
+	const char *m_board;
+	unsigned int m_outs;
+	unsigned int m_divided;
+	cardmask_type m_expected;
+};
+
+
+int main(void)
+{
+	vector<string> set_draw, flush_draw, both, low_pair;
+	set_draw.push_back("Qc Qd");
+	flush_draw.push_back("8h 9h");
+	both.push_back("Qc Qd");
+	both.push_back("8h 9h");
+	low_pair.push_back("2s 2d");
+
+	TestCase *tests[] = {
+		new TestCardMask(),
+		new TestInsuranceOuts("set draw", "As Ad", set_draw, "Kh 4h 2c 7s",
+			2, 0, mask_of("Qh Qs")),
+		new TestInsuranceOuts("flush draw", "As Ad", flush_draw, "Kh 4h 2c 7s",
+			9, 0, mask_of("2h 3h 5h 6h 7h Th Jh Qh Ah")),
+		// Qh completes both draws and is counted once
+		new TestInsuranceOuts("two draws", "As Ad", both, "Kh 4h 2c 7s",
+			10, 0, mask_of("Qs 2h 3h 5h 6h 7h Th Jh Qh Ah")),
+		// a king or an eight puts a straight on the board for both hands
+		new TestInsuranceOuts("board straight", "3s 3d", low_pair, "9c Tc Jd Qh",
+			2, 8, mask_of("2c 2h 8c 8d 8h 8s Kc Kd Kh Ks")),
+	};
+
+	const unsigned int test_count = sizeof(tests) / sizeof(tests[0]);
+	unsigned int failed_tests = 0;
+
+	for (unsigned int i=0; i < test_count; i++)
+	{
+		TestCase *tc = tests[i];
+
+		const bool retval = tc->run();
+
+		cerr << "<<< END test (#" << (i+1) << ") " << tc->name() <<
+			": RESULT=" << (retval ? "ok" : "err") << " OK=" << tc->countSuccess() <<
+			" FAIL=" << tc->countFailed() << " <<<" << endl;
+
+		if (!retval)
+			failed_tests++;
+	}
+
+	cerr << endl << "Tests failed: " << failed_tests << " of " << test_count << endl;
+
+	return failed_tests ? 1 : 0;
+}
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2008, 2009, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+/* Table::collectBets() against fixed bet layouts and against the former
+ * builder, which rescanned all seats once per all-in level. */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <iostream>
+#include <vector>
+
+#include "Player.hpp"
+#include "Table.hpp"
+
+#include "TestCase.hpp"
+
+
+using namespace std;
+
+
+// GameController sends its messages through these (see game.cpp)
+bool client_chat(int from_gid, int from_tid, int to, const char *message)
+{
+	return true;
+}
+
+bool client_snapshot(int from_gid, int from_tid, int to, int sid, const char *message)
+{
+	return true;
+}
+
+
+//! \brief One seat of a bet layout; a stake of 0 means the player is all-in
+typedef struct {
+	bool occupied;
+	bool in_round;
+	chips_type bet;
+	chips_type stake;
+} seat_layout;
+
+
+//! \brief Specialized testcase for the pot builder of Table
+class TestCaseTable : public TestCase
+{
+public:
+	TestCaseTable() { setName("TestCaseTable"); reset(); };
+
+protected:
+	//! \brief Empty table with one empty main pot
+	void reset()
+	{
+		for (unsigned int i=0; i < 10; i++)
+		{
+			table.setOccupied(i, false);
+			table.setInRound(i, false);
+			table.seats[i].bet = 0;
+			table.seats[i].player = &players[i];
+		}
+
+		table.pots.clear();
+		Table::Pot pot;
+		pot.amount = 0;
+		pot.involved_mask = 0;
+		pot.final = false;
+		table.pots.push_back(pot);
+	};
+
+	void seat(unsigned int s, chips_type bet, chips_type stake, bool folded=false)
+	{
+		table.setOccupied(s, true);
+		table.setInRound(s, !folded);
+		table.seats[s].bet = bet;
+		players[s].setStake(stake);
+	};
+
+	void layout(const seat_layout *l)
+	{
+		for (unsigned int i=0; i < 10; i++)
+		{
+			table.setOccupied(i, l[i].occupied);
+			table.setInRound(i, l[i].in_round);
+			table.seats[i].bet = l[i].bet;
+			players[i].setStake(l[i].stake);
+		}
+	};
+
+	bool pot(unsigned int i, chips_type amount, unsigned int mask, bool final)
+	{
+		if (i >= table.pots.size())
+			return false;
+
+		const Table::Pot &p = table.pots[i];
+		return (p.amount == amount && p.involved_mask == mask && p.final == final);
+	};
+
+	vector<Table::Pot>& pots() { return table.pots; };
+
+	//! \brief Bets left on the table are the ones of the layout
+	bool sameBets(const seat_layout *l) const
+	{
+		for (unsigned int i=0; i < 10; i++)
+			if (table.seats[i].bet != l[i].bet)
+				return false;
+
+		return true;
+	};
+
+	bool betsCleared() const
+	{
+		for (unsigned int i=0; i < 10; i++)
+			if (table.seats[i].bet)
+				return false;
+
+		return true;
+	};
+
+	Table table;
+	Player players[10];
+};
+
+
+class TestFoldedBets : public TestCaseTable
+{
+public:
+	TestFoldedBets() { setName("folded bets"); };
+
+	bool run()
+	{
+		// seat 3 folded after putting in 50
+		seat(0, 100, 900);
+		seat(1, 100, 900);
+		seat(2, 100, 900);
+		seat(3, 50, 950, true);
+		table.collectBets();
+
+		test(pots().size() == 1, "one pot");
+		test(pot(0, 350, 0x7, false), "folded bet is in the pot, folder is not involved");
+		test(betsCleared(), "bets are collected");
+
+		// the next betting round adds to the same pot
+		seat(0, 200, 700);
+		seat(1, 200, 700);
+		seat(2, 0, 900, true);
+		table.collectBets();
+
+		test(pots().size() == 1, "still one pot");
+		test(pot(0, 750, 0x7, false), "second round adds to the main pot");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+class TestSidePots : public TestCaseTable
+{
+public:
+	TestSidePots() { setName("all-in side pots"); };
+
+	bool run()
+	{
+		// all-ins for 20 and 60, two callers of 100, a fold for 30
+		seat(0, 20, 0);
+		seat(2, 60, 0);
+		seat(5, 100, 400);
+		seat(7, 100, 400);
+		seat(8, 30, 470, true);
+		table.collectBets();
+
+		test(pots().size() == 3, "main pot and two side pots");
+		test(pot(0, 4 * 20 + 30, 0xa5, true), "main pot: four players and the folded bet");
+		test(pot(1, 3 * 40, 0xa4, true), "first side pot: all but the short all-in");
+		test(pot(2, 2 * 40, 0xa0, false), "second side pot: the callers, still open");
+		test(betsCleared(), "bets are collected");
+
+		// betting goes on in the open side pot
+		seat(5, 150, 250);
+		seat(7, 150, 250);
+		table.collectBets();
+
+		test(pots().size() == 3, "no new pot while the last one is open");
+		test(pot(2, 2 * 40 + 2 * 150, 0xa0, false), "second side pot grows");
+
+		// two equal all-ins close the pot without a new side pot
+		seat(5, 250, 0);
+		seat(7, 250, 0);
+		table.collectBets();
+
+		test(pots().size() == 3, "equal all-ins need no side pot");
+		test(pot(2, 2 * 40 + 2 * 150 + 2 * 250, 0xa0, true), "last pot is final");
+
+		// a final pot is never added to
+		seat(5, 10, 100);
+		seat(7, 10, 100);
+		table.collectBets();
+
+		test(pots().size() == 4, "bets after a final pot open a new one");
+		test(pot(3, 20, 0xa0, false), "new pot has the two bettors");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+//! \brief Random layouts, compared with the former builder
+class TestRandomLayouts : public TestCaseTable
+{
+public:
+	TestRandomLayouts(unsigned int layouts) : m_layouts(layouts) { setName("random layouts"); };
+
+	bool run()
+	{
+		srand(4711);
+
+		unsigned int mismatch = 0, sidepots = 0;
+
+		for (unsigned int n=0; n < m_layouts; n++)
+		{
+			seat_layout l[10];
+			vector<Table::Pot> expected;
+
+			reset();
+			expected = pots();
+
+			// up to three betting rounds into the same set of pots
+			const unsigned int rounds = 1 + rand() % 3;
+			for (unsigned int r=0; r < rounds; r++)
+			{
+				randomLayout(l);
+				layout(l);
+
+				reference(l, expected);
+				table.collectBets();
+			}
+
+			// both leave folded bets on the table when nobody in the hand has bet
+			if (!samePots(expected, pots()) || !sameBets(l))
+				mismatch++;
+
+			if (expected.size() > 1)
+				sidepots++;
+		}
+
+		char desc[64];
+		snprintf(desc, sizeof(desc), "%u layouts (%u with side pots) match", m_layouts, sidepots);
+		test(mismatch == 0, desc);
+		test(sidepots > m_layouts / 10, "layouts cover side pots");
+
+		return (countFailed() == 0);
+	};
+
+private:
+	static void randomLayout(seat_layout *l)
+	{
+		// a few bet sizes, so equal bets and equal all-ins are common
+		static const chips_type sizes[] = { 0, 10, 20, 20, 40, 50, 80, 100 };
+
+		for (unsigned int i=0; i < 10; i++)
+		{
+			l[i].occupied = (rand() % 10 < 7);
+			l[i].in_round = l[i].occupied && (rand() % 4 != 0);
+			l[i].bet = l[i].occupied ? sizes[rand() % 8] : 0;
+			l[i].stake = (rand() % 3 == 0) ? 0 : 1000;
+		}
+	};
+
+	//! \brief The pot builder before the layered version
+	static void reference(seat_layout *l, vector<Table::Pot> &pots)
+	{
+		do
+		{
+			chips_type smallest_bet = 0;
+			bool need_sidepot = false;
+
+			for (unsigned int i=0; i < 10; i++)
+			{
+				if (!l[i].occupied || !l[i].in_round || l[i].bet == 0)
+					continue;
+
+				if (smallest_bet == 0)
+					smallest_bet = l[i].bet;
+				else if (l[i].bet < smallest_bet)
+				{
+					smallest_bet = l[i].bet;
+					need_sidepot = true;
+				}
+				else if (l[i].bet > smallest_bet)
+					need_sidepot = true;
+			}
+
+			if (smallest_bet == 0)
+				return;
+
+			if (pots.back().final)
+			{
+				Table::Pot pot;
+				pot.amount = 0;
+				pot.involved_mask = 0;
+				pot.final = false;
+				pots.push_back(pot);
+			}
+
+			Table::Pot *cur_pot = &pots.back();
+
+			for (unsigned int i=0; i < 10; i++)
+			{
+				if (!l[i].occupied || l[i].bet == 0)
+					continue;
+
+				if (!l[i].in_round)
+				{
+					cur_pot->amount += l[i].bet;
+					l[i].bet = 0;
+					continue;
+				}
+
+				if (!need_sidepot)
+				{
+					cur_pot->amount += l[i].bet;
+					l[i].bet = 0;
+				}
+				else
+				{
+					cur_pot->amount += smallest_bet;
+					l[i].bet -= smallest_bet;
+				}
+
+				if (l[i].stake == 0)
+					cur_pot->final = true;
+
+				cur_pot->involved_mask |= 1u << i;
+			}
+
+			if (!need_sidepot)
+				break;
+
+		} while (true);
+	};
+
+	static bool samePots(const vector<Table::Pot> &a, const vector<Table::Pot> &b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (unsigned int i=0; i < a.size(); i++)
+			if (a[i].amount != b[i].amount || a[i].involved_mask != b[i].involved_mask || a[i].final != b[i].final)
+				return false;
+
+		return true;
+	};
+
+	unsigned int m_layouts;
+};
+
+
+int main(void)
+{
+	TestCase *tests[] = {
+		new TestFoldedBets(),
+		new TestSidePots(),
+		new TestRandomLayouts(20000),
+	};
+
+	const unsigned int test_count = sizeof(tests) / sizeof(tests[0]);
+	unsigned int failed_tests = 0;
+
+	for (unsigned int i=0; i < test_count; i++)
+	{
+		TestCase *tc = tests[i];
+
+		const bool retval = tc->run();
+
+		cerr << "<<< END test (#" << (i+1) << ") " << tc->name() <<
+			": RESULT=" << (retval ? "ok" : "err") << " OK=" << tc->countSuccess() <<
+			" FAIL=" << tc->countFailed() << " <<<" << endl;
+
+		if (!retval)
+			failed_tests++;
+	}
+
+	cerr << endl << "Tests failed: " << failed_tests << " of " << test_count << endl;
+
+	return failed_tests ? 1 : 0;
+}
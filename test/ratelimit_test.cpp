@@ -0,0 +1,235 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+/* Token buckets and strike escalation of RateLimiter, on a simulated clock. */
+
+#include <cstring>
+
+#include <iostream>
+
+#include "RateLimiter.hpp"
+
+#include "TestCase.hpp"
+
+
+using namespace std;
+
+
+#define SEC  1000000ULL
+
+
+//! \brief Fresh limiter and limits for each test; commands are classed by their text
+class TestCaseRateLimiter : public TestCase
+{
+public:
+	TestCaseRateLimiter()
+	{
+		setName("TestCaseRateLimiter");
+
+		// clientcon is zero-filled on connect, so the limiter is too
+		memset(&limiter, 0, sizeof(limiter));
+
+		for (unsigned int i=0; i < RateClasses; i++)
+		{
+			limits.rate[i] = 100;
+			limits.burst[i] = 100;
+		}
+
+		limits.delay_strikes = 2;
+		limits.disconnect_strikes = 4;
+		limits.forgive_usec = 10 * SEC;
+
+		now = 1000 * SEC;
+	};
+
+protected:
+	RateLimiter::Verdict send(const char *cmd)
+	{
+		return limiter.check(RateLimiter::commandClass(cmd, strlen(cmd)), now, limits);
+	};
+
+	RateLimiter limiter;
+	RateLimiter::Limits limits;
+	unsigned long long now;
+};
+
+
+class TestCommandClass : public TestCaseRateLimiter
+{
+public:
+	TestCommandClass() { setName("command classes"); };
+
+	bool run()
+	{
+		test(RateLimiter::commandClass("REQUEST serverinfo", 18) == RateQuery, "REQUEST is a query");
+		test(RateLimiter::commandClass("12 ACTION fold", 14) == RatePlay, "message-id is skipped");
+		test(RateLimiter::commandClass("  7  CREATE x", 13) == RateManage, "spaces around the message-id are skipped");
+		test(RateLimiter::commandClass("SYNC 3", 6) == RateNone, "SYNC is not limited");
+		test(RateLimiter::commandClass("CHAT -1 hi", 10) == RateGeneral, "other commands are general");
+		test(RateLimiter::commandClass("REQUESTS", 8) == RateGeneral, "whole word must match");
+		test(RateLimiter::commandClass("REQUEST serverinfo", 4) == RateGeneral, "only the framed length is read");
+		test(RateLimiter::commandClass("", 0) == RateGeneral, "empty line is general");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+class TestBuckets : public TestCaseRateLimiter
+{
+public:
+	TestBuckets() { setName("token buckets"); };
+
+	bool run()
+	{
+		limits.rate[RateGeneral] = 2;
+		limits.burst[RateGeneral] = 4;
+		limits.rate[RateQuery] = 1;
+		limits.burst[RateQuery] = 2;
+
+		// a new limiter starts with full buckets
+		unsigned int passed = 0;
+		for (unsigned int i=0; i < 4; i++)
+			if (send("CHAT -1 hi") == RateLimiter::Pass)
+				passed++;
+		test(passed == 4, "burst of the general bucket passes");
+
+		test(send("CHAT -1 hi") == RateLimiter::Delay, "empty bucket delays");
+		test(limiter.getStrikes() == 1 && limiter.isDelayed(), "first strike");
+
+		test(send("CHAT -1 hi") == RateLimiter::Delay, "retry is still delayed");
+		test(limiter.getStrikes() == 1, "retry is no new strike");
+
+		now += SEC / 2;
+		test(send("CHAT -1 hi") == RateLimiter::Pass, "one token after half a second");
+		test(!limiter.isDelayed(), "delay is over");
+
+		// the class bucket runs dry before the general one
+		now += 10 * SEC;
+		test(send("REQUEST serverinfo") == RateLimiter::Pass, "first query");
+		test(send("REQUEST serverinfo") == RateLimiter::Pass, "second query");
+		test(send("REQUEST serverinfo") == RateLimiter::Delay, "third query waits for its class");
+
+		limiter.clearDelay();
+		test(send("CHAT -1 hi") == RateLimiter::Pass, "general command still passes");
+		test(send("SYNC 1") == RateLimiter::Pass, "SYNC always passes");
+
+		// refill is capped at the burst
+		now += 1000 * SEC;
+		passed = 0;
+		for (unsigned int i=0; i < 10; i++)
+			if (send("CHAT -1 hi") == RateLimiter::Pass)
+				passed++;
+		test(passed == 4, "idle time refills no more than the burst");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+class TestEscalation : public TestCaseRateLimiter
+{
+public:
+	TestEscalation() { setName("escalation"); };
+
+	bool run()
+	{
+		limits.rate[RateGeneral] = 1;
+		limits.burst[RateGeneral] = 1;
+
+		test(send("CHAT -1 hi") == RateLimiter::Pass, "burst");
+
+		// two strikes are delayed, each retried until a token arrives
+		for (unsigned int i=1; i <= 2; i++)
+		{
+			test(send("CHAT -1 hi") == RateLimiter::Delay, "delayed");
+			now += SEC;
+			test(send("CHAT -1 hi") == RateLimiter::Pass, "retry passes");
+		}
+
+		test(send("CHAT -1 hi") == RateLimiter::Refuse, "third strike is refused");
+		test(!limiter.isDelayed(), "refused command is not retried");
+		test(send("CHAT -1 hi") == RateLimiter::Refuse, "fourth strike is refused");
+		test(send("CHAT -1 hi") == RateLimiter::Disconnect, "fifth strike disconnects");
+		test(limiter.getStrikes() == 5, "five strikes");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+class TestForgive : public TestCaseRateLimiter
+{
+public:
+	TestForgive() { setName("forgiving strikes"); };
+
+	bool run()
+	{
+		limits.rate[RateGeneral] = 1;
+		limits.burst[RateGeneral] = 1;
+
+		send("CHAT -1 hi");
+		test(send("CHAT -1 hi") == RateLimiter::Delay, "strike");
+
+		now += 5 * SEC;
+		test(send("CHAT -1 hi") == RateLimiter::Pass, "passes after a pause");
+		test(limiter.getStrikes() == 1, "strike is kept within the forgive time");
+
+		now += 10 * SEC;
+		test(send("CHAT -1 hi") == RateLimiter::Pass, "passes again");
+		test(limiter.getStrikes() == 0, "strike is forgiven after the forgive time");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+int main(void)
+{
+	TestCase *tests[] = {
+		new TestCommandClass(),
+		new TestBuckets(),
+		new TestEscalation(),
+		new TestForgive(),
+	};
+
+	const unsigned int test_count = sizeof(tests) / sizeof(tests[0]);
+	unsigned int failed_tests = 0;
+
+	for (unsigned int i=0; i < test_count; i++)
+	{
+		TestCase *tc = tests[i];
+
+		const bool retval = tc->run();
+
+		cerr << "<<< END test (#" << (i+1) << ") " << tc->name() <<
+			": RESULT=" << (retval ? "ok" : "err") << " OK=" << tc->countSuccess() <<
+			" FAIL=" << tc->countFailed() << " <<<" << endl;
+
+		if (!retval)
+			failed_tests++;
+	}
+
+	cerr << endl << "Tests failed: " << failed_tests << " of " << test_count << endl;
+
+	return failed_tests ? 1 : 0;
+}
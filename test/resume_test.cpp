@@ -0,0 +1,232 @@
+/*
+ * Copyright 2008-2010, Dominik Geyer
+ *
+ * This file is part of HoldingNuts.
+ *
+ * HoldingNuts is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HoldingNuts is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HoldingNuts.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Dominik Geyer <dominik.geyer@holdingnuts.net>
+ */
+
+/* Resuming a session: the client's event count against the server's EventRing. */
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "EventRing.hpp"
+
+#include "TestCase.hpp"
+
+
+using namespace std;
+
+
+//! \brief One client session; lines go through the server's ring and the client's counter
+class TestCaseResume : public TestCase
+{
+public:
+	TestCaseResume()
+	{
+		setName("TestCaseResume");
+
+		ring.reset(16);
+		client_seq = 0;
+		connected = true;
+	};
+
+protected:
+	// line recorded by the server (event_record) and sent if the client is connected
+	void event(const string &line)
+	{
+		ring.push(line.c_str());
+		receive(line);
+	};
+
+	// line sent without recording it
+	void other(const string &line)
+	{
+		receive(line);
+	};
+
+	// spectator payload as queued by spectator_flush; every line was recorded
+	void spectatorBatch(const string &payload)
+	{
+		string::size_type start = 0, end;
+		while ((end = payload.find("\r\n", start)) != string::npos)
+		{
+			event(payload.substr(start, end - start));
+			start = end + 2;
+		}
+	};
+
+	void receive(const string &line)
+	{
+		if (!connected)
+			return;
+
+		received.push_back(line);
+		if (EventRing::isEvent(line.c_str()))
+			client_seq++;
+	};
+
+	// reconnect and check that the replay continues exactly where the client stopped
+	bool resume(const vector<string> &expected)
+	{
+		connected = true;
+
+		vector<const string*> missed;
+		if (!ring.getSince(client_seq, missed))
+			return false;
+
+		if (missed.size() != expected.size())
+			return false;
+
+		for (unsigned int i=0; i < missed.size(); i++)
+		{
+			if (*missed[i] != expected[i])
+				return false;
+			receive(*missed[i]);
+		}
+
+		return client_seq == ring.getSeq();
+	};
+
+	EventRing ring;
+	unsigned int client_seq;
+	bool connected;
+	vector<string> received;
+};
+
+
+class TestCountingRule : public TestCaseResume
+{
+public:
+	TestCountingRule() { setName("counting rule"); };
+
+	bool run()
+	{
+		test(EventRing::isEvent("SNAP 1:0 1 3:1 2:2 1"), "table snapshot");
+		test(EventRing::isEvent("SNAP -1:-1 1 1 +4 \"bob\""), "foyer snapshot");
+		test(EventRing::isEvent("MSG 1:-1 game Game started"), "game message");
+		test(EventRing::isEvent("MSG 1:0:4 \"bob\" hi"), "table chat");
+		test(!EventRing::isEvent("MSG -1 foyer Warning"), "foyer message");
+		test(!EventRing::isEvent("MSG 4 \"bob\" hi"), "private chat");
+		test(!EventRing::isEvent("MSG 4 \"a:b\" hi"), "colon in the sender name");
+		test(!EventRing::isEvent("PSERVER 1 4 0"), "introduction");
+		test(!EventRing::isEvent("OK 3 1"), "response");
+		test(!EventRing::isEvent("SNAPSHOT"), "whole word must match");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+class TestResumeForeignTraffic : public TestCaseResume
+{
+public:
+	TestResumeForeignTraffic() { setName("resume after foyer and spectator traffic"); };
+
+	bool run()
+	{
+		event("SNAP -1:-1 2 0 4 \"bob\"");
+		event("SNAP 1:0 1 state");
+		other("OK 1");
+		spectatorBatch("SNAP 2:0 5 1 4\r\nSNAP 2:0 1 state\r\n");
+		event("MSG 1:-1 game Next hand");
+		other("MSG 5 \"eve\" hi");
+		test(client_seq == ring.getSeq(), "client counts every recorded line");
+
+		connected = false;
+
+		vector<string> missed;
+		missed.push_back("SNAP -1:-1 1 +6 \"ann\"");
+		missed.push_back("SNAP 2:0 5 2 6");
+		missed.push_back("SNAP 1:0 1 state");
+		missed.push_back("SNAP 2:0 1 state");
+		missed.push_back("MSG 1:0:4 \"bob\" gg");
+
+		event(missed[0]);
+		spectatorBatch(missed[1] + "\r\n");
+		event(missed[2]);
+		spectatorBatch(missed[3] + "\r\n");
+		other("MSG -1 foyer Server restarts");
+		event(missed[4]);
+
+		test(resume(missed), "replay is exactly the missed lines");
+
+		event("SNAP 1:0 1 state");
+		test(client_seq == ring.getSeq(), "counting continues after the replay");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+class TestResumeGap : public TestCaseResume
+{
+public:
+	TestResumeGap() { setName("gap larger than the ring"); };
+
+	bool run()
+	{
+		event("SNAP 1:0 1 state");
+		connected = false;
+
+		for (unsigned int i=0; i < 16; i++)
+			spectatorBatch("SNAP 2:0 1 state\r\n");
+
+		vector<const string*> missed;
+		test(ring.getSince(client_seq, missed), "full ring still replays");
+
+		event("SNAP -1:-1 2 -4");
+		missed.clear();
+		test(!ring.getSince(client_seq, missed), "one more needs a keyframe");
+		test(!ring.getSince(ring.getSeq() + 1, missed), "sequence from the future needs a keyframe");
+
+		return (countFailed() == 0);
+	};
+};
+
+
+int main(void)
+{
+	TestCase *tests[] = {
+		new TestCountingRule(),
+		new TestResumeForeignTraffic(),
+		new TestResumeGap(),
+	};
+
+	const unsigned int test_count = sizeof(tests) / sizeof(tests[0]);
+	unsigned int failed_tests = 0;
+
+	for (unsigned int i=0; i < test_count; i++)
+	{
+		TestCase *tc = tests[i];
+
+		const bool retval = tc->run();
+
+		cerr << "<<< END test (#" << (i+1) << ") " << tc->name() <<
+			": RESULT=" << (retval ? "ok" : "err") << " OK=" << tc->countSuccess() <<
+			" FAIL=" << tc->countFailed() << " <<<" << endl;
+
+		if (!retval)
+			failed_tests++;
+	}
+
+	cerr << endl << "Tests failed: " << failed_tests << " of " << test_count << endl;
+
+	return failed_tests ? 1 : 0;
+}